@@ -31,11 +31,14 @@
 #include "global_config.h"
 #include "rbh_cfg_helpers.h"
 #include "chglog_reader.h"
+#include "cl_spill.h"
+#include "cl_capture.h"
 
 #include <pthread.h>
 #include <errno.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <glib.h>
 #include "lustre_extended_types.h"
 
@@ -47,6 +50,10 @@
 /* for logs */
 #define CHGLOG_TAG  "ChangeLog"
 
+/* counters updated by several decoder threads */
+#define ATOMIC_ADD(_var, _val) (__sync_fetch_and_add(&(_var), (_val)))
+#define ATOMIC_SUB(_var, _val) (__sync_fetch_and_sub(&(_var), (_val)))
+
 struct rec_stats {
     /** index of the record */
     uint64_t        rec_id;
@@ -81,6 +88,56 @@ static void update_rec_stats(struct rec_stats *rs, CL_REC_TYPE *logrec)
     }
 }
 
+struct reader_thr_info_t;
+
+/** a changelog record handed over to a decoding partition */
+typedef struct cl_work_item {
+    CL_REC_TYPE        *rec;
+    unsigned int        flags;  /**< insert_into_hash() flags */
+    bool                filter; /**< check if the record can be ignored */
+    bool                counted; /**< already counted as interesting */
+    unsigned long long  seq;    /**< order of the record in the reader */
+} cl_work_item_t;
+
+/**
+ * Decoding partition of a reader thread. Records are dispatched to
+ * partitions by FID hash, so the records about a given entry are always
+ * processed in order by the same decoder thread.
+ */
+typedef struct cl_partition_t {
+    /** reader this partition belongs to */
+    struct reader_thr_info_t *reader;
+
+    /** decoder thread (if the reader has several partitions) */
+    pthread_t thr_id;
+
+    /** protects the work queue, the stop flag and the pending operations
+     * (records are decoded with this lock held) */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    /** records waiting to be decoded (circular buffer) */
+    cl_work_item_t *work;
+    unsigned int work_size;
+    unsigned int work_first;
+    unsigned int work_count;
+
+    /** decoder thread is running */
+    bool started;
+    /** decoder thread was asked to stop */
+    bool stop;
+
+    /** Queue of pending changelogs to push to the pipeline. */
+    struct rh_list_head op_queue;
+
+    /** Store the ops for easier access. Each element in the hash
+     * table is also in the op_queue list. This hash table doesn't
+     * need a lock per slot since there is only one decoder per
+     * partition. The slot counts won't be used either. */
+    struct id_hash *id_hash;
+
+} cl_partition_t;
+
 /* reader thread info, one per MDT */
 typedef struct reader_thr_info_t {
     /** reader thread index */
@@ -102,6 +159,16 @@ typedef struct reader_thr_info_t {
     /** number of suppressed/merged records */
     unsigned long long suppressed_records;
 
+    /** number of records folded into (or cancelled with) another one */
+    unsigned long long folded_records;
+
+    /** number of operations pushed to the pipeline */
+    unsigned long long pushed_ops;
+
+    /** number of records saved to/replayed from the spill file */
+    unsigned long long spilled_records;
+    unsigned long long replayed_records;
+
     /** last record read from the changelog */
     struct rec_stats last_read;
     /** last record pushed to the pipeline */
@@ -119,18 +186,45 @@ typedef struct reader_thr_info_t {
     /** thread was asked to stop */
     unsigned int force_stop:1;
 
+    /** time the reader started */
+    time_t start_time;
+
+    /** spill file (NULL if spill_dir is not set) */
+    cl_spill_t *spill;
+    /** new records go to the spill file */
+    bool spilling;
+    /** all records older than the spilled ones have been read */
+    bool spill_caught_up;
+    /** spilled records can be cleared from the changelog */
+    bool spill_clearable;
+    /** last record read before spilling */
+    uint64_t spill_start;
+    /** records appended since the last sync of the spill file */
+    unsigned int spill_unsynced;
+    time_t spill_sync_time;
+
+    /** serializes changelog clearing, and protects the spill state it
+     * reads (spill_clearable, spill->synced_idx) */
+    pthread_mutex_t clear_lock;
+
+    /** records are saved to this file (NULL if capture_file is not set) */
+    cl_capture_t *capture;
+    /** records are read from this file instead of the MDT changelog
+     * (NULL if replay_file is not set) */
+    cl_capture_t *replay;
+
     /** log handler */
     void *chglog_hdlr;
 
-    /** Queue of pending changelogs to push to the pipeline. */
-    struct rh_list_head op_queue;
-    unsigned int op_queue_count;
+    /** decoding partitions (1 per decoder thread) */
+    cl_partition_t *parts;
+    unsigned int nb_parts;
 
-    /** Store the ops for easier access. Each element in the hash
-     * table is also in the op_queue list. This hash table doesn't
-     * need a lock per slot since there is only one reader. The
-     * slot counts won't be used either. */
-    struct id_hash *id_hash;
+    /** sequence number of the next dispatched record */
+    unsigned long long next_seq;
+
+    /** number of pending changelogs in the partition queues */
+    volatile unsigned int op_queue_count;
 
     ull_t cl_counters[CL_LAST]; /* since program start time */
     ull_t cl_reported[CL_LAST]; /* last reported stat (for incremental diff) */
@@ -162,6 +256,10 @@ static int log_close(reader_thr_info_t *p_info)
 {
     int rc;
 
+    /* not opened (replay of a capture file) */
+    if (p_info->chglog_hdlr == NULL)
+        return 0;
+
     /* close the log and clear input buffers */
     rc = llapi_changelog_fini(&p_info->chglog_hdlr);
 
@@ -202,11 +300,26 @@ static int clear_changelog_records(reader_thr_info_t *p_info)
 {
     int rc;
     const char *reader_id;
+    uint64_t rec_id;
+
+    P(p_info->clear_lock);
+    rec_id = p_info->last_commit.rec_id;
 
-    if (p_info->last_commit.rec_id == 0) {
+    /* records saved to the spill file can be cleared as well */
+    if (p_info->spill_clearable && p_info->spill->synced_idx > rec_id)
+        rec_id = p_info->spill->synced_idx;
+
+    if (rec_id == 0) {
         /* No record was ever committed. Stop here because calling
          * llapi_changelog_clear() with record 0 will clear all
          * records, leading to a potential record loss. */
+        V(p_info->clear_lock);
+        return 0;
+    }
+
+    /* already cleared (e.g. replay of spilled records) */
+    if (rec_id <= p_info->last_clear.rec_id) {
+        V(p_info->clear_lock);
         return 0;
     }
 
@@ -214,27 +327,31 @@ static int clear_changelog_records(reader_thr_info_t *p_info)
 
     DisplayLog(LVL_DEBUG, CHGLOG_TAG,
                "%s: acknowledging ChangeLog records up to #%"PRIu64,
-               p_info->mdtdevice, p_info->last_commit.rec_id);
+               p_info->mdtdevice, rec_id);
+
+    /* records replayed from a file: there is no changelog to clear */
+    if (p_info->replay != NULL)
+        goto cleared;
 
     DisplayLog(LVL_FULL, CHGLOG_TAG, "llapi_changelog_clear('%s', '%s', %"PRIu64")",
-               p_info->mdtdevice, reader_id,
-               p_info->last_commit.rec_id);
+               p_info->mdtdevice, reader_id, rec_id);
 
-    rc = llapi_changelog_clear(p_info->mdtdevice, reader_id,
-                               p_info->last_commit.rec_id);
+    rc = llapi_changelog_clear(p_info->mdtdevice, reader_id, rec_id);
 
     if (rc) {
         DisplayLog(LVL_CRIT, CHGLOG_TAG,
                    "ERROR: llapi_changelog_clear(\"%s\", \"%s\", %"PRIu64") "
-                   "returned %d", p_info->mdtdevice, reader_id,
-                   p_info->last_commit.rec_id, rc);
+                   "returned %d", p_info->mdtdevice, reader_id, rec_id, rc);
+        V(p_info->clear_lock);
         return rc;
     }
 
+ cleared:
     /* update info about last cleared record */
-    p_info->last_clear.rec_id = p_info->last_commit.rec_id;
+    p_info->last_clear.rec_id = rec_id;
     p_info->last_clear.rec_time =  p_info->last_commit.rec_time;
     gettimeofday(&p_info->last_clear.step_time, NULL);
+    V(p_info->clear_lock);
 
     return 0;
 }
@@ -438,6 +555,9 @@ static int log_record_callback(lmgr_t *lmgr, struct entry_proc_op_t *pop,
         return EINVAL;
     }
 
+    DisplayLog(LVL_FULL, CHGLOG_TAG, "%s: record #%llu of "DFID" applied",
+               info->mdtdevice, logrec->cr_index, PFID(&logrec->cr_tfid));
+
     /* update info about the last committed record */
     update_rec_stats(&info->last_commit, logrec);
 
@@ -450,12 +570,16 @@ static int log_record_callback(lmgr_t *lmgr, struct entry_proc_op_t *pop,
      *      - batch_ack_count = 1 (i.e. acknowledge every record).
      *      - we reached the last pushed record.
      *      - if the delta to last cleared record is high enough.
+     *      - if the last clear is older than batch_ack_delay.
      * do nothing in all other cases:
      */
     if ((cl_reader_config.batch_ack_count > 1)
         && (logrec->cr_index < info->last_push.rec_id)
         && ((logrec->cr_index - info->last_clear.rec_id)
-            < cl_reader_config.batch_ack_count)) {
+            < cl_reader_config.batch_ack_count)
+        && (info->last_commit.step_time.tv_sec
+            - info->last_clear.step_time.tv_sec
+            < cl_reader_config.batch_ack_delay)) {
         DisplayLog(LVL_FULL, CHGLOG_TAG, "callback - %s cl_record: %llu, "
                    "last_cleared: %"PRIu64", last_pushed: %"PRIu64,
                    info->mdtdevice, logrec->cr_index,
@@ -594,19 +718,26 @@ static void dump_record(int debug_level, const char *mdt,
 static void dump_op_queue(reader_thr_info_t *p_info, int debug_level, int num)
 {
     entry_proc_op_t *op;
+    unsigned int i;
 
     if (log_config.debug_level < debug_level || num == 0)
         return;
 
-    rh_list_for_each_entry_reverse(op, &p_info->op_queue, list) {
-        dump_record(debug_level, p_info->mdtdevice,
-                    op->extra_info.log_record.p_log_rec);
+    for (i = 0; i < p_info->nb_parts && num != 0; i++) {
+        cl_partition_t *part = &p_info->parts[i];
+
+        P(part->lock);
+        rh_list_for_each_entry_reverse(op, &part->op_queue, list) {
+            dump_record(debug_level, p_info->mdtdevice,
+                        op->extra_info.log_record.p_log_rec);
 
-        if (num != -1) {
-            num--;
-            if (num == 0)
-                return;
+            if (num != -1) {
+                num--;
+                if (num == 0)
+                    break;
+            }
         }
+        V(part->lock);
     }
 }
 
@@ -638,27 +769,114 @@ static void set_name(CL_REC_TYPE *logrec, entry_proc_op_t *p_op)
     }
 }
 
-/* Push the oldest (all=FALSE) or all (all=TRUE) entries into the pipeline. */
-static void process_op_queue(reader_thr_info_t *p_info, bool push_all)
+/**
+ * Get the sequence number of the oldest record held by a partition,
+ * decoded (in op_queue) or not (in the work queue).
+ * Must be called with the partition lock held.
+ * @param[out] decoded  whether this record has been decoded.
+ * @return ULLONG_MAX if the partition holds no record.
+ */
+static unsigned long long part_oldest_seq(cl_partition_t *part, bool *decoded)
+{
+    unsigned long long seq = ULLONG_MAX;
+
+    *decoded = false;
+
+    if (!rh_list_empty(&part->op_queue)) {
+        entry_proc_op_t *op =
+            rh_list_first_entry(&part->op_queue, entry_proc_op_t, list);
+
+        seq = op->extra_info.log_record.seq;
+        *decoded = true;
+    }
+
+    /* records are dispatched in order, so the first one is the oldest */
+    if (part->work_count > 0 && part->work[part->work_first].seq < seq) {
+        seq = part->work[part->work_first].seq;
+        *decoded = false;
+    }
+    return seq;
+}
+
+/**
+ * Get the partition holding the oldest pending record, and wait for this
+ * record to be decoded. Only this partition is waited for: the others keep
+ * on decoding meanwhile.
+ * @return the partition, locked, with the oldest operation at the head of
+ *         its queue, or NULL if no record is pending.
+ */
+static cl_partition_t *lock_oldest_partition(reader_thr_info_t *p_info)
+{
+    for (;;) {
+        cl_partition_t *oldest = NULL;
+        unsigned long long oldest_seq = ULLONG_MAX;
+        unsigned long long seq;
+        bool decoded;
+        unsigned int i;
+
+        for (i = 0; i < p_info->nb_parts; i++) {
+            cl_partition_t *part = &p_info->parts[i];
+
+            P(part->lock);
+            seq = part_oldest_seq(part, &decoded);
+            V(part->lock);
+
+            if (seq < oldest_seq) {
+                oldest = part;
+                oldest_seq = seq;
+            }
+        }
+
+        if (oldest == NULL)
+            return NULL;
+
+        /* Records are only dispatched by the reader thread (the caller),
+         * so the other partitions can't get an older record meanwhile. */
+        P(oldest->lock);
+        for (;;) {
+            seq = part_oldest_seq(oldest, &decoded);
+            if (seq != oldest_seq || decoded)
+                break;
+            pthread_cond_wait(&oldest->cond, &oldest->lock);
+        }
+
+        if (seq == oldest_seq)
+            return oldest;
+
+        /* the record has been dropped or folded: look again */
+        V(oldest->lock);
+    }
+}
+
+/* Push the oldest (all=FALSE) or all (all=TRUE) entries into the pipeline.
+ * Operations of all partitions are merged by sequence number, so they are
+ * pushed in the order records were read.
+ * If nowait is set, stop as soon as the pipeline is full. */
+static void process_op_queue(reader_thr_info_t *p_info, bool push_all,
+                             bool nowait)
 {
     time_t oldest = time(NULL) - cl_reader_config.queue_max_age;
     CL_REC_TYPE *rec;
+    cl_partition_t *part;
 
     DisplayLog(LVL_FULL, CHGLOG_TAG, "processing changelog queue");
 
-    while (!rh_list_empty(&p_info->op_queue)) {
+    while ((part = lock_oldest_partition(p_info)) != NULL) {
         entry_proc_op_t *op =
-            rh_list_first_entry(&p_info->op_queue, entry_proc_op_t, list);
+            rh_list_first_entry(&part->op_queue, entry_proc_op_t, list);
 
         /* Stop when the queue is below our limit, and when the oldest
          * element is still new enough. */
         if (!push_all &&
             (p_info->op_queue_count < cl_reader_config.queue_max_size) &&
-            (op->timestamp.changelog_inserted > oldest))
+            (op->timestamp.changelog_inserted > oldest)) {
+            V(part->lock);
             break;
+        }
 
         rh_list_del(&op->list);
         rh_list_del(&op->id_hash_list);
+        V(part->lock);
 
         rec = op->extra_info.log_record.p_log_rec;
         DisplayLog(LVL_FULL, CHGLOG_TAG, "pushing cl record #%llu: age=%ld",
@@ -669,10 +887,21 @@ static void process_op_queue(reader_thr_info_t *p_info, bool push_all)
          * in pipeline for stage locking. */
         set_name(rec, op);
         /* Push the entry to the pipeline */
-        EntryProcessor_Push(op);
+        if (!nowait) {
+            EntryProcessor_Push(op);
+        } else if (EntryProcessor_TryPush(op) != 0) {
+            /* put it back at the head of the queues */
+            P(part->lock);
+            rh_list_add(&op->list, &part->op_queue);
+            rh_list_add(&op->id_hash_list,
+                        &get_hash_slot(part->id_hash, &op->entry_id)->list);
+            V(part->lock);
+            break;
+        }
 
         update_rec_stats(&p_info->last_push, rec);
-        p_info->op_queue_count--;
+        p_info->pushed_ops++;
+        ATOMIC_SUB(p_info->op_queue_count, 1);
     }
 }
 
@@ -683,10 +912,11 @@ static void process_op_queue(reader_thr_info_t *p_info, bool push_all)
                                        the last one. */
 #define GET_FID_FROM_DB     0x0004  /* fid is not valid, get it from DB */
 
-/* Insert the operation into the internal hash table. */
-static int insert_into_hash(reader_thr_info_t *p_info, CL_REC_TYPE *p_rec,
-                            unsigned int flags)
+/* Insert the operation into the internal hash table of a partition. */
+static int insert_into_hash(cl_partition_t *part, CL_REC_TYPE *p_rec,
+                            unsigned int flags, unsigned long long seq)
 {
+    reader_thr_info_t *p_info = part->reader;
     entry_proc_op_t *op;
     struct id_hash_slot *slot;
 
@@ -704,6 +934,8 @@ static int insert_into_hash(reader_thr_info_t *p_info, CL_REC_TYPE *p_rec,
     op->extra_info_is_set = 1;
     op->extra_info.is_changelog_record = 1;
     op->extra_info.log_record.p_log_rec = p_rec;
+    op->extra_info.log_record.seq = seq;
+    op->extra_info.log_record.folded_types = 0;
 
     /* set mdt name */
     op->extra_info.log_record.mdt =
@@ -730,16 +962,25 @@ static int insert_into_hash(reader_thr_info_t *p_info, CL_REC_TYPE *p_rec,
 
     /* Add the entry on the pending queue ... */
     op->timestamp.changelog_inserted = time(NULL);
-    rh_list_add_tail(&op->list, &p_info->op_queue);
-    p_info->op_queue_count++;
+    rh_list_add_tail(&op->list, &part->op_queue);
+    ATOMIC_ADD(p_info->op_queue_count, 1);
 
     /* ... and the hash table. */
-    slot = get_hash_slot(p_info->id_hash, &op->entry_id);
+    slot = get_hash_slot(part->id_hash, &op->entry_id);
     rh_list_add_tail(&op->id_hash_list, &slot->list);
 
     return 0;
 }
 
+/* Records that only change attributes of an entry */
+#define DATA_CHANGE_MASK   (1<<CL_TRUNC | 1<<CL_CLOSE | 1<<CL_MTIME)
+#define META_CHANGE_MASK   (1<<CL_CTIME | 1<<CL_SETATTR)
+#define ATTR_CHANGE_MASK   (DATA_CHANGE_MASK | META_CHANGE_MASK | 1<<CL_OPEN \
+                            | 1<<CL_ATIME | 1<<CL_XATTR)
+/* Records that can be cancelled with the create/unlink sequence
+ * they belong to. */
+#define CANCEL_TRANSPARENT_MASK (ATTR_CHANGE_MASK | 1<<CL_RENAME | 1<<CL_EXT)
+
 /* Describes which records can be safely ignored. By default a record
  * is never ignored. It is only necessary to add an entry in this
  * table if the record may be skipped (and thus has a mask defined) or
@@ -752,6 +993,9 @@ static const struct {
         IGNORE_ALWAYS
     } ignore;
     unsigned int ignore_mask;
+    /* if fold_records is enabled, previous records of these types can
+     * absorb this one (its type is then added to their folded_types) */
+    unsigned int fold_mask;
 } record_filters[CL_LAST] = {
 
     /* Record we don't care about. */
@@ -764,21 +1008,24 @@ static const struct {
      * operation is a CLOSE, drop it if we find a previous
      * TRUNC/CLOSE/MTIME or CREATE for the same FID. */
     [CL_TRUNC] = { IGNORE_MASK, 1<<CL_TRUNC | 1<<CL_CLOSE | 1<<CL_MTIME
-                   | 1<<CL_CREATE },
+                   | 1<<CL_CREATE, META_CHANGE_MASK },
     [CL_CLOSE] = { IGNORE_MASK, 1<<CL_TRUNC | 1<<CL_CLOSE | 1<<CL_MTIME
-                   | 1<<CL_CREATE },
+                   | 1<<CL_CREATE, META_CHANGE_MASK },
     [CL_MTIME] = { IGNORE_MASK, 1<<CL_TRUNC | 1<<CL_CLOSE | 1<<CL_MTIME
-                   | 1<<CL_CREATE | 1<<CL_MKNOD | 1<<CL_MKDIR },
+                   | 1<<CL_CREATE | 1<<CL_MKNOD | 1<<CL_MKDIR,
+                   META_CHANGE_MASK },
 
     /* Similar operations (metadata changes). */
     [CL_CTIME] = { IGNORE_MASK, 1<<CL_CTIME | 1<<CL_SETATTR | 1<<CL_CREATE
-                   | 1<<CL_MKNOD | 1<<CL_MKDIR },
+                   | 1<<CL_MKNOD | 1<<CL_MKDIR, DATA_CHANGE_MASK },
     [CL_SETATTR] = { IGNORE_MASK, 1<<CL_CTIME | 1<<CL_SETATTR | 1<<CL_CREATE
-                   | 1<<CL_MKNOD | 1<<CL_MKDIR },
+                   | 1<<CL_MKNOD | 1<<CL_MKDIR, DATA_CHANGE_MASK },
 
     /* Note: no need to check UNLINK_LAST or HSM flags: if unlink comes just
      * after create, there was no HARDLINK or HSM event in between, so we can
-     * safely cancel the create without missing anything. */
+     * safely cancel the create without missing anything.
+     * If fold_records is enabled, records of CANCEL_TRANSPARENT_MASK in
+     * between are cancelled too. */
     [CL_UNLINK] = { IGNORE_CANCEL, 1<<CL_CREATE | 1<<CL_MKNOD },
     [CL_RMDIR] = { IGNORE_CANCEL, 1<<CL_MKDIR },
 };
@@ -787,14 +1034,15 @@ static const struct {
 /* Special case for CL records is reserved to HSM
  *
  */
-static bool can_ignore_hsm_record(reader_thr_info_t *p_info,
+static bool can_ignore_hsm_record(cl_partition_t *part,
                               const CL_REC_TYPE *logrec_in)
 {
+    reader_thr_info_t *p_info = part->reader;
     entry_proc_op_t *op, *t1;
     struct id_hash_slot *slot;
     char flag_buff[256] = "";
 
-    slot = get_hash_slot(p_info->id_hash, &logrec_in->cr_tfid);
+    slot = get_hash_slot(part->id_hash, &logrec_in->cr_tfid);
     rh_list_for_each_entry_safe_reverse(op, t1, &slot->list, id_hash_list) {
         CL_REC_TYPE *logrec = op->extra_info.log_record.p_log_rec;
 
@@ -812,10 +1060,10 @@ static bool can_ignore_hsm_record(reader_thr_info_t *p_info,
             /* free and remove previous record */
             rh_list_del(&op->list);
             rh_list_del(&op->id_hash_list);
-            p_info->op_queue_count--;
+            ATOMIC_SUB(p_info->op_queue_count, 1);
             EntryProcessor_Release(op);
             /* removed record was previously counted as interesting */
-            p_info->interesting_records--;
+            ATOMIC_SUB(p_info->interesting_records, 1);
 
             return false;
         }
@@ -824,28 +1072,103 @@ static bool can_ignore_hsm_record(reader_thr_info_t *p_info,
 }
 #endif
 
+/* Remove a queued operation that has been folded with a new record. */
+static void drop_queued_op(reader_thr_info_t *p_info, entry_proc_op_t *op)
+{
+    rh_list_del(&op->list);
+    rh_list_del(&op->id_hash_list);
+    ATOMIC_SUB(p_info->op_queue_count, 1);
+    ATOMIC_ADD(p_info->folded_records, 1);
+    /* removed record was previously counted as interesting */
+    ATOMIC_SUB(p_info->interesting_records, 1);
+    EntryProcessor_Release(op);
+}
+
+/* Compare the parent and name of 2 changelog records. */
+static bool same_cl_name(const CL_REC_TYPE *rec1, const CL_REC_TYPE *rec2)
+{
+    const char *name1 = rh_get_cl_cr_name((CL_REC_TYPE *)rec1);
+    const char *name2 = rh_get_cl_cr_name((CL_REC_TYPE *)rec2);
+    size_t len1 = strnlen(name1, rec1->cr_namelen);
+    size_t len2 = strnlen(name2, rec2->cr_namelen);
+
+    return entry_id_equal(&rec1->cr_pfid, &rec2->cr_pfid)
+        && len1 == len2 && !memcmp(name1, name2, len1);
+}
+
+/* A renamed entry is renamed again while the RNMTO (CL_EXT) record of its
+ * previous rename is still queued: the intermediate name will never be
+ * seen, so drop the RNMTO record along with the new RNMFRM record.
+ * Returns TRUE if the new record can be ignored.
+ */
+static bool fold_rename_chain(cl_partition_t *part,
+                              const CL_REC_TYPE *logrec_in)
+{
+    reader_thr_info_t *p_info = part->reader;
+    entry_proc_op_t *op, *t1;
+    struct id_hash_slot *slot;
+
+    slot = get_hash_slot(part->id_hash, &logrec_in->cr_tfid);
+    rh_list_for_each_entry_safe_reverse(op, t1, &slot->list, id_hash_list) {
+        CL_REC_TYPE *logrec = op->extra_info.log_record.p_log_rec;
+
+        if (!entry_id_equal(&logrec->cr_tfid, &logrec_in->cr_tfid))
+            continue;
+
+        /* attribute changes don't matter */
+        if (ATTR_CHANGE_MASK & (1 << logrec->cr_type))
+            continue;
+
+        /* any other namespace change must be kept */
+        if (logrec->cr_type != CL_EXT || !same_cl_name(logrec, logrec_in))
+            return false;
+
+        DisplayChangelogs("(folded rename chain %s:%llu; %s:%llu)",
+                          p_info->mdtdevice, logrec->cr_index,
+                          p_info->mdtdevice, logrec_in->cr_index);
+        drop_queued_op(p_info, op);
+        ATOMIC_ADD(p_info->folded_records, 1);
+        return true;
+    }
+    return false;
+}
+
 /* Decides whether a new changelog record can be ignored. Ignoring a
  * record should not impact the database state, however the gain is to:
  *  - reduce contention on pipeline stages with constraints,
  *  - reduce the number of DB and FS requests.
+ * folded is set if the record was folded with queued ones (it is then
+ * counted in folded_records).
  *
  * Returns TRUE or FALSE.
  */
-static bool can_ignore_record(reader_thr_info_t *p_info,
-                              const CL_REC_TYPE *logrec_in)
+static bool can_ignore_record(cl_partition_t *part,
+                              const CL_REC_TYPE *logrec_in, bool *folded)
 {
+    reader_thr_info_t *p_info = part->reader;
     entry_proc_op_t *op, *t1;
+    entry_proc_op_t *fold_op = NULL;
+    entry_proc_op_t *cancel_op = NULL;
     unsigned int ignore_mask;
+    unsigned int fold_mask = 0;
     struct id_hash_slot *slot;
     char flag_buff[256] = "";
 
+    *folded = false;
+
 #ifdef _LUSTRE_HSM
     // Function for handling duplicate HSM events
     if (logrec_in->cr_type == CL_HSM) {
-        return can_ignore_hsm_record(p_info, logrec_in);
+        return can_ignore_hsm_record(part, logrec_in);
     }
 #endif
 
+    if (logrec_in->cr_type == CL_RENAME) {
+        *folded = cl_reader_config.fold_records
+            && fold_rename_chain(part, logrec_in);
+        return *folded;
+    }
+
     if (record_filters[logrec_in->cr_type].ignore == IGNORE_NEVER)
         return false;
 
@@ -861,8 +1184,10 @@ static bool can_ignore_record(reader_thr_info_t *p_info,
      * changelog record must be set. All the changelog record with the
      * same FID will go into the same bucket, so parse that slot
      * instead of the whole op_queue list. */
-    slot = get_hash_slot(p_info->id_hash, &logrec_in->cr_tfid);
+    slot = get_hash_slot(part->id_hash, &logrec_in->cr_tfid);
     ignore_mask = record_filters[logrec_in->cr_type].ignore_mask;
+    if (cl_reader_config.fold_records)
+        fold_mask = record_filters[logrec_in->cr_type].fold_mask;
 
     rh_list_for_each_entry_safe_reverse(op, t1, &slot->list, id_hash_list) {
         CL_REC_TYPE *logrec = op->extra_info.log_record.p_log_rec;
@@ -876,9 +1201,16 @@ static bool can_ignore_record(reader_thr_info_t *p_info,
                    CL_BASE_ARG(p_info->mdtdevice, logrec));
 
         if (record_filters[logrec_in->cr_type].ignore == IGNORE_CANCEL) {
-            /* If there is a non-cancellable record in between, we cannot merge
-             * and cancel the whole sequence. */
             if ((ignore_mask & (1 << logrec->cr_type)) == 0) {
+                /* Records about the entry life between create and unlink
+                 * can be cancelled with them. */
+                if (cl_reader_config.fold_records
+                    && (CANCEL_TRANSPARENT_MASK & (1 << logrec->cr_type))) {
+                    cancel_op = op;
+                    continue;
+                }
+                /* If there is a non-cancellable record in between, we
+                 * cannot merge and cancel the whole sequence. */
                 DisplayLog(LVL_FULL, CHGLOG_TAG, "-> Significant record "
                    "between create/unlink sequence: peer must be kept");
                 return false;
@@ -889,13 +1221,28 @@ static bool can_ignore_record(reader_thr_info_t *p_info,
             DisplayChangelogs("(dropped log peer %s:%llu; %s:%llu)",
                               p_info->mdtdevice, logrec->cr_index,
                               p_info->mdtdevice, logrec_in->cr_index);
+            if (cancel_op != NULL) {
+                /* also drop the records in between */
+                rh_list_for_each_entry_safe_reverse(cancel_op, t1,
+                                                    &slot->list,
+                                                    id_hash_list) {
+                    if (cancel_op == op)
+                        break;
+                    if (entry_id_equal(&cancel_op->extra_info.log_record.
+                                       p_log_rec->cr_tfid,
+                                       &logrec_in->cr_tfid))
+                        drop_queued_op(p_info, cancel_op);
+                }
+                ATOMIC_ADD(p_info->folded_records, 2);
+                *folded = true;
+            }
             /* free and remove previous record */
             rh_list_del(&op->list);
             rh_list_del(&op->id_hash_list);
-            p_info->op_queue_count--;
+            ATOMIC_SUB(p_info->op_queue_count, 1);
             EntryProcessor_Release(op);
             /* removed record was previously counted as interesting */
-            p_info->interesting_records--;
+            ATOMIC_SUB(p_info->interesting_records, 1);
             /* ignore second record as well */
             return true;
         }
@@ -924,6 +1271,28 @@ static bool can_ignore_record(reader_thr_info_t *p_info,
                               p_info->mdtdevice, logrec_in->cr_index);
             return true;
         }
+
+        /* remember the most recent record that can absorb this one */
+        if (fold_op == NULL && (fold_mask & (1 << logrec->cr_type)))
+            fold_op = op;
+    }
+
+    if (fold_op != NULL) {
+        CL_REC_TYPE *logrec = fold_op->extra_info.log_record.p_log_rec;
+
+        DisplayLog(LVL_FULL, CHGLOG_TAG, "-> Folded into record %llu",
+                   logrec->cr_index);
+        fold_op->extra_info.log_record.folded_types |=
+            1 << logrec_in->cr_type;
+        if (logrec_in->cr_index == logrec->cr_index + 1)
+            logrec->cr_index++;
+
+        DisplayChangelogs("(folded record %s:%llu into %s:%llu)",
+                          p_info->mdtdevice, logrec_in->cr_index,
+                          p_info->mdtdevice, logrec->cr_index);
+        ATOMIC_ADD(p_info->folded_records, 1);
+        *folded = true;
+        return true;
     }
 
     return false;
@@ -1075,6 +1444,109 @@ static CL_REC_TYPE *create_fake_rename_record(const reader_thr_info_t *p_info,
 }
 #endif
 
+/**
+ * Decode a record in its partition: drop it if it is redundant with
+ * a pending one, else add it to the partition queue.
+ */
+static void decode_rec(cl_partition_t *part, const cl_work_item_t *item)
+{
+    reader_thr_info_t *p_info = part->reader;
+    CL_REC_TYPE *p_rec = item->rec;
+
+    if (item->filter) {
+        bool folded;
+
+        /* This record might be of interest. But try to check whether it
+         * might create a duplicate operation anyway. */
+        if (can_ignore_record(part, p_rec, &folded)) {
+            DisplayLog(LVL_FULL, CHGLOG_TAG, "Ignoring event %s",
+                       changelog_type2str(p_rec->cr_type));
+            if (item->counted)
+                /* it was counted as interesting when it was read */
+                ATOMIC_SUB(p_info->interesting_records, 1);
+            /* folded records are already counted in folded_records */
+            if (!folded)
+                ATOMIC_ADD(p_info->suppressed_records, 1);
+            if (item->flags & PLR_FLG_FREE2)
+                free(p_rec);
+            else
+                llapi_changelog_free(&p_rec);
+            return;
+        }
+        if (!item->counted)
+            ATOMIC_ADD(p_info->interesting_records, 1);
+    }
+
+    insert_into_hash(part, p_rec, item->flags, item->seq);
+}
+
+/** a thread that decodes the records of a partition */
+static void *cl_decoder_thr(void *arg)
+{
+    cl_partition_t *part = (cl_partition_t *)arg;
+    cl_work_item_t item;
+
+    P(part->lock);
+    for (;;) {
+        while (part->work_count == 0 && !part->stop)
+            pthread_cond_wait(&part->cond, &part->lock);
+
+        if (part->work_count == 0)
+            /* stop requested and nothing left */
+            break;
+
+        item = part->work[part->work_first];
+        part->work_first = (part->work_first + 1) % part->work_size;
+        part->work_count--;
+
+        /* Decode with the lock held, so the reader can pick decoded
+         * operations from the partition queue at any time. */
+        decode_rec(part, &item);
+
+        /* wake up the reader (waiting for room or for a decoded record) */
+        pthread_cond_broadcast(&part->cond);
+    }
+    V(part->lock);
+
+    return NULL;
+}
+
+/**
+ * Hand over a record to the partition of its FID.
+ * @param filter  check if the record can be ignored.
+ * @param counted the record was already counted as interesting.
+ */
+static void dispatch_rec(reader_thr_info_t *p_info, CL_REC_TYPE *p_rec,
+                         unsigned int flags, bool filter, bool counted)
+{
+    cl_partition_t *part;
+    cl_work_item_t item = {
+        .rec = p_rec,
+        .flags = flags,
+        .filter = filter,
+        .counted = counted,
+        .seq = p_info->next_seq++,
+    };
+
+    /* single partition: decode it in the reader thread */
+    if (p_info->nb_parts <= 1) {
+        decode_rec(&p_info->parts[0], &item);
+        return;
+    }
+
+    part = &p_info->parts[hash_id(&p_rec->cr_tfid, p_info->nb_parts)];
+
+    P(part->lock);
+    while (part->work_count == part->work_size)
+        pthread_cond_wait(&part->cond, &part->lock);
+
+    part->work[(part->work_first + part->work_count) % part->work_size] =
+        item;
+    part->work_count++;
+    pthread_cond_broadcast(&part->cond);
+    V(part->lock);
+}
+
 /**
  * This handles a single log record.
  */
@@ -1095,17 +1567,18 @@ static int process_log_rec(reader_thr_info_t *p_info, CL_REC_TYPE *p_rec)
         return EINVAL;
     }
 
-    /* This record might be of interest. But try to check whether it
-     * might create a duplicate operation anyway. */
-    if (can_ignore_record(p_info, p_rec)) {
-        DisplayLog(LVL_FULL, CHGLOG_TAG, "Ignoring event %s",
-                   changelog_type2str(opnum));
-        p_info->suppressed_records++;
-        llapi_changelog_free(&p_rec);
+    /* Records that may be redundant with a pending one are filtered
+     * by the decoder of their partition. */
+    if (record_filters[opnum].ignore != IGNORE_NEVER
+#ifdef _LUSTRE_HSM
+        || opnum == CL_HSM
+#endif
+        ) {
+        dispatch_rec(p_info, p_rec, 0, true, false);
         goto done;
     }
 
-    p_info->interesting_records++;
+    ATOMIC_ADD(p_info->interesting_records, 1);
 
     if (p_rec->cr_type == CL_RENAME) {
         /* Ensure there is no pending rename. */
@@ -1147,7 +1620,7 @@ static int process_log_rec(reader_thr_info_t *p_info, CL_REC_TYPE *p_rec)
                 unlink = create_fake_unlink_record(p_info,
                                                    p_rec, &insert_flags);
                 if (unlink) {
-                    insert_into_hash(p_info, unlink, insert_flags);
+                    dispatch_rec(p_info, unlink, insert_flags, false, true);
                 } else {
                     DisplayLog(LVL_CRIT, CHGLOG_TAG,
                                "Could not allocate an UNLINK record.");
@@ -1177,7 +1650,7 @@ static int process_log_rec(reader_thr_info_t *p_info, CL_REC_TYPE *p_rec)
              */
             /* 1) build & push RNMFRM */
             p_rec2 = create_fake_rename_record(p_info, p_rec);
-            insert_into_hash(p_info, p_rec2, PLR_FLG_FREE2);
+            dispatch_rec(p_info, p_rec2, PLR_FLG_FREE2, true, true);
 
             /* 2) update RNMTO */
             p_rec->cr_type = CL_EXT;    /* CL_RENAME -> CL_RNMTO */
@@ -1186,7 +1659,7 @@ static int process_log_rec(reader_thr_info_t *p_info, CL_REC_TYPE *p_rec)
 #else
             p_rec->cr_tfid = p_rec->cr_sfid;    /* removed fid -> renamed fid */
 #endif
-            insert_into_hash(p_info, p_rec, 0);
+            dispatch_rec(p_info, p_rec, 0, false, true);
         } else
 #endif
         {
@@ -1229,7 +1702,7 @@ static int process_log_rec(reader_thr_info_t *p_info, CL_REC_TYPE *p_rec)
             unlink = create_fake_unlink_record(p_info, p_rec, &insert_flags);
 
             if (unlink) {
-                insert_into_hash(p_info, unlink, insert_flags);
+                dispatch_rec(p_info, unlink, insert_flags, false, true);
             } else {
                 DisplayLog(LVL_CRIT, CHGLOG_TAG,
                            "Could not allocate an UNLINK record.");
@@ -1252,12 +1725,12 @@ static int process_log_rec(reader_thr_info_t *p_info, CL_REC_TYPE *p_rec)
         /* indicate the target fid as the renamed entry */
         p_rec->cr_tfid = p_info->cl_rename->cr_tfid;
 
-        insert_into_hash(p_info, p_info->cl_rename, 0);
+        dispatch_rec(p_info, p_info->cl_rename, 0, true, true);
         p_info->cl_rename = NULL;
-        insert_into_hash(p_info, p_rec, 0);
+        dispatch_rec(p_info, p_rec, 0, false, true);
     } else {
         /* build the record to be processed in the pipeline */
-        insert_into_hash(p_info, p_rec, 0);
+        dispatch_rec(p_info, p_rec, 0, false, true);
     }
 
  done:
@@ -1272,7 +1745,10 @@ static cl_status_e cl_get_one(reader_thr_info_t *info, CL_REC_TYPE **pp_rec)
     int rc;
 
     /* get next record */
-    rc = llapi_changelog_recv(info->chglog_hdlr, pp_rec);
+    if (info->replay != NULL)
+        rc = cl_replay_next(info->replay, pp_rec);
+    else
+        rc = llapi_changelog_recv(info->chglog_hdlr, pp_rec);
 
     if (!EMPTY_STRING(log_config.changelogs_file) && rc != 0 && rc != 1) {
         DisplayChangelogs(">>> llapi_changelog_recv returned error %d "
@@ -1286,6 +1762,14 @@ static cl_status_e cl_get_one(reader_thr_info_t *info, CL_REC_TYPE **pp_rec)
         /* Successfully retrieved a record. Update last read record. */
         update_rec_stats(&info->last_read, *pp_rec);
         info->nb_read++;
+
+        if (info->capture != NULL
+            && cl_capture_write(info->capture, *pp_rec) != 0) {
+            DisplayLog(LVL_MAJOR, CHGLOG_TAG, "Stopping changelog capture");
+            cl_capture_close(info->capture);
+            MemFree(info->capture);
+            info->capture = NULL;
+        }
         return cl_ok;
 
     case -EINTR:
@@ -1298,6 +1782,22 @@ static cl_status_e cl_get_one(reader_thr_info_t *info, CL_REC_TYPE **pp_rec)
     case -EPROTO:  /* error in KUC channel */
     default:
 
+        /* end of the replayed records */
+        if (info->replay != NULL) {
+            double elapsed = time(NULL) - info->start_time;
+
+            DisplayLog(LVL_EVENT, CHGLOG_TAG, "%s: end of replay: %llu "
+                       "records read from %s in %.0fs (%.2f rec/sec)",
+                       info->mdtdevice, info->replay->count,
+                       info->replay->path, elapsed,
+                       elapsed > 0 ? info->replay->count / elapsed : 0.0);
+            return cl_stop;
+        }
+
+        /* no older record to read before replaying spilled records */
+        if (rc == 1)
+            info->spill_caught_up = true;
+
         /* warn if it is an error */
         if (rc != 1)
             DisplayLog(LVL_EVENT, CHGLOG_TAG,
@@ -1341,6 +1841,180 @@ static cl_status_e cl_get_one(reader_thr_info_t *info, CL_REC_TYPE **pp_rec)
     return cl_continue;
 }
 
+/** stop and wait for the decoder threads of a reader */
+static void stop_decoders(reader_thr_info_t *info)
+{
+    unsigned int i;
+
+    if (info->nb_parts <= 1)
+        return;
+
+    for (i = 0; i < info->nb_parts; i++) {
+        cl_partition_t *part = &info->parts[i];
+
+        P(part->lock);
+        part->stop = true;
+        pthread_cond_broadcast(&part->cond);
+        V(part->lock);
+    }
+
+    for (i = 0; i < info->nb_parts; i++) {
+        cl_partition_t *part = &info->parts[i];
+
+        if (part->started) {
+            pthread_join(part->thr_id, NULL);
+            part->started = false;
+        }
+    }
+}
+
+/** Is the DB stuck (nothing committed for spill_delay)? */
+static bool db_stuck(const reader_thr_info_t *info, time_t now)
+{
+    time_t last = info->last_commit.step_time.tv_sec;
+
+    if (last < info->start_time)
+        last = info->start_time;
+
+    return now - last >= cl_reader_config.spill_delay;
+}
+
+/**
+ * Manage the spill file of a reader: start spilling when the DB is stuck,
+ * replay spilled records when the pipeline can take them, periodically sync
+ * the spill file and clear the spilled records from the changelog.
+ */
+static void spill_step(reader_thr_info_t *info)
+{
+    cl_spill_t *spill = info->spill;
+    time_t now = time(NULL);
+    CL_REC_TYPE *rec;
+
+    P(info->clear_lock);
+    if (!info->spilling
+        && info->op_queue_count >= cl_reader_config.queue_max_size
+        && EntryProcessor_Saturated() && db_stuck(info, now)) {
+        DisplayLog(LVL_MAJOR, CHGLOG_TAG, "%s: no record committed to the "
+                   "database for %lds: saving new records to %s",
+                   info->mdtdevice, now - MAX(info->start_time,
+                                            info->last_commit.step_time.tv_sec),
+                   spill->path);
+        info->spilling = true;
+        info->spill_caught_up = true;
+        info->spill_clearable = false;
+        info->spill_start = info->last_read.rec_id;
+    }
+
+    /* Spilled records can only be cleared from the changelog once the
+     * records read before them have been committed. */
+    if (info->spilling && !info->spill_clearable && info->spill_caught_up
+        && info->last_commit.rec_id >= info->spill_start)
+        info->spill_clearable = true;
+    V(info->clear_lock);
+
+    /* replay spilled records while the pipeline can take them */
+    if (info->spilling && info->spill_caught_up) {
+        while (!cl_spill_empty(spill)
+               && info->op_queue_count < cl_reader_config.queue_max_size
+               && !EntryProcessor_Saturated()) {
+            rec = cl_spill_next(spill);
+            if (rec == NULL)
+                break;
+            info->replayed_records++;
+            process_log_rec(info, rec);
+        }
+
+        if (cl_spill_empty(spill)) {
+            DisplayLog(LVL_EVENT, CHGLOG_TAG, "%s: all spilled records have "
+                       "been replayed", info->mdtdevice);
+            P(info->clear_lock);
+            info->spilling = false;
+            info->spill_clearable = false;
+            V(info->clear_lock);
+        }
+    }
+
+    if (info->spill_unsynced >= cl_reader_config.batch_ack_count
+        || now - info->spill_sync_time >= cl_reader_config.batch_ack_delay) {
+        bool clearable;
+        int rc;
+
+        P(info->clear_lock);
+        rc = cl_spill_sync(spill, info->last_commit.rec_id);
+        clearable = info->spill_clearable;
+        V(info->clear_lock);
+
+        if (rc) {
+            DisplayLog(LVL_CRIT, CHGLOG_TAG, "Failed to sync spill file %s: %s",
+                       spill->path, strerror(rc));
+        } else {
+            info->spill_unsynced = 0;
+            if (clearable)
+                clear_changelog_records(info);
+        }
+        info->spill_sync_time = now;
+    }
+}
+
+/** Save a record to the spill file (it is released). */
+static void spill_rec(reader_thr_info_t *info, CL_REC_TYPE *p_rec)
+{
+    cl_spill_t *spill = info->spill;
+
+    /* after a restart, the records older than the spilled ones must be
+     * processed first, and the spilled ones must not be read twice */
+    if (!info->spill_caught_up) {
+        if (p_rec->cr_index < spill->first_idx) {
+            process_log_rec(info, p_rec);
+            return;
+        }
+        info->spill_caught_up = true;
+    }
+    if (!cl_spill_empty(spill) && p_rec->cr_index <= spill->last_idx) {
+        DisplayLog(LVL_FULL, CHGLOG_TAG, "record #%llu is already spilled",
+                   p_rec->cr_index);
+        llapi_changelog_free(&p_rec);
+        return;
+    }
+
+    while (cl_spill_append(spill, p_rec) == ENOSPC) {
+        DisplayLog(LVL_MAJOR, CHGLOG_TAG, "%s: spill file %s is full, "
+                   "waiting for spilled records to be processed",
+                   info->mdtdevice, spill->path);
+        if (info->force_stop) {
+            /* the record is not cleared: it will be read again */
+            llapi_changelog_free(&p_rec);
+            return;
+        }
+        rh_sleep(1);
+        process_op_queue(info, false, true);
+        spill_step(info);
+        if (!info->spilling) {
+            /* everything was replayed meanwhile */
+            process_log_rec(info, p_rec);
+            return;
+        }
+    }
+
+    info->spilled_records++;
+    info->spill_unsynced++;
+    llapi_changelog_free(&p_rec);
+}
+
+/** Replay all spilled records (one-shot mode) */
+static void spill_replay_all(reader_thr_info_t *info)
+{
+    CL_REC_TYPE *rec;
+
+    while ((rec = cl_spill_next(info->spill)) != NULL) {
+        info->replayed_records++;
+        process_log_rec(info, rec);
+        if (info->op_queue_count >= cl_reader_config.queue_max_size)
+            process_op_queue(info, false, false);
+    }
+    info->spilling = false;
+}
+
 /** a thread that reads lines from a given changelog */
 static void *chglog_reader_thr(void *arg)
 {
@@ -1352,10 +2026,14 @@ static void *chglog_reader_thr(void *arg)
 
     /* loop until a TERM signal is caught */
     while (!info->force_stop) {
+        if (info->spill != NULL)
+            spill_step(info);
+
         /* Is it time to flush? */
         if (info->op_queue_count >= cl_reader_config.queue_max_size ||
             next_push_time <= time(NULL)) {
-            process_op_queue(info, false);
+            /* never block if records can be spilled */
+            process_op_queue(info, false, info->spill != NULL);
 
             next_push_time = time(NULL) + cl_reader_config.queue_check_interval;
 
@@ -1363,6 +2041,13 @@ static void *chglog_reader_thr(void *arg)
                 FlushLogs();
         }
 
+        /* pipeline is full: wait for it to progress (or for spilling) */
+        if (info->spill != NULL && !info->spilling
+            && info->op_queue_count >= cl_reader_config.queue_max_size) {
+            rh_usleep(10000);
+            continue;
+        }
+
         st = cl_get_one(info, &p_rec);
         if (st == cl_continue)
             continue;
@@ -1370,17 +2055,35 @@ static void *chglog_reader_thr(void *arg)
             break;
 
         /* handle the line and push it to the pipeline */
-        process_log_rec(info, p_rec);
+        if (info->spilling)
+            spill_rec(info, p_rec);
+        else
+            process_log_rec(info, p_rec);
     }
 
-    if (one_shot) {
+    if (one_shot || info->replay != NULL) {
         /* Expected behavior in one-shot mode is to process all pending
          * changelogs. So flush the internal queue. */
-        process_op_queue(info, true);
+        if (info->spill != NULL)
+            spill_replay_all(info);
+        process_op_queue(info, true, false);
+    }
+
+    if (info->spill != NULL) {
+        P(info->clear_lock);
+        cl_spill_sync(info->spill, info->last_commit.rec_id);
+        V(info->clear_lock);
+        cl_spill_close(info->spill);
     }
+    if (info->capture != NULL)
+        cl_capture_close(info->capture);
+    if (info->replay != NULL)
+        cl_capture_close(info->replay);
     /* Else, process what stopped by a signal. Drop pending records and exit
      * ASAP. */
 
+    stop_decoders(info);
+
     DisplayLog(LVL_CRIT, CHGLOG_TAG, "Changelog reader thread terminating");
     FlushLogs();
     return NULL;
@@ -1405,6 +2108,188 @@ static void action_sigchld(int sig)
 }
 #endif
 
+/** close and release the spill, capture and replay files of a reader */
+static void close_reader_files(reader_thr_info_t *info)
+{
+    if (info->spill != NULL) {
+        cl_spill_close(info->spill);
+        MemFree(info->spill);
+        info->spill = NULL;
+    }
+    if (info->capture != NULL) {
+        cl_capture_close(info->capture);
+        MemFree(info->capture);
+        info->capture = NULL;
+    }
+    if (info->replay != NULL) {
+        cl_capture_close(info->replay);
+        MemFree(info->replay);
+        info->replay = NULL;
+    }
+}
+
+/** open the spill file of a reader, and resume spilling if needed */
+static int open_spill(reader_thr_info_t *info)
+{
+    char path[RBH_PATH_MAX];
+    int rc;
+
+    info->spill = MemAlloc(sizeof(cl_spill_t));
+    if (info->spill == NULL)
+        return ENOMEM;
+
+    snprintf(path, sizeof(path), "%s/%s.spill", cl_reader_config.spill_dir,
+             info->mdtdevice);
+    rc = cl_spill_open(info->spill, path, cl_reader_config.spill_max_size);
+    if (rc) {
+        MemFree(info->spill);
+        info->spill = NULL;
+        return rc;
+    }
+
+    if (!cl_spill_empty(info->spill)) {
+        /* replay them after the older records of the changelog */
+        info->spilling = true;
+        info->spill_caught_up = false;
+        info->spill_start = info->spill->first_idx - 1;
+    }
+    return 0;
+}
+
+/**
+ * Open the capture file and the replay file of a reader, if they are set
+ * in the configuration (<file>.<mdt_name>).
+ */
+static int open_capture(reader_thr_info_t *info)
+{
+    const char *mdt_name = cl_reader_config.mdt_def[info->thr_index].mdt_name;
+    char path[RBH_PATH_MAX];
+    int rc;
+
+    if (!EMPTY_STRING(cl_reader_config.replay_file)) {
+        info->replay = MemAlloc(sizeof(cl_capture_t));
+        if (info->replay == NULL)
+            return ENOMEM;
+
+        snprintf(path, sizeof(path), "%s.%s", cl_reader_config.replay_file,
+                 mdt_name);
+        rc = cl_replay_open(info->replay, path,
+                            cl_reader_config.replay_realtime);
+        if (rc) {
+            MemFree(info->replay);
+            info->replay = NULL;
+            return rc;
+        }
+    }
+
+    if (!EMPTY_STRING(cl_reader_config.capture_file)) {
+        info->capture = MemAlloc(sizeof(cl_capture_t));
+        if (info->capture == NULL)
+            return ENOMEM;
+
+        snprintf(path, sizeof(path), "%s.%s", cl_reader_config.capture_file,
+                 mdt_name);
+        rc = cl_capture_open(info->capture, path);
+        if (rc) {
+            MemFree(info->capture);
+            info->capture = NULL;
+            return rc;
+        }
+    }
+    return 0;
+}
+
+/** release the decoding partitions of a reader (decoders must be stopped,
+ * and partition queues empty) */
+static void free_partitions(reader_thr_info_t *info)
+{
+    unsigned int i;
+
+    if (info->parts == NULL)
+        return;
+
+    for (i = 0; i < info->nb_parts; i++) {
+        cl_partition_t *part = &info->parts[i];
+
+        /* partitions are initialized in order */
+        if (part->reader == NULL)
+            break;
+
+        MemFree(part->work);
+        MemFree(part->id_hash);
+        pthread_cond_destroy(&part->cond);
+        pthread_mutex_destroy(&part->lock);
+    }
+    MemFree(info->parts);
+    info->parts = NULL;
+    info->nb_parts = 0;
+}
+
+/** allocate the decoding partitions of a reader */
+static int init_partitions(reader_thr_info_t *info)
+{
+    unsigned int i;
+
+    info->nb_parts = cl_reader_config.decoder_threads;
+    info->parts = MemCalloc(info->nb_parts, sizeof(cl_partition_t));
+    if (info->parts == NULL)
+        return ENOMEM;
+
+    for (i = 0; i < info->nb_parts; i++) {
+        cl_partition_t *part = &info->parts[i];
+
+        part->reader = info;
+        rh_list_init(&part->op_queue);
+        pthread_mutex_init(&part->lock, NULL);
+        pthread_cond_init(&part->cond, NULL);
+        part->id_hash = id_hash_init(
+            max_count_to_hash_size(cl_reader_config.queue_max_size
+                                   / info->nb_parts), false);
+        if (part->id_hash == NULL)
+            goto free_parts;
+
+        /* work queue is only needed if decoding is done by other threads */
+        if (info->nb_parts > 1) {
+            part->work_size = cl_reader_config.queue_max_size;
+            part->work = MemCalloc(part->work_size, sizeof(cl_work_item_t));
+            if (part->work == NULL)
+                goto free_parts;
+        }
+    }
+    return 0;
+
+free_parts:
+    free_partitions(info);
+    return ENOMEM;
+}
+
+/** start the decoder threads of a reader */
+static int start_decoders(reader_thr_info_t *info)
+{
+    unsigned int i;
+
+    if (info->nb_parts <= 1)
+        return 0;
+
+    for (i = 0; i < info->nb_parts; i++) {
+        /* pthread_create() returns the error code (errno is not set) */
+        int err = pthread_create(&info->parts[i].thr_id, NULL, cl_decoder_thr,
+                                 &info->parts[i]);
+
+        if (err) {
+            DisplayLog(LVL_CRIT, CHGLOG_TAG,
+                       "ERROR creating ChangeLog decoder thread: %s",
+                       strerror(err));
+            stop_decoders(info);
+            return err;
+        }
+        info->parts[i].started = true;
+    }
+    DisplayLog(LVL_DEBUG, CHGLOG_TAG, "%s: %u decoder threads started",
+               info->mdtdevice, info->nb_parts);
+    return 0;
+}
+
 /** start ChangeLog Reader module */
 int cl_reader_start(run_flags_t flags, int mdt_index)
 {
@@ -1494,15 +2379,28 @@ int cl_reader_start(run_flags_t flags, int mdt_index)
 
         memset(info, 0, sizeof(reader_thr_info_t));
         info->thr_index = i;
-        rh_list_init(&info->op_queue);
         info->last_report = time(NULL);
-        info->id_hash = id_hash_init(
-            max_count_to_hash_size(cl_reader_config.queue_max_size), false);
+        info->start_time = info->spill_sync_time = time(NULL);
+        pthread_mutex_init(&info->clear_lock, NULL);
+
+        rc = init_partitions(info);
+        if (rc)
+            goto out;
 
         snprintf(mdtdevice, 128, "%s-%s", get_fsname(),
                  cl_reader_config.mdt_def[i].mdt_name);
 
         info->mdtdevice = strdup(mdtdevice);
+
+        if (!EMPTY_STRING(cl_reader_config.spill_dir)) {
+            rc = open_spill(info);
+            if (rc)
+                goto free_reader;
+        }
+
+        rc = open_capture(info);
+        if (rc)
+            goto free_reader;
         info->flags =
             ((one_shot
               || cl_reader_config.force_polling) ? 0 : CHANGELOG_FLAG_FOLLOW)
@@ -1525,23 +2423,32 @@ int cl_reader_start(run_flags_t flags, int mdt_index)
         /* open the changelog (if we are in one_shot mode,
          * don't use the CHANGELOG_FLAG_FOLLOW flag)
          */
-        rc = llapi_changelog_start(&info->chglog_hdlr,
-                                   info->flags, info->mdtdevice, last_rec);
+        if (info->replay != NULL)
+            rc = 0; /* records are read from the replay file */
+        else
+            rc = llapi_changelog_start(&info->chglog_hdlr,
+                                       info->flags, info->mdtdevice, last_rec);
 
         if (rc) {
             DisplayLog(LVL_CRIT, CHGLOG_TAG,
                        "ERROR %d opening changelog for MDT '%s': %s",
                        rc, mdtdevice, strerror(abs(rc)));
-            return abs(rc);
+            rc = abs(rc);
+            goto free_reader;
         }
 
+        /* start decoder threads */
+        rc = start_decoders(info);
+        if (rc)
+            goto free_reader;
+
         /* then create the thread that manages it */
-        if (pthread_create(&info->thr_id, NULL, chglog_reader_thr, info)) {
-            int err = errno;
+        rc = pthread_create(&info->thr_id, NULL, chglog_reader_thr, info);
+        if (rc) {
             DisplayLog(LVL_CRIT, CHGLOG_TAG,
                        "ERROR creating ChangeLog reader thread: %s",
-                       strerror(err));
-            return err;
+                       strerror(rc));
+            goto free_reader;
         }
 
     }
@@ -1550,6 +2457,19 @@ int cl_reader_start(run_flags_t flags, int mdt_index)
         ListMgr_CloseAccess(&lmgr);
 
     return 0;
+
+free_reader:
+    /* release the reader that failed to start */
+    stop_decoders(&reader_info[i]);
+    log_close(&reader_info[i]);
+    close_reader_files(&reader_info[i]);
+    free_partitions(&reader_info[i]);
+    free(reader_info[i].mdtdevice);
+    reader_info[i].mdtdevice = NULL;
+out:
+    if (dbget)
+        ListMgr_CloseAccess(&lmgr);
+    return rc;
 }
 
 /** terminate ChangeLog Readers */
@@ -1678,6 +2598,28 @@ int cl_reader_dump_stats(void)
                    reader_info[i].interesting_records);
         DisplayLog(LVL_MAJOR, "STATS", "   suppressed records  = %llu",
                    reader_info[i].suppressed_records);
+        DisplayLog(LVL_MAJOR, "STATS", "   folded records      = %llu",
+                   reader_info[i].folded_records);
+        if (reader_info[i].replay != NULL)
+            DisplayLog(LVL_MAJOR, "STATS", "   replaying from      = %s",
+                       reader_info[i].replay->path);
+        if (reader_info[i].capture != NULL)
+            DisplayLog(LVL_MAJOR, "STATS", "   captured records    = %llu "
+                       "(to %s)", reader_info[i].capture->count,
+                       reader_info[i].capture->path);
+        if (reader_info[i].spill != NULL)
+            DisplayLog(LVL_MAJOR, "STATS", "   spilled records     = %llu "
+                       "(replayed: %llu, pending: %u%s)",
+                       reader_info[i].spilled_records,
+                       reader_info[i].replayed_records,
+                       reader_info[i].spill->count,
+                       reader_info[i].spilling ? ", spilling" : "");
+        if (reader_info[i].pushed_ops > 0)
+            DisplayLog(LVL_MAJOR, "STATS", "   pushed operations   = %llu "
+                       "(fold ratio: %.2f records/op)",
+                       reader_info[i].pushed_ops,
+                       (double)reader_info[i].nb_read
+                       / reader_info[i].pushed_ops);
         DisplayLog(LVL_MAJOR, "STATS", "   records pending     = %u",
                    reader_info[i].op_queue_count);
 
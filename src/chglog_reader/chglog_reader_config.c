@@ -54,6 +54,14 @@ static void cl_reader_set_default_cfg(void *module_config)
     p_config->force_polling = true;
     p_config->polling_interval = 1; /* 1s */
     p_config->queue_max_size = 1000;
+    p_config->decoder_threads = 1;
+    p_config->fold_records = true;
+    p_config->spill_dir[0] = '\0';
+    p_config->spill_max_size = 1024LL * 1024 * 1024;    /* 1GB */
+    p_config->spill_delay = 60;    /* 1min */
+    p_config->capture_file[0] = '\0';
+    p_config->replay_file[0] = '\0';
+    p_config->replay_realtime = false;
     p_config->queue_max_age = 5;    /* 5s */
     p_config->queue_check_interval = 1; /* every second */
     p_config->commit_update_max_delay = 5;
@@ -64,6 +72,8 @@ static void cl_reader_set_default_cfg(void *module_config)
 
     /* acknowledge 1024 records at once */
     p_config->batch_ack_count = 1024;
+    /* or every 5s */
+    p_config->batch_ack_delay = 5;
 }
 
 /** Write default parameters for changelog readers */
@@ -76,9 +86,18 @@ static void cl_reader_write_default(FILE *output)
     print_end_block(output, 1);
 
     print_line(output, 1, "batch_ack_count  : 1024");
+    print_line(output, 1, "batch_ack_delay  : 5s");
     print_line(output, 1, "force_polling    : yes");
     print_line(output, 1, "polling_interval : 1s");
     print_line(output, 1, "queue_max_size   : 1000");
+    print_line(output, 1, "decoder_threads  : 1");
+    print_line(output, 1, "fold_records     : yes");
+    print_line(output, 1, "spill_dir        : \"\" (disabled)");
+    print_line(output, 1, "spill_max_size   : 1GB");
+    print_line(output, 1, "spill_delay      : 1min");
+    print_line(output, 1, "capture_file     : \"\" (disabled)");
+    print_line(output, 1, "replay_file      : \"\" (disabled)");
+    print_line(output, 1, "replay_realtime  : no");
     print_line(output, 1, "queue_max_age    : 5s");
     print_line(output, 1, "queue_check_interval : 1s");
     print_line(output, 1, "commit_update_max_delay : 5s");
@@ -126,6 +145,8 @@ static void cl_reader_write_template(FILE *output)
 
     print_line(output, 1, "# clear changelog every 1024 records:");
     print_line(output, 1, "batch_ack_count = 1024 ;");
+    print_line(output, 1, "# or at least every 5s:");
+    print_line(output, 1, "batch_ack_delay = 5s ;");
     fprintf(output, "\n");
 
     print_line(output, 1, "force_polling    = yes ;");
@@ -134,6 +155,22 @@ static void cl_reader_write_template(FILE *output)
     print_line(output, 1, "queue_max_size   = 1000 ;");
     print_line(output, 1, "queue_max_age    = 5s ;");
     print_line(output, 1, "queue_check_interval = 1s ;");
+    print_line(output, 1, "# threads filtering records of each MDT");
+    print_line(output, 1, "decoder_threads  = 1 ;");
+    print_line(output, 1, "# merge the records of an entry that are queued");
+    print_line(output, 1, "# at the same time (see queue_max_size/age)");
+    print_line(output, 1, "fold_records     = yes ;");
+    print_line(output, 1, "# save records to a local file when the DB can't");
+    print_line(output, 1, "# keep up, so they can be cleared from the MDT");
+    print_line(output, 1, "#spill_dir       = \"/var/spool/robinhood\" ;");
+    print_line(output, 1, "#spill_max_size  = 1GB ;");
+    print_line(output, 1, "#spill_delay     = 1min ;");
+    print_line(output, 1, "# record changelogs to <capture_file>.<mdt_name>");
+    print_line(output, 1, "#capture_file    = \"/tmp/changelog\" ;");
+    print_line(output, 1, "# process records from <replay_file>.<mdt_name>");
+    print_line(output, 1, "# instead of MDT changelogs (e.g. for benchmarks)");
+    print_line(output, 1, "#replay_file     = \"/tmp/changelog\" ;");
+    print_line(output, 1, "#replay_realtime = no ;");
     print_line(output, 1, "# delays to update last committed record in the DB");
     print_line(output, 1, "commit_update_max_delay = 5s ;");
     print_line(output, 1, "commit_update_max_delta = 10k ;");
@@ -223,7 +260,11 @@ static int cl_reader_read_cfg(config_file_t config, void *module_config,
 
     static const char *cl_cfg_allow[] = {
         "force_polling", "polling_interval", "batch_ack_count",
+        "batch_ack_delay",
         "queue_max_size", "queue_max_age", "queue_check_interval",
+        "decoder_threads", "fold_records",
+        "spill_dir", "spill_max_size", "spill_delay",
+        "capture_file", "replay_file", "replay_realtime",
         "commit_update_max_delay", "commit_update_max_delta",
         "mds_has_lu543", "mds_has_lu1331", MDT_DEF_BLOCK,
         NULL
@@ -235,8 +276,25 @@ static int cl_reader_read_cfg(config_file_t config, void *module_config,
          &p_config->polling_interval, 0},
         {"batch_ack_count", PT_INT, PFLG_NOT_NULL | PFLG_POSITIVE,
          &p_config->batch_ack_count, 0},
+        {"batch_ack_delay", PT_DURATION, PFLG_NOT_NULL | PFLG_POSITIVE,
+         &p_config->batch_ack_delay, 0},
         {"queue_max_size", PT_INT, PFLG_NOT_NULL | PFLG_POSITIVE,
          &p_config->queue_max_size, 0},
+        {"decoder_threads", PT_INT, PFLG_NOT_NULL | PFLG_POSITIVE,
+         &p_config->decoder_threads, 0},
+        {"fold_records", PT_BOOL, 0, &p_config->fold_records, 0},
+        {"spill_dir", PT_STRING, PFLG_ABSOLUTE_PATH | PFLG_REMOVE_FINAL_SLASH
+         | PFLG_NO_WILDCARDS, p_config->spill_dir,
+         sizeof(p_config->spill_dir)},
+        {"spill_max_size", PT_SIZE, PFLG_POSITIVE | PFLG_NOT_NULL,
+         &p_config->spill_max_size, 0},
+        {"spill_delay", PT_DURATION, PFLG_POSITIVE | PFLG_NOT_NULL,
+         &p_config->spill_delay, 0},
+        {"capture_file", PT_STRING, PFLG_ABSOLUTE_PATH | PFLG_NO_WILDCARDS,
+         p_config->capture_file, sizeof(p_config->capture_file)},
+        {"replay_file", PT_STRING, PFLG_ABSOLUTE_PATH | PFLG_NO_WILDCARDS,
+         p_config->replay_file, sizeof(p_config->replay_file)},
+        {"replay_realtime", PT_BOOL, 0, &p_config->replay_realtime, 0},
         {"queue_max_age", PT_DURATION, PFLG_NOT_NULL | PFLG_POSITIVE,
          &p_config->queue_max_age, 0},
         {"queue_check_interval", PT_DURATION, PFLG_NOT_NULL | PFLG_POSITIVE,
@@ -346,17 +404,35 @@ static int cl_reader_reload_cfg(chglog_reader_config_t *cfg)
                       "polling_interval", "%ld",);
     SCALAR_PARAM_UPDT(cfg, batch_ack_count, CHGLOG_CFG_BLOCK, "batch_ack_count",
                       "%u",);
+    SCALAR_PARAM_UPDT(cfg, batch_ack_delay, CHGLOG_CFG_BLOCK, "batch_ack_delay",
+                      "%ld",);
     SCALAR_PARAM_UPDT(cfg, queue_max_size, CHGLOG_CFG_BLOCK, "queue_max_size",
                       "%u",);
     SCALAR_PARAM_UPDT(cfg, queue_max_age, CHGLOG_CFG_BLOCK, "queue_max_age",
                       "%ld",);
     SCALAR_PARAM_UPDT(cfg, queue_check_interval, CHGLOG_CFG_BLOCK,
                       "queue_check_interval", "%ld",);
+    SCALAR_PARAM_UPDT(cfg, fold_records, CHGLOG_CFG_BLOCK, "fold_records",
+                      "%s", bool2str);
+    SCALAR_PARAM_UPDT(cfg, spill_delay, CHGLOG_CFG_BLOCK, "spill_delay",
+                      "%ld",);
     SCALAR_PARAM_UPDT(cfg, commit_update_max_delta, CHGLOG_CFG_BLOCK,
                       "commit_update_max_delta", "%"PRIu64,);
     SCALAR_PARAM_UPDT(cfg, commit_update_max_delay, CHGLOG_CFG_BLOCK,
                       "commit_update_max_delay", "%ld",);
 
+    if (cfg->decoder_threads != cl_reader_config.decoder_threads)
+        NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK, "decoder_threads");
+    if (strcmp(cfg->spill_dir, cl_reader_config.spill_dir))
+        NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK, "spill_dir");
+    if (cfg->spill_max_size != cl_reader_config.spill_max_size)
+        NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK, "spill_max_size");
+    if (strcmp(cfg->capture_file, cl_reader_config.capture_file))
+        NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK, "capture_file");
+    if (strcmp(cfg->replay_file, cl_reader_config.replay_file))
+        NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK, "replay_file");
+    if (cfg->replay_realtime != cl_reader_config.replay_realtime)
+        NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK, "replay_realtime");
     if (cfg->mds_has_lu543 != cl_reader_config.mds_has_lu543)
         NO_PARAM_UPDT_MSG(CHGLOG_CFG_BLOCK, "mds_has_lu543");
     if (cfg->mds_has_lu1331 != cl_reader_config.mds_has_lu1331)
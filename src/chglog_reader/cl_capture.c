@@ -0,0 +1,206 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    cl_capture.c
+ * \brief   Capture of changelog records to a file, and replay.
+ *
+ * File layout: a header, followed by records, each of them preceded by
+ * its length. Records are written as received from liblustreapi, so they
+ * can only be replayed by a robinhood built against a compatible Lustre
+ * version.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "Memory.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "cl_capture.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define CAPTURE_TAG     "ChangeLog"
+#define CAPTURE_MAGIC   "RBHCLCAP"
+#define CAPTURE_VERSION 1
+
+struct capture_hdr {
+    char     magic[8];
+    uint32_t version;
+    /** sizeof(CL_REC_TYPE) of the capturing program */
+    uint32_t rec_type_size;
+};
+
+int cl_capture_open(cl_capture_t *cap, const char *path)
+{
+    struct capture_hdr hdr;
+    int rc;
+
+    memset(cap, 0, sizeof(*cap));
+    rh_strncpy(cap->path, path, sizeof(cap->path));
+
+    cap->file = fopen(path, "w");
+    if (cap->file == NULL) {
+        rc = errno;
+        DisplayLog(LVL_CRIT, CAPTURE_TAG, "Failed to create capture file "
+                   "'%s': %s", path, strerror(rc));
+        return rc;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic));
+    hdr.version = CAPTURE_VERSION;
+    hdr.rec_type_size = sizeof(CL_REC_TYPE);
+
+    if (fwrite(&hdr, sizeof(hdr), 1, cap->file) != 1) {
+        rc = errno ? errno : EIO;
+        fclose(cap->file);
+        cap->file = NULL;
+        return rc;
+    }
+
+    DisplayLog(LVL_EVENT, CAPTURE_TAG, "Capturing changelog records to '%s'",
+               path);
+    return 0;
+}
+
+int cl_capture_write(cl_capture_t *cap, const CL_REC_TYPE *rec)
+{
+    uint32_t len = rh_get_cl_rec_size(rec);
+
+    if (fwrite(&len, sizeof(len), 1, cap->file) != 1
+        || fwrite(rec, len, 1, cap->file) != 1) {
+        int rc = errno ? errno : EIO;
+
+        DisplayLog(LVL_MAJOR, CAPTURE_TAG, "Failed to write record #%llu to "
+                   "'%s': %s", rec->cr_index, cap->path, strerror(rc));
+        return rc;
+    }
+    cap->count++;
+    return 0;
+}
+
+int cl_replay_open(cl_capture_t *cap, const char *path, bool realtime)
+{
+    struct capture_hdr hdr;
+    int rc;
+
+    memset(cap, 0, sizeof(*cap));
+    rh_strncpy(cap->path, path, sizeof(cap->path));
+    cap->realtime = realtime;
+
+    cap->file = fopen(path, "r");
+    if (cap->file == NULL) {
+        rc = errno;
+        DisplayLog(LVL_CRIT, CAPTURE_TAG, "Failed to open changelog capture "
+                   "'%s': %s", path, strerror(rc));
+        return rc;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, cap->file) != 1
+        || memcmp(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic))
+        || hdr.version != CAPTURE_VERSION) {
+        DisplayLog(LVL_CRIT, CAPTURE_TAG, "'%s' is not a changelog capture "
+                   "file", path);
+        rc = EINVAL;
+        goto close_file;
+    }
+
+    if (hdr.rec_type_size != sizeof(CL_REC_TYPE)) {
+        DisplayLog(LVL_CRIT, CAPTURE_TAG, "'%s' was captured by a program "
+                   "built against an incompatible Lustre version "
+                   "(record size %u, expected %zu)", path, hdr.rec_type_size,
+                   sizeof(CL_REC_TYPE));
+        rc = EINVAL;
+        goto close_file;
+    }
+
+    DisplayLog(LVL_EVENT, CAPTURE_TAG, "Replaying changelog records from "
+               "'%s' (%s)", path, realtime ? "recorded speed" : "max speed");
+    return 0;
+
+ close_file:
+    fclose(cap->file);
+    cap->file = NULL;
+    return rc;
+}
+
+/** wait until it is time to replay a record */
+static void replay_wait(cl_capture_t *cap, const CL_REC_TYPE *rec)
+{
+    struct timeval rec_time, now;
+    long long delay_us;
+
+    rec_time.tv_sec = cltime2sec(rec->cr_time);
+    rec_time.tv_usec = cltime2nsec(rec->cr_time) / 1000;
+    gettimeofday(&now, NULL);
+
+    if (cap->count == 0) {
+        cap->first_rec = rec_time;
+        cap->first_play = now;
+        return;
+    }
+
+    /* record delay since the first record, minus elapsed time */
+    delay_us = (rec_time.tv_sec - cap->first_rec.tv_sec) * 1000000LL
+        + (rec_time.tv_usec - cap->first_rec.tv_usec)
+        - (now.tv_sec - cap->first_play.tv_sec) * 1000000LL
+        - (now.tv_usec - cap->first_play.tv_usec);
+
+    if (delay_us > 0)
+        rh_usleep(delay_us);
+}
+
+int cl_replay_next(cl_capture_t *cap, CL_REC_TYPE **rec)
+{
+    uint32_t len;
+
+    if (fread(&len, sizeof(len), 1, cap->file) != 1)
+        return ferror(cap->file) ? -EIO : 1;
+
+    if (len < sizeof(CL_REC_TYPE)) {
+        DisplayLog(LVL_CRIT, CAPTURE_TAG, "%s: invalid record length %u "
+                   "after %llu records", cap->path, len, cap->count);
+        return -EINVAL;
+    }
+
+    *rec = MemAlloc(len);
+    if (*rec == NULL)
+        return -ENOMEM;
+
+    if (fread(*rec, len, 1, cap->file) != 1) {
+        DisplayLog(LVL_MAJOR, CAPTURE_TAG, "%s: truncated record after "
+                   "%llu records", cap->path, cap->count);
+        MemFree(*rec);
+        *rec = NULL;
+        return 1;
+    }
+
+    if (cap->realtime)
+        replay_wait(cap, *rec);
+
+    cap->count++;
+    return 0;
+}
+
+void cl_capture_close(cl_capture_t *cap)
+{
+    if (cap->file != NULL) {
+        fclose(cap->file);
+        cap->file = NULL;
+    }
+}
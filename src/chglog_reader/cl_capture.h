@@ -0,0 +1,71 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    cl_capture.h
+ * \brief   Capture of changelog records to a file, and replay.
+ *
+ * Captured records can be fed back to the changelog reader instead of
+ * a MDT changelog, to reproduce or benchmark changelog processing.
+ */
+
+#ifndef _CL_CAPTURE_H
+#define _CL_CAPTURE_H
+
+#include "lustre_extended_types.h"
+#include "global_config.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+/** capture (or replay) file of a changelog reader */
+typedef struct cl_capture_t {
+    char        path[RBH_PATH_MAX];
+    FILE       *file;
+
+    /** number of records written/read */
+    unsigned long long count;
+
+    /** replay records at the speed they were recorded */
+    bool        realtime;
+    /** time of the first replayed record, and when it was replayed */
+    struct timeval first_rec;
+    struct timeval first_play;
+} cl_capture_t;
+
+/** Create a capture file (existing file is truncated). */
+int cl_capture_open(cl_capture_t *cap, const char *path);
+
+/** Write a record to a capture file. */
+int cl_capture_write(cl_capture_t *cap, const CL_REC_TYPE *rec);
+
+/**
+ * Open a capture file for replay.
+ * @param realtime wait between records as they were recorded, else replay
+ *                 them as fast as possible.
+ */
+int cl_replay_open(cl_capture_t *cap, const char *path, bool realtime);
+
+/**
+ * Get the next record from a capture file.
+ * Return values are the same as llapi_changelog_recv():
+ * @retval 0       a record is returned (to be released by
+ *                 llapi_changelog_free).
+ * @retval 1       end of file.
+ * @retval -errno  error.
+ */
+int cl_replay_next(cl_capture_t *cap, CL_REC_TYPE **rec);
+
+/** Close a capture or replay file. */
+void cl_capture_close(cl_capture_t *cap);
+
+#endif
@@ -0,0 +1,347 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    cl_spill.c
+ * \brief   On-disk spill queue for changelog records.
+ *
+ * Segment layout: a header, followed by records appended one after the
+ * other. Each record is preceded by its length, the generation of the
+ * segment and a checksum, so a partially written record (or a record
+ * left by a previous generation) marks the end of the segment.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "Memory.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "cl_spill.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SPILL_TAG     "ChangeLog"
+#define SPILL_MAGIC   "RBHSPILL"
+#define SPILL_VERSION 1
+
+/** segment header */
+struct spill_hdr {
+    char     magic[8];
+    uint32_t version;
+    /** generation of valid records */
+    uint32_t gen;
+    /** records before this offset have been committed to the DB */
+    uint64_t done_off;
+};
+
+/** record header */
+struct spill_rec_hdr {
+    uint32_t len;
+    uint32_t gen;
+    uint32_t sum;
+    uint32_t padding;
+};
+
+#define SPILL_ALIGN(_s)   (((_s) + 7) & ~((size_t)7))
+#define SPILL_DATA_START  SPILL_ALIGN(sizeof(struct spill_hdr))
+#define SPILL_MIN_SIZE    (1024 * 1024)
+
+/** FNV-1a checksum of a record */
+static uint32_t spill_checksum(uint32_t gen, const void *data, size_t len)
+{
+    const unsigned char *c = data;
+    uint32_t sum = 2166136261U;
+    size_t i;
+
+    for (i = 0; i < sizeof(gen); i++) {
+        sum ^= (gen >> (8 * i)) & 0xff;
+        sum *= 16777619U;
+    }
+    for (i = 0; i < len; i++) {
+        sum ^= c[i];
+        sum *= 16777619U;
+    }
+    return sum;
+}
+
+static inline struct spill_hdr *spill_header(cl_spill_t *spill)
+{
+    return (struct spill_hdr *)spill->map;
+}
+
+/**
+ * Return the record at the given offset, or NULL if there is no valid
+ * record there (end of segment).
+ */
+static const struct spill_rec_hdr *spill_rec_at(const cl_spill_t *spill,
+                                                size_t off)
+{
+    const struct spill_rec_hdr *rh;
+
+    if (off + sizeof(*rh) > spill->map_size)
+        return NULL;
+
+    rh = (const struct spill_rec_hdr *)(spill->map + off);
+    if (rh->len == 0 || rh->gen != spill->gen
+        || rh->len > spill->map_size - off - sizeof(*rh))
+        return NULL;
+
+    if (spill_checksum(rh->gen, rh + 1, rh->len) != rh->sum) {
+        DisplayLog(LVL_MAJOR, SPILL_TAG, "%s: invalid checksum at offset %zu: "
+                   "ignoring the end of the spill file", spill->path, off);
+        return NULL;
+    }
+    return rh;
+}
+
+static inline const CL_REC_TYPE *spill_rec_data(const struct spill_rec_hdr
+                                                *rh)
+{
+    return (const CL_REC_TYPE *)(rh + 1);
+}
+
+static inline size_t spill_rec_next(size_t off, const struct spill_rec_hdr
+                                    *rh)
+{
+    return off + sizeof(*rh) + SPILL_ALIGN(rh->len);
+}
+
+/** start a new generation of records at the beginning of the segment */
+static void spill_reset(cl_spill_t *spill)
+{
+    struct spill_hdr *hdr = spill_header(spill);
+
+    spill->gen++;
+    hdr->gen = spill->gen;
+    hdr->done_off = SPILL_DATA_START;
+
+    spill->read_off = spill->write_off = spill->synced_off = SPILL_DATA_START;
+    spill->count = 0;
+    spill->first_idx = spill->last_idx = spill->synced_idx = 0;
+}
+
+/** load the records left by a previous run */
+static void spill_load(cl_spill_t *spill)
+{
+    struct spill_hdr *hdr = spill_header(spill);
+    const struct spill_rec_hdr *rh;
+    size_t off;
+
+    if (memcmp(hdr->magic, SPILL_MAGIC, sizeof(hdr->magic))
+        || hdr->version != SPILL_VERSION) {
+        /* new or unknown file: initialize it */
+        memcpy(hdr->magic, SPILL_MAGIC, sizeof(hdr->magic));
+        hdr->version = SPILL_VERSION;
+        spill->gen = hdr->gen;
+        spill_reset(spill);
+        return;
+    }
+
+    spill->gen = hdr->gen;
+    if (hdr->done_off < SPILL_DATA_START || hdr->done_off > spill->map_size) {
+        DisplayLog(LVL_MAJOR, SPILL_TAG, "%s: invalid header, "
+                   "discarding its contents", spill->path);
+        spill_reset(spill);
+        return;
+    }
+
+    spill->count = 0;
+    off = spill->read_off = hdr->done_off;
+    while ((rh = spill_rec_at(spill, off)) != NULL) {
+        if (spill->count == 0)
+            spill->first_idx = spill_rec_data(rh)->cr_index;
+        spill->last_idx = spill_rec_data(rh)->cr_index;
+        spill->count++;
+        off = spill_rec_next(off, rh);
+    }
+    spill->write_off = spill->synced_off = off;
+    spill->synced_idx = spill->last_idx;
+
+    if (spill->count == 0)
+        spill_reset(spill);
+    else
+        DisplayLog(LVL_EVENT, SPILL_TAG, "%s: %u records to be replayed "
+                   "(#%"PRIu64" to #%"PRIu64")", spill->path, spill->count,
+                   spill->first_idx, spill->last_idx);
+}
+
+int cl_spill_open(cl_spill_t *spill, const char *path, size_t max_size)
+{
+    struct stat st;
+    int rc;
+
+    memset(spill, 0, sizeof(*spill));
+    rh_strncpy(spill->path, path, sizeof(spill->path));
+
+    spill->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (spill->fd < 0) {
+        rc = errno;
+        DisplayLog(LVL_CRIT, SPILL_TAG, "Failed to open spill file '%s': %s",
+                   path, strerror(rc));
+        return rc;
+    }
+
+    if (fstat(spill->fd, &st)) {
+        rc = errno;
+        goto close_fd;
+    }
+
+    /* keep previous records if the file is bigger than the current limit */
+    spill->map_size = SPILL_ALIGN(max_size);
+    if (spill->map_size < SPILL_MIN_SIZE)
+        spill->map_size = SPILL_MIN_SIZE;
+    if (st.st_size > spill->map_size)
+        spill->map_size = st.st_size;
+
+    /* Allocate the blocks of the whole segment: writing to a hole of the
+     * shared mapping would raise SIGBUS if the filesystem is full. */
+    rc = posix_fallocate(spill->fd, 0, spill->map_size);
+    if (rc) {
+        DisplayLog(LVL_CRIT, SPILL_TAG, "Failed to allocate %zu bytes for "
+                   "spill file '%s': %s", spill->map_size, path, strerror(rc));
+        goto close_fd;
+    }
+
+    spill->map = mmap(NULL, spill->map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, spill->fd, 0);
+    if (spill->map == MAP_FAILED) {
+        rc = errno;
+        DisplayLog(LVL_CRIT, SPILL_TAG, "Failed to map spill file '%s': %s",
+                   path, strerror(rc));
+        spill->map = NULL;
+        goto close_fd;
+    }
+
+    spill_load(spill);
+    return 0;
+
+ close_fd:
+    close(spill->fd);
+    spill->fd = -1;
+    return rc;
+}
+
+void cl_spill_close(cl_spill_t *spill)
+{
+    if (spill->map != NULL) {
+        msync(spill->map, spill->map_size, MS_SYNC);
+        munmap(spill->map, spill->map_size);
+        spill->map = NULL;
+    }
+    if (spill->fd >= 0) {
+        close(spill->fd);
+        spill->fd = -1;
+    }
+}
+
+int cl_spill_append(cl_spill_t *spill, const CL_REC_TYPE *rec)
+{
+    struct spill_rec_hdr *rh;
+    size_t len = rh_get_cl_rec_size(rec);
+    size_t end;
+
+    end = spill->write_off + sizeof(*rh) + SPILL_ALIGN(len);
+    /* always keep room for an end marker */
+    if (end + sizeof(*rh) > spill->map_size)
+        return ENOSPC;
+
+    rh = (struct spill_rec_hdr *)(spill->map + spill->write_off);
+    memcpy(rh + 1, rec, len);
+    rh->gen = spill->gen;
+    rh->sum = spill_checksum(spill->gen, rec, len);
+    rh->padding = 0;
+    rh->len = len;
+
+    /* terminate the segment */
+    memset(spill->map + end, 0, sizeof(*rh));
+
+    if (spill->count == 0)
+        spill->first_idx = rec->cr_index;
+    spill->last_idx = rec->cr_index;
+    spill->count++;
+    spill->write_off = end;
+
+    return 0;
+}
+
+int cl_spill_sync(cl_spill_t *spill, uint64_t committed_idx)
+{
+    struct spill_hdr *hdr = spill_header(spill);
+    const struct spill_rec_hdr *rh;
+    size_t off = hdr->done_off;
+    size_t start;
+    long pgsz = sysconf(_SC_PAGESIZE);
+
+    /* skip the replayed records that are now in the DB */
+    while (off < spill->read_off && (rh = spill_rec_at(spill, off)) != NULL
+           && spill_rec_data(rh)->cr_index <= committed_idx)
+        off = spill_rec_next(off, rh);
+    hdr->done_off = off;
+
+    /* everything has been committed: start over */
+    if (spill->count == 0 && off == spill->write_off)
+        spill_reset(spill);
+
+    /* header and new records */
+    if (msync(spill->map, pgsz, MS_SYNC))
+        return errno;
+
+    if (spill->write_off > spill->synced_off) {
+        start = spill->synced_off & ~((size_t)pgsz - 1);
+        if (msync(spill->map + start,
+                  spill->write_off + sizeof(*rh) - start, MS_SYNC))
+            return errno;
+    }
+    spill->synced_off = spill->write_off;
+    spill->synced_idx = spill->last_idx;
+
+    return 0;
+}
+
+CL_REC_TYPE *cl_spill_next(cl_spill_t *spill)
+{
+    const struct spill_rec_hdr *rh;
+    CL_REC_TYPE *rec;
+
+    if (spill->count == 0)
+        return NULL;
+
+    rh = spill_rec_at(spill, spill->read_off);
+    if (rh == NULL) {
+        /* should not happen as records are checked when loaded */
+        DisplayLog(LVL_CRIT, SPILL_TAG, "%s: unexpected end of records at "
+                   "offset %zu", spill->path, spill->read_off);
+        spill->count = 0;
+        return NULL;
+    }
+
+    rec = MemAlloc(rh->len);
+    if (rec == NULL)
+        return NULL;
+    memcpy(rec, spill_rec_data(rh), rh->len);
+
+    spill->read_off = spill_rec_next(spill->read_off, rh);
+    spill->count--;
+    if (spill->count > 0)
+        spill->first_idx = spill_rec_data((const struct spill_rec_hdr *)
+                                          (spill->map + spill->read_off))
+                                          ->cr_index;
+    return rec;
+}
@@ -0,0 +1,96 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    cl_spill.h
+ * \brief   On-disk spill queue for changelog records.
+ *
+ * When the pipeline can't keep up (e.g. database outage), the changelog
+ * reader appends the records it reads to a memory-mapped segment file,
+ * so they can be cleared from the MDT changelog. They are replayed in
+ * order when the pipeline is able to process them again.
+ */
+
+#ifndef _CL_SPILL_H
+#define _CL_SPILL_H
+
+#include "lustre_extended_types.h"
+#include "global_config.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** spill segment of a changelog reader */
+typedef struct cl_spill_t {
+    char     path[RBH_PATH_MAX];
+    int      fd;
+
+    /** the whole segment file is mapped */
+    char    *map;
+    size_t   map_size;
+
+    /** generation of the records in the segment */
+    uint32_t gen;
+
+    /** offset of the next record to replay */
+    size_t   read_off;
+    /** end of the appended records */
+    size_t   write_off;
+    /** end of the records synced to disk */
+    size_t   synced_off;
+
+    /** number of records not replayed yet */
+    unsigned int count;
+
+    /** index of the first record not replayed yet */
+    uint64_t first_idx;
+    /** index of the last appended record */
+    uint64_t last_idx;
+    /** index of the last record synced to disk */
+    uint64_t synced_idx;
+} cl_spill_t;
+
+/**
+ * Open (or create) a spill segment. Records left by a previous run
+ * are loaded and will be replayed first.
+ */
+int cl_spill_open(cl_spill_t *spill, const char *path, size_t max_size);
+
+/** Unmap and close a spill segment. */
+void cl_spill_close(cl_spill_t *spill);
+
+/**
+ * Append a record to the spill segment.
+ * @retval ENOSPC if the segment is full.
+ */
+int cl_spill_append(cl_spill_t *spill, const CL_REC_TYPE *rec);
+
+/**
+ * Write appended records to disk, and forget the replayed records
+ * that have been committed to the DB.
+ * @param committed_idx index of the last record committed to the DB.
+ */
+int cl_spill_sync(cl_spill_t *spill, uint64_t committed_idx);
+
+/**
+ * Get the next record to replay.
+ * @return a copy of the record (to be released by llapi_changelog_free),
+ *         NULL if there is no more record to replay.
+ */
+CL_REC_TYPE *cl_spill_next(cl_spill_t *spill);
+
+/** Are all spilled records replayed? */
+static inline bool cl_spill_empty(const cl_spill_t *spill)
+{
+    return spill->count == 0;
+}
+
+#endif
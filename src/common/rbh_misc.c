@@ -35,6 +35,7 @@
 #include <sys/types.h>
 #include <utime.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <fcntl.h>
 #include <ctype.h>
 #include <string.h>
@@ -472,66 +473,202 @@ const char *mode2type(mode_t mode)
         return NULL;
 }
 
-void stat2rbh_attrs(const struct stat *p_inode, attr_set_t *p_attr_set,
-                    bool size_info)
+/* creation time is always <= ctime */
+static void update_creation_time(const struct stat *p_inode,
+                                 attr_set_t *p_attr_set)
 {
-    ATTR_MASK_SET(p_attr_set, uid);
-    if (global_config.uid_gid_as_numbers)
-        ATTR(p_attr_set, uid).num = p_inode->st_uid;
-    else
-        uid2str(p_inode->st_uid, ATTR(p_attr_set, uid).txt);
+    if (ATTR_MASK_TEST(p_attr_set, creation_time)) {
+        if (p_inode->st_ctime < ATTR(p_attr_set, creation_time))
+            ATTR(p_attr_set, creation_time) = p_inode->st_ctime;
+    } else {
+        ATTR_MASK_SET(p_attr_set, creation_time);
+        ATTR(p_attr_set, creation_time) = p_inode->st_ctime;
+    }
+}
 
-    ATTR_MASK_SET(p_attr_set, gid);
-    if (global_config.uid_gid_as_numbers)
-        ATTR(p_attr_set, gid).num = p_inode->st_gid;
-    else
-        gid2str(p_inode->st_gid, ATTR(p_attr_set, gid).txt);
+void statx2rbh_attrs(const struct stat *p_inode, attr_set_t *p_attr_set,
+                     unsigned int stx_mask)
+{
+    if (stx_mask & STATX_UID) {
+        ATTR_MASK_SET(p_attr_set, uid);
+        if (global_config.uid_gid_as_numbers)
+            ATTR(p_attr_set, uid).num = p_inode->st_uid;
+        else
+            uid2str(p_inode->st_uid, ATTR(p_attr_set, uid).txt);
+    }
 
-    if (size_info) {
+    if (stx_mask & STATX_GID) {
+        ATTR_MASK_SET(p_attr_set, gid);
+        if (global_config.uid_gid_as_numbers)
+            ATTR(p_attr_set, gid).num = p_inode->st_gid;
+        else
+            gid2str(p_inode->st_gid, ATTR(p_attr_set, gid).txt);
+    }
+
+    if (stx_mask & STATX_SIZE) {
         ATTR_MASK_SET(p_attr_set, size);
         ATTR(p_attr_set, size) = p_inode->st_size;
+    }
 
+    if (stx_mask & STATX_BLOCKS) {
         ATTR_MASK_SET(p_attr_set, blocks);
         ATTR(p_attr_set, blocks) = p_inode->st_blocks;
+    }
 
-        /* times are also wrong when they come from the MDT device */
-        ATTR_MASK_SET(p_attr_set, last_access);
-
-        /* Vary the setting of last_access depending on value of
-         * global_config.last_access_only_atime */
-        if (global_config.last_access_only_atime)
+    /* Vary the setting of last_access depending on value of
+     * global_config.last_access_only_atime */
+    if (global_config.last_access_only_atime) {
+        if (stx_mask & STATX_ATIME) {
+            ATTR_MASK_SET(p_attr_set, last_access);
             ATTR(p_attr_set, last_access) = p_inode->st_atime;
-        else
-            ATTR(p_attr_set, last_access) =
-                MAX(p_inode->st_atime, p_inode->st_mtime);
+        }
+    } else if ((stx_mask & (STATX_ATIME | STATX_MTIME))
+               == (STATX_ATIME | STATX_MTIME)) {
+        ATTR_MASK_SET(p_attr_set, last_access);
+        ATTR(p_attr_set, last_access) =
+            MAX(p_inode->st_atime, p_inode->st_mtime);
+    }
 
+    if (stx_mask & STATX_MTIME) {
         ATTR_MASK_SET(p_attr_set, last_mod);
         ATTR(p_attr_set, last_mod) = p_inode->st_mtime;
+    }
 
+    if (stx_mask & STATX_CTIME) {
         ATTR_MASK_SET(p_attr_set, last_mdchange);
         ATTR(p_attr_set, last_mdchange) = p_inode->st_ctime;
+
+        update_creation_time(p_inode, p_attr_set);
     }
 
-    if (ATTR_MASK_TEST(p_attr_set, creation_time)) {
-        /* creation time is always <= ctime */
-        if (p_inode->st_ctime < ATTR(p_attr_set, creation_time))
-            ATTR(p_attr_set, creation_time) = p_inode->st_ctime;
-    } else {
-        ATTR_MASK_SET(p_attr_set, creation_time);
-        ATTR(p_attr_set, creation_time) = p_inode->st_ctime;
+    if (stx_mask & STATX_TYPE) {
+        const char *type = mode2type(p_inode->st_mode);
+
+        if (type != NULL) {
+            ATTR_MASK_SET(p_attr_set, type);
+            strcpy(ATTR(p_attr_set, type), type);
+        }
+    }
+
+    if (stx_mask & STATX_NLINK) {
+        ATTR_MASK_SET(p_attr_set, nlink);
+        ATTR(p_attr_set, nlink) = p_inode->st_nlink;
     }
 
-    const char *type = mode2type(p_inode->st_mode);
-    if (type != NULL) {
-        ATTR_MASK_SET(p_attr_set, type);
-        strcpy(ATTR(p_attr_set, type), type);
+    if (stx_mask & STATX_MODE) {
+        ATTR_MASK_SET(p_attr_set, mode);
+        /* mode + sticky bits */
+        ATTR(p_attr_set, mode) = p_inode->st_mode & 07777;
     }
+}
+
+void stat2rbh_attrs(const struct stat *p_inode, attr_set_t *p_attr_set,
+                    bool size_info)
+{
+    if (size_info) {
+        statx2rbh_attrs(p_inode, p_attr_set, STATX_BASIC_STATS);
+        return;
+    }
+
+    /* times are also wrong when they come from the MDT device */
+    statx2rbh_attrs(p_inode, p_attr_set, STATX_BASIC_STATS
+                    & ~(STATX_SIZE | STATX_BLOCKS | STATX_ATIME
+                        | STATX_MTIME | STATX_CTIME));
+    update_creation_time(p_inode, p_attr_set);
+}
+
+unsigned int attr_mask2statx(const attr_mask_t *mask)
+{
+    unsigned int stx_mask = 0;
+
+    if (mask->std & ATTR_MASK_uid)
+        stx_mask |= STATX_UID;
+    if (mask->std & ATTR_MASK_gid)
+        stx_mask |= STATX_GID;
+    if (mask->std & ATTR_MASK_size)
+        stx_mask |= STATX_SIZE;
+    if (mask->std & ATTR_MASK_blocks)
+        stx_mask |= STATX_BLOCKS;
+    if (mask->std & ATTR_MASK_last_access) {
+        stx_mask |= STATX_ATIME;
+        if (!global_config.last_access_only_atime)
+            stx_mask |= STATX_MTIME;
+    }
+    if (mask->std & ATTR_MASK_last_mod)
+        stx_mask |= STATX_MTIME;
+    if (mask->std & (ATTR_MASK_last_mdchange | ATTR_MASK_creation_time))
+        stx_mask |= STATX_CTIME;
+    if (mask->std & ATTR_MASK_type)
+        stx_mask |= STATX_TYPE;
+    if (mask->std & ATTR_MASK_nlink)
+        stx_mask |= STATX_NLINK;
+    if (mask->std & ATTR_MASK_mode)
+        stx_mask |= STATX_MODE;
+
+    return stx_mask;
+}
+
+#ifdef HAVE_STATX
+/* set to false if statx is not supported by the kernel */
+static bool statx_supported = true;
+#endif
+
+int rbh_statx(int dirfd, const char *path, unsigned int stx_mask,
+              bool dont_sync, struct stat *p_inode, unsigned int *stx_got)
+{
+#ifdef HAVE_STATX
+    struct statx stx;
+    int flags = AT_SYMLINK_NOFOLLOW;
 
-    ATTR_MASK_SET(p_attr_set, nlink);
-    ATTR(p_attr_set, nlink) = p_inode->st_nlink;
+    if (!statx_supported)
+        goto fallback;
 
-    ATTR_MASK_SET(p_attr_set, mode);
-    ATTR(p_attr_set, mode) = p_inode->st_mode & 07777;  /* mode + sticky bits */
+    if (dont_sync)
+        flags |= AT_STATX_DONT_SYNC;
+
+    /* always get entry type and inode */
+    stx_mask |= STATX_TYPE | STATX_INO;
+
+    if (statx(dirfd, path, flags, stx_mask, &stx) != 0) {
+        if (errno == ENOSYS) {
+            DisplayLog(LVL_EVENT, __func__, "statx is not supported: "
+                       "using fstatat instead");
+            statx_supported = false;
+            goto fallback;
+        }
+        return -errno;
+    }
+
+    memset(p_inode, 0, sizeof(*p_inode));
+    p_inode->st_dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    p_inode->st_rdev = makedev(stx.stx_rdev_major, stx.stx_rdev_minor);
+    p_inode->st_ino = stx.stx_ino;
+    p_inode->st_mode = stx.stx_mode;
+    p_inode->st_nlink = stx.stx_nlink;
+    p_inode->st_uid = stx.stx_uid;
+    p_inode->st_gid = stx.stx_gid;
+    p_inode->st_size = stx.stx_size;
+    p_inode->st_blksize = stx.stx_blksize;
+    p_inode->st_blocks = stx.stx_blocks;
+    p_inode->st_atim.tv_sec = stx.stx_atime.tv_sec;
+    p_inode->st_atim.tv_nsec = stx.stx_atime.tv_nsec;
+    p_inode->st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+    p_inode->st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+    p_inode->st_ctim.tv_sec = stx.stx_ctime.tv_sec;
+    p_inode->st_ctim.tv_nsec = stx.stx_ctime.tv_nsec;
+
+    /* the filesystem may return more fields than requested,
+     * or less if it does not support some */
+    *stx_got = stx.stx_mask & STATX_BASIC_STATS;
+    return 0;
+
+ fallback:
+#endif
+    if (fstatat(dirfd, path, p_inode, AT_SYMLINK_NOFOLLOW) != 0)
+        return -errno;
+
+    *stx_got = STATX_BASIC_STATS;
+    return 0;
 }
 
 void rbh_attrs2stat(const attr_set_t *p_attr_set, struct stat *p_inode)
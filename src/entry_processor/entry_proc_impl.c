@@ -28,9 +28,17 @@
 #include <pthread.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 
 static sem_t pipeline_token;
 
+/* stage information is aligned on cache lines, so worker threads
+ * working on different stages don't invalidate each other's caches */
+#define CACHE_LINE_SIZE 64
+
+/* read a value shared between threads without taking its lock */
+#define READ_ONCE(_x) (*(volatile typeof(_x) *)&(_x))
+
 /* each stage of the pipeline consist of the following information: */
 typedef struct __list_by_stage__ {
     struct rh_list_head entries;
@@ -50,15 +58,51 @@ typedef struct __list_by_stage__ {
                                              * processing entries at this
                                              * stage */
     pthread_mutex_t stage_mutex;
-} list_by_stage_t;
+} __attribute__ ((aligned(CACHE_LINE_SIZE))) list_by_stage_t;
 
 /* Note1: nb_current_entries + nb_unprocessed_entries + nb_processed_entries
  *         = nb entries at a given step */
 /* stages mutex must always be taken from lower stage to upper to avoid
  * deadlocks */
+/* Note3: counters are always modified with the stage mutex held, but they
+ * can be read without it to skip stages with nothing to do. */
 
 static list_by_stage_t *pipeline = NULL;
 
+/* New operations are first queued to a lock-free MPMC ring, so that
+ * pushing threads (scan, changelog readers) never wait for stage locks.
+ * Worker threads move them to the pipeline stages by batches, under
+ * ingress_lock to keep their order (which ID constraints rely on). */
+#define INGRESS_SIZE  4096 /* must be a power of 2 */
+#define INGRESS_BATCH 256  /* max ops moved to the stages at once */
+
+typedef struct ingress_cell__ {
+    volatile unsigned long seq;
+    entry_proc_op_t *op;
+} ingress_cell_t;
+
+typedef struct ingress_pos__ {
+    volatile unsigned long val;
+} __attribute__ ((aligned(CACHE_LINE_SIZE))) ingress_pos_t;
+
+static struct {
+    ingress_pos_t enqueue;
+    ingress_pos_t dequeue;
+    ingress_cell_t *cells;
+} ingress;
+
+static pthread_mutex_t ingress_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void ingress_init(void)
+{
+    unsigned long i;
+
+    for (i = 0; i < INGRESS_SIZE; i++)
+        ingress.cells[i].seq = i;
+    ingress.enqueue.val = 0;
+    ingress.dequeue.val = 0;
+}
+
 /* EXPORTED VARIABLES: current pipeline in operation */
 pipeline_stage_t *entry_proc_pipeline = NULL;
 pipeline_descr_t entry_proc_descr = { 0 };
@@ -81,14 +125,57 @@ static entry_proc_op_t **EntryProcessor_GetNextOp(int *count);
 static void print_op_stats(entry_proc_op_t *p_op, unsigned int stage,
                            const char *what);
 
+/* Asynchronous stages (STAGE_FLAG_ASYNC) are run by a second thread of
+ * each worker, with its own DB connection. The worker queues the operations
+ * and goes on processing other stages while the DB request is running.
+ * Operations are acknowledged once the request is done, so constraints on
+ * their ids are kept until then. */
+typedef struct async_batch__ {
+    entry_proc_op_t **ops;
+    int count;
+} async_batch_t;
+
+typedef struct async_runner__ {
+    pthread_t thread_id;
+    lmgr_t lmgr;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* signaled when the queue changes */
+    async_batch_t *queue;   /* ring of db_apply_async_depth batches */
+    unsigned int first;
+    unsigned int count;     /* batches queued or running */
+    bool stop;
+} async_runner_t;
+
 typedef struct worker_info__ {
     unsigned int index;
     pthread_t thread_id;
     lmgr_t lmgr;
+    async_runner_t *runner; /* NULL if async stages are run by the worker */
 } worker_info_t;
 
 static worker_info_t *worker_params = NULL;
 
+/* Operation structures are recycled instead of being freed: they are
+ * large and allocated at a high rate, often by a thread and released by
+ * another one, which is costly and fragments malloc arenas.
+ * Each thread keeps a cache of free operations, and exchanges them by
+ * batches with a shared pool. */
+#define OP_CACHE_MAX        64
+#define OP_CACHE_BATCH      32
+#define OP_POOL_DEFAULT_MAX 10000
+
+typedef struct op_cache__ {
+    entry_proc_op_t *first;
+    unsigned int count;
+} op_cache_t;
+
+static pthread_key_t op_cache_key;
+static pthread_once_t op_cache_once = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t op_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static entry_proc_op_t *op_pool = NULL;
+static unsigned int op_pool_count = 0;
+
 #ifdef _DEBUG_ENTRYPROC
 static void dump_entry_op(entry_proc_op_t *p_op)
 {
@@ -117,6 +204,132 @@ static void dump_entry_op(entry_proc_op_t *p_op)
 #endif
 
 /* worker thread for pipeline */
+/** run the function of the current stage of the given operations */
+static void run_stage(entry_proc_op_t **list_op, int count, lmgr_t *lmgr)
+{
+    const pipeline_stage_t *stage_info =
+        &entry_proc_pipeline[list_op[0]->pipeline_stage];
+
+    if (count == 1) {
+        /* preferably call single entry function, if it exists */
+        if (stage_info->stage_function)
+            stage_info->stage_function(list_op[0], lmgr);
+        /* else, call batch function if it exists */
+        else if (stage_info->stage_batch_function)
+            stage_info->stage_batch_function(list_op, count, lmgr);
+        else
+            /* no function! */
+            RBH_BUG("No function is defined for a pipeline step");
+    } else if (count > 1) {
+        /* call batch function, if it exists */
+        if (stage_info->stage_batch_function)
+            stage_info->stage_batch_function(list_op, count, lmgr);
+        else
+            /* no batch function! */
+            RBH_BUG("Batched returned whereas no batch function is "
+                    "defined for this stage");
+    } else
+        RBH_BUG("Empty operation list returned");
+}
+
+static void *async_runner_thr(void *arg)
+{
+    worker_info_t *myinfo = (worker_info_t *) arg;
+    async_runner_t *runner = myinfo->runner;
+    const unsigned int depth = entry_proc_conf.db_apply_async_depth;
+
+    /* create connection to database */
+    if (ListMgr_InitAccess(&runner->lmgr)) {
+        DisplayLog(LVL_CRIT, ENTRYPROC_TAG,
+                   "Async DB thread of pipeline worker #%u could not connect to ListMgr. Exiting.",
+                   myinfo->index);
+        exit(1);
+    }
+
+    P(runner->lock);
+    for (;;) {
+        async_batch_t batch;
+
+        while (runner->count == 0 && !runner->stop)
+            pthread_cond_wait(&runner->cond, &runner->lock);
+        if (runner->count == 0)
+            break;
+
+        batch = runner->queue[runner->first];
+        V(runner->lock);
+
+        run_stage(batch.ops, batch.count, &runner->lmgr);
+        MemFree(batch.ops);
+
+        P(runner->lock);
+        runner->first = (runner->first + 1) % depth;
+        runner->count--;
+        pthread_cond_signal(&runner->cond);
+    }
+    V(runner->lock);
+
+    ListMgr_CloseAccess(&runner->lmgr);
+    pthread_exit(NULL);
+    return NULL;
+}
+
+static int async_runner_start(worker_info_t *myinfo)
+{
+    async_runner_t *runner;
+    int rc;
+
+    runner = MemCalloc(1, sizeof(*runner));
+    if (!runner)
+        return ENOMEM;
+    runner->queue = MemCalloc(entry_proc_conf.db_apply_async_depth,
+                              sizeof(async_batch_t));
+    if (!runner->queue) {
+        MemFree(runner);
+        return ENOMEM;
+    }
+    pthread_mutex_init(&runner->lock, NULL);
+    pthread_cond_init(&runner->cond, NULL);
+
+    myinfo->runner = runner;
+    rc = pthread_create(&runner->thread_id, NULL, async_runner_thr, myinfo);
+    if (rc) {
+        myinfo->runner = NULL;
+        MemFree(runner->queue);
+        MemFree(runner);
+    }
+    return rc;
+}
+
+/** queue operations to the async thread (waits if its queue is full) */
+static void async_runner_submit(async_runner_t *runner,
+                                entry_proc_op_t **list_op, int count)
+{
+    const unsigned int depth = entry_proc_conf.db_apply_async_depth;
+    async_batch_t *batch;
+
+    P(runner->lock);
+    while (runner->count >= depth)
+        pthread_cond_wait(&runner->cond, &runner->lock);
+
+    batch = &runner->queue[(runner->first + runner->count) % depth];
+    batch->ops = list_op;
+    batch->count = count;
+    runner->count++;
+    pthread_cond_signal(&runner->cond);
+    V(runner->lock);
+}
+
+/** run the queued operations and stop the async thread */
+static void async_runner_stop(async_runner_t *runner)
+{
+    P(runner->lock);
+    runner->stop = true;
+    pthread_cond_signal(&runner->cond);
+    V(runner->lock);
+
+    pthread_join(runner->thread_id, NULL);
+}
+
 static void *entry_proc_worker_thr(void *arg)
 {
     entry_proc_op_t **list_op;
@@ -136,30 +349,24 @@ static void *entry_proc_worker_thr(void *arg)
         exit(1);
     }
 
+    if (entry_proc_conf.db_apply_async_depth > 0) {
+        rc = async_runner_start(myinfo);
+        if (rc)
+            DisplayLog(LVL_MAJOR, ENTRYPROC_TAG, "Pipeline worker #%u could "
+                       "not start its async DB thread: %s. DB operations "
+                       "will be synchronous.", myinfo->index, strerror(rc));
+    }
+
     while ((list_op = EntryProcessor_GetNextOp(&count)) != NULL) {
-        const pipeline_stage_t *stage_info =
-            &entry_proc_pipeline[list_op[0]->pipeline_stage];
-        if (count == 1) {
-            /* preferably call single entry function, if it exists */
-            if (stage_info->stage_function)
-                stage_info->stage_function(list_op[0], &myinfo->lmgr);
-            /* else, call batch function if it exists */
-            else if (stage_info->stage_batch_function)
-                stage_info->stage_batch_function(list_op, count, &myinfo->lmgr);
-            else
-                /* no function! */
-                RBH_BUG("No function is defined for a pipeline step");
-        } else if (count > 1) {
-            /* call batch function, if it exists */
-            if (stage_info->stage_batch_function)
-                stage_info->stage_batch_function(list_op, count, &myinfo->lmgr);
-            else
-                /* no batch function! */
-                RBH_BUG("Batched returned whereas no batch function is "
-                        "defined for this stage");
-        } else
-            RBH_BUG("Empty operation list returned");
+        if (myinfo->runner != NULL && count > 0
+            && (entry_proc_pipeline[list_op[0]->pipeline_stage].stage_flags
+                & STAGE_FLAG_ASYNC)) {
+            /* list_op is freed by the async thread */
+            async_runner_submit(myinfo->runner, list_op, count);
+            continue;
+        }
 
+        run_stage(list_op, count, &myinfo->lmgr);
         MemFree(list_op);
     }
 
@@ -168,7 +375,9 @@ static void *entry_proc_worker_thr(void *arg)
                    "Error: EntryProcessor_GetNextOp returned NULL but no termination signal has been received!!!");
 
     /* All operations have been processed. Now flushing DB operations and
-     * closing connection. */
+     * closing connections. */
+    if (myinfo->runner != NULL)
+        async_runner_stop(myinfo->runner);
     ListMgr_CloseAccess(&myinfo->lmgr);
 
     /* notify thread's termination */
@@ -274,6 +483,9 @@ int EntryProcessor_Init(pipeline_flavor_e flavor, run_flags_t flags, void *arg)
                entry_proc_conf.nb_thread);
     DisplayLog(LVL_FULL, "EntryProc_Config", "max_batch_size=%u",
                entry_proc_conf.max_batch_size);
+    if (entry_proc_conf.db_apply_async_depth > 0)
+        DisplayLog(LVL_FULL, "EntryProc_Config", "db_apply_async_depth=%u",
+                   entry_proc_conf.db_apply_async_depth);
     for (i = 0; i < entry_proc_descr.stage_count; i++) {
         if (entry_proc_pipeline[i].stage_flags & STAGE_FLAG_SEQUENTIAL)
             DisplayLog(LVL_FULL, "EntryProc_Config", "%s: sequential",
@@ -287,11 +499,14 @@ int EntryProcessor_Init(pipeline_flavor_e flavor, run_flags_t flags, void *arg)
                        entry_proc_pipeline[i].max_thread_count);
     }
 
-    pipeline =
-        (list_by_stage_t *) MemCalloc(entry_proc_descr.stage_count,
-                                      sizeof(list_by_stage_t));
-    if (!pipeline)
+    if (posix_memalign((void **)&pipeline, CACHE_LINE_SIZE,
+                       entry_proc_descr.stage_count * sizeof(list_by_stage_t)))
+        return ENOMEM;
+
+    if (posix_memalign((void **)&ingress.cells, CACHE_LINE_SIZE,
+                       INGRESS_SIZE * sizeof(ingress_cell_t)))
         return ENOMEM;
+    ingress_init();
 
     if (entry_proc_conf.match_classes && policies.fileset_count == 0) {
         DisplayLog(LVL_EVENT, ENTRYPROC_TAG,
@@ -345,70 +560,184 @@ int EntryProcessor_Init(pipeline_flavor_e flavor, run_flags_t flags, void *arg)
     return 0;
 }
 
-/**
- * This function adds a new operation, allocated through
- * GetNewEntryProc_op(), to the queue. All fields have been set to 0
- * or a proper value.
- */
-void EntryProcessor_Push(entry_proc_op_t *p_entry)
+/** number of operations in the ingress ring (approximate) */
+static inline unsigned int ingress_count(void)
 {
-    int i;
-    unsigned int insert_stage;
+    return READ_ONCE(ingress.enqueue.val) - READ_ONCE(ingress.dequeue.val);
+}
 
-    /* if a limit of pending operations is specified, wait for a token */
-    if (entry_proc_conf.max_pending_operations > 0)
-        sem_wait(&pipeline_token);
+/** queue an operation to the ingress ring.
+ * @return false if the ring is full. */
+static bool ingress_enqueue(entry_proc_op_t *p_op)
+{
+    ingress_cell_t *cell;
+    unsigned long pos = ingress.enqueue.val;
+
+    for (;;) {
+        long diff;
+
+        cell = &ingress.cells[pos & (INGRESS_SIZE - 1)];
+        diff = (long)cell->seq - (long)pos;
+        __sync_synchronize();
+
+        if (diff == 0) {
+            /* the cell is free: take it */
+            if (__sync_bool_compare_and_swap(&ingress.enqueue.val, pos,
+                                             pos + 1))
+                break;
+            pos = ingress.enqueue.val;
+        } else if (diff < 0) {
+            /* the cell was not released by the consumer */
+            return false;
+        } else {
+            /* another thread took this cell */
+            pos = ingress.enqueue.val;
+        }
+    }
 
-    /* We must always insert it in the first stage, to keep
-     * the good ordering of entries.
-     * Except if all stages between stage0 and insert_stage are empty
-     */
+    cell->op = p_op;
+    /* publish the operation */
+    __sync_synchronize();
+    cell->seq = pos + 1;
+    return true;
+}
 
-    /* by default, insert stage is entry stage
-     * except if there is a non empty stage before
-     */
-    insert_stage = p_entry->pipeline_stage;
+/** take the first operation of the ingress ring (NULL if it is empty) */
+static entry_proc_op_t *ingress_dequeue(void)
+{
+    ingress_cell_t *cell;
+    entry_proc_op_t *p_op;
+    unsigned long pos = ingress.dequeue.val;
+
+    for (;;) {
+        long diff;
+
+        cell = &ingress.cells[pos & (INGRESS_SIZE - 1)];
+        diff = (long)cell->seq - (long)(pos + 1);
+        __sync_synchronize();
+
+        if (diff == 0) {
+            if (__sync_bool_compare_and_swap(&ingress.dequeue.val, pos,
+                                             pos + 1))
+                break;
+            pos = ingress.dequeue.val;
+        } else if (diff < 0) {
+            /* empty, or the first operation is not published yet */
+            return NULL;
+        } else {
+            pos = ingress.dequeue.val;
+        }
+    }
 
-    /* take all locks for stage0 to insert_stage or first non empty stage */
-    for (i = 0; i <= p_entry->pipeline_stage; i++) {
-        P(pipeline[i].stage_mutex);
+    p_op = cell->op;
+    /* release the cell for the next round */
+    __sync_synchronize();
+    cell->seq = pos + INGRESS_SIZE;
+    return p_op;
+}
 
-        if (!rh_list_empty(&pipeline[i].entries)) {
-            insert_stage = i;
-            break;
+/** insert operations in the pipeline, in the given order */
+static void push_ops(entry_proc_op_t **ops, unsigned int count)
+{
+    unsigned int i, j;
+    unsigned int max_stage = 0;
+
+    for (i = 0; i < count; i++)
+        if (ops[i]->pipeline_stage > max_stage)
+            max_stage = ops[i]->pipeline_stage;
+
+    /* take all locks from stage0 to the highest insert stage */
+    for (j = 0; j <= max_stage; j++)
+        P(pipeline[j].stage_mutex);
+
+    for (i = 0; i < count; i++) {
+        entry_proc_op_t *p_entry = ops[i];
+        unsigned int insert_stage;
+
+        /* We must always insert it in the first stage, to keep
+         * the good ordering of entries.
+         * Except if all stages between stage0 and insert_stage are empty
+         */
+
+        /* by default, insert stage is entry stage
+         * except if there is a non empty stage before
+         */
+        insert_stage = p_entry->pipeline_stage;
+        for (j = 0; j < p_entry->pipeline_stage; j++) {
+            if (!rh_list_empty(&pipeline[j].entries)) {
+                insert_stage = j;
+                break;
+            }
         }
-    }
 
 #ifdef _DEBUG_ENTRYPROC
-    if (insert_stage != p_entry->pipeline_stage)
-        printf("INSERT STAGE (%u) != PUSH STAGE(%u)\n", insert_stage,
-               p_entry->pipeline_stage);
+        if (insert_stage != p_entry->pipeline_stage)
+            printf("INSERT STAGE (%u) != PUSH STAGE(%u)\n", insert_stage,
+                   p_entry->pipeline_stage);
 #endif
 
-    /* If the stage has an ID_CONSTRAINT and ID is set, register entry */
-    if ((entry_proc_pipeline[insert_stage].
-         stage_flags & STAGE_FLAG_ID_CONSTRAINT)
-        && p_entry->entry_id_is_set) {
-        id_constraint_register(p_entry, false);
-    }
+        /* If the stage has an ID_CONSTRAINT and ID is set, register entry */
+        if ((entry_proc_pipeline[insert_stage].
+             stage_flags & STAGE_FLAG_ID_CONSTRAINT)
+            && p_entry->entry_id_is_set) {
+            id_constraint_register(p_entry, false);
+        }
 #ifdef _DEBUG_ENTRYPROC
-    printf("inserting to stage %u: list=%p, next=%p, prev=%p\n",
-           insert_stage, &pipeline[insert_stage].entries,
-           pipeline[insert_stage].entries.next,
-           pipeline[insert_stage].entries.prev);
+        printf("inserting to stage %u: list=%p, next=%p, prev=%p\n",
+               insert_stage, &pipeline[insert_stage].entries,
+               pipeline[insert_stage].entries.next,
+               pipeline[insert_stage].entries.prev);
 #endif
 
-    /* insert entry */
-    rh_list_add_tail(&p_entry->list, &pipeline[insert_stage].entries);
+        /* insert entry */
+        rh_list_add_tail(&p_entry->list, &pipeline[insert_stage].entries);
 
-    if (insert_stage < p_entry->pipeline_stage)
-        pipeline[insert_stage].nb_processed_entries++;
-    else
-        pipeline[insert_stage].nb_unprocessed_entries++;
+        if (insert_stage < p_entry->pipeline_stage)
+            pipeline[insert_stage].nb_processed_entries++;
+        else
+            pipeline[insert_stage].nb_unprocessed_entries++;
+    }
 
     /* release all lists lock */
-    for (i = 0; i <= insert_stage; i++)
-        V(pipeline[i].stage_mutex);
+    for (j = 0; j <= max_stage; j++)
+        V(pipeline[j].stage_mutex);
+}
+
+/**
+ * Move operations from the ingress ring to the pipeline stages.
+ * @param wait wait for another thread that is moving operations,
+ *             else return immediately.
+ */
+static void ingress_drain(bool wait)
+{
+    entry_proc_op_t *ops[INGRESS_BATCH];
+    unsigned int count;
+
+    if (wait)
+        P(ingress_lock);
+    else if (pthread_mutex_trylock(&ingress_lock) != 0)
+        return;
+
+    do {
+        for (count = 0; count < INGRESS_BATCH; count++) {
+            ops[count] = ingress_dequeue();
+            if (ops[count] == NULL)
+                break;
+        }
+        if (count > 0)
+            push_ops(ops, count);
+    } while (count == INGRESS_BATCH);
+
+    V(ingress_lock);
+}
+
+/** insert an operation in the pipeline (once it got a token) */
+static void push_op(entry_proc_op_t *p_entry)
+{
+    /* if the ring is full, move its contents to the pipeline stages
+     * before queuing this operation after them */
+    while (!ingress_enqueue(p_entry))
+        ingress_drain(true);
 
     /* there is a new entry to be processed ! (signal only if threads
      * are waiting) */
@@ -416,9 +745,45 @@ void EntryProcessor_Push(entry_proc_op_t *p_entry)
     if (nb_waiting_threads > 0)
         pthread_cond_signal(&work_avail_cond);
     V(work_avail_lock);
+}
 
+/**
+ * This function adds a new operation, allocated through
+ * GetNewEntryProc_op(), to the queue. All fields have been set to 0
+ * or a proper value.
+ */
+void EntryProcessor_Push(entry_proc_op_t *p_entry)
+{
+    /* if a limit of pending operations is specified, wait for a token */
+    if (entry_proc_conf.max_pending_operations > 0)
+        sem_wait(&pipeline_token);
+
+    push_op(p_entry);
 }   /* EntryProcessor_Push */
 
+int EntryProcessor_TryPush(entry_proc_op_t *p_entry)
+{
+    if (entry_proc_conf.max_pending_operations > 0
+        && sem_trywait(&pipeline_token) != 0)
+        return EAGAIN;
+
+    push_op(p_entry);
+    return 0;
+}
+
+bool EntryProcessor_Saturated(void)
+{
+    int val;
+
+    if (entry_proc_conf.max_pending_operations <= 0)
+        return false;
+
+    if (sem_getvalue(&pipeline_token, &val) != 0)
+        return false;
+
+    return val <= 0;
+}
+
 /*
  * Move terminated operations to next stage.
  * The source stage is locked.
@@ -564,6 +929,44 @@ static int move_stage_entries(const unsigned int source_stage_index)
     return count;
 }   /* move_stage_entries */
 
+/**
+ * Check (without lock) if a stage can't accept another thread.
+ */
+static inline bool stage_is_busy(unsigned int i)
+{
+    unsigned int flags = READ_ONCE(entry_proc_pipeline[i].stage_flags);
+    unsigned int nb_threads = READ_ONCE(pipeline[i].nb_threads);
+
+    if (flags & STAGE_FLAG_SEQUENTIAL)
+        return nb_threads != 0;
+
+    if (flags & STAGE_FLAG_FORCE_SEQ)
+        return true;
+
+    return (entry_proc_pipeline[i].max_thread_count != 0)
+            && (nb_threads >= entry_proc_pipeline[i].max_thread_count);
+}
+
+/**
+ * Count the entries in the stages after the given one.
+ * Their locks are taken in turn, so the caller can hold the lock of
+ * the given stage.
+ */
+static unsigned int upper_stage_entries(unsigned int stage)
+{
+    unsigned int i, total = 0;
+
+    for (i = stage + 1; i < entry_proc_descr.stage_count; i++) {
+        list_by_stage_t *pl = &pipeline[i];
+
+        P(pl->stage_mutex);
+        total += pl->nb_current_entries + pl->nb_unprocessed_entries
+            + pl->nb_processed_entries;
+        V(pl->stage_mutex);
+    }
+    return total;
+}
+
 /**
  * Return an entry to be processed.
  * This entry is tagged "being_processed" and stage info is updated.
@@ -574,25 +977,34 @@ static entry_proc_op_t **next_work_avail(bool *p_empty, int *op_count)
 {
     entry_proc_op_t *p_curr;
     int i;
-    int tot_entries = 0;
 
     if (terminate_flag == BREAK)
         return NULL;
 
-    *p_empty = true;
+    /* get new operations */
+    if (ingress_count() > 0)
+        ingress_drain(false);
+
+    /* operations may remain in the ring if another thread is moving them */
+    *p_empty = (ingress_count() == 0);
 
     /* check every stage from the last to the first */
     for (i = entry_proc_descr.stage_count - 1; i >= 0; i--) {
         list_by_stage_t *pl = &pipeline[i];
+        unsigned int unprocessed = READ_ONCE(pl->nb_unprocessed_entries);
+
+        /* Skip stages with nothing to do without taking their lock.
+         * If an entry is missed, the thread that made it available
+         * signals work_avail_cond after updating the counters. */
+        if (unprocessed == 0 || stage_is_busy(i)) {
+            if (unprocessed != 0)
+                *p_empty = false;
+            continue;
+        }
 
         /* entries have not been processed at this stage. */
         P(pl->stage_mutex);
 
-        /* Accumulate the number of entries in the upper stages. */
-        tot_entries +=
-            pl->nb_current_entries + pl->nb_unprocessed_entries +
-            pl->nb_processed_entries;
-
         if (pl->nb_unprocessed_entries == 0) {
             V(pl->stage_mutex);
 #ifdef _DEBUG_ENTRYPROC
@@ -650,20 +1062,55 @@ static entry_proc_op_t **next_work_avail(bool *p_empty, int *op_count)
                         return NULL;
                     }
 
+                    entry_proc_op_t **listop =
+                        MemCalloc(entry_proc_conf.max_batch_size,
+                                  sizeof(entry_proc_op_t *));
+                    if (!listop) {
+                        V(pl->stage_mutex);
+                        return NULL;
+                    }
+
                     /* tag the entry and update stage info */
                     pl->nb_unprocessed_entries--;
                     pl->nb_current_entries++;
                     pl->nb_threads++;
                     p_curr->being_processed = 1;
 
-                    V(pl->stage_mutex);
+                    listop[0] = p_curr;
+                    *op_count = 1;
+
+                    /* if the stage is batchable, take the contiguous range
+                     * of entries that follow */
+                    if (entry_proc_conf.max_batch_size > 1
+                        && entry_proc_pipeline[i].test_batchable != NULL
+                        && entry_proc_pipeline[i].stage_batch_function
+                           != NULL) {
+                        entry_proc_op_t *p_next;
+                        attr_mask_t batch_mask = p_curr->fs_attrs.attr_mask;
+
+                        rh_list_for_each_entry_after(p_next, &pl->entries,
+                                                     p_curr, list) {
+                            if (*op_count >= entry_proc_conf.max_batch_size
+                                || p_next->being_processed
+                                || p_next->pipeline_stage != i
+                                || ((entry_proc_pipeline[i].stage_flags
+                                     & STAGE_FLAG_ID_CONSTRAINT)
+                                    && p_next->entry_id_is_set
+                                    && !id_constraint_is_first_op(p_next))
+                                || !entry_proc_pipeline[i].
+                                    test_batchable(p_curr, p_next,
+                                                   &batch_mask))
+                                break;
 
-                    entry_proc_op_t **listop =
-                        MemAlloc(sizeof(entry_proc_op_t *));
-                    if (listop) {
-                        *listop = p_curr;
-                        *op_count = 1;
+                            pl->nb_unprocessed_entries--;
+                            pl->nb_current_entries++;
+                            p_next->being_processed = 1;
+                            listop[*op_count] = p_next;
+                            (*op_count)++;
+                        }
                     }
+
+                    V(pl->stage_mutex);
                     return listop;
                 }
             }
@@ -709,7 +1156,9 @@ static entry_proc_op_t **next_work_avail(bool *p_empty, int *op_count)
                      * empty. */
                     if (p_curr ==
                         rh_list_first_entry(&pl->entries, entry_proc_op_t, list)
-                        && tot_entries - pl->nb_unprocessed_entries == 0) {
+                        && pl->nb_current_entries == 0
+                        && pl->nb_processed_entries == 0
+                        && upper_stage_entries(i) == 0) {
                         /* This is the first entry, and there is no
                          * other entry being processed in this or the
                          * upper stages. So we can process it */
@@ -788,6 +1237,13 @@ static entry_proc_op_t **next_work_avail(bool *p_empty, int *op_count)
                             /* entry is already beeing processed or is at
                              * a different stage */
                             break;
+                        else if ((entry_proc_pipeline[i].stage_flags
+                                  & STAGE_FLAG_ID_CONSTRAINT)
+                                 && (!p_next->entry_id_is_set
+                                     || !id_constraint_is_first_op(p_next)))
+                            /* another operation on this id must be
+                             * processed first */
+                            break;
 
                         if (entry_proc_pipeline[i].
                             test_batchable(p_curr, p_next, &batch_mask)) {
@@ -840,6 +1296,22 @@ static entry_proc_op_t **EntryProcessor_GetNextOp(int *count)
     int i;
     *count = 0;
 
+    /* Fast path: look for available work without taking the global lock,
+     * so that busy workers don't serialize on it. */
+    list_op = next_work_avail(&is_empty, count);
+    if (list_op != NULL) {
+        /* maybe other entries can be processed after this one ? */
+        if (READ_ONCE(nb_waiting_threads) > 0) {
+            P(work_avail_lock);
+            if (nb_waiting_threads > 0)
+                pthread_cond_signal(&work_avail_cond);
+            V(work_avail_lock);
+        }
+        goto out;
+    }
+
+    /* Slow path: check again while holding the lock, so no notification
+     * can be missed before waiting. */
     P(work_avail_lock);
     nb_waiting_threads++;
 
@@ -871,6 +1343,7 @@ static entry_proc_op_t **EntryProcessor_GetNextOp(int *count)
 
     V(work_avail_lock);
 
+ out:
     gettimeofday(&(list_op[0]->timestamp.start_processing_time), NULL);
     for (i = 1; i < *count; i++)
         list_op[i]->timestamp.start_processing_time =
@@ -879,6 +1352,117 @@ static entry_proc_op_t **EntryProcessor_GetNextOp(int *count)
     return list_op;
 }
 
+static unsigned int op_pool_max(void)
+{
+    if (entry_proc_conf.max_pending_operations > 0)
+        return entry_proc_conf.max_pending_operations;
+    return OP_POOL_DEFAULT_MAX;
+}
+
+/** move 'count' operations from a thread cache to the shared pool */
+static void op_cache_flush(op_cache_t *cache, unsigned int count)
+{
+    entry_proc_op_t *p_op;
+
+    P(op_pool_lock);
+    while (count > 0 && cache->first != NULL) {
+        p_op = cache->first;
+        cache->first = p_op->next_free;
+        cache->count--;
+        count--;
+
+        if (op_pool_count >= op_pool_max()) {
+            MemFree(p_op);
+        } else {
+            p_op->next_free = op_pool;
+            op_pool = p_op;
+            op_pool_count++;
+        }
+    }
+    V(op_pool_lock);
+}
+
+/** thread termination: give its cached operations back to the pool */
+static void op_cache_destroy(void *arg)
+{
+    op_cache_t *cache = arg;
+
+    op_cache_flush(cache, cache->count);
+    MemFree(cache);
+}
+
+static void op_cache_key_init(void)
+{
+    pthread_key_create(&op_cache_key, op_cache_destroy);
+}
+
+/** get the operation cache of the current thread */
+static op_cache_t *op_cache_get(void)
+{
+    op_cache_t *cache;
+
+    pthread_once(&op_cache_once, op_cache_key_init);
+
+    cache = pthread_getspecific(op_cache_key);
+    if (cache == NULL) {
+        cache = MemCalloc(1, sizeof(*cache));
+        if (cache == NULL)
+            return NULL;
+        pthread_setspecific(op_cache_key, cache);
+    }
+    return cache;
+}
+
+static void op_cache_put(entry_proc_op_t *p_op)
+{
+    op_cache_t *cache = op_cache_get();
+
+    if (cache == NULL) {
+        MemFree(p_op);
+        return;
+    }
+
+    p_op->next_free = cache->first;
+    cache->first = p_op;
+    cache->count++;
+
+    if (cache->count > OP_CACHE_MAX)
+        op_cache_flush(cache, OP_CACHE_BATCH);
+}
+
+/** get a free operation structure (not initialized) */
+static entry_proc_op_t *op_cache_take(void)
+{
+    op_cache_t *cache = op_cache_get();
+    entry_proc_op_t *p_op;
+
+    if (cache == NULL)
+        return MemAlloc(sizeof(entry_proc_op_t));
+
+    /* refill the thread cache from the shared pool */
+    if (cache->first == NULL && op_pool_count > 0) {
+        P(op_pool_lock);
+        while (op_pool != NULL && cache->count < OP_CACHE_BATCH) {
+            p_op = op_pool;
+            op_pool = p_op->next_free;
+            op_pool_count--;
+
+            p_op->next_free = cache->first;
+            cache->first = p_op;
+            cache->count++;
+        }
+        V(op_pool_lock);
+    }
+
+    if (cache->first == NULL)
+        return MemAlloc(sizeof(entry_proc_op_t));
+
+    p_op = cache->first;
+    cache->first = p_op->next_free;
+    cache->count--;
+    return p_op;
+}
+
 /**
  * Release an entry op.
  */
@@ -895,20 +1479,33 @@ void EntryProcessor_Release(entry_proc_op_t *p_op)
     ListMgr_FreeAttrs(&p_op->fs_attrs);
     ListMgr_FreeAttrs(&p_op->db_attrs);
 
-    /* free the memory */
-    MemFree(p_op);
+    if (p_op->gc_dirs != NULL) {
+        int i;
+
+        for (i = 0; i < p_op->gc_dir_count; i++)
+            free(p_op->gc_dirs[i].fullname);
+        MemFree(p_op->gc_dirs);
+    }
+
+    /* keep the structure for a next operation */
+    op_cache_put(p_op);
 }
 
 /**
  * Acknownledge a batch of operations.
+ * If next_stages is not NULL, it gives the next stage of each operation
+ * (a negative value means the operation is to be removed). Else, all
+ * operations go to next_stage (or are removed if remove is true).
  */
-int EntryProcessor_AcknowledgeBatch(entry_proc_op_t **ops, unsigned int count,
-                                    unsigned int next_stage, bool remove)
+static int acknowledge_ops(entry_proc_op_t **ops, unsigned int count,
+                           const int *next_stages, unsigned int next_stage,
+                           bool remove)
 {
     const unsigned int curr_stage = ops[0]->pipeline_stage;
     list_by_stage_t *pl = &pipeline[curr_stage];
     int nb_moved;
     struct timeval now, diff;
+    bool any_removed = false;
     int i;
 
     gettimeofday(&now, NULL);
@@ -930,11 +1527,19 @@ int EntryProcessor_AcknowledgeBatch(entry_proc_op_t **ops, unsigned int count,
     timeradd(&diff, &pl->total_processing_time, &pl->total_processing_time);
 
     for (i = 0; i < count; i++) {
+        unsigned int op_stage = next_stage;
+        bool op_remove = remove;
+
+        if (next_stages != NULL) {
+            op_remove = (next_stages[i] < 0);
+            op_stage = next_stages[i];
+        }
+
         /* sanity check */
-        if ((!remove) && (ops[i]->pipeline_stage >= next_stage)) {
+        if ((!op_remove) && (ops[i]->pipeline_stage >= op_stage)) {
             DisplayLog(LVL_CRIT, ENTRYPROC_TAG, "CRITICAL: entry is already"
                        " in a higher pipeline stage %u >= %u !!!",
-                       ops[i]->pipeline_stage, next_stage);
+                       ops[i]->pipeline_stage, op_stage);
 
             V(pl->stage_mutex);
             RBH_BUG("Entry is already in a higher pipeline stage.");
@@ -942,10 +1547,11 @@ int EntryProcessor_AcknowledgeBatch(entry_proc_op_t **ops, unsigned int count,
 
         /* update their status */
         ops[i]->being_processed = 0;
-        ops[i]->pipeline_stage = next_stage;
+        ops[i]->pipeline_stage = op_stage;
 
         /* remove the entry, if it must be */
-        if (remove) {
+        if (op_remove) {
+            any_removed = true;
             /* update stage info. */
             pl->nb_processed_entries--;
             rh_list_del_init(&ops[i]->list);
@@ -972,7 +1578,7 @@ int EntryProcessor_AcknowledgeBatch(entry_proc_op_t **ops, unsigned int count,
      * so it must have been moved.
      */
     /* @TODO check configuration for max_thread_count */
-    if (remove || (nb_moved > 0)
+    if (any_removed || (nb_moved > 0)
         || (entry_proc_pipeline[curr_stage].max_thread_count != 0)) {
         P(work_avail_lock);
         if (nb_waiting_threads > 0)
@@ -981,8 +1587,11 @@ int EntryProcessor_AcknowledgeBatch(entry_proc_op_t **ops, unsigned int count,
     }
 
     /* free entry resources if asked */
-    if (remove) {
+    if (any_removed) {
         for (i = 0; i < count; i++) {
+            if (next_stages != NULL ? next_stages[i] >= 0 : !remove)
+                continue;
+
             /* If a limit of pending operations is specified, release a token */
             if (entry_proc_conf.max_pending_operations > 0)
                 sem_post(&pipeline_token);
@@ -994,6 +1603,24 @@ int EntryProcessor_AcknowledgeBatch(entry_proc_op_t **ops, unsigned int count,
     return 0;
 }
 
+/**
+ * Acknownledge a batch of operations.
+ */
+int EntryProcessor_AcknowledgeBatch(entry_proc_op_t **ops, unsigned int count,
+                                    unsigned int next_stage, bool remove)
+{
+    return acknowledge_ops(ops, count, NULL, next_stage, remove);
+}
+
+/**
+ * Acknowledge a batch of operations that go to different stages.
+ */
+int EntryProcessor_AcknowledgeEach(entry_proc_op_t **ops, unsigned int count,
+                                   const int *next_stages)
+{
+    return acknowledge_ops(ops, count, next_stages, 0, false);
+}
+
 /**
  * Advise that the entry is ready for next step of the pipeline.
  * @param next_stage The next stage to be performed for this entry
@@ -1064,6 +1691,8 @@ void EntryProcessor_DumpCurrentStages(void)
         DisplayLog(LVL_MAJOR, "STATS",
                    "==== EntryProcessor Pipeline Stats ===");
         DisplayLog(LVL_MAJOR, "STATS", "Idle threads: %u", nb_waiting_threads);
+        DisplayLog(LVL_MAJOR, "STATS", "Operations waiting for insertion: %u",
+                   ingress_count());
 
         id_constraint_stats();
 
@@ -1121,9 +1750,19 @@ void EntryProcessor_DumpCurrentStages(void)
                 nb_upd += worker_params[i].lmgr.nbop[OPIDX_UPDATE];
                 nb_rm += worker_params[i].lmgr.nbop[OPIDX_RM];
             }
+            if (worker_params && worker_params[i].runner) {
+                const lmgr_t *lmgr = &worker_params[i].runner->lmgr;
+
+                nb_get += lmgr->nbop[OPIDX_GET];
+                nb_ins += lmgr->nbop[OPIDX_INSERT];
+                nb_upd += lmgr->nbop[OPIDX_UPDATE];
+                nb_rm += lmgr->nbop[OPIDX_RM];
+            }
         }
         DisplayLog(LVL_MAJOR, "STATS", "DB ops: get=%u/ins=%u/upd=%u/rm=%u",
                    nb_get, nb_ins, nb_upd, nb_rm);
+        DisplayLog(LVL_MAJOR, "STATS", "Free operations in shared pool: %u",
+                   op_pool_count);
     }
 
     if (TestDisplayLevel(LVL_EVENT)) {
@@ -1159,11 +1798,13 @@ entry_proc_op_t *EntryProcessor_Get(void)
     /* allocate a new pipeline entry */
     entry_proc_op_t *p_entry;
 
-    p_entry = (entry_proc_op_t *) MemCalloc(1, sizeof(entry_proc_op_t));
+    p_entry = op_cache_take();
 
     if (!p_entry)
         return NULL;
 
+    memset(p_entry, 0, sizeof(*p_entry));
+
     /* nothing is set */
     ATTR_MASK_INIT(&p_entry->db_attrs);
     ATTR_MASK_INIT(&p_entry->fs_attrs);
@@ -1177,7 +1818,7 @@ entry_proc_op_t *EntryProcessor_Get(void)
 static unsigned int count_nb_ops(void)
 {
     int i;
-    unsigned int total = 0;
+    unsigned int total = ingress_count();
 
     for (i = 0; i < entry_proc_descr.stage_count; i++) {
         total += pipeline[i].nb_current_entries
@@ -261,6 +261,7 @@ static void entry_proc_cfg_set_default(void *module_config)
 
     conf->max_pending_operations = 100;
     conf->max_batch_size = 100;
+    conf->db_apply_async_depth = 0;
     conf->match_classes = true;
 
     conf->detect_fake_mtime = false;
@@ -277,6 +278,7 @@ static void entry_proc_cfg_write_default(FILE *output)
 
     print_line(output, 1, "max_pending_operations :  100");
     print_line(output, 1, "max_batch_size         :  100");
+    print_line(output, 1, "db_apply_async_depth   :  0");
     print_line(output, 1, "match_classes          :  yes");
     print_line(output, 1, "detect_fake_mtime      :  no");
     print_end_block(output, 0);
@@ -414,6 +416,30 @@ static void set_default_pipeline_config(const pipeline_descr_t *descr,
     }
 }
 
+/** DB operations can be run asynchronously by a dedicated thread of each
+ * worker. In this case, the thread limit of DB_APPLY stage is a limit of
+ * batches in flight. */
+static void set_async_pipeline_config(const pipeline_descr_t *descr,
+                                      pipeline_stage_t *p,
+                                      const entry_proc_config_t *conf)
+{
+    int i = descr->DB_APPLY;
+
+    if (conf->db_apply_async_depth == 0) {
+        p[i].stage_flags &= ~STAGE_FLAG_ASYNC;
+        p[i].stage_flags |= STAGE_FLAG_SYNC;
+        return;
+    }
+
+    p[i].stage_flags &= ~STAGE_FLAG_SYNC;
+    p[i].stage_flags |= STAGE_FLAG_ASYNC;
+
+    /* keep a single batch at once if they can't be parallelized */
+    if ((p[i].stage_flags & STAGE_FLAG_MAX_THREADS)
+        && p[i].max_thread_count > 1)
+        p[i].max_thread_count *= conf->db_apply_async_depth;
+}
+
 static int entry_proc_cfg_read(config_file_t config, void *module_config,
                                char *msg_out)
 {
@@ -435,6 +461,8 @@ static int entry_proc_cfg_read(config_file_t config, void *module_config,
          &conf->max_pending_operations, 0},
         {"max_batch_size", PT_INT, PFLG_POSITIVE | PFLG_NOT_NULL,
          &conf->max_batch_size, 0},
+        {"db_apply_async_depth", PT_INT, PFLG_POSITIVE,
+         &conf->db_apply_async_depth, 0},
         {"match_classes", PT_BOOL, 0, &conf->match_classes, 0},
         {"detect_fake_mtime", PT_BOOL, 0, &conf->detect_fake_mtime, 0},
 
@@ -447,6 +475,7 @@ static int entry_proc_cfg_read(config_file_t config, void *module_config,
     if (rc == ENOENT) {
         /* set default pipeline config */
         set_default_pipeline_config(&std_pipeline_descr, std_pipeline, conf);
+        set_async_pipeline_config(&std_pipeline_descr, std_pipeline, conf);
         /* No error because no parameter is mandatory */
         return 0;
     }
@@ -477,6 +506,8 @@ static int entry_proc_cfg_read(config_file_t config, void *module_config,
     if (rc)
         return rc;
 
+    set_async_pipeline_config(&std_pipeline_descr, std_pipeline, conf);
+
     // TODO load_pipeline_config(&diff_pipeline_descr, &diff_pipeline);
 
     /* TODO Check consistency of performance strategy:
@@ -509,6 +540,7 @@ static int entry_proc_cfg_read(config_file_t config, void *module_config,
     entry_proc_allowed[next_idx++] = "nb_threads";
     entry_proc_allowed[next_idx++] = "max_pending_operations";
     entry_proc_allowed[next_idx++] = "max_batch_size";
+    entry_proc_allowed[next_idx++] = "db_apply_async_depth";
     entry_proc_allowed[next_idx++] = "match_classes";
     entry_proc_allowed[next_idx++] = "detect_fake_mtime";
 
@@ -542,6 +574,11 @@ static int entry_proc_cfg_reload(entry_proc_config_t *conf)
                    ENTRYPROC_CONFIG_BLOCK
                    "::max_pending_operations changed in config file, but cannot be modified dynamically");
 
+    if (conf->db_apply_async_depth != entry_proc_conf.db_apply_async_depth)
+        DisplayLog(LVL_MAJOR, "EntryProc_Config",
+                   ENTRYPROC_CONFIG_BLOCK
+                   "::db_apply_async_depth changed in config file, but cannot be modified dynamically");
+
     if (conf->max_batch_size != entry_proc_conf.max_batch_size) {
         DisplayLog(LVL_MAJOR, "EntryProc_Config",
                    ENTRYPROC_CONFIG_BLOCK
@@ -608,6 +645,18 @@ static void entry_proc_cfg_write_template(FILE *output)
     print_line(output, 1, "# max batched DB operations (1=no batching)");
     print_line(output, 1, "max_batch_size = 100;");
     fprintf(output, "\n");
+    print_line(output, 1,
+               "# Run DB operations in a separate thread of each worker, with");
+    print_line(output, 1,
+               "# its own DB connection, so the worker can process other");
+    print_line(output, 1,
+               "# entries while the DB is busy. This sets the number of");
+    print_line(output, 1,
+               "# batches each worker can have in flight (0=synchronous).");
+    print_line(output, 1,
+               "# Useful when the DB server is remote (high network latency).");
+    print_line(output, 1, "db_apply_async_depth = 0;");
+    fprintf(output, "\n");
 
     print_line(output, 1,
                "# Optionnaly specify a maximum thread count for each stage of the pipeline:");
@@ -23,6 +23,9 @@ typedef struct entry_proc_config_t {
     unsigned int nb_thread;
     unsigned int max_pending_operations;
     unsigned int max_batch_size;
+    /* number of DB_APPLY batches a worker can have in flight
+     * (0: DB operations are done synchronously by the worker) */
+    unsigned int db_apply_async_depth;
 
     bool match_classes;
 
@@ -44,18 +44,27 @@ static inline bool err_missing(int rc)
 /* forward declaration of EntryProc functions of pipeline */
 static int EntryProc_get_fid(struct entry_proc_op_t *, lmgr_t *);
 static int EntryProc_get_info_db(struct entry_proc_op_t *, lmgr_t *);
+static int EntryProc_get_info_db_batch(struct entry_proc_op_t **, int,
+                                       lmgr_t *);
 static int EntryProc_get_info_fs(struct entry_proc_op_t *, lmgr_t *);
 static int EntryProc_pre_apply(struct entry_proc_op_t *, lmgr_t *);
 static int EntryProc_db_apply(struct entry_proc_op_t *, lmgr_t *);
 static int EntryProc_db_batch_apply(struct entry_proc_op_t **, int, lmgr_t *);
 #ifdef HAVE_CHANGELOGS
 static int EntryProc_chglog_clr(struct entry_proc_op_t *, lmgr_t *);
+static int EntryProc_chglog_clr_batch(struct entry_proc_op_t **, int,
+                                      lmgr_t *);
+static bool chglog_clr_is_batchable(struct entry_proc_op_t *,
+                                    struct entry_proc_op_t *, attr_mask_t *);
 #endif
 static int EntryProc_rm_old_entries(struct entry_proc_op_t *, lmgr_t *);
 
 /* forward declaration to check batchable operations for db_apply stage */
 static bool dbop_is_batchable(struct entry_proc_op_t *,
                               struct entry_proc_op_t *, attr_mask_t *);
+/* forward declaration to check batchable operations for get_info_db stage */
+static bool getdb_is_batchable(struct entry_proc_op_t *,
+                               struct entry_proc_op_t *, attr_mask_t *);
 
 /** pipeline stages */
 enum {
@@ -86,7 +95,8 @@ const pipeline_descr_t std_pipeline_descr = {
 pipeline_stage_t std_pipeline[] = {
     {STAGE_GET_FID, "STAGE_GET_FID", EntryProc_get_fid, NULL, NULL,
      STAGE_FLAG_PARALLEL | STAGE_FLAG_SYNC, 0},
-    {STAGE_GET_INFO_DB, "STAGE_GET_INFO_DB", EntryProc_get_info_db, NULL, NULL,
+    {STAGE_GET_INFO_DB, "STAGE_GET_INFO_DB", EntryProc_get_info_db,
+     EntryProc_get_info_db_batch, getdb_is_batchable,
      STAGE_FLAG_PARALLEL | STAGE_FLAG_SYNC | STAGE_FLAG_ID_CONSTRAINT, 0},
     {STAGE_GET_INFO_FS, "STAGE_GET_INFO_FS", EntryProc_get_info_fs, NULL, NULL,
      STAGE_FLAG_PARALLEL | STAGE_FLAG_SYNC, 0},
@@ -105,9 +115,10 @@ pipeline_stage_t std_pipeline[] = {
 
 #ifdef HAVE_CHANGELOGS
     /* only 1 thread here because committing records must be sequential
-     * (in the same order as changelog) */
-    /* XXX could this stage be batched, like DB_APPLY? */
-    {STAGE_CHGLOG_CLR, "STAGE_CHGLOG_CLR", EntryProc_chglog_clr, NULL, NULL,
+     * (in the same order as changelog). Contiguous ranges of records
+     * are acknowledged as a batch. */
+    {STAGE_CHGLOG_CLR, "STAGE_CHGLOG_CLR", EntryProc_chglog_clr,
+     EntryProc_chglog_clr_batch, chglog_clr_is_batchable,
      STAGE_FLAG_SEQUENTIAL | STAGE_FLAG_SYNC, 1},
 
     /* acknowledging records must be sequential,
@@ -225,6 +236,71 @@ static inline void check_path_info(struct entry_proc_op_t *p_op,
     }
 }
 
+/**
+ * Set the attributes to be refreshed for an entry already in DB,
+ * according to the type of a changelog record.
+ */
+static void set_record_attr_need(struct entry_proc_op_t *p_op,
+                                 unsigned int cr_type)
+{
+    if ((cr_type == CL_MTIME) || (cr_type == CL_CLOSE)
+        || (cr_type == CL_TRUNC) || (cr_type == CL_HSM)) {
+        DisplayLog(LVL_DEBUG, ENTRYPROC_TAG,
+                   "Getattr needed because this is a %s event, and "
+                   "metadata has not been recently updated.",
+                   changelog_type2str(cr_type));
+
+        p_op->fs_attr_need.std |= POSIX_ATTR_MASK;
+    } else if ((cr_type == CL_CTIME) || (cr_type == CL_SETATTR)) {
+        DisplayLog(LVL_DEBUG, ENTRYPROC_TAG,
+                   "Getattr (except size) needed because this is a %s "
+                   "event, and metadata has not been recently updated.",
+                   changelog_type2str(cr_type));
+
+        /* chmod, chown, utime... don't change entry size:
+         * don't get it, as it may require RPCs to data servers */
+        p_op->fs_attr_need.std |= POSIX_ATTR_MASK
+            & ~(ATTR_MASK_size | ATTR_MASK_blocks);
+    }
+}
+
+/**
+ * Call changelog callbacks for the record types that were folded
+ * into the record of this operation, as if they had been received alone.
+ * The resulting action is only taken into account if the main record
+ * did not request any.
+ */
+static void run_folded_cl_cb(struct entry_proc_op_t *p_op,
+                             unsigned int folded, uint32_t status_mask,
+                             proc_action_e *rec_action)
+{
+    CL_REC_TYPE *logrec = p_op->extra_info.log_record.p_log_rec;
+    unsigned int saved_type = logrec->cr_type;
+    int i;
+
+    for (i = 0; i < CL_LAST; i++) {
+        attr_mask_t status_mask_need = null_mask;
+        proc_action_e action = PROC_ACT_NONE;
+
+        if (!(folded & (1 << i)))
+            continue;
+
+        DisplayLog(LVL_FULL, ENTRYPROC_TAG, DFID ": running changelog "
+                   "callbacks for folded %s record", PFID(&p_op->entry_id),
+                   changelog_type2str(i));
+
+        logrec->cr_type = i;
+        run_all_cl_cb(logrec, &p_op->entry_id, &p_op->db_attrs,
+                      &p_op->fs_attrs, &status_mask_need, status_mask,
+                      &action);
+        p_op->fs_attr_need = attr_mask_or(&p_op->fs_attr_need,
+                                          &status_mask_need);
+        if (*rec_action == PROC_ACT_NONE)
+            *rec_action = action;
+    }
+    logrec->cr_type = saved_type;
+}
+
 /**
  * Infer information from the changelog record (status, ...).
  * \return next pipeline step to be perfomed.
@@ -238,8 +314,12 @@ static int EntryProc_FillFromLogRec(struct entry_proc_op_t *p_op,
 
     /* alias to the log record */
     CL_REC_TYPE *logrec = p_op->extra_info.log_record.p_log_rec;
+    /* records of other types the reader folded into this one */
+    unsigned int folded = p_op->extra_info.log_record.folded_types
+                          & ~(1 << logrec->cr_type);
     attr_mask_t status_mask_need = null_mask;
     proc_action_e rec_action = PROC_ACT_NONE;
+    int i;
 
     /* if this is a CREATE record, we know that its status is NEW. */
     if (logrec->cr_type == CL_CREATE) {
@@ -337,6 +417,9 @@ static int EntryProc_FillFromLogRec(struct entry_proc_op_t *p_op,
     else if (logrec->cr_type == CL_SETATTR) {
         attr_mask_set_index(&p_op->fs_attr_need, ATTR_INDEX_projid);
     }
+
+    if (folded & (1 << CL_SETATTR))
+        attr_mask_set_index(&p_op->fs_attr_need, ATTR_INDEX_projid);
 #endif
 
     /* if the entry is already in DB, try to determine if something changed */
@@ -347,18 +430,11 @@ static int EntryProc_FillFromLogRec(struct entry_proc_op_t *p_op,
         }
 
         /* get the new attributes, in case of a SATTR, HSM... */
-        if (allow_md_updt && ((logrec->cr_type == CL_MTIME)
-                              || (logrec->cr_type == CL_CTIME)
-                              || (logrec->cr_type == CL_CLOSE)
-                              || (logrec->cr_type == CL_TRUNC)
-                              || (logrec->cr_type == CL_HSM)
-                              || (logrec->cr_type == CL_SETATTR))) {
-            DisplayLog(LVL_DEBUG, ENTRYPROC_TAG,
-                       "Getattr needed because this is a %s event, and "
-                       "metadata has not been recently updated.",
-                       changelog_type2str(logrec->cr_type));
-
-            p_op->fs_attr_need.std |= POSIX_ATTR_MASK;
+        if (allow_md_updt) {
+            set_record_attr_need(p_op, logrec->cr_type);
+            for (i = 0; i < CL_LAST; i++)
+                if (folded & (1 << i))
+                    set_record_attr_need(p_op, i);
         }
     }
 
@@ -378,6 +454,10 @@ static int EntryProc_FillFromLogRec(struct entry_proc_op_t *p_op,
                   &status_mask_need, cl_cb_status_mask, &rec_action);
     p_op->fs_attr_need = attr_mask_or(&p_op->fs_attr_need, &status_mask_need);
 
+    /* status managers must see the folded records too */
+    if (folded != 0)
+        run_folded_cl_cb(p_op, folded, cl_cb_status_mask, &rec_action);
+
     /* process the value of rec_action */
     switch (rec_action) {
     case PROC_ACT_NONE:    /* nothing particular */
@@ -559,11 +639,9 @@ static int EntryProc_ProcessLogRec(struct entry_proc_op_t *p_op)
             db_missing = attr_mask_and_not(&p_op->db_attr_need,
                                            &p_op->db_attrs.attr_mask);
 
-            /* get attrs if some is missing (all std attrs) */
-            if ((db_missing.std & POSIX_ATTR_MASK) &&
-                ((p_op->fs_attrs.attr_mask.std & POSIX_ATTR_MASK) !=
-                 POSIX_ATTR_MASK))
-                p_op->fs_attr_need.std |= POSIX_ATTR_MASK;
+            /* get the missing attrs */
+            p_op->fs_attr_need.std |= db_missing.std & POSIX_ATTR_MASK
+                & ~p_op->fs_attrs.attr_mask.std;
 
             /* get projid if missing (file and dir only) */
             if ((db_missing.std & ATTR_MASK_projid)
@@ -896,19 +974,23 @@ static void scan2dbneed(struct entry_proc_op_t *p_op)
 }
 
 
+/** prefetch_rc value when entry attributes have not been prefetched */
+#define NO_PREFETCH (-1)
+
 /**
  * check if the entry exists in the database and what info
  * must be retrieved.
+ * @param prefetch_rc status of ListMgr_BatchGet() if the entry attributes
+ *        have already been retrieved by a batched request, or NO_PREFETCH.
+ * @return the next pipeline stage for this operation (-1 to drop it).
  */
-int EntryProc_get_info_db(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
+static int get_info_db(struct entry_proc_op_t *p_op, lmgr_t *lmgr,
+                       int prefetch_rc)
 {
     int rc = 0;
     int next_stage = -1;    /* -1 = skip */
     attr_mask_t tmp;
 
-    const pipeline_stage_t *stage_info =
-        &entry_proc_pipeline[p_op->pipeline_stage];
-
     /* always ignore root */
     if (p_op->entry_id_is_set
         && entry_id_equal(&p_op->entry_id, get_root_id())) {
@@ -985,13 +1067,18 @@ int EntryProc_get_info_db(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
             }
         }
 
-        /* determine needed attributes from DB */
-        logrec2dbneed(p_op);
+        if (prefetch_rc == NO_PREFETCH) {
+            /* determine needed attributes from DB */
+            logrec2dbneed(p_op);
 
-        /* attributes to be retrieved */
-        p_op->db_attrs.attr_mask = p_op->db_attr_need;
+            /* attributes to be retrieved */
+            p_op->db_attrs.attr_mask = p_op->db_attr_need;
 
-        rc = ListMgr_Get(lmgr, &p_op->entry_id, &p_op->db_attrs);
+            rc = ListMgr_Get(lmgr, &p_op->entry_id, &p_op->db_attrs);
+        } else {
+            /* already retrieved by the batch function */
+            rc = prefetch_rc;
+        }
 
         if (rc == DB_SUCCESS) {
             p_op->db_exists = 1;
@@ -1044,12 +1131,20 @@ int EntryProc_get_info_db(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
             goto next_step;
         }
 
-        /* determined needed attributes from DB */
-        scan2dbneed(p_op);
+        if (prefetch_rc == NO_PREFETCH) {
+            /* determined needed attributes from DB */
+            scan2dbneed(p_op);
+        }
 
-        if (!attr_mask_is_null(p_op->db_attr_need)) {
-            p_op->db_attrs.attr_mask = p_op->db_attr_need;
-            rc = ListMgr_Get(lmgr, &p_op->entry_id, &p_op->db_attrs);
+        if (prefetch_rc != NO_PREFETCH
+            || !attr_mask_is_null(p_op->db_attr_need)) {
+            if (prefetch_rc == NO_PREFETCH) {
+                p_op->db_attrs.attr_mask = p_op->db_attr_need;
+                rc = ListMgr_Get(lmgr, &p_op->entry_id, &p_op->db_attrs);
+            } else {
+                /* already retrieved by the batch function */
+                rc = prefetch_rc;
+            }
 
             if (rc == DB_SUCCESS) {
                 p_op->db_exists = 1;
@@ -1170,6 +1265,18 @@ int EntryProc_get_info_db(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
 #endif
 
  next_step:
+    return next_stage;
+}
+
+int EntryProc_get_info_db(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
+{
+    int rc;
+    int next_stage;
+    const pipeline_stage_t *stage_info =
+        &entry_proc_pipeline[p_op->pipeline_stage];
+
+    next_stage = get_info_db(p_op, lmgr, NO_PREFETCH);
+
     if (next_stage == -1)
         /* drop the entry */
         rc = EntryProcessor_Acknowledge(p_op, -1, true);
@@ -1184,6 +1291,133 @@ int EntryProc_get_info_db(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
     return rc;
 }
 
+/** can the DB attributes of the operation be retrieved by a batched
+ * request? */
+static bool is_prefetchable(struct entry_proc_op_t *p_op)
+{
+    if (!p_op->entry_id_is_set)
+        return false;
+#ifdef HAVE_CHANGELOGS
+    /* Changelog records can be retrieved by id, unless the FID must first
+     * be resolved from the NAMES table (UNLINK without FID). */
+    if (p_op->extra_info.is_changelog_record)
+        return !p_op->get_fid_from_db;
+#endif
+    return ATTR_MASK_TEST(&p_op->fs_attrs, fullpath);
+}
+
+/** determine the attributes to be retrieved from the DB */
+static void op2dbneed(struct entry_proc_op_t *p_op)
+{
+#ifdef HAVE_CHANGELOGS
+    if (p_op->extra_info.is_changelog_record) {
+        logrec2dbneed(p_op);
+        return;
+    }
+#endif
+    scan2dbneed(p_op);
+}
+
+static bool getdb_is_batchable(struct entry_proc_op_t *first,
+                               struct entry_proc_op_t *next,
+                               attr_mask_t *full_attr_mask)
+{
+    /* Scanned entries and changelog records can be mixed in a batch.
+     * Batched operations are all the first of their id in the pipeline
+     * (see the ID constraint), so records about the same entry are still
+     * processed in order. Their masks may differ: the batch function
+     * issues one request per distinct mask. */
+    return is_prefetchable(first) && is_prefetchable(next);
+}
+
+/**
+ * Get DB information for a batch of scanned entries and changelog records.
+ * Entries needing the same attributes are retrieved by a single request.
+ */
+static int EntryProc_get_info_db_batch(struct entry_proc_op_t **ops,
+                                       int count, lmgr_t *lmgr)
+{
+    int i, j, n, rc = 0;
+    const pipeline_stage_t *stage_info =
+        &entry_proc_pipeline[ops[0]->pipeline_stage];
+    entry_id_t **ids = NULL;
+    attr_set_t **attrs = NULL;
+    int *rcs = NULL;
+    int *grp_rcs = NULL;
+    int *grp = NULL;
+    int *next_stages = NULL;
+    bool *todo = NULL;
+
+    ids = MemCalloc(count, sizeof(*ids));
+    attrs = MemCalloc(count, sizeof(*attrs));
+    rcs = MemCalloc(count, sizeof(*rcs));
+    grp_rcs = MemCalloc(count, sizeof(*grp_rcs));
+    grp = MemCalloc(count, sizeof(*grp));
+    next_stages = MemCalloc(count, sizeof(*next_stages));
+    todo = MemCalloc(count, sizeof(*todo));
+    if (!ids || !attrs || !rcs || !grp_rcs || !grp || !next_stages || !todo) {
+        rc = -ENOMEM;
+        goto out;
+    }
+
+    for (i = 0; i < count; i++) {
+        rcs[i] = NO_PREFETCH;
+
+        /* root and special entries are dropped by get_info_db() */
+        todo[i] = is_prefetchable(ops[i])
+            && !entry_id_equal(&ops[i]->entry_id, get_root_id())
+            && !is_lustre_special(ops[i]);
+        if (todo[i])
+            /* determine needed attributes from DB */
+            op2dbneed(ops[i]);
+    }
+
+    /* retrieve entries having the same db_attr_need with a single request */
+    for (i = 0; i < count; i++) {
+        if (!todo[i])
+            continue;
+
+        n = 0;
+        for (j = i; j < count; j++) {
+            if (!todo[j] || !attr_mask_equal(&ops[i]->db_attr_need,
+                                             &ops[j]->db_attr_need))
+                continue;
+
+            ops[j]->db_attrs.attr_mask = ops[j]->db_attr_need;
+            ids[n] = &ops[j]->entry_id;
+            attrs[n] = &ops[j]->db_attrs;
+            grp[n] = j;
+            todo[j] = false;
+            n++;
+        }
+
+        DisplayLog(LVL_FULL, ENTRYPROC_TAG, "BatchGet(%u ops: " DFID "...)",
+                   n, PFID(ids[0]));
+
+        rc = ListMgr_BatchGet(lmgr, ids, attrs, n, grp_rcs);
+        for (j = 0; j < n; j++)
+            rcs[grp[j]] = rc ? rc : grp_rcs[j];
+    }
+
+    for (i = 0; i < count; i++)
+        next_stages[i] = get_info_db(ops[i], lmgr, rcs[i]);
+
+    rc = EntryProcessor_AcknowledgeEach(ops, count, next_stages);
+    if (rc)
+        DisplayLog(LVL_CRIT, ENTRYPROC_TAG,
+                   "Error %d acknowledging stage %s.", rc,
+                   stage_info->stage_name);
+ out:
+    MemFree(todo);
+    MemFree(next_stages);
+    MemFree(grp);
+    MemFree(grp_rcs);
+    MemFree(rcs);
+    MemFree(attrs);
+    MemFree(ids);
+    return rc;
+}
+
 /** skip_record a record by acknowledging current operation */
 static int skip_record(struct entry_proc_op_t *p_op)
 {
@@ -1323,6 +1557,12 @@ int EntryProc_get_info_fs(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
 #ifdef HAVE_CHANGELOGS  /* never needed for scans */
     if (NEED_GETATTR(p_op) && (p_op->extra_info.is_changelog_record)) {
         struct stat entry_md;
+        /* only get needed attributes (+nlink to check removal) */
+        unsigned int stx_mask = attr_mask2statx(&p_op->fs_attr_need)
+                                    | STATX_NLINK;
+        unsigned int stx_got = STATX_BASIC_STATS;
+        bool full_getattr = ((p_op->fs_attr_need.std & POSIX_ATTR_MASK)
+                                == POSIX_ATTR_MASK);
 
         rc = errno = 0;
 #if defined(_LUSTRE) && defined(_HAVE_FID) && defined(_MDS_STAT_SUPPORT)
@@ -1330,8 +1570,8 @@ int EntryProc_get_info_fs(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
             rc = lustre_mds_stat_by_fid(&p_op->entry_id, &entry_md);
         else
 #endif
-        if (lstat(path, &entry_md) != 0)
-            rc = -errno;
+            rc = rbh_statx(AT_FDCWD, path, stx_mask, false, &entry_md,
+                           &stx_got);
 
         /* get entry attributes */
         if (rc != 0) {
@@ -1345,7 +1585,7 @@ int EntryProc_get_info_fs(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
 
             /* If lstat returns an error, drop the log record */
             return skip_record(p_op);
-        } else if (entry_md.st_nlink == 0) {
+        } else if ((stx_got & STATX_NLINK) && entry_md.st_nlink == 0) {
             /* remove pending */
             DisplayLog(LVL_DEBUG, ENTRYPROC_TAG,
                        "Entry %s has nlink=0: remove pending", path);
@@ -1354,14 +1594,18 @@ int EntryProc_get_info_fs(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
 
         /* convert them to internal structure */
 #if defined(_LUSTRE) && defined(_HAVE_FID) && defined(_MDS_STAT_SUPPORT)
-        stat2rbh_attrs(&entry_md, &p_op->fs_attrs,
-                       !global_config.direct_mds_stat);
-#else
-        stat2rbh_attrs(&entry_md, &p_op->fs_attrs, true);
+        if (global_config.direct_mds_stat)
+            stat2rbh_attrs(&entry_md, &p_op->fs_attrs, false);
+        else
 #endif
-        ATTR_MASK_SET(&p_op->fs_attrs, md_update);
-        ATTR(&p_op->fs_attrs, md_update) = time(NULL);
+            statx2rbh_attrs(&entry_md, &p_op->fs_attrs,
+                            stx_got & (stx_mask | STATX_TYPE));
 
+        /* md_update indicates the last time all attributes were refreshed */
+        if (full_getattr) {
+            ATTR_MASK_SET(&p_op->fs_attrs, md_update);
+            ATTR(&p_op->fs_attrs, md_update) = time(NULL);
+        }
     }
     /* getattr needed */
     if (NEED_GETPATH(p_op)) {
@@ -1523,7 +1767,10 @@ static bool dbop_is_batchable(struct entry_proc_op_t *first,
 {
     if (first->db_op_type != OP_TYPE_INSERT
         && first->db_op_type != OP_TYPE_UPDATE
-        && first->db_op_type != OP_TYPE_NONE)
+        && first->db_op_type != OP_TYPE_NONE
+        && first->db_op_type != OP_TYPE_REMOVE_ONE
+        && first->db_op_type != OP_TYPE_REMOVE_LAST
+        && first->db_op_type != OP_TYPE_SOFT_REMOVE)
         return false;
     else if (first->db_op_type != next->db_op_type)
         return false;
@@ -1531,6 +1778,17 @@ static bool dbop_is_batchable(struct entry_proc_op_t *first,
     /* all NOOP operations can be batched */
     else if (first->db_op_type == OP_TYPE_NONE)
         return true;
+    /* removals only need the entry id, parent and name: they can always be
+     * batched (the ID constraint ensures a batch doesn't contain 2 operations
+     * on the same entry) */
+    else if (first->db_op_type == OP_TYPE_REMOVE_ONE
+             || first->db_op_type == OP_TYPE_REMOVE_LAST)
+        return true;
+    /* soft removals are batched if they have the same attributes, so the
+     * missing ones can be retrieved by a single request */
+    else if (first->db_op_type == OP_TYPE_SOFT_REMOVE)
+        return attr_mask_equal(&first->fs_attrs.attr_mask,
+                               &next->fs_attrs.attr_mask);
     /* different masks can be mixed, as long as attributes for each table are
      * the same or 0. Ask the list manager about that. */
     else if (lmgr_batch_compat(*full_attr_mask, next->fs_attrs.attr_mask)) {
@@ -1674,6 +1932,38 @@ int EntryProc_pre_apply(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
     return rc;
 }
 
+/**
+ * During the initial load, entries discovered by the scan are loaded
+ * by chunks.
+ */
+static inline bool is_bulk_insert(const struct entry_proc_op_t *p_op)
+{
+    return !p_op->extra_info.is_changelog_record && ListMgr_BulkLoadActive();
+}
+
+/** log a soft removal and set its removal time */
+static void prepare_soft_remove(struct entry_proc_op_t *p_op)
+{
+    if (log_config.debug_level >= LVL_DEBUG) {
+        attr_mask_t tmp = null_mask;
+        attr_mask_t tmp2 = null_mask;
+        GString *gs = g_string_new(NULL);
+
+        tmp.std = ATTR_MASK_fullpath | ATTR_MASK_parent_id | ATTR_MASK_name;
+        tmp2 = sm_softrm_mask();
+        tmp = attr_mask_or(&tmp, &tmp2);
+
+        print_attrs(gs, &p_op->fs_attrs, tmp, true);
+        DisplayLog(LVL_DEBUG, ENTRYPROC_TAG, "SoftRemove(" DFID ",%s)",
+                   PFID(&p_op->entry_id), gs->str);
+        g_string_free(gs, TRUE);
+    }
+
+    /* FIXME get remove time from changelog */
+    ATTR_MASK_SET(&p_op->fs_attrs, rm_time);
+    ATTR(&p_op->fs_attrs, rm_time) = time(NULL);
+}
+
 /**
  * Perform a single operation on the database.
  */
@@ -1695,7 +1985,14 @@ int EntryProc_db_apply(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
     case OP_TYPE_INSERT:
         DisplayLog(LVL_FULL, ENTRYPROC_TAG, "Insert(" DFID ")",
                    PFID(&p_op->entry_id));
-        rc = ListMgr_Insert(lmgr, &p_op->entry_id, &p_op->fs_attrs, false);
+        if (is_bulk_insert(p_op)) {
+            entry_id_t *p_id = &p_op->entry_id;
+            attr_set_t *p_attrs = &p_op->fs_attrs;
+
+            rc = ListMgr_BulkInsert(lmgr, &p_id, &p_attrs, 1);
+        } else
+            rc = ListMgr_Insert(lmgr, &p_op->entry_id, &p_op->fs_attrs,
+                                false);
         break;
 
     case OP_TYPE_UPDATE:
@@ -1717,25 +2014,7 @@ int EntryProc_db_apply(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
         break;
 
     case OP_TYPE_SOFT_REMOVE:
-
-        if (log_config.debug_level >= LVL_DEBUG) {
-            attr_mask_t tmp = null_mask;
-            attr_mask_t tmp2 = null_mask;
-            GString *gs = g_string_new(NULL);
-
-            tmp.std = ATTR_MASK_fullpath | ATTR_MASK_parent_id | ATTR_MASK_name;
-            tmp2 = sm_softrm_mask();
-            tmp = attr_mask_or(&tmp, &tmp2);
-
-            print_attrs(gs, &p_op->fs_attrs, tmp, true);
-            DisplayLog(LVL_DEBUG, ENTRYPROC_TAG, "SoftRemove(" DFID ",%s)",
-                       PFID(&p_op->entry_id), gs->str);
-            g_string_free(gs, TRUE);
-        }
-
-        /* FIXME get remove time from changelog */
-        ATTR_MASK_SET(&p_op->fs_attrs, rm_time);
-        ATTR(&p_op->fs_attrs, rm_time) = time(NULL);
+        prepare_soft_remove(p_op);
         rc = ListMgr_SoftRemove(lmgr, &p_op->entry_id, &p_op->fs_attrs);
         break;
 
@@ -1802,13 +2081,38 @@ int EntryProc_db_batch_apply(struct entry_proc_op_t **ops, int count,
     case OP_TYPE_INSERT:
         DisplayLog(LVL_FULL, ENTRYPROC_TAG, "BatchInsert(%u ops: " DFID "...)",
                    count, PFID(ids[0]));
-        rc = ListMgr_BatchInsert(lmgr, ids, attrs, count, false);
+        for (i = 0; i < count && is_bulk_insert(ops[i]); i++)
+            ;
+        if (i == count)
+            rc = ListMgr_BulkInsert(lmgr, ids, attrs, count);
+        else
+            rc = ListMgr_BatchInsert(lmgr, ids, attrs, count, false);
         break;
     case OP_TYPE_UPDATE:
         DisplayLog(LVL_FULL, ENTRYPROC_TAG, "BatchUpdate(%u ops: " DFID "...)",
                    count, PFID(ids[0]));
         rc = ListMgr_BatchInsert(lmgr, ids, attrs, count, true);
         break;
+    case OP_TYPE_REMOVE_ONE:
+        DisplayLog(LVL_FULL, ENTRYPROC_TAG,
+                   "BatchRemoveOne(%u ops: " DFID "...)", count,
+                   PFID(ids[0]));
+        rc = ListMgr_BatchRemove(lmgr, ids, attrs, count, false);
+        break;
+    case OP_TYPE_REMOVE_LAST:
+        DisplayLog(LVL_FULL, ENTRYPROC_TAG,
+                   "BatchRemoveLast(%u ops: " DFID "...)", count,
+                   PFID(ids[0]));
+        rc = ListMgr_BatchRemove(lmgr, ids, attrs, count, true);
+        break;
+    case OP_TYPE_SOFT_REMOVE:
+        DisplayLog(LVL_FULL, ENTRYPROC_TAG,
+                   "BatchSoftRemove(%u ops: " DFID "...)", count,
+                   PFID(ids[0]));
+        for (i = 0; i < count; i++)
+            prepare_soft_remove(ops[i]);
+        rc = ListMgr_BatchSoftRemove(lmgr, ids, attrs, count);
+        break;
     default:
         DisplayLog(LVL_CRIT, ENTRYPROC_TAG,
                    "Unexpected operation for batch op: %d", ops[0]->db_op_type);
@@ -1870,6 +2174,64 @@ int EntryProc_chglog_clr(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
 
     return rc;
 }
+
+static bool chglog_clr_is_batchable(struct entry_proc_op_t *first,
+                                    struct entry_proc_op_t *next,
+                                    attr_mask_t *full_attr_mask)
+{
+    /* the stage is sequential: any contiguous range of operations
+     * can be acknowledged at once */
+    return true;
+}
+
+/**
+ * Acknowledge a contiguous range of changelog records.
+ * Records of a given reader arrive in order in this stage, so only the
+ * last record of each reader is reported to its callback: it is the new
+ * low watermark of committed records for this reader.
+ */
+int EntryProc_chglog_clr_batch(struct entry_proc_op_t **ops, int count,
+                               lmgr_t *lmgr)
+{
+    int i, j, rc;
+    const pipeline_stage_t *stage_info =
+        &entry_proc_pipeline[ops[0]->pipeline_stage];
+
+    DisplayLog(LVL_FULL, ENTRYPROC_TAG, "stage %s - %d records",
+               stage_info->stage_name, count);
+
+    for (i = 0; i < count; i++) {
+        bool last = true;
+
+        if (ops[i]->callback_func == NULL)
+            continue;
+
+        /* is there a later record for the same reader? */
+        for (j = i + 1; j < count; j++) {
+            if (ops[j]->callback_func == ops[i]->callback_func
+                && ops[j]->callback_param == ops[i]->callback_param) {
+                last = false;
+                break;
+            }
+        }
+        if (!last)
+            continue;
+
+        rc = ops[i]->callback_func(lmgr, ops[i], ops[i]->callback_param);
+        if (rc)
+            DisplayLog(LVL_CRIT, ENTRYPROC_TAG,
+                       "Error %d performing callback at stage %s.", rc,
+                       stage_info->stage_name);
+    }
+
+    /* Acknowledge the operations and remove them from pipeline */
+    rc = EntryProcessor_AcknowledgeBatch(ops, count, -1, true);
+    if (rc)
+        DisplayLog(LVL_CRIT, ENTRYPROC_TAG, "Error %d acknowledging stage %s.",
+                   rc, stage_info->stage_name);
+
+    return rc;
+}
 #endif
 
 static void mass_rm_cb(const entry_id_t *p_id)
@@ -1877,6 +2239,90 @@ static void mass_rm_cb(const entry_id_t *p_id)
     printf("--" DFID "\n", PFID(p_id));
 }
 
+/**
+ * Incremental scan: clean the entries of a directory that have not been
+ * seen during the scan, and the content of removed subdirectories.
+ * @param gc_entries  if false, only clean names.
+ */
+static int rm_old_dir_entries(lmgr_t *lmgr, const wagon_t *dir,
+                              time_t scan_start, bool gc_entries,
+                              rm_cb_func_t cb)
+{
+    wagon_t *child_ids = NULL;
+    attr_set_t *child_attrs = NULL;
+    unsigned int child_count = 0;
+    attr_mask_t mask = {.std = ATTR_MASK_parent_id | ATTR_MASK_type
+                        | ATTR_MASK_md_update | ATTR_MASK_path_update};
+    lmgr_filter_t filter;
+    filter_value_t val;
+    int i, rc;
+
+    rc = ListMgr_GetChild(lmgr, NULL, dir, 1, mask, &child_ids, &child_attrs,
+                          &child_count);
+    if (rc)
+        return rc;
+
+    for (i = 0; gc_entries && i < child_count; i++) {
+        attr_set_t *attrs = &child_attrs[i];
+
+        /* name or entry seen during the scan */
+        if ((ATTR_MASK_TEST(attrs, path_update)
+             && ATTR(attrs, path_update) >= scan_start)
+            || (ATTR_MASK_TEST(attrs, md_update)
+                && ATTR(attrs, md_update) >= scan_start))
+            continue;
+
+        /* clean the content of removed directories */
+        if (ATTR_MASK_TEST(attrs, type)
+            && !strcmp(ATTR(attrs, type), STR_TYPE_DIR)) {
+            rc = rm_old_dir_entries(lmgr, &child_ids[i], scan_start,
+                                    gc_entries, cb);
+            if (rc)
+                goto out;
+        }
+
+        DisplayLog(LVL_FULL, ENTRYPROC_TAG, "Removing %s (not seen during "
+                   "incremental scan)", child_ids[i].fullname);
+
+        if (has_deletion_policy()) {
+            ATTR_MASK_SET(attrs, fullpath);
+            rh_strncpy(ATTR(attrs, fullpath), child_ids[i].fullname,
+                       sizeof(ATTR(attrs, fullpath)));
+            ATTR_MASK_SET(attrs, rm_time);
+            ATTR(attrs, rm_time) = time(NULL);
+            rc = ListMgr_SoftRemove(lmgr, &child_ids[i].id, attrs);
+        } else {
+            rc = ListMgr_Remove(lmgr, &child_ids[i].id, attrs, true);
+        }
+        if (rc)
+            goto out;
+
+        if (cb)
+            cb(&child_ids[i].id);
+    }
+
+    /* clean remaining names that have not been seen */
+    lmgr_simple_filter_init(&filter);
+
+    val.value.val_id = dir->id;
+    lmgr_simple_filter_add(&filter, ATTR_INDEX_parent_id, EQUAL, val, 0);
+    val.value.val_uint = scan_start;
+    lmgr_simple_filter_add(&filter, ATTR_INDEX_path_update, LESSTHAN_STRICT,
+                           val, 0);
+
+    rc = ListMgr_MassRemove(lmgr, &filter, NULL);
+    lmgr_simple_filter_free(&filter);
+
+ out:
+    for (i = 0; i < child_count; i++) {
+        ListMgr_FreeAttrs(&child_attrs[i]);
+        free(child_ids[i].fullname);
+    }
+    MemFree(child_attrs);
+    MemFree(child_ids);
+    return rc;
+}
+
 int EntryProc_rm_old_entries(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
 {
     int rc;
@@ -1890,10 +2336,42 @@ int EntryProc_rm_old_entries(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
     if (!attr_mask_is_null(diff_mask))
         cb = mass_rm_cb;
 
+    /* all entries of the scan have been processed: complete the initial
+     * load before cleaning old entries */
+    if (ListMgr_BulkLoadActive()) {
+        rc = ListMgr_BulkLoadEnd(lmgr);
+        if (rc) {
+            DisplayLog(LVL_CRIT, ENTRYPROC_TAG, "Error: failed to complete "
+                       "initial load: error %d: %s", rc, lmgr_err2str(rc));
+            /* some entries of the scan are missing from the DB: the scan
+             * is not complete */
+            ListMgr_SetVar(lmgr, LAST_SCAN_STATUS, SCAN_STATUS_INCOMPLETE);
+            goto callback;
+        }
+    }
+
     /* If gc_entries or gc_names are not set,
      * this is just a special op to wait for pipeline flush.
      * => don't clean old entries */
-    if (p_op->gc_entries || p_op->gc_names) {
+    if (p_op->gc_dirs_only) {
+        int i;
+
+        /* incremental scan: only clean the directories that were read */
+        ListMgr_ForceCommitFlag(lmgr, true);
+
+        for (i = 0; i < p_op->gc_dir_count; i++) {
+            rc = rm_old_dir_entries(lmgr, &p_op->gc_dirs[i],
+                                    ATTR(&p_op->fs_attrs, md_update),
+                                    p_op->gc_entries, cb);
+            if (rc) {
+                DisplayLog(LVL_CRIT, ENTRYPROC_TAG,
+                           "Error: failed to clean old entries in %s: "
+                           "error %d: %s", p_op->gc_dirs[i].fullname,
+                           rc, lmgr_err2str(rc));
+                break;
+            }
+        }
+    } else if (p_op->gc_entries || p_op->gc_names) {
         lmgr_simple_filter_init(&filter);
 
         if (p_op->gc_entries) {
@@ -1940,6 +2418,7 @@ int EntryProc_rm_old_entries(struct entry_proc_op_t *p_op, lmgr_t *lmgr)
                        rc, lmgr_err2str(rc));
     }
 
+ callback:
     /* must call callback function in any case, to unblock the scan */
     if (p_op->callback_func) {
         /* Perform callback to info collector */
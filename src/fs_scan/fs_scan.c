@@ -47,14 +47,62 @@
 
 fs_scan_config_t fs_scan_config;
 run_flags_t fsscan_flags = 0;
-const char *partial_scan_root = NULL;
+const char *partial_scan_roots[MAX_SCAN_ROOTS];
+unsigned int partial_scan_count = 0;
+
+/* scanned directories, for logs and scan stats */
+static char scan_roots_str[MAX_VAR_LEN] = "";
 
 #define fsscan_once (fsscan_flags & RUNFLG_ONCE)
 #define fsscan_nogc (fsscan_flags & RUNFLG_NO_GC)
+#define fsscan_incr (fsscan_flags & RUNFLG_INCR_SCAN)
 
 static bool is_lustre_fs = false;
 static bool is_first_scan = false;
 
+/* statx fields to be retrieved for scanned entries */
+static unsigned int scan_stx_mask = STATX_BASIC_STATS;
+
+/* state of a directory entry read by getdents */
+typedef enum {
+    ENT_TODO = 0, /* entry must be stat'ed */
+    ENT_BUSY,     /* stat in progress by the prefetch thread */
+    ENT_SELF,     /* scan thread will stat the entry itself */
+    ENT_DONE,     /* stat done (result in rc and inode) */
+    ENT_SKIP      /* entry ignored according to its d_type */
+} entry_state_t;
+
+/* a directory entry in the buffer of a scan thread */
+typedef struct dir_entry_slot__ {
+    const char     *name;   /* points to the getdents buffer */
+    entry_state_t   state;
+    int             rc;     /* stat status */
+    bool            ignore_checked; /* ignore rules already checked */
+    unsigned int    stx_got; /* statx fields set in inode */
+    struct stat     inode;
+} dir_entry_slot_t;
+
+/* helper thread to stat entries ahead of a scan thread */
+typedef struct stat_prefetch__ {
+    pthread_t           thread;
+    pthread_mutex_t     lock;
+    pthread_cond_t      work_cond;  /* new entries or scan progress */
+    pthread_cond_t      done_cond;  /* stat of an entry is done */
+
+    /* current chunk of entries */
+    const robinhood_task_t *task;
+    int                 dirfd;
+    dir_entry_slot_t   *slots;
+    unsigned int        count;
+
+    unsigned int        next;       /* next slot to be handled by helper */
+    unsigned int        consumed;   /* slots processed by scan thread */
+
+    bool                helper_busy;
+    bool                helper_waiting;
+    bool                stop;
+} stat_prefetch_t;
+
 /* information about scanning thread */
 
 typedef struct thread_scan_info__ {
@@ -76,6 +124,18 @@ typedef struct thread_scan_info__ {
     struct timeval time_consumed;
     struct timeval last_processing_time;
 
+    /* buffer for reading directory entries
+     * and related entry slots */
+    char *dirent_buf;
+    dir_entry_slot_t *slots;
+
+    /* stat prefetching helper (NULL if disabled) */
+    stat_prefetch_t *prefetch;
+
+    /* DB connection (for incremental scans) */
+    lmgr_t lmgr;
+    bool db_connected;
+
 } thread_scan_info_t;
 
 /**
@@ -99,8 +159,44 @@ static unsigned int last_duration = 0;
 static bool last_scan_complete = false;
 static time_t scan_start_time = 0;
 
+/* incremental scan: only read directories modified since last scan */
+static bool incr_scan = false;
+
+/* shard checkpoints are recorded during the scan */
+static bool shard_ckpt = false;
+/* the current scan resumes an interrupted one:
+ * shards already checkpointed are skipped */
+static bool scan_resumed = false;
+
+/* per root entry counts (partial scan of several directories) */
+static unsigned int root_entries[MAX_SCAN_ROOTS];
+static unsigned int root_errors[MAX_SCAN_ROOTS];
+
+/* incremental scan: list of directories that have been read
+ * (their entries not seen during the scan are cleaned at the end) */
+static pthread_mutex_t relisted_lock = PTHREAD_MUTEX_INITIALIZER;
+static wagon_t *relisted_dirs = NULL;
+static unsigned int relisted_count = 0;
+static unsigned int relisted_size = 0;
+static bool relisted_overflow = false;
+
 static struct timeval accurate_start_time = { 0, 0 };
 
+/* Adaptive throttling: the latency of filesystem operations is sampled in
+ * a histogram of log2(usec) buckets, and the number of active scan threads
+ * is adjusted every THROTTLE_PERIOD to hold the target 99th percentile.
+ * Threads with index >= active_scan_threads don't take new tasks. */
+#define LAT_BUCKETS          32
+#define THROTTLE_PERIOD      2  /* seconds */
+#define THROTTLE_MIN_SAMPLES 100
+#define throttle_enabled() (fs_scan_config.target_latency_ms > 0)
+
+static unsigned int lat_hist[LAT_BUCKETS];
+static time_t throttle_last_update = 0;
+static unsigned int active_scan_threads = 0;
+static pthread_mutex_t throttle_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t throttle_cond = PTHREAD_COND_INITIALIZER;
+
 static unsigned int nb_hang_total = 0;
 
 /* used for adaptive scan interval */
@@ -209,14 +305,94 @@ static void ResetScanStats(bool do_lock)
         V(lock_scan);
 }
 
-static bool ignore_entry(char *fullpath, char *name, unsigned int depth,
-                         struct stat *p_stat)
+/* check ignore rules for the given entry */
+static bool match_ignore_rules(entry_id_t *p_id, attr_set_t *p_attrs)
 {
-    entry_id_t tmpid;
-    attr_set_t tmpattr;
     unsigned int i;
     policy_match_t rc = POLICY_NO_MATCH;
 
+    for (i = 0; i < fs_scan_config.ignore_count; i++) {
+        switch (entry_matches
+                (p_id, p_attrs, &fs_scan_config.ignore_list[i].bool_expr,
+                 NULL, NULL)) {
+        case POLICY_MATCH:
+            return true;
+
+        case POLICY_MISSING_ATTR:
+            DisplayLog(LVL_MAJOR, FSSCAN_TAG,
+                       "Attribute is missing for checking ignore rule");
+            if (rc != POLICY_ERR)
+                rc = POLICY_MISSING_ATTR;
+            break;
+
+        case POLICY_ERR:
+            DisplayLog(LVL_CRIT, FSSCAN_TAG,
+                       "An error occurred when checking ignore rule");
+            rc = POLICY_ERR;
+            break;
+
+        case POLICY_NO_MATCH:
+            /* continue testing other ignore rules */
+            break;
+        }
+    }
+
+    return (rc != POLICY_NO_MATCH);
+}
+
+/** build the description of the scanned directories */
+static void init_scan_roots_str(void)
+{
+    int i;
+
+    if (partial_scan_count == 0) {
+        rh_strncpy(scan_roots_str, global_config.fs_path,
+                   sizeof(scan_roots_str));
+        return;
+    }
+
+    scan_roots_str[0] = '\0';
+    for (i = 0; i < partial_scan_count; i++) {
+        if (i > 0)
+            strncat(scan_roots_str, ",",
+                    sizeof(scan_roots_str) - strlen(scan_roots_str) - 1);
+        strncat(scan_roots_str, partial_scan_roots[i],
+                sizeof(scan_roots_str) - strlen(scan_roots_str) - 1);
+    }
+}
+
+/* init the mask of attributes to be retrieved for scanned entries */
+static void init_scan_stx_mask(void)
+{
+    attr_mask_t mask = {.std = POSIX_ATTR_MASK | ATTR_MASK_creation_time};
+
+    scan_stx_mask = attr_mask2statx(&mask) | STATX_TYPE;
+
+#if defined(_LUSTRE) && defined(_MDS_STAT_SUPPORT)
+    /* size and times are not relevant when they are taken from the MDT:
+     * don't get them from the client to avoid OST RPCs. */
+    if (is_lustre_fs && global_config.direct_mds_stat)
+        scan_stx_mask &= ~(STATX_SIZE | STATX_BLOCKS | STATX_ATIME
+                           | STATX_MTIME);
+#endif
+}
+
+/* convert attributes of a scanned entry to robinhood attributes */
+static void scan_stat2rbh_attrs(const struct stat *p_stat,
+                                unsigned int stx_got, attr_set_t *p_attrs)
+{
+#if defined(_LUSTRE) && defined(_MDS_STAT_SUPPORT)
+    if (is_lustre_fs && global_config.direct_mds_stat) {
+        stat2rbh_attrs(p_stat, p_attrs, false);
+        return;
+    }
+#endif
+    statx2rbh_attrs(p_stat, p_attrs, stx_got & scan_stx_mask);
+}
+
+/** check if the entry is a Lustre special directory */
+static bool ignore_special_dir(const char *fullpath)
+{
 #ifdef _HAVE_FID
     const char *dot_lu = get_dot_lustre_dir();
 
@@ -234,6 +410,17 @@ static bool ignore_entry(char *fullpath, char *name, unsigned int depth,
         return true;
     }
 #endif
+    return false;
+}
+
+static bool ignore_entry(char *fullpath, char *name, unsigned int depth,
+                         struct stat *p_stat, unsigned int stx_got)
+{
+    entry_id_t tmpid;
+    attr_set_t tmpattr;
+
+    if (ignore_special_dir(fullpath))
+        return true;
 
     /* build temporary attr set for testing ignore condition */
     ATTR_MASK_INIT(&tmpattr);
@@ -247,12 +434,7 @@ static bool ignore_entry(char *fullpath, char *name, unsigned int depth,
     ATTR_MASK_SET(&tmpattr, depth);
     ATTR(&tmpattr, depth) = depth;
 
-#if defined(_LUSTRE) && defined(_MDS_STAT_SUPPORT)
-    stat2rbh_attrs(p_stat, &tmpattr,
-                   !(is_lustre_fs && global_config.direct_mds_stat));
-#else
-    stat2rbh_attrs(p_stat, &tmpattr, true);
-#endif
+    scan_stat2rbh_attrs(p_stat, stx_got, &tmpattr);
 
     /* Set entry id */
 #ifndef _HAVE_FID
@@ -260,34 +442,184 @@ static bool ignore_entry(char *fullpath, char *name, unsigned int depth,
     tmpid.fs_key = get_fskey();
 #endif
 
-    rc = POLICY_NO_MATCH;
+    return match_ignore_rules(&tmpid, &tmpattr);
+}
+
+/* Indicate if ignore rules can be checked using the information
+ * returned by getdents (name, type), i.e. without calling stat. */
+static bool ignore_by_dtype = false;
+
+static void init_ignore_by_dtype(void)
+{
+    unsigned int i;
+    uint32_t dtype_mask = ATTR_MASK_name | ATTR_MASK_fullpath
+        | ATTR_MASK_depth | ATTR_MASK_type;
+
+    ignore_by_dtype = false;
+    if (fs_scan_config.ignore_count == 0)
+        return;
+
     for (i = 0; i < fs_scan_config.ignore_count; i++) {
-        switch (entry_matches
-                (&tmpid, &tmpattr, &fs_scan_config.ignore_list[i].bool_expr,
-                 NULL, NULL)) {
-        case POLICY_MATCH:
-            return true;
+        const attr_mask_t *mask = &fs_scan_config.ignore_list[i].attr_mask;
 
-        case POLICY_MISSING_ATTR:
-            DisplayLog(LVL_MAJOR, FSSCAN_TAG,
-                       "Attribute is missing for checking ignore rule");
-            if (rc != POLICY_ERR)
-                rc = POLICY_MISSING_ATTR;
-            break;
+        if ((mask->std & ~dtype_mask) || mask->status || mask->sm_info)
+            return;
+    }
+    ignore_by_dtype = true;
+}
 
-        case POLICY_ERR:
-            DisplayLog(LVL_CRIT, FSSCAN_TAG,
-                       "An error occurred when checking ignore rule");
-            rc = POLICY_ERR;
-            break;
+/* convert getdents d_type to robinhood type */
+static const char *dtype2type(unsigned char d_type)
+{
+    switch (d_type) {
+    case DT_REG:
+        return STR_TYPE_FILE;
+    case DT_DIR:
+        return STR_TYPE_DIR;
+    case DT_LNK:
+        return STR_TYPE_LINK;
+    case DT_CHR:
+        return STR_TYPE_CHR;
+    case DT_BLK:
+        return STR_TYPE_BLK;
+    case DT_FIFO:
+        return STR_TYPE_FIFO;
+    case DT_SOCK:
+        return STR_TYPE_SOCK;
+    default:
+        return NULL;
+    }
+}
 
-        case POLICY_NO_MATCH:
-            /* continue testing other ignore rules */
-            break;
+/**
+ * Check ignore rules using entry type from getdents.
+ * Must only be called if ignore_by_dtype is true.
+ */
+static bool ignore_entry_by_dtype(const char *dirpath, const char *name,
+                                  unsigned int depth, unsigned char d_type,
+                                  ino_t ino)
+{
+    entry_id_t tmpid;
+    attr_set_t tmpattr;
+    const char *type = dtype2type(d_type);
+    int rc;
+
+    ATTR_MASK_INIT(&tmpattr);
+
+    ATTR_MASK_SET(&tmpattr, fullpath);
+    rc = snprintf(ATTR(&tmpattr, fullpath), RBH_PATH_MAX, "%s/%s", dirpath,
+                  name);
+    if (rc >= RBH_PATH_MAX)
+        /* let process_one_entry() report the error */
+        return false;
+
+    if (ignore_special_dir(ATTR(&tmpattr, fullpath)))
+        return true;
+
+    ATTR_MASK_SET(&tmpattr, name);
+    rh_strncpy(ATTR(&tmpattr, name), name, sizeof(ATTR(&tmpattr, name)));
+
+    ATTR_MASK_SET(&tmpattr, depth);
+    ATTR(&tmpattr, depth) = depth;
+
+    if (type != NULL) {
+        ATTR_MASK_SET(&tmpattr, type);
+        strcpy(ATTR(&tmpattr, type), type);
+    }
+
+#ifndef _HAVE_FID
+    tmpid.inode = ino;
+    tmpid.fs_key = get_fskey();
+#else
+    memset(&tmpid, 0, sizeof(tmpid));
+#endif
+
+    return match_ignore_rules(&tmpid, &tmpattr);
+}
+
+/**
+ * Push the final DB operation of a scan for the given root
+ * (NULL for a full scan) and wait for its completion:
+ * remove entries with md_update < scan_start_time.
+ * @return 1 if the operation cleaned all directories read during
+ *         an incremental scan (whatever the root), 0 if it only
+ *         applies to root, a negative error code on failure.
+ */
+static int gc_scan_root(const char *root)
+{
+    entry_proc_op_t *op;
+    int rc = 0;
+
+    op = EntryProcessor_Get();
+    if (!op) {
+        DisplayLog(LVL_CRIT, FSSCAN_TAG,
+                   "CRITICAL ERROR: Failed to allocate a new op");
+        return -ENOMEM;
+    }
+
+    op->pipeline_stage = entry_proc_descr.GC_OLDENT;
+
+    /* set callback */
+    op->callback_func = db_special_op_callback;
+    op->callback_param = (void *)"Remove obsolete entries";
+
+    ATTR_MASK_INIT(&op->fs_attrs);
+
+    /* if this is an initial scan, don't rm old entries
+     * (but flush pipeline still) */
+    if (fsscan_nogc || (is_first_scan && partial_scan_count == 0)) {
+        op->gc_entries = 0;
+        op->gc_names = 0;
+        op->callback_param = (void *)"End of flush";
+    } else {
+        /* clean names not seen during the scan */
+        op->gc_names = 1;
+
+        /* If we care about deleted entries and the scan was partial,
+         * it is dangerous to clean entries because files may have been
+         * moved from one part of the namespace to another.
+         */
+        if (root != NULL && has_deletion_policy())
+            op->gc_entries = 0;
+        else
+            op->gc_entries = 1;
+
+        /* set the timestamp of scan in (md_update attribute) */
+        ATTR_MASK_SET(&op->fs_attrs, md_update);
+        ATTR(&op->fs_attrs, md_update) = scan_start_time;
+
+        /* incremental scan: only clean the directories that were read */
+        if (incr_scan) {
+            P(relisted_lock);
+            if (!relisted_overflow) {
+                op->gc_dirs_only = 1;
+                op->gc_dirs = relisted_dirs;
+                op->gc_dir_count = relisted_count;
+                relisted_dirs = NULL;
+                relisted_count = relisted_size = 0;
+                rc = 1;
+            }
+            V(relisted_lock);
         }
     }
 
-    return (rc != POLICY_NO_MATCH);
+    /* set root (if partial scan) */
+    if (root != NULL) {
+        ATTR_MASK_SET(&op->fs_attrs, fullpath);
+        strcpy(ATTR(&op->fs_attrs, fullpath), root);
+    }
+
+    /* set wait db flag */
+    set_db_wait_flag();
+
+#ifndef _BENCH_SCAN
+    /* Push directory to the pipeline */
+    EntryProcessor_Push(op);
+    wait_for_db_callback();
+#else
+    EntryProcessor_Release(op);
+#endif
+    return rc;
 }
 
 /* Terminate a filesystem scan (called by the thread
@@ -321,9 +653,9 @@ static int TerminateScan(int scan_complete, time_t end)
          * the scan */
         FSScan_StoreStats(&lmgr);
         /* and update the scan status */
-        if (partial_scan_root) {
+        if (partial_scan_count > 0) {
             snprintf(tmp, sizeof(tmp), "%s (%s)", SCAN_STATUS_PARTIAL,
-                     partial_scan_root);
+                     scan_roots_str);
             ListMgr_SetVar(&lmgr, LAST_SCAN_STATUS, tmp);
         } else
             ListMgr_SetVar(&lmgr, LAST_SCAN_STATUS,
@@ -337,65 +669,19 @@ static int TerminateScan(int scan_complete, time_t end)
     /* if scan is incomplete (aborted or failed), don't remove old entries
      * in DB. */
     if (scan_complete) {
-        entry_proc_op_t *op;
-
-        /* final DB operation: remove entries with
-         * md_update < scan_start_time */
-        op = EntryProcessor_Get();
-        if (!op) {
-            DisplayLog(LVL_CRIT, FSSCAN_TAG,
-                       "CRITICAL ERROR: Failed to allocate a new op");
-            return -ENOMEM;
-        }
-
-        op->pipeline_stage = entry_proc_descr.GC_OLDENT;
-
-        /* set callback */
-        op->callback_func = db_special_op_callback;
-        op->callback_param = (void *)"Remove obsolete entries";
-
-        ATTR_MASK_INIT(&op->fs_attrs);
-
-        /* if this is an initial scan, don't rm old entries
-         * (but flush pipeline still) */
-        if (fsscan_nogc || (is_first_scan && !partial_scan_root)) {
-            op->gc_entries = 0;
-            op->gc_names = 0;
-            op->callback_param = (void *)"End of flush";
-        } else {
-            /* clean names not seen during the scan */
-            op->gc_names = 1;
-
-            /* If we care about deleted entries and the scan was partial,
-             * it is dangerous to clean entries because files may have been
-             * moved from one part of the namespace to another.
-             */
-            if (partial_scan_root && has_deletion_policy())
-                op->gc_entries = 0;
-            else
-                op->gc_entries = 1;
-
-            /* set the timestamp of scan in (md_update attribute) */
-            ATTR_MASK_SET(&op->fs_attrs, md_update);
-            ATTR(&op->fs_attrs, md_update) = scan_start_time;
-        }
+        unsigned int i;
+        int rc;
 
-        /* set root (if partial scan) */
-        if (partial_scan_root) {
-            ATTR_MASK_SET(&op->fs_attrs, fullpath);
-            strcpy(ATTR(&op->fs_attrs, fullpath), partial_scan_root);
+        /* one GC operation per scanned directory */
+        for (i = 0; i < partial_scan_count || i == 0; i++) {
+            rc = gc_scan_root(partial_scan_count > 0 ?
+                              partial_scan_roots[i] : NULL);
+            if (rc < 0)
+                return rc;
+            /* the list of read directories covers all roots */
+            if (rc > 0)
+                break;
         }
-
-        /* set wait db flag */
-        set_db_wait_flag();
-
-#ifndef _BENCH_SCAN
-        /* Push directory to the pipeline */
-        EntryProcessor_Push(op);
-        wait_for_db_callback();
-#else
-        EntryProcessor_Release(op);
-#endif
     }
 
     /* take a lock on scan info */
@@ -417,12 +703,8 @@ static int TerminateScan(int scan_complete, time_t end)
     /* release the lock */
     V(lock_scan);
 
-    if (partial_scan_root)
-        DisplayLog(LVL_EVENT, FSSCAN_TAG, "File list of %s has been updated",
-                   partial_scan_root);
-    else
-        DisplayLog(LVL_EVENT, FSSCAN_TAG, "File list of %s has been updated",
-                   global_config.fs_path);
+    DisplayLog(LVL_EVENT, FSSCAN_TAG, "File list of %s has been updated",
+               scan_roots_str);
 
     /* sending batched alerts */
     DisplayLog(LVL_VERB, FSSCAN_TAG, "Sending batched alerts, if any");
@@ -474,6 +756,82 @@ static int TerminateScan(int scan_complete, time_t end)
 
 }
 
+/** scan shard checkpoint, recorded once all entries of the shard
+ * have been processed by the pipeline */
+typedef struct shard_ckpt__ {
+    char    varname[128];
+    time_t  scan_start;
+} shard_ckpt_t;
+
+static inline void shard_varname(char *buf, size_t size, const entry_id_t *id)
+{
+    snprintf(buf, size, SCAN_SHARD_PREFIX DFID_NOBRACE, PFID(id));
+}
+
+static int shard_ckpt_callback(lmgr_t *lmgr, struct entry_proc_op_t *p_op,
+                               void *arg)
+{
+    shard_ckpt_t *ckpt = arg;
+    char value[128];
+    int rc;
+
+    sprintf(value, "%lu", (unsigned long)ckpt->scan_start);
+    rc = ListMgr_SetVar(lmgr, ckpt->varname, value);
+    if (rc)
+        DisplayLog(LVL_MAJOR, FSSCAN_TAG, "Failed to store scan checkpoint "
+                   "%s: error %d", ckpt->varname, rc);
+    MemFree(ckpt);
+    return 0;
+}
+
+/**
+ * All entries of a scan shard have been pushed to the pipeline.
+ * Record a checkpoint for it, so it is not scanned again if the scan
+ * is interrupted and resumed. The checkpoint is pushed as a special
+ * operation to the last pipeline stage, so it is only stored after
+ * all entries of the shard have been committed to the DB.
+ */
+static void shard_completed(robinhood_task_t *p_task)
+{
+    entry_proc_op_t *op;
+    shard_ckpt_t *ckpt;
+
+    if (!shard_ckpt || p_task->shard_failed)
+        return;
+
+    ckpt = MemAlloc(sizeof(*ckpt));
+    if (ckpt == NULL)
+        return;
+    shard_varname(ckpt->varname, sizeof(ckpt->varname), &p_task->dir_id);
+    ckpt->scan_start = scan_start_time;
+
+    op = EntryProcessor_Get();
+    if (!op) {
+        DisplayLog(LVL_CRIT, FSSCAN_TAG,
+                   "CRITICAL ERROR: Failed to allocate a new op");
+        MemFree(ckpt);
+        return;
+    }
+
+    op->pipeline_stage = entry_proc_descr.GC_OLDENT;
+    op->callback_func = shard_ckpt_callback;
+    op->callback_param = ckpt;
+    ATTR_MASK_INIT(&op->fs_attrs);
+    /* no GC, just the callback */
+    op->gc_entries = 0;
+    op->gc_names = 0;
+
+    DisplayLog(LVL_DEBUG, FSSCAN_TAG, "Scan shard %s completed",
+               p_task->path);
+
+#ifndef _BENCH_SCAN
+    EntryProcessor_Push(op);
+#else
+    MemFree(ckpt);
+    EntryProcessor_Release(op);
+#endif
+}
+
 /**
  * Function for terminating a task
  * and merging recursively with parent terminated tasks.
@@ -534,12 +892,19 @@ static int RecursiveTaskTermination(thread_scan_info_t *p_info,
                            "%s of %s %s, %u entries found (%u errors). "
                            "Duration = %ld.%02lds",
                            bool_scan_complete ? "Full scan" : "Scan",
-                           partial_scan_root ? partial_scan_root :
-                           global_config.fs_path,
+                           scan_roots_str,
                            bool_scan_complete ? "completed" : "aborted", count,
                            err_count, duree_precise.tv_sec,
                            duree_precise.tv_usec / 10000);
 
+                /* separate stats for each scanned directory */
+                for (i = 0; partial_scan_count > 1 && i < partial_scan_count;
+                     i++)
+                    DisplayLog(LVL_MAJOR, FSSCAN_TAG,
+                               "Scan of %s: %u entries found (%u errors)",
+                               partial_scan_roots[i], root_entries[i],
+                               root_errors[i]);
+
                 DisplayLog(LVL_EVENT, FSSCAN_TAG, "Flushing pipeline...");
 
                 /* merge global scan information */
@@ -555,6 +920,10 @@ static int RecursiveTaskTermination(thread_scan_info_t *p_info,
 
             }
 
+            /* all entries of a scan shard have been processed */
+            if (current_task->shard == current_task && bool_scan_complete)
+                shard_completed(current_task);
+
             /* this thread now manages parent task */
             p_info->current_task = maman;
 
@@ -665,6 +1034,112 @@ static inline int check_entry_dev(dev_t entry_dev, dev_t *root_dev,
 
 static bool noatime_permitted = true;
 
+static inline void fs_op_start(struct timeval *start)
+{
+    if (throttle_enabled())
+        gettimeofday(start, NULL);
+}
+
+/** account the latency of a filesystem operation */
+static void fs_op_end(const struct timeval *start)
+{
+    struct timeval end, diff;
+    uint64_t usec;
+    unsigned int bucket = 0;
+
+    if (!throttle_enabled())
+        return;
+
+    gettimeofday(&end, NULL);
+    timersub(&end, start, &diff);
+    usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+    /* bucket N holds latencies in [2^N, 2^(N+1)[ usec */
+    while (usec > 1 && bucket < LAT_BUCKETS - 1) {
+        usec >>= 1;
+        bucket++;
+    }
+    __sync_fetch_and_add(&lat_hist[bucket], 1);
+}
+
+/**
+ * Adjust the number of active scan threads according to the 99th
+ * percentile of operation latency since the last update: decrease it
+ * if the latency is above the target, increase it if it is below.
+ */
+static void throttle_update(void)
+{
+    unsigned int hist[LAT_BUCKETS];
+    uint64_t total = 0, cumul = 0;
+    uint64_t p99_min, target;
+    unsigned int i, active;
+    time_t now = time(NULL);
+
+    if (!throttle_enabled() || now - throttle_last_update < THROTTLE_PERIOD)
+        return;
+
+    /* only one thread does the update */
+    if (pthread_mutex_trylock(&throttle_lock) != 0)
+        return;
+
+    if (now - throttle_last_update < THROTTLE_PERIOD)
+        goto out;
+    throttle_last_update = now;
+
+    for (i = 0; i < LAT_BUCKETS; i++) {
+        hist[i] = __sync_lock_test_and_set(&lat_hist[i], 0);
+        total += hist[i];
+    }
+    if (total < THROTTLE_MIN_SAMPLES)
+        goto out;
+
+    for (i = 0; i < LAT_BUCKETS - 1; i++) {
+        cumul += hist[i];
+        if (cumul * 100 >= total * 99)
+            break;
+    }
+    /* the 99th percentile is in [p99_min, 2 * p99_min[ */
+    p99_min = 1ULL << i;
+    target = fs_scan_config.target_latency_ms * 1000ULL;
+
+    active = active_scan_threads;
+    if (p99_min > target && active > fs_scan_config.min_threads_scan) {
+        /* decrease quickly */
+        unsigned int step = (active - fs_scan_config.min_threads_scan) / 4;
+
+        active -= (step > 0 ? step : 1);
+    } else if (2 * p99_min <= target && active < fs_scan_config.nb_threads_scan)
+        /* increase slowly */
+        active++;
+    else
+        goto out;
+
+    DisplayLog(LVL_VERB, FSSCAN_TAG, "Operation latency p99 in [%.1f, %.1f[ "
+               "ms (target: %u ms): %u -> %u active scan threads",
+               p99_min / 1000.0, 2 * p99_min / 1000.0,
+               fs_scan_config.target_latency_ms, active_scan_threads, active);
+    active_scan_threads = active;
+    pthread_cond_broadcast(&throttle_cond);
+ out:
+    V(throttle_lock);
+}
+
+/** wait while the thread is not allowed to process tasks */
+static void throttle_wait(thread_scan_info_t *p_info)
+{
+    if (!throttle_enabled() || p_info->index < active_scan_threads)
+        return;
+
+    P(throttle_lock);
+    while (throttle_enabled() && p_info->index >= active_scan_threads
+           && !p_info->force_stop) {
+        struct timespec ts = {.tv_sec = time(NULL) + THROTTLE_PERIOD };
+
+        pthread_cond_timedwait(&throttle_cond, &throttle_lock, &ts);
+    }
+    V(throttle_lock);
+}
+
 static int openat_noatime(int pfd, const char *name, int rddir)
 {
     int fd = -1;
@@ -727,99 +1202,379 @@ static int open_noatime(const char *path, int rddir)
 
     return fd;
 }
-#endif
+#endif
+
+/** disable GC if a transient directory error occurred */
+static void check_dir_error(int rc)
+{
+    if (rc != 0 && abs(rc) != ENOENT && abs(rc) != ESTALE) {
+        /* If we cannot read the directory, we must avoid dropping all
+         * its entries from the DB => Switch to NO_GC mode. */
+        fsscan_flags |= RUNFLG_NO_GC;
+        DisplayLog(LVL_CRIT, FSSCAN_TAG,
+                   "Disabling GC because the namespace can't be fully scanned");
+    }
+}
+
+/** get the DB connection of a scan thread */
+static lmgr_t *scan_thread_db(thread_scan_info_t *p_info)
+{
+    if (!p_info->db_connected) {
+        if (ListMgr_InitAccess(&p_info->lmgr) != DB_SUCCESS) {
+            DisplayLog(LVL_MAJOR, FSSCAN_TAG,
+                       "Failed to connect to the database");
+            return NULL;
+        }
+        p_info->db_connected = true;
+    }
+    return &p_info->lmgr;
+}
+
+/** close the DB connection of a scan thread (if it is open) */
+static void scan_thread_db_close(thread_scan_info_t *p_info)
+{
+    if (!p_info->db_connected)
+        return;
+
+    /* flush pending requests of this connection */
+    ListMgr_CloseAccess(&p_info->lmgr);
+    p_info->db_connected = false;
+}
+
+/** check if a task is the top directory of the scan (or one of them) */
+static bool is_scan_top(const robinhood_task_t *p_task)
+{
+    if (p_task->partial_scan_root == NULL)
+        return p_task->parent_task == NULL;
+    return !strcmp(p_task->path, p_task->partial_scan_root);
+}
+
+/** check if a shard was completely scanned before the resumed scan was
+ * interrupted */
+static bool shard_done(thread_scan_info_t *p_info, const entry_id_t *id)
+{
+    char varname[128];
+    char value[128];
+    lmgr_t *lmgr;
+
+    lmgr = scan_thread_db(p_info);
+    if (lmgr == NULL)
+        return false;
+
+    shard_varname(varname, sizeof(varname), id);
+    if (ListMgr_GetVar(lmgr, varname, value, sizeof(value)) != DB_SUCCESS)
+        return false;
+
+    return strtoul(value, NULL, 10) == (unsigned long)scan_start_time;
+}
+
+static int create_child_task(thread_scan_info_t *p_info,
+                             const char *childpath, struct stat *inode,
+                             robinhood_task_t *parent,
+                             const char *scan_root,
+                             const char *entryname)
+{
+    robinhood_task_t *p_task;
+    int rc = 0;
+
+    p_task = CreateTask();
+
+    if (p_task == NULL) {
+        DisplayLog(LVL_CRIT, FSSCAN_TAG,
+                   "CRITICAL ERROR: task creation failed");
+        return -1;
+    }
+
+    p_task->parent_task = parent;
+    /* propagate partial_scan_root, unless it is specified */
+    p_task->partial_scan_root = scan_root ? scan_root :
+                                    parent->partial_scan_root;
+    rh_strncpy(p_task->path, childpath, sizeof(p_task->path));
+    if (entryname)
+        rh_strncpy(p_task->relpath, entryname, sizeof(p_task->relpath));
+    else
+        assert(p_task->parent_task->fd == -1);
+
+    /* set parent id */
+    if ((rc = path2id(childpath, &p_task->dir_id, inode)) != 0)
+        goto out_free;
+
+    /* sub-directories of the scan root are scan shards */
+    if (entryname != NULL && is_scan_top(parent)) {
+        if (scan_resumed && shard_done(p_info, &p_task->dir_id)) {
+            DisplayLog(LVL_DEBUG, FSSCAN_TAG, "%s was scanned before "
+                       "the scan was interrupted: skipping it", childpath);
+            goto out_free;
+        }
+        p_task->shard = p_task;
+    } else
+        p_task->shard = parent->shard;
+
+    p_task->dir_md = *inode;
+    p_task->depth = parent->depth + 1;
+    p_task->task_finished = false;
+
+    /* add the task to the parent's subtask list */
+    AddChildTask(parent, p_task);
+
+    /* insert task to the queue of the current thread */
+    InsertTask_to_Stack(&tasks_stack, p_task, p_info->index);
+    return 0;
+
+ out_free:
+    FreeTask(p_task);
+    return rc;
+}
+
+static int do_stat_entry(const char *path, const char *name, int parentfd,
+                         struct stat *inode, unsigned int *stx_got)
+{
+    *stx_got = STATX_BASIC_STATS;
+
+#ifndef _NO_AT_FUNC
+    /* if called for a directory between root and partial_scan_root */
+    if (parentfd != -1)
+        return rbh_statx(parentfd, name, scan_stx_mask,
+                         fs_scan_config.stat_dont_sync, inode, stx_got);
+    else
+#endif
+#if defined(_LUSTRE) && defined(_MDS_STAT_SUPPORT)
+    if (is_lustre_fs && global_config.direct_mds_stat) {
+        int rc;
+        rc = lustre_mds_stat(path, parentfd, inode);
+        if (!rc)
+            /* device id is not the one seen by client: change it */
+            inode->st_dev = fsdev;
+        return rc;
+    } else
+#endif
+    if (lstat(path, inode) == -1)
+        return -errno;
+
+    return 0;
+}
+
+static int stat_entry(const char *path, const char *name, int parentfd,
+                      struct stat *inode, unsigned int *stx_got)
+{
+    struct timeval start;
+    int rc;
+
+    fs_op_start(&start);
+    rc = do_stat_entry(path, name, parentfd, inode, stx_got);
+    fs_op_end(&start);
+
+    return rc;
+}
+
+#ifndef _NO_AT_FUNC
+/* Stat prefetch thread: stat directory entries ahead of the scan thread,
+ * in a window of 'stat_prefetch_window' entries. */
+static void *Thr_stat_prefetch(void *arg)
+{
+    stat_prefetch_t *pf = (stat_prefetch_t *)arg;
+    char path[RBH_PATH_MAX];
+    struct stat inode;
+    unsigned int stx_got = 0;
+    dir_entry_slot_t *slot;
+    int rc;
+
+    P(pf->lock);
+    while (!pf->stop) {
+        /* don't stat entries already handled by the scan thread */
+        if (pf->next < pf->consumed)
+            pf->next = pf->consumed;
+
+        if (pf->next >= pf->count
+            || pf->next >= pf->consumed + fs_scan_config.stat_prefetch_window)
+        {
+            /* wait for new entries or scan progress */
+            pf->helper_waiting = true;
+            pthread_cond_wait(&pf->work_cond, &pf->lock);
+            pf->helper_waiting = false;
+            continue;
+        }
+
+        slot = &pf->slots[pf->next];
+        pf->next++;
+
+        if (slot->state != ENT_TODO)
+            continue;
+
+        slot->state = ENT_BUSY;
+        pf->helper_busy = true;
+        V(pf->lock);
+
+        rc = snprintf(path, sizeof(path), "%s/%s", pf->task->path,
+                      slot->name);
+        if (rc >= sizeof(path))
+            rc = -ENAMETOOLONG;
+        else
+            rc = stat_entry(path, slot->name, pf->dirfd, &inode, &stx_got);
+
+        P(pf->lock);
+        slot->rc = rc;
+        slot->inode = inode;
+        slot->stx_got = stx_got;
+        slot->state = ENT_DONE;
+        pf->helper_busy = false;
+        pthread_cond_broadcast(&pf->done_cond);
+    }
+    V(pf->lock);
+
+    return NULL;
+}
+
+static void unlock_prefetch(void *arg)
+{
+    V(((stat_prefetch_t *)arg)->lock);
+}
+
+/* wait for the prefetch thread to release the current chunk */
+static void prefetch_wait_idle(stat_prefetch_t *pf)
+{
+    /* the scan thread may be cancelled in case of hang */
+    pthread_cleanup_push(unlock_prefetch, pf);
+    while (pf->helper_busy)
+        pthread_cond_wait(&pf->done_cond, &pf->lock);
+    pthread_cleanup_pop(0);
+}
+
+/* hand a new chunk of directory entries to the prefetch thread */
+static void prefetch_start_chunk(stat_prefetch_t *pf,
+                                 const robinhood_task_t *p_task, int dirfd,
+                                 unsigned int count)
+{
+    P(pf->lock);
+    prefetch_wait_idle(pf);
+    pf->task = p_task;
+    pf->dirfd = dirfd;
+    pf->count = count;
+    pf->next = 0;
+    pf->consumed = 0;
+    pthread_cond_signal(&pf->work_cond);
+    V(pf->lock);
+}
 
-/** disable GC if a transient directory error occurred */
-static void check_dir_error(int rc)
+/* release the current chunk before its buffer is reused or freed */
+static void prefetch_end_chunk(stat_prefetch_t *pf)
 {
-    if (rc != 0 && abs(rc) != ENOENT && abs(rc) != ESTALE) {
-        /* If we cannot read the directory, we must avoid dropping all
-         * its entries from the DB => Switch to NO_GC mode. */
-        fsscan_flags |= RUNFLG_NO_GC;
-        DisplayLog(LVL_CRIT, FSSCAN_TAG,
-                   "Disabling GC because the namespace can't be fully scanned");
-    }
+    P(pf->lock);
+    prefetch_wait_idle(pf);
+    pf->count = 0;
+    pf->task = NULL;
+    V(pf->lock);
 }
 
-static int create_child_task(const char *childpath, struct stat *inode,
-                             robinhood_task_t *parent,
-                             const char *scan_root,
-                             const char *entryname)
+/**
+ * Get the attributes of the given slot from prefetch thread.
+ * If the prefetch thread has not started to stat it, it will be done
+ * by the scan thread itself.
+ */
+static void prefetch_get(stat_prefetch_t *pf, unsigned int index)
 {
-    robinhood_task_t *p_task;
-    int rc = 0;
+    dir_entry_slot_t *slot = &pf->slots[index];
 
-    p_task = CreateTask();
+    P(pf->lock);
+    pthread_cleanup_push(unlock_prefetch, pf);
 
-    if (p_task == NULL) {
-        DisplayLog(LVL_CRIT, FSSCAN_TAG,
-                   "CRITICAL ERROR: task creation failed");
-        return -1;
-    }
+    /* slots before index are processed */
+    pf->consumed = index;
+    if (pf->helper_waiting)
+        pthread_cond_signal(&pf->work_cond);
 
-    p_task->parent_task = parent;
-    /* propagate partial_scan_root, unless it is specified */
-    p_task->partial_scan_root = scan_root ? scan_root :
-                                    parent->partial_scan_root;
-    rh_strncpy(p_task->path, childpath, sizeof(p_task->path));
-    if (entryname)
-        rh_strncpy(p_task->relpath, entryname, sizeof(p_task->relpath));
+    if (slot->state == ENT_TODO)
+        /* don't wait: stat it now */
+        slot->state = ENT_SELF;
     else
-        assert(p_task->parent_task->fd == -1);
+        while (slot->state == ENT_BUSY)
+            pthread_cond_wait(&pf->done_cond, &pf->lock);
 
-    /* set parent id */
-    if ((rc = path2id(childpath, &p_task->dir_id, inode)) != 0)
-        goto out_free;
+    pthread_cleanup_pop(1);
+}
 
-    p_task->dir_md = *inode;
-    p_task->depth = parent->depth + 1;
-    p_task->task_finished = false;
+static int prefetch_init(thread_scan_info_t *p_info)
+{
+    stat_prefetch_t *pf;
+    int rc;
 
-    /* add the task to the parent's subtask list */
-    AddChildTask(parent, p_task);
+    pf = MemCalloc(1, sizeof(*pf));
+    if (!pf)
+        return ENOMEM;
 
-    /* insert task to the stack */
-    InsertTask_to_Stack(&tasks_stack, p_task);
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->work_cond, NULL);
+    pthread_cond_init(&pf->done_cond, NULL);
+    pf->slots = p_info->slots;
+
+    rc = pthread_create(&pf->thread, &thread_attrs, Thr_stat_prefetch, pf);
+    if (rc) {
+        DisplayLog(LVL_CRIT, FSSCAN_TAG,
+                   "ERROR %d creating stat prefetch thread: %s", rc,
+                   strerror(rc));
+        pthread_cond_destroy(&pf->done_cond);
+        pthread_cond_destroy(&pf->work_cond);
+        pthread_mutex_destroy(&pf->lock);
+        MemFree(pf);
+        return rc;
+    }
+    p_info->prefetch = pf;
     return 0;
+}
 
- out_free:
-    FreeTask(p_task);
-    return rc;
+static void prefetch_stop(stat_prefetch_t *pf)
+{
+    P(pf->lock);
+    pf->stop = true;
+    pthread_cond_signal(&pf->work_cond);
+    V(pf->lock);
 }
 
-static int stat_entry(const char *path, const char *name, int parentfd,
-                      struct stat *inode)
+/* wait for the prefetch thread to terminate and release it */
+static void prefetch_free(thread_scan_info_t *p_info)
 {
-#ifndef _NO_AT_FUNC
-    /* if called for a directory between root and partial_scan_root */
-    if (parentfd != -1) {
-        if (fstatat(parentfd, name, inode, AT_SYMLINK_NOFOLLOW) == -1)
-            return -errno;
-    } else
-#endif
-#if defined(_LUSTRE) && defined(_MDS_STAT_SUPPORT)
-    if (is_lustre_fs && global_config.direct_mds_stat) {
-        int rc;
-        rc = lustre_mds_stat(path, parentfd, inode);
-        if (!rc)
-            /* device id is not the one seen by client: change it */
-            inode->st_dev = fsdev;
-        return rc;
-    } else
-#endif
-    if (lstat(path, inode) == -1)
-        return -errno;
+    stat_prefetch_t *pf = p_info->prefetch;
 
-    return 0;
+    if (pf == NULL)
+        return;
+
+    prefetch_stop(pf);
+    pthread_join(pf->thread, NULL);
+
+    pthread_cond_destroy(&pf->done_cond);
+    pthread_cond_destroy(&pf->work_cond);
+    pthread_mutex_destroy(&pf->lock);
+    MemFree(pf);
+    p_info->prefetch = NULL;
+}
+
+/* release the resources of a scan thread that is not running */
+static void scan_thread_free(thread_scan_info_t *p_info)
+{
+    prefetch_free(p_info);
+    if (p_info->slots != NULL) {
+        MemFree(p_info->slots);
+        p_info->slots = NULL;
+    }
+    if (p_info->dirent_buf != NULL) {
+        MemFree(p_info->dirent_buf);
+        p_info->dirent_buf = NULL;
+    }
 }
+#endif
 
-/* process a filesystem entry */
+/* process a filesystem entry.
+ * @param slot  entry read from directory buffer with its possibly
+ *              prefetched attributes (NULL if not read by getdents).
+ */
 static int process_one_entry(thread_scan_info_t *p_info,
                              robinhood_task_t *p_task,
-                             char *entry_name, int parentfd)
+                             char *entry_name, int parentfd,
+                             const dir_entry_slot_t *slot)
 {
     char entry_path[RBH_PATH_MAX];
     struct stat inode;
+    unsigned int stx_got;
     int rc = 0;
     int no_md = 0;
 
@@ -833,8 +1588,14 @@ static int process_one_entry(thread_scan_info_t *p_info,
     }
 
     /* retrieve information about the entry (to know if it's a directory
-     * or something else) */
-    rc = stat_entry(entry_path, entry_name, parentfd, &inode);
+     * or something else), if it was not prefetched */
+    if (slot != NULL && slot->state == ENT_DONE) {
+        rc = slot->rc;
+        inode = slot->inode;
+        stx_got = slot->stx_got;
+    } else {
+        rc = stat_entry(entry_path, entry_name, parentfd, &inode, &stx_got);
+    }
     if (rc) {
 #ifdef _LUSTRE
         if (is_lustre_fs && (rc == -ESHUTDOWN)) {
@@ -855,8 +1616,11 @@ static int process_one_entry(thread_scan_info_t *p_info,
         return rc;
     }
 
-    /* Test if entry or directory is ignored */
-    if (ignore_entry(entry_path, entry_name, p_task->depth, &inode)) {
+    /* Test if entry or directory is ignored
+     * (if not already checked using getdents information) */
+    if ((slot == NULL || !slot->ignore_checked)
+        && ignore_entry(entry_path, entry_name, p_task->depth, &inode,
+                        stx_got)) {
         DisplayLog(LVL_DEBUG, FSSCAN_TAG,
                    "%s matches an 'ignore' rule. Skipped.", entry_path);
         return 0;
@@ -869,7 +1633,8 @@ static int process_one_entry(thread_scan_info_t *p_info,
      * Note: directories are pushed in Thr_scan(), after the closedir() call.
      */
     if (S_ISDIR(inode.st_mode)) {
-        rc = create_child_task(entry_path, &inode, p_task, NULL, entry_name);
+        rc = create_child_task(p_info, entry_path, &inode, p_task, NULL,
+                               entry_name);
         if (rc)
             return rc;
     } else {
@@ -911,12 +1676,7 @@ static int process_one_entry(thread_scan_info_t *p_info,
         ATTR(&op->fs_attrs, depth) = p_task->depth;
 
         if (!no_md) {
-#if defined(_LUSTRE) && defined(_MDS_STAT_SUPPORT)
-            stat2rbh_attrs(&inode, &op->fs_attrs,
-                           !(is_lustre_fs && global_config.direct_mds_stat));
-#else
-            stat2rbh_attrs(&inode, &op->fs_attrs, true);
-#endif
+            scan_stat2rbh_attrs(&inode, stx_got, &op->fs_attrs);
             /* set update time  */
             ATTR_MASK_SET(&op->fs_attrs, md_update);
             ATTR(&op->fs_attrs, md_update) = time(NULL);
@@ -1028,7 +1788,8 @@ static int process_one_entry(thread_scan_info_t *p_info,
 
 /* directory specific types and accessors */
 #ifndef _NO_AT_FUNC
-#define GETDENTS_BUF_SZ 4096
+/* minimal size of a dirent64 record (with 1 char name + padding) */
+#define DIRENT64_MIN_RECLEN ((offsetof(struct dirent64, d_name) + 1 + 7) & ~7)
 #define DIR_T int
 #define DIR_FD(_d) (_d)
 #define DIR_ERR(_d) ((_d) < 0)
@@ -1042,15 +1803,36 @@ static int process_one_entry(thread_scan_info_t *p_info,
 
 static inline DIR_T dir_open(const char *path, int pfd, const char *relpath)
 {
+    struct timeval start;
+    DIR_T dirp;
+
+    fs_op_start(&start);
 #ifndef _NO_AT_FUNC
     if (pfd != -1)
-        return openat_noatime(pfd, relpath, true);
+        dirp = openat_noatime(pfd, relpath, true);
     else
-        return open_noatime(path, true);
+        dirp = open_noatime(path, true);
 #else
-    return opendir(path);
+    dirp = opendir(path);
 #endif
+    fs_op_end(&start);
+
+    return dirp;
+}
+
+#ifndef _NO_AT_FUNC
+static inline int dir_read(int fd, void *buf, size_t size)
+{
+    struct timeval start;
+    int rc;
+
+    fs_op_start(&start);
+    rc = syscall(SYS_getdents64, fd, buf, size);
+    fs_op_end(&start);
+
+    return rc;
 }
+#endif
 
 static int process_one_dir(robinhood_task_t *p_task,
                            thread_scan_info_t *p_info,
@@ -1058,7 +1840,6 @@ static int process_one_dir(robinhood_task_t *p_task,
 {
     DIR_T dirp;
 #ifndef _NO_AT_FUNC
-    char dirent_buf[GETDENTS_BUF_SZ];
     struct dirent64 *direntry = NULL;
 #else
     struct dirent direntry;
@@ -1092,37 +1873,86 @@ static int process_one_dir(robinhood_task_t *p_task,
     p_info->last_action = time(NULL);
 
 #ifndef _NO_AT_FUNC
-    /* scan directory entries by chunk of 4k */
-    direntry = (struct dirent64 *)dirent_buf;
-    while ((rc = syscall(SYS_getdents64, dirp, direntry, GETDENTS_BUF_SZ))
-                    > 0) {
+    /* scan directory entries by chunk of readdir_buffer_size */
+    direntry = (struct dirent64 *)p_info->dirent_buf;
+    while ((rc = dir_read(dirp, direntry,
+                          fs_scan_config.readdir_buffer_size)) > 0) {
         off_t bytepos;
         struct dirent64 *dp;
+        unsigned int count = 0;
+        unsigned int i;
 
         /* notify current activity */
         p_info->last_action = time(NULL);
 
+        /* first index the entries of this chunk */
         for (bytepos = 0; bytepos < rc;) {
-            dp = (struct dirent64 *)(dirent_buf + bytepos);
+            dir_entry_slot_t *slot;
+
+            dp = (struct dirent64 *)(p_info->dirent_buf + bytepos);
             bytepos += dp->d_reclen;
 
+            if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
+                continue;
+
+            slot = &p_info->slots[count];
+            count++;
+
+            slot->name = dp->d_name;
+            slot->rc = 0;
+            slot->state = ENT_TODO;
+            slot->ignore_checked = false;
+
+            /* if the type is known, don't stat ignored entries */
+            if (ignore_by_dtype && dp->d_type != DT_UNKNOWN) {
+                slot->ignore_checked = true;
+                if (ignore_entry_by_dtype(p_task->path, dp->d_name,
+                                          p_task->depth, dp->d_type,
+                                          dp->d_ino)) {
+                    DisplayLog(LVL_DEBUG, FSSCAN_TAG,
+                               "%s/%s matches an 'ignore' rule. Skipped.",
+                               p_task->path, dp->d_name);
+                    slot->state = ENT_SKIP;
+                }
+            }
+        }
+
+        (*nb_entries) += count;
+
+        /* start stat'ing entries ahead */
+        if (p_info->prefetch)
+            prefetch_start_chunk(p_info->prefetch, p_task, DIR_FD(dirp),
+                                 count);
+
+        for (i = 0; i < count; i++) {
             /* break ASAP if requested */
             if (p_info->force_stop) {
                 DisplayLog(LVL_EVENT, FSSCAN_TAG, "Stop requested: "
                            "cancelling directory scan operation "
                            "(in '%s')", p_task->path);
+                if (p_info->prefetch)
+                    prefetch_end_chunk(p_info->prefetch);
                 return -ECANCELED;
             }
 
-            if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
+            if (p_info->slots[i].state == ENT_SKIP)
                 continue;
 
-            (*nb_entries)++;
+            if (p_info->prefetch)
+                prefetch_get(p_info->prefetch, i);
 
             /* Handle filesystem entry. */
-            if (process_one_entry(p_info, p_task, dp->d_name, DIR_FD(dirp)))
+            if (process_one_entry(p_info, p_task,
+                                  (char *)p_info->slots[i].name,
+                                  DIR_FD(dirp), &p_info->slots[i]))
                 (*nb_errors)++;
+
+            /* notify current activity */
+            p_info->last_action = time(NULL);
         }
+
+        if (p_info->prefetch)
+            prefetch_end_chunk(p_info->prefetch);
     }
     /* rc == 0 => end of dir */
     if (rc < 0) {
@@ -1165,7 +1995,8 @@ static int process_one_dir(robinhood_task_t *p_task,
 #endif
 
         /* Handle filesystem entry. */
-        if (process_one_entry(p_info, p_task, direntry.d_name, dirfd(dirp)))
+        if (process_one_entry(p_info, p_task, direntry.d_name, dirfd(dirp),
+                              NULL))
             (*nb_errors)++;
 
     }   /* end of dir */
@@ -1177,12 +2008,15 @@ static int process_one_dir(robinhood_task_t *p_task,
  * If scan is restricted to a list of subdirectories, create 1 task
  * per subdirectory.
  */
-static int push_dir_list(robinhood_task_t *parent_task)
+static int push_dir_list(thread_scan_info_t *p_info,
+                         robinhood_task_t *parent_task,
+                         const char * const *dir_list,
+                         unsigned int dir_count)
 {
     int i, rc;
 
-    for (i = 0; i < fs_scan_config.dir_count; i++) {
-        const char *dir = fs_scan_config.dir_list[i];
+    for (i = 0; i < dir_count; i++) {
+        const char *dir = dir_list[i];
         char *new_task_path;
         const char *next_name;
         const char *next_slash;
@@ -1222,10 +2056,10 @@ static int push_dir_list(robinhood_task_t *parent_task)
         }
 
         DisplayLog(LVL_FULL, FSSCAN_TAG, "Pushing dir '%s' to reach "
-                   "sub-tree '%s'", new_task_path, fs_scan_config.dir_list[i]);
+                   "sub-tree '%s'", new_task_path, dir);
 
-        rc = create_child_task(new_task_path, &inode,
-                               parent_task, fs_scan_config.dir_list[i], NULL);
+        rc = create_child_task(p_info, new_task_path, &inode,
+                               parent_task, dir, NULL);
         free(new_task_path);
         if (rc)
             return rc;
@@ -1234,6 +2068,205 @@ static int push_dir_list(robinhood_task_t *parent_task)
     return 0;
 }
 
+/** free the list of directories read during an incremental scan */
+static void free_relisted_dirs(void)
+{
+    int i;
+
+    P(relisted_lock);
+    for (i = 0; i < relisted_count; i++)
+        free(relisted_dirs[i].fullname);
+    MemFree(relisted_dirs);
+    relisted_dirs = NULL;
+    relisted_count = relisted_size = 0;
+    relisted_overflow = false;
+    V(relisted_lock);
+}
+
+/** incremental scan: remember a directory has been read */
+static void add_relisted_dir(const robinhood_task_t *p_task)
+{
+    char *path;
+
+    P(relisted_lock);
+    if (relisted_overflow)
+        goto out;
+
+    if (relisted_count == relisted_size) {
+        unsigned int new_size = relisted_size ? 2 * relisted_size : 1024;
+        wagon_t *new_list;
+
+        new_list = MemRealloc(relisted_dirs, new_size * sizeof(wagon_t));
+        if (new_list == NULL)
+            goto overflow;
+        relisted_dirs = new_list;
+        relisted_size = new_size;
+    }
+
+    path = strdup(p_task->path);
+    if (path == NULL)
+        goto overflow;
+
+    relisted_dirs[relisted_count].id = p_task->dir_id;
+    relisted_dirs[relisted_count].fullname = path;
+    relisted_count++;
+    goto out;
+
+ overflow:
+    /* fall back to a full GC */
+    DisplayLog(LVL_MAJOR, FSSCAN_TAG, "Failed to allocate memory for the "
+               "list of directories read: a full GC will be done at the end "
+               "of the scan");
+    relisted_overflow = true;
+ out:
+    V(relisted_lock);
+}
+
+/**
+ * Incremental scan: check if the content of a directory may have changed
+ * since it was stored in the DB, by comparing its mtime and ctime.
+ */
+static bool dir_content_changed(thread_scan_info_t *p_info,
+                                robinhood_task_t *p_task)
+{
+    attr_set_t dir_attrs = ATTR_SET_INIT;
+    lmgr_t *lmgr;
+    time_t stat_time;
+    bool changed = true;
+    int rc;
+
+    /* Get fresh attributes, and remember if the directory has been modified
+     * in the current second: in this case, it may be modified again with
+     * the same mtime after we read it. */
+    stat_time = time(NULL);
+#ifndef _NO_AT_FUNC
+    if (p_task->parent_task && p_task->parent_task->fd != -1)
+        rc = fstatat(p_task->parent_task->fd, p_task->relpath,
+                     &p_task->dir_md, AT_SYMLINK_NOFOLLOW);
+    else
+#endif
+        rc = lstat(p_task->path, &p_task->dir_md);
+    if (rc)
+        /* let the directory reading report the error */
+        return true;
+
+    p_task->dir_md_unstable = (p_task->dir_md.st_mtime >= stat_time
+                               || p_task->dir_md.st_ctime >= stat_time);
+
+    lmgr = scan_thread_db(p_info);
+    if (lmgr == NULL)
+        return true;
+
+    dir_attrs.attr_mask.std = ATTR_MASK_last_mod | ATTR_MASK_last_mdchange;
+    rc = ListMgr_Get(lmgr, &p_task->dir_id, &dir_attrs);
+    if (rc == DB_NOT_EXISTS)
+        return true;
+    else if (rc) {
+        DisplayLog(LVL_MAJOR, FSSCAN_TAG, "Failed to get attributes of "
+                   "directory %s from DB: error %d", p_task->path, rc);
+        return true;
+    }
+
+    if (ATTR_MASK_TEST(&dir_attrs, last_mod)
+        && ATTR_MASK_TEST(&dir_attrs, last_mdchange)
+        && (ATTR(&dir_attrs, last_mod) == p_task->dir_md.st_mtime)
+        && (ATTR(&dir_attrs, last_mdchange) == p_task->dir_md.st_ctime))
+        changed = false;
+
+    ListMgr_FreeAttrs(&dir_attrs);
+    return changed;
+}
+
+/**
+ * Incremental scan: process the entries of a directory that has not changed
+ * since last scan. Entry names are taken from the DB, but entries are still
+ * stat'ed as their attributes may have changed.
+ */
+static int process_dir_from_db(robinhood_task_t *p_task,
+                               thread_scan_info_t *p_info,
+                               unsigned int *nb_entries,
+                               unsigned int *nb_errors)
+{
+    DIR_T dirp;
+    wagon_t dir;
+    wagon_t *child_ids = NULL;
+    attr_set_t *child_attrs = NULL;
+    unsigned int child_count = 0;
+    attr_mask_t mask = {.std = ATTR_MASK_name};
+    int i, rc;
+
+    (*nb_entries) = 0;
+
+    /* hearbeat before opendir */
+    p_info->last_action = time(NULL);
+
+    /* the directory fd is needed to stat entries and open subdirectories */
+    dirp = dir_open(p_task->path,
+                    p_task->parent_task ? p_task->parent_task->fd : -1,
+                    p_task->relpath);
+    if (DIR_ERR(dirp)) {
+        rc = -errno;
+        DisplayLog(LVL_CRIT, FSSCAN_TAG,
+                   OPENDIR_STR " failed on %s (%s)",
+                   p_task->path, strerror(-rc));
+        (*nb_errors)++;
+        check_dir_error(rc);
+
+        return rc;
+    }
+    p_task->fd = dirp;
+
+    dir.id = p_task->dir_id;
+    dir.fullname = p_task->path;
+
+    rc = ListMgr_GetChild(&p_info->lmgr, NULL, &dir, 1, mask, &child_ids,
+                          &child_attrs, &child_count);
+    if (rc) {
+        DisplayLog(LVL_MAJOR, FSSCAN_TAG, "Failed to get the content of "
+                   "directory %s from DB (error %d): reading it", p_task->path,
+                   rc);
+        /* the directory must be fully read */
+        close(p_task->fd);
+        p_task->fd = -1;
+        return -EAGAIN;
+    }
+
+    DisplayLog(LVL_FULL, FSSCAN_TAG, "%s unchanged since last scan: "
+               "%u entries from DB", p_task->path, child_count);
+
+    for (i = 0; i < child_count; i++) {
+        /* break ASAP if requested */
+        if (p_info->force_stop) {
+            DisplayLog(LVL_EVENT, FSSCAN_TAG, "Stop requested: "
+                       "cancelling directory scan operation "
+                       "(in '%s')", p_task->path);
+            rc = -ECANCELED;
+            break;
+        }
+
+        if (!ATTR_MASK_TEST(&child_attrs[i], name))
+            continue;
+
+        (*nb_entries)++;
+
+        if (process_one_entry(p_info, p_task, ATTR(&child_attrs[i], name),
+                              DIR_FD(dirp), NULL))
+            (*nb_errors)++;
+
+        /* notify current activity */
+        p_info->last_action = time(NULL);
+    }
+
+    for (i = 0; i < child_count; i++) {
+        ListMgr_FreeAttrs(&child_attrs[i]);
+        free(child_ids[i].fullname);
+    }
+    MemFree(child_attrs);
+    MemFree(child_ids);
+
+    return rc;
+}
+
 static int process_one_task(robinhood_task_t *p_task,
                             thread_scan_info_t *p_info,
                             unsigned int *nb_entries, unsigned int *nb_errors)
@@ -1303,7 +2336,16 @@ static int process_one_task(robinhood_task_t *p_task,
         DisplayLog(LVL_DEBUG, FSSCAN_TAG, "Partial scan: processing '%s' in %s",
                    name, p_task->path);
 
-        rc = process_one_entry(p_info, p_task, name, -1);
+        rc = process_one_entry(p_info, p_task, name, -1, NULL);
+        if (rc) {
+            (*nb_errors)++;
+            return rc;
+        }
+    } else if (p_task->depth == 0 && partial_scan_count > 1) {
+        /* partial scan of several directories: create child tasks under
+         * mother task to scan them concurrently */
+        rc = push_dir_list(p_info, p_task, partial_scan_roots,
+                           partial_scan_count);
         if (rc) {
             (*nb_errors)++;
             return rc;
@@ -1311,7 +2353,9 @@ static int process_one_task(robinhood_task_t *p_task,
     } else if (p_task->depth == 0 && fs_scan_config.dir_count > 0) {
         /* If scan is restricted to subdirectories, create child tasks under
          * mother task */
-        rc = push_dir_list(p_task);
+        rc = push_dir_list(p_info, p_task,
+                           (const char * const *)fs_scan_config.dir_list,
+                           fs_scan_config.dir_count);
         if (rc) {
             (*nb_errors)++;
             return rc;
@@ -1323,8 +2367,19 @@ static int process_one_task(robinhood_task_t *p_task,
     else if (p_task->depth == 0)
 #endif
     {
-        /* read the directory and process each entry */
-        rc = process_one_dir(p_task, p_info, nb_entries, nb_errors);
+        rc = -EAGAIN;
+
+        /* incremental scan: get the entries of unchanged directories
+         * from the DB */
+        if (incr_scan && !dir_content_changed(p_info, p_task))
+            rc = process_dir_from_db(p_task, p_info, nb_entries, nb_errors);
+
+        if (rc == -EAGAIN) {
+            /* read the directory and process each entry */
+            rc = process_one_dir(p_task, p_info, nb_entries, nb_errors);
+            if (rc == 0 && incr_scan)
+                add_relisted_dir(p_task);
+        }
         if (rc)
             return rc;
     }
@@ -1407,6 +2462,10 @@ static int process_one_task(robinhood_task_t *p_task,
 #else
             stat2rbh_attrs(&p_task->dir_md, &op->fs_attrs, true);
 #endif
+            /* make sure the directory will be read again by next
+             * incremental scan */
+            if (p_task->dir_md_unstable)
+                ATTR_MASK_UNSET(&op->fs_attrs, last_mdchange);
 #ifdef _LUSTRE
             if (global_config.lustre_projid) {
                 rc = lustre_project_get_id(p_task->path);
@@ -1469,6 +2528,21 @@ static int process_one_task(robinhood_task_t *p_task,
  * Thr_scan :
  * main routine for handling tasks.
  */
+/** update the stats of the scanned directory a task belongs to */
+static void count_root_entries(const robinhood_task_t *p_task,
+                               unsigned int nb_entries, unsigned int nb_errors)
+{
+    int i;
+
+    for (i = 0; i < partial_scan_count; i++) {
+        if (p_task->partial_scan_root == partial_scan_roots[i]) {
+            __sync_fetch_and_add(&root_entries[i], nb_entries);
+            __sync_fetch_and_add(&root_errors[i], nb_errors);
+            return;
+        }
+    }
+}
+
 static void *Thr_scan(void *arg_thread)
 {
     robinhood_task_t *p_task;
@@ -1498,8 +2572,14 @@ static void *Thr_scan(void *arg_thread)
         DisplayLog(LVL_FULL, FSSCAN_TAG, "ThrScan-%d: Waiting for a task",
                    p_info->index);
 
+        /* adaptive throttling: wait until this thread is allowed
+         * to process tasks */
+        throttle_wait(p_info);
+        if (p_info->force_stop)
+            break;
+
         /* take a task from queue */
-        p_task = GetTask_from_Stack(&tasks_stack);
+        p_task = GetTask_from_Stack(&tasks_stack, p_info->index);
 
         /* skip it if the thread was requested to stop */
         if (p_info->force_stop)
@@ -1536,6 +2616,14 @@ static void *Thr_scan(void *arg_thread)
         timeradd(&diff, &p_info->time_consumed, &p_info->time_consumed);
         p_info->entries_handled += nb_entries;
         p_info->entries_errors += nb_errors;
+        if (partial_scan_count > 1)
+            count_root_entries(p_task, nb_entries, nb_errors);
+
+        /* a shard with errors (on the directory or on some of its
+         * entries) must be scanned again if the scan is interrupted
+         * and resumed */
+        if ((task_rc != 0 || nb_errors > 0) && p_task->shard != NULL)
+            p_task->shard->shard_failed = true;
 
         /* make an average on directory entries */
         if (nb_entries > 0) {
@@ -1557,10 +2645,14 @@ static void *Thr_scan(void *arg_thread)
                        rc);
             Exit(1);
         }
+
+        throttle_update();
     }
 
     p_info->current_task = NULL;
 
+    scan_thread_db_close(p_info);
+
     /* check scan termination status */
     if (all_threads_idle())
         signal_scan_finished();
@@ -1596,7 +2688,7 @@ int Robinhood_InitScanModule(void)
 
     /* initializing task stack */
 
-    st = InitTaskStack(&tasks_stack);
+    st = InitTaskStack(&tasks_stack, fs_scan_config.nb_threads_scan);
     if (st)
         return st;
 
@@ -1609,6 +2701,10 @@ int Robinhood_InitScanModule(void)
     if (!strcmp(global_config.fs_type, "lustre"))
         is_lustre_fs = true;
 
+    init_scan_stx_mask();
+    init_scan_roots_str();
+    active_scan_threads = fs_scan_config.nb_threads_scan;
+
     /* initializing thread attrs */
 
     pthread_attr_init(&thread_attrs);
@@ -1621,6 +2717,9 @@ int Robinhood_InitScanModule(void)
     if (!thread_list)
         return ENOMEM;
 
+    /* check if ignore rules can be matched without stat */
+    init_ignore_by_dtype();
+
     /* creating scanning threads  */
 
     for (i = 0; i < fs_scan_config.nb_threads_scan; i++) {
@@ -1637,6 +2736,28 @@ int Robinhood_InitScanModule(void)
         timerclear(&thread_list[i].time_consumed);
         timerclear(&thread_list[i].last_processing_time);
 
+#ifndef _NO_AT_FUNC
+        /* allocate directory buffer and entry slots */
+        thread_list[i].dirent_buf = MemAlloc(fs_scan_config.
+                                             readdir_buffer_size);
+        thread_list[i].slots = MemCalloc(fs_scan_config.readdir_buffer_size
+                                         / DIRENT64_MIN_RECLEN,
+                                         sizeof(dir_entry_slot_t));
+        if (!thread_list[i].dirent_buf || !thread_list[i].slots) {
+            scan_thread_free(&thread_list[i]);
+            return ENOMEM;
+        }
+
+        thread_list[i].prefetch = NULL;
+        if (fs_scan_config.stat_prefetch_window > 0) {
+            rc = prefetch_init(&thread_list[i]);
+            if (rc) {
+                scan_thread_free(&thread_list[i]);
+                return rc;
+            }
+        }
+#endif
+
         rc = pthread_create(&(thread_list[i].thread_scan), &thread_attrs,
                             Thr_scan, &(thread_list[i]));
 
@@ -1644,6 +2765,9 @@ int Robinhood_InitScanModule(void)
             DisplayLog(LVL_CRIT, FSSCAN_TAG,
                        "ERROR %d CREATING SCANNING THREAD: %s", rc,
                        strerror(rc));
+#ifndef _NO_AT_FUNC
+            scan_thread_free(&thread_list[i]);
+#endif
             return rc;
         }
     }
@@ -1672,6 +2796,10 @@ void Robinhood_StopScanModule(void)
     /* terminate scan threads */
     for (i = 0; i < fs_scan_config.nb_threads_scan; i++) {
         thread_list[i].force_stop = true;
+#ifndef _NO_AT_FUNC
+        if (thread_list[i].prefetch)
+            prefetch_stop(thread_list[i].prefetch);
+#endif
     }
 
     DisplayLog(LVL_EVENT, FSSCAN_TAG,
@@ -1681,6 +2809,12 @@ void Robinhood_StopScanModule(void)
     if (!all_threads_idle())
         wait_scan_finished();
 
+#ifndef _NO_AT_FUNC
+    /* scan threads no longer use their prefetch helper */
+    for (i = 0; i < fs_scan_config.nb_threads_scan; i++)
+        prefetch_free(&thread_list[i]);
+#endif
+
     /* update scan status in db */
     if (running) {
         if (ListMgr_InitAccess(&lmgr) == DB_SUCCESS) {
@@ -1700,6 +2834,42 @@ void Robinhood_StopScanModule(void)
  * @param partial_root NULL for full scan; subdir path for partial scan
  * @retval EBUSY if a scan is already running.
  */
+/**
+ * Check if the previous scan of the same directories was interrupted
+ * and can be resumed.
+ * @param[out] start_time start time of the interrupted scan.
+ */
+static bool can_resume_scan(lmgr_t *lmgr, time_t *start_time)
+{
+    char value[MAX_VAR_LEN];
+    time_t prev_start;
+
+    if (ListMgr_GetVar(lmgr, LAST_SCAN_STATUS, value, sizeof(value))
+        != DB_SUCCESS)
+        return false;
+    if (strcmp(value, SCAN_STATUS_RUNNING)
+        && strcmp(value, SCAN_STATUS_ABORTED)
+        && strcmp(value, SCAN_STATUS_INCOMPLETE))
+        return false;
+
+    if (ListMgr_GetVar(lmgr, LAST_SCAN_ROOT, value, sizeof(value))
+        != DB_SUCCESS || strcmp(value, scan_roots_str))
+        return false;
+
+    if (ListMgr_GetVar(lmgr, LAST_SCAN_START_TIME, value, sizeof(value))
+        != DB_SUCCESS)
+        return false;
+    prev_start = strtoul(value, NULL, 10);
+
+    /* don't resume an outdated scan */
+    if (prev_start == 0
+        || time(NULL) - prev_start > fs_scan_config.max_scan_interval)
+        return false;
+
+    *start_time = prev_start;
+    return true;
+}
+
 static int StartScan(void)
 {
     robinhood_task_t *p_parent_task;
@@ -1718,8 +2888,7 @@ static int StartScan(void)
         V(lock_scan);
         DisplayLog(LVL_MAJOR, FSSCAN_TAG,
                    "An scan is already running on %s",
-                   partial_scan_root ? partial_scan_root : global_config.
-                   fs_path);
+                   scan_roots_str);
         return EBUSY;
     }
 
@@ -1730,29 +2899,38 @@ static int StartScan(void)
         V(lock_scan);
         DisplayLog(LVL_CRIT, FSSCAN_TAG,
                    "ERROR creating scan task for %s",
-                   partial_scan_root ? partial_scan_root : global_config.
-                   fs_path);
+                   scan_roots_str);
         return -1;
     }
 
-    if (partial_scan_root) {
-        /* check that partial_root is under FS root */
-        if (strncmp(global_config.fs_path, partial_scan_root,
-                    strlen(global_config.fs_path))) {
-            V(lock_scan);
-            DisplayLog(LVL_CRIT, FSSCAN_TAG,
-                       "ERROR scan root %s is not under fs root %s",
-                       partial_scan_root, global_config.fs_path);
-            return -1;
-        }
-        p_parent_task->partial_scan_root = partial_scan_root;
-    }
+    /* scan roots have been checked in FSScan_Start().
+     * With several roots, the root task pushes one task per directory. */
+    if (partial_scan_count == 1)
+        p_parent_task->partial_scan_root = partial_scan_roots[0];
 
     /* always start at the root to get info about parent dirs */
     strcpy(p_parent_task->path, global_config.fs_path);
     p_parent_task->depth = 0;
     p_parent_task->task_finished = false;
 
+    /* incremental scan needs reliable directory times */
+    incr_scan = fsscan_incr;
+#if defined(_LUSTRE) && defined(_MDS_STAT_SUPPORT)
+    if (incr_scan && is_lustre_fs && global_config.direct_mds_stat) {
+        DisplayLog(LVL_MAJOR, FSSCAN_TAG, "Incremental scan is not "
+                   "compatible with direct_mds_stat: doing a full scan");
+        incr_scan = false;
+    }
+#endif
+    free_relisted_dirs();
+
+    /* the diff pipeline processes the whole DB at each GC operation */
+    shard_ckpt = fs_scan_config.resume_scan
+                 && (entry_proc_pipeline == std_pipeline);
+    scan_resumed = false;
+    memset(root_entries, 0, sizeof(root_entries));
+    memset(root_errors, 0, sizeof(root_errors));
+
     /* set the mother task, and remember start time */
     root_task = p_parent_task;
     scan_start_time = time(NULL);
@@ -1765,19 +2943,40 @@ static int StartScan(void)
     }
 
     if (!no_db) {
-        /* archive previous scan start/end time */
-        if (ListMgr_GetVar
-            (&lmgr, LAST_SCAN_START_TIME, timestamp,
-             sizeof(timestamp)) == DB_SUCCESS)
-            ListMgr_SetVar(&lmgr, PREV_SCAN_START_TIME, timestamp);
-        if (ListMgr_GetVar
-            (&lmgr, LAST_SCAN_END_TIME, timestamp,
-             sizeof(timestamp)) == DB_SUCCESS)
-            ListMgr_SetVar(&lmgr, PREV_SCAN_END_TIME, timestamp);
-
-        /* store current scan start time and status in db */
-        sprintf(timestamp, "%lu", (unsigned long)scan_start_time);
-        ListMgr_SetVar(&lmgr, LAST_SCAN_START_TIME, timestamp);
+        /* resume the previous scan of the same directories if it was
+         * interrupted: it keeps its start time */
+        if (shard_ckpt)
+            scan_resumed = can_resume_scan(&lmgr, &scan_start_time);
+
+        if (scan_resumed) {
+            struct tm start_tm;
+
+            strftime(timestamp, sizeof(timestamp), "%Y/%m/%d %T",
+                     localtime_r(&scan_start_time, &start_tm));
+            DisplayLog(LVL_EVENT, FSSCAN_TAG, "Resuming the interrupted scan of %s "
+                       "started at %s", scan_roots_str, timestamp);
+        } else {
+            /* archive previous scan start/end time */
+            if (ListMgr_GetVar
+                (&lmgr, LAST_SCAN_START_TIME, timestamp,
+                 sizeof(timestamp)) == DB_SUCCESS)
+                ListMgr_SetVar(&lmgr, PREV_SCAN_START_TIME, timestamp);
+            if (ListMgr_GetVar
+                (&lmgr, LAST_SCAN_END_TIME, timestamp,
+                 sizeof(timestamp)) == DB_SUCCESS)
+                ListMgr_SetVar(&lmgr, PREV_SCAN_END_TIME, timestamp);
+
+            /* store current scan start time and root in db */
+            sprintf(timestamp, "%lu", (unsigned long)scan_start_time);
+            ListMgr_SetVar(&lmgr, LAST_SCAN_START_TIME, timestamp);
+            ListMgr_SetVar(&lmgr, LAST_SCAN_ROOT, scan_roots_str);
+
+            /* drop checkpoints of previous scans */
+            ListMgr_ClearVars(&lmgr, SCAN_SHARD_PREFIX);
+        }
+
+        /* store current scan status in db */
+        sprintf(timestamp, "%lu", (unsigned long)time(NULL));
         ListMgr_SetVar(&lmgr, LAST_SCAN_LAST_ACTION_TIME, timestamp);
         ListMgr_SetVar(&lmgr, LAST_SCAN_STATUS, SCAN_STATUS_RUNNING);
         /* store the number of scanning threads */
@@ -1790,8 +2989,15 @@ static int StartScan(void)
 
         if ((rc == DB_SUCCESS) && (count == 0)) {
             is_first_scan = true;
+            incr_scan = false;
             DisplayLog(LVL_EVENT, FSSCAN_TAG,
                        "Notice: this is the first scan (DB is empty)");
+
+            /* Load the entries of the scan by large chunks, unless
+             * changelog records are processed meanwhile: they would be
+             * overwritten by the buffered entries of the scan. */
+            if (!(fsscan_flags & RUNFLG_NO_BULK_LOAD))
+                ListMgr_BulkLoadStart(&lmgr);
         } else if (rc)
             DisplayLog(LVL_MAJOR, FSSCAN_TAG,
                        "Failed to retrieve entry count from DB: error %d", rc);
@@ -1803,6 +3009,11 @@ static int StartScan(void)
         ListMgr_CloseAccess(&lmgr);
     }
 
+    /* the directories read before the scan was interrupted are unknown:
+     * fall back to a full GC */
+    if (scan_resumed && incr_scan)
+        relisted_overflow = true;
+
     /* reset threads stats */
     ResetScanStats(false);
 
@@ -1812,8 +3023,8 @@ static int StartScan(void)
     /* start batching alerts */
     Alert_StartBatching();
 
-    /* insert first task in stack */
-    InsertTask_to_Stack(&tasks_stack, p_parent_task);
+    /* insert first task in the shared queue */
+    InsertTask_to_Stack(&tasks_stack, p_parent_task, TASK_QUEUE_SHARED);
 
     /* indicates that a scan started in logs */
     FlushLogs();
@@ -1843,6 +3054,14 @@ static void *Thr_scan_recovery(void *arg_thread)
     }
 #endif
 
+    /* the DB connection of the terminated thread can't be trusted:
+     * close it, a new one is opened on demand */
+    scan_thread_db_close(p_info);
+
+    /* the task was interrupted: its shard is not complete */
+    if (p_info->current_task->shard != NULL)
+        p_info->current_task->shard->shard_failed = true;
+
     /* terminate and free current task */
     st = RecursiveTaskTermination(p_info, p_info->current_task, false);
     if (st) {
@@ -1975,8 +3194,7 @@ int Robinhood_CheckScanDeadlines(void)
 
         DisplayLog(LVL_MAJOR, FSSCAN_TAG,
                    "Starting scan of %s (current scan interval is %s)",
-                   partial_scan_root ? partial_scan_root : global_config.
-                   fs_path, tmp_buff);
+                   scan_roots_str, tmp_buff);
 
         st = StartScan();
 
@@ -1996,8 +3214,7 @@ int Robinhood_CheckScanDeadlines(void)
         /* retry a scan, if the last was incomplete */
 
         DisplayLog(LVL_MAJOR, FSSCAN_TAG, "Starting scan of %s",
-                   partial_scan_root ? partial_scan_root : global_config.
-                   fs_path);
+                   scan_roots_str);
 
         st = StartScan();
 
@@ -2125,6 +3342,8 @@ void Robinhood_StatsScan(robinhood_fsscan_stat_t *p_stats)
     p_stats->last_duration = last_duration;
     p_stats->scan_complete = last_scan_complete;
     p_stats->current_scan_interval = scan_interval;
+    p_stats->active_threads = throttle_enabled() ? active_scan_threads :
+                                  fs_scan_config.nb_threads_scan;
 
     if (root_task != NULL) {
         unsigned int i;
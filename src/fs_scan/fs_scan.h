@@ -28,7 +28,8 @@
 /* defined in fs_scan.c */
 extern fs_scan_config_t  fs_scan_config;
 extern run_flags_t       fsscan_flags;
-extern const char       *partial_scan_root;
+extern const char       *partial_scan_roots[MAX_SCAN_ROOTS];
+extern unsigned int       partial_scan_count;
 
 /* Audit module relative types */
 
@@ -52,6 +53,9 @@ typedef struct robinhood_fsscan_stat__ {
     double          avg_ms_per_entry;
     double          curr_ms_per_entry;
 
+    /* number of scan threads allowed to run (adaptive throttling) */
+    unsigned int    active_threads;
+
 } robinhood_fsscan_stat_t;
 
 /**
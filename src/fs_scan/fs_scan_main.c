@@ -62,25 +62,52 @@ static void *scan_starter(void *arg)
     return NULL;
 }
 
+/** check if path is dir or one of its sub-directories */
+static bool path_is_under(const char *path, const char *dir)
+{
+    size_t len = strlen(dir);
+
+    return !strncmp(path, dir, len) && (path[len] == '\0'
+                                        || path[len] == '/');
+}
+
 /** Start FS Scan info collector */
-int FSScan_Start(run_flags_t flags, const char *partial_root)
+int FSScan_Start(run_flags_t flags, const char **partial_roots,
+                 unsigned int root_count)
 {
-    int rc;
+    int rc, i, j;
 
     fsscan_flags = flags;
-    partial_scan_root = partial_root;
 
-    if (partial_root) {
+    if (root_count > MAX_SCAN_ROOTS) {
+        DisplayLog(LVL_CRIT, FSSCAN_TAG,
+                   "ERROR too many scan roots (max: %u)", MAX_SCAN_ROOTS);
+        return EINVAL;
+    }
+
+    for (i = 0; i < root_count; i++) {
         /* check that partial_root is under FS root */
         if (strncmp
-            (global_config.fs_path, partial_scan_root,
+            (global_config.fs_path, partial_roots[i],
              strlen(global_config.fs_path))) {
             DisplayLog(LVL_CRIT, FSSCAN_TAG,
                        "ERROR scan root %s is not under fs root %s",
-                       partial_scan_root, global_config.fs_path);
+                       partial_roots[i], global_config.fs_path);
             return EINVAL;
         }
+        /* scanned sub-trees must not overlap */
+        for (j = 0; j < i; j++) {
+            if (path_is_under(partial_roots[i], partial_roots[j])
+                || path_is_under(partial_roots[j], partial_roots[i])) {
+                DisplayLog(LVL_CRIT, FSSCAN_TAG,
+                           "ERROR scan roots %s and %s overlap",
+                           partial_roots[j], partial_roots[i]);
+                return EINVAL;
+            }
+        }
+        partial_scan_roots[i] = partial_roots[i];
     }
+    partial_scan_count = root_count;
 
     rc = Robinhood_InitScanModule();
     if (rc)
@@ -196,6 +223,12 @@ void FSScan_DumpStats(void)
         DisplayLog(LVL_MAJOR, "STATS", "     last action: %s (%s ago)",
                    tmp_buff, tmp_buff2);
 
+        if (fs_scan_config.target_latency_ms > 0)
+            DisplayLog(LVL_MAJOR, "STATS",
+                       "     active threads: %u/%u (target latency: %u ms)",
+                       stats.active_threads, fs_scan_config.nb_threads_scan,
+                       fs_scan_config.target_latency_ms);
+
         if (stats.scanned_entries) {
             double speed;
 
@@ -205,8 +238,7 @@ void FSScan_DumpStats(void)
 
             if (stats.curr_ms_per_entry > 0.0)
                 speed =
-                    (1000.0 / stats.curr_ms_per_entry) *
-                    fs_scan_config.nb_threads_scan;
+                    (1000.0 / stats.curr_ms_per_entry) * stats.active_threads;
             else
                 speed = 0.0;
 
@@ -235,6 +267,9 @@ void FSScan_DumpStats(void)
 #define FSSCAN_CONFIG_BLOCK  "FS_Scan"
 #define IGNORE_BLOCK  "Ignore"
 
+/* minimal size for readdir buffer */
+#define READDIR_BUFFER_MIN 4096
+
 #define MINUTE 60
 #define HOUR 3600
 #define DAY (24*HOUR)
@@ -254,10 +289,16 @@ static void fs_scan_cfg_set_default(void *module_config)
 #endif
     conf->scan_retry_delay = HOUR;
     conf->nb_threads_scan = 2;
+    conf->target_latency_ms = 0;
+    conf->min_threads_scan = 1;
     conf->scan_op_timeout = 0;
     conf->exit_on_timeout = false;
     conf->spooler_check_interval = MINUTE;
     conf->nb_prealloc_tasks = 256;
+    conf->readdir_buffer_size = 64 * 1024;
+    conf->stat_prefetch_window = 0;
+    conf->stat_dont_sync = false;
+    conf->resume_scan = true;
 
     conf->ignore_list = NULL;
     conf->ignore_count = 0;
@@ -277,10 +318,16 @@ static void fs_scan_cfg_write_default(FILE *output)
 #endif
     print_line(output, 1, "scan_retry_delay       :    1h");
     print_line(output, 1, "nb_threads_scan        :     2");
+    print_line(output, 1, "target_latency_ms      :     0 (disabled)");
+    print_line(output, 1, "min_threads_scan       :     1");
     print_line(output, 1, "scan_op_timeout        :     0 (disabled)");
     print_line(output, 1, "exit_on_timeout        :    no");
     print_line(output, 1, "spooler_check_interval :  1min");
     print_line(output, 1, "nb_prealloc_tasks      :   256");
+    print_line(output, 1, "readdir_buffer_size    :   64KB");
+    print_line(output, 1, "stat_prefetch_window   :     0 (disabled)");
+    print_line(output, 1, "stat_dont_sync         :    no");
+    print_line(output, 1, "resume_scan            :   yes");
     print_line(output, 1, "ignore                 :  NONE");
     print_line(output, 1, "dir_list               :  NONE");
     print_line(output, 1, "completion_command     :  NONE");
@@ -339,14 +386,20 @@ static int fs_scan_cfg_read(config_file_t config, void *module_config,
     static const char *fsscan_allowed[] = {
         "scan_interval", "min_scan_interval", "max_scan_interval",
         "scan_retry_delay", "nb_threads_scan", "scan_op_timeout",
+        "target_latency_ms", "min_threads_scan",
         "exit_on_timeout", "spooler_check_interval", "nb_prealloc_tasks",
-        "completion_command", "scan_only",
+        "completion_command", "scan_only", "readdir_buffer_size",
+        "stat_prefetch_window", "stat_dont_sync", "resume_scan",
         IGNORE_BLOCK, NULL
     };
 
     const cfg_param_t cfg_params[] = {
         {"nb_threads_scan", PT_INT, PFLG_POSITIVE | PFLG_NOT_NULL,
          &conf->nb_threads_scan, 0},
+        {"target_latency_ms", PT_INT, PFLG_POSITIVE,
+         &conf->target_latency_ms, 0},
+        {"min_threads_scan", PT_INT, PFLG_POSITIVE | PFLG_NOT_NULL,
+         &conf->min_threads_scan, 0},
         {"scan_retry_delay", PT_DURATION, PFLG_POSITIVE | PFLG_NOT_NULL,
          &conf->scan_retry_delay, 0},
         {"scan_op_timeout", PT_DURATION, PFLG_POSITIVE, &conf->scan_op_timeout,
@@ -356,6 +409,12 @@ static int fs_scan_cfg_read(config_file_t config, void *module_config,
          &conf->spooler_check_interval, 0},
         {"nb_prealloc_tasks", PT_INT, PFLG_POSITIVE | PFLG_NOT_NULL,
          &conf->nb_prealloc_tasks, 0},
+        {"readdir_buffer_size", PT_SIZE, PFLG_POSITIVE | PFLG_NOT_NULL,
+         &conf->readdir_buffer_size, 0},
+        {"stat_prefetch_window", PT_INT, PFLG_POSITIVE,
+         &conf->stat_prefetch_window, 0},
+        {"stat_dont_sync", PT_BOOL, 0, &conf->stat_dont_sync, 0},
+        {"resume_scan", PT_BOOL, 0, &conf->resume_scan, 0},
         /* completion command can contain wildcards: {cfg}, {fspath} ... */
         {"completion_command", PT_CMD, 0,
          &conf->completion_command, 0},
@@ -373,6 +432,20 @@ static int fs_scan_cfg_read(config_file_t config, void *module_config,
     if (rc)
         return rc;
 
+    if (conf->min_threads_scan > conf->nb_threads_scan) {
+        sprintf(msg_out, "Invalid value for '" FSSCAN_CONFIG_BLOCK
+                "::min_threads_scan': must not exceed nb_threads_scan (%u)",
+                conf->nb_threads_scan);
+        return EINVAL;
+    }
+
+    if (conf->readdir_buffer_size < READDIR_BUFFER_MIN) {
+        sprintf(msg_out, "Invalid value for '" FSSCAN_CONFIG_BLOCK
+                "::readdir_buffer_size': must be at least %u bytes",
+                READDIR_BUFFER_MIN);
+        return EINVAL;
+    }
+
     /* parameters with specific management */
     rc = GetDurationParam(fsscan_block, FSSCAN_CONFIG_BLOCK,
                           "min_scan_interval", PFLG_POSITIVE | PFLG_NOT_NULL,
@@ -568,6 +641,22 @@ static int fs_scan_cfg_reload(fs_scan_config_t *conf)
         fs_scan_config.exit_on_timeout = conf->exit_on_timeout;
     }
 
+    if (conf->stat_dont_sync != fs_scan_config.stat_dont_sync) {
+        DisplayLog(LVL_EVENT, "FS_Scan_Config",
+                   FSSCAN_CONFIG_BLOCK "::stat_dont_sync updated: %s->%s",
+                   bool2str(fs_scan_config.stat_dont_sync),
+                   bool2str(conf->stat_dont_sync));
+        fs_scan_config.stat_dont_sync = conf->stat_dont_sync;
+    }
+
+    if (conf->resume_scan != fs_scan_config.resume_scan) {
+        DisplayLog(LVL_EVENT, "FS_Scan_Config",
+                   FSSCAN_CONFIG_BLOCK "::resume_scan updated: %s->%s",
+                   bool2str(fs_scan_config.resume_scan),
+                   bool2str(conf->resume_scan));
+        fs_scan_config.resume_scan = conf->resume_scan;
+    }
+
     if (conf->spooler_check_interval != fs_scan_config.spooler_check_interval) {
         DisplayLog(LVL_EVENT, "FS_Scan_Config",
                    FSSCAN_CONFIG_BLOCK
@@ -577,6 +666,21 @@ static int fs_scan_cfg_reload(fs_scan_config_t *conf)
         fs_scan_config.spooler_check_interval = conf->spooler_check_interval;
     }
 
+    if (conf->target_latency_ms != fs_scan_config.target_latency_ms) {
+        DisplayLog(LVL_EVENT, "FS_Scan_Config",
+                   FSSCAN_CONFIG_BLOCK "::target_latency_ms updated: %u->%u",
+                   fs_scan_config.target_latency_ms, conf->target_latency_ms);
+        fs_scan_config.target_latency_ms = conf->target_latency_ms;
+    }
+
+    if (conf->min_threads_scan != fs_scan_config.min_threads_scan
+        && conf->min_threads_scan <= fs_scan_config.nb_threads_scan) {
+        DisplayLog(LVL_EVENT, "FS_Scan_Config",
+                   FSSCAN_CONFIG_BLOCK "::min_threads_scan updated: %u->%u",
+                   fs_scan_config.min_threads_scan, conf->min_threads_scan);
+        fs_scan_config.min_threads_scan = conf->min_threads_scan;
+    }
+
     if (compare_cmd
         (conf->completion_command, fs_scan_config.completion_command)) {
         DisplayLog(LVL_MAJOR, "FS_Scan_Config",
@@ -598,6 +702,16 @@ static int fs_scan_cfg_reload(fs_scan_config_t *conf)
                    FSSCAN_CONFIG_BLOCK
                    "::nb_prealloc_tasks changed in config file, but cannot be modified dynamically");
 
+    if (conf->readdir_buffer_size != fs_scan_config.readdir_buffer_size)
+        DisplayLog(LVL_MAJOR, "FS_Scan_Config",
+                   FSSCAN_CONFIG_BLOCK
+                   "::readdir_buffer_size changed in config file, but cannot be modified dynamically");
+
+    if (conf->stat_prefetch_window != fs_scan_config.stat_prefetch_window)
+        DisplayLog(LVL_MAJOR, "FS_Scan_Config",
+                   FSSCAN_CONFIG_BLOCK
+                   "::stat_prefetch_window changed in config file, but cannot be modified dynamically");
+
     /* compare ignore list */
     update_ignore(fs_scan_config.ignore_list, fs_scan_config.ignore_count,
                   conf->ignore_list, conf->ignore_count, FSSCAN_CONFIG_BLOCK);
@@ -642,6 +756,13 @@ static void fs_scan_cfg_write_template(FILE *output)
     print_line(output, 1,
                "# number of threads used for scanning the filesystem");
     print_line(output, 1, "nb_threads_scan        =     2 ;");
+    print_line(output, 1,
+               "# adapt the number of active scan threads to keep the 99th");
+    print_line(output, 1,
+               "# percentile of filesystem operation latency under this");
+    print_line(output, 1, "# target (0 to disable)");
+    print_line(output, 1, "#target_latency_ms     =    20 ;");
+    print_line(output, 1, "#min_threads_scan      =     1 ;");
     fprintf(output, "\n");
     print_line(output, 1,
                "# when a scan fails, this is the delay before retrying");
@@ -666,6 +787,25 @@ static void fs_scan_cfg_write_template(FILE *output)
     print_line(output, 1, "# Memory preallocation parameters");
     print_line(output, 1, "nb_prealloc_tasks      =   256 ;");
     fprintf(output, "\n");
+    print_line(output, 1,
+               "# size of the buffer for reading directory entries (per thread)");
+    print_line(output, 1, "readdir_buffer_size    =  64KB ;");
+    print_line(output, 1,
+               "# number of entries a helper thread can stat ahead of");
+    print_line(output, 1,
+               "# each scan thread (0 to disable)");
+    print_line(output, 1, "#stat_prefetch_window  =   256 ;");
+    print_line(output, 1,
+               "# don't request up-to-date attributes from the filesystem");
+    print_line(output, 1,
+               "# (may return cached size and times, if supported)");
+    print_line(output, 1, "#stat_dont_sync        =    no ;");
+    print_line(output, 1,
+               "# resume an interrupted scan, skipping the top-level");
+    print_line(output, 1,
+               "# directories that were completely scanned");
+    print_line(output, 1, "#resume_scan           =   yes ;");
+    fprintf(output, "\n");
     print_begin_block(output, 1, IGNORE_BLOCK, NULL);
     print_line(output, 2,
                "# ignore \".snapshot\" and \".snapdir\" directories (don't scan them)");
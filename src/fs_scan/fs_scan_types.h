@@ -45,6 +45,10 @@ typedef struct robinhood_task__ {
     /* metadatas of this directory */
     struct stat     dir_md;
 
+    /* incremental scan: the directory was modified in the same second
+     * it was stat'ed, so dir_md times can't be trusted for next scan */
+    bool            dir_md_unstable;
+
     /* parent task */
     struct robinhood_task__ *parent_task;
 
@@ -52,6 +56,14 @@ typedef struct robinhood_task__ {
      * or restricted scans */
     const char *partial_scan_root;
 
+    /* scan shard this task belongs to (the sub-tree of an entry
+     * of the scan root), NULL for the scan root and above */
+    struct robinhood_task__ *shard;
+
+    /* for shard tasks: an error occurred while scanning the shard,
+     * so it must not be checkpointed */
+    volatile bool shard_failed;
+
     /* lock for protecting the child list
      * and the task_finished boolean.
      */
@@ -88,12 +100,18 @@ typedef struct robinhood_task__ {
  */
 #define MAX_TASK_DEPTH  255
 
-/* A stack of tasks ordered by depth,
- * handled by 'task_stack_mngmt' routines.
+/* A queue of tasks ordered by depth, owned by a scan thread.
+ * The owner takes the deepest tasks (depth first scan), whereas
+ * other threads steal the shallowest ones (larger sub-trees).
  */
-typedef struct tasks_stack__ {
-    pthread_mutex_t     stack_lock; /* lock on the stack */
-    sem_t               sem_tasks;  /* token for available tasks */
+typedef struct task_deque__ {
+    pthread_mutex_t     deque_lock; /* lock on this queue */
+
+    /* number of tasks in the queue (read without lock by thieves) */
+    volatile unsigned int nb_tasks;
+
+    /* depth of the shallowest task (read without lock by thieves) */
+    volatile unsigned int min_task_depth;
 
     /* Indicates the depth for the first task available */
     unsigned int        max_task_depth;
@@ -101,6 +119,18 @@ typedef struct tasks_stack__ {
     /* list of tasks, ordered by depth */
     robinhood_task_t   *tasks_at_depth[MAX_TASK_DEPTH + 1];
 
+} task_deque_t;
+
+/* A stack of tasks ordered by depth, split into per-thread queues.
+ * handled by 'task_stack_mngmt' routines.
+ */
+typedef struct tasks_stack__ {
+    sem_t               sem_tasks;  /* token for available tasks */
+
+    /* one queue per scan thread + a shared queue (last one) */
+    unsigned int        nb_deques;
+    task_deque_t       *deques;
+
 } task_stack_t;
 
 #endif
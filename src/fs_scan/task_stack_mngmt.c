@@ -24,27 +24,102 @@
 #include "task_stack_mngmt.h"
 #include "rbh_logs.h"
 #include "rbh_misc.h"
+#include "Memory.h"
+
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+
+/* update min/max depth after the list at the given depth got empty */
+static void update_deque_depths(task_deque_t *p_deque)
+{
+    int index;
+
+    if (p_deque->nb_tasks == 0) {
+        p_deque->min_task_depth = 0;
+        p_deque->max_task_depth = 0;
+        return;
+    }
+
+    for (index = p_deque->max_task_depth; index >= 0; index--) {
+        if (p_deque->tasks_at_depth[index] != NULL) {
+            p_deque->max_task_depth = index;
+            break;
+        }
+    }
+
+    for (index = p_deque->min_task_depth; index <= MAX_TASK_DEPTH; index++) {
+        if (p_deque->tasks_at_depth[index] != NULL) {
+            p_deque->min_task_depth = index;
+            break;
+        }
+    }
+}
+
+/* take a task from the given depth of a queue (queue must be locked) */
+static robinhood_task_t *deque_take(task_deque_t *p_deque, unsigned int depth)
+{
+    robinhood_task_t *p_task = p_deque->tasks_at_depth[depth];
+
+    if (p_task == NULL)
+        return NULL;
+
+    /* update the list for this depth */
+    p_deque->tasks_at_depth[depth] = p_task->next_task;
+    p_deque->nb_tasks--;
+
+    /* if the list at current depth is empty, we need to
+     * update min and max depths.
+     */
+    if (p_task->next_task == NULL)
+        update_deque_depths(p_deque);
+
+    return p_task;
+}
+
+/* map a thread index to a queue index */
+static inline unsigned int deque_index(task_stack_t *p_stack,
+                                       unsigned int thr_index)
+{
+    /* last queue is the shared one */
+    if (thr_index >= p_stack->nb_deques - 1)
+        return p_stack->nb_deques - 1;
+    return thr_index;
+}
 
 /* Initialize a stack of tasks */
-int InitTaskStack(task_stack_t *p_stack)
+int InitTaskStack(task_stack_t *p_stack, unsigned int nb_threads)
 {
-    unsigned int index;
+    unsigned int i;
     int rc;
 
+    /* one queue per thread + one shared queue */
+    p_stack->nb_deques = nb_threads + 1;
+    p_stack->deques = MemCalloc(p_stack->nb_deques, sizeof(task_deque_t));
+    if (p_stack->deques == NULL)
+        return ENOMEM;
+
     /* initialize each level of the priority stack */
-    for (index = 0; index <= MAX_TASK_DEPTH; index++) {
-        p_stack->tasks_at_depth[index] = NULL;
-    }
+    for (i = 0; i < p_stack->nb_deques; i++) {
+        task_deque_t *p_deque = &p_stack->deques[i];
 
-    /* no task waiting for now */
-    p_stack->max_task_depth = 0;
+        memset(p_deque->tasks_at_depth, 0, sizeof(p_deque->tasks_at_depth));
 
-    /* initialize the lock and the semaphore for accessing the list */
-    pthread_mutex_init(&p_stack->stack_lock, NULL);
+        /* no task waiting for now */
+        p_deque->nb_tasks = 0;
+        p_deque->min_task_depth = 0;
+        p_deque->max_task_depth = 0;
+
+        /* initialize the lock for accessing the list */
+        pthread_mutex_init(&p_deque->deque_lock, NULL);
+    }
 
     /* initially, no task available: sem=0 */
     if ((rc = sem_init(&p_stack->sem_tasks, 0, 0))) {
-        pthread_mutex_destroy(&p_stack->stack_lock);
+        for (i = 0; i < p_stack->nb_deques; i++)
+            pthread_mutex_destroy(&p_stack->deques[i].deque_lock);
+        MemFree(p_stack->deques);
+        p_stack->deques = NULL;
         DisplayLog(LVL_CRIT, FSSCAN_TAG, "ERROR initializing semaphore");
         return rc;
     }
@@ -54,75 +129,123 @@ int InitTaskStack(task_stack_t *p_stack)
 }
 
 /* insert a task in the stack */
-void InsertTask_to_Stack(task_stack_t *p_stack, robinhood_task_t *p_task)
+void InsertTask_to_Stack(task_stack_t *p_stack, robinhood_task_t *p_task,
+                         unsigned int thr_index)
 {
+    task_deque_t *p_deque = &p_stack->deques[deque_index(p_stack, thr_index)];
     unsigned int prof = p_task->depth;
 
     /* don't distinguish priorities over a given depth */
     if (prof > MAX_TASK_DEPTH)
         prof = MAX_TASK_DEPTH;
 
-    /* take the lock on stack */
-    P(p_stack->stack_lock);
+    /* take the lock on the thread queue */
+    P(p_deque->deque_lock);
 
     /* insert the task at the good depth */
-    p_task->next_task = p_stack->tasks_at_depth[prof];
-    p_stack->tasks_at_depth[prof] = p_task;
-
-    /* update max_task_depth, if needed */
-    if (prof > p_stack->max_task_depth)
-        p_stack->max_task_depth = prof;
+    p_task->next_task = p_deque->tasks_at_depth[prof];
+    p_deque->tasks_at_depth[prof] = p_task;
+
+    /* update min and max depths, if needed */
+    if (p_deque->nb_tasks == 0) {
+        p_deque->min_task_depth = prof;
+        p_deque->max_task_depth = prof;
+    } else {
+        if (prof > p_deque->max_task_depth)
+            p_deque->max_task_depth = prof;
+        if (prof < p_deque->min_task_depth)
+            p_deque->min_task_depth = prof;
+    }
+    p_deque->nb_tasks++;
 
-    /* release the stack lock */
-    V(p_stack->stack_lock);
+    /* release the queue lock */
+    V(p_deque->deque_lock);
 
     /* unblock waiting worker threads */
     sem_post_safe(&p_stack->sem_tasks);
 
 }
 
-/* take a task (blocking until there is a task in the stack) */
-robinhood_task_t *GetTask_from_Stack(task_stack_t *p_stack)
+/* Steal the shallowest task available in other threads queues.
+ * Shallow directories are likely to have the largest sub-trees,
+ * so the thief gets enough work for a while. */
+static robinhood_task_t *steal_task(task_stack_t *p_stack, unsigned int own)
 {
-    robinhood_task_t *p_task;
-    int index;
+    robinhood_task_t *p_task = NULL;
+    unsigned int i, victim, best_depth;
+    int best;
+
+    /* Look for the queue with the shallowest task (without locking:
+     * this is only a hint, checked again once the queue is locked). */
+    best = -1;
+    best_depth = MAX_TASK_DEPTH + 1;
+    for (i = 1; i <= p_stack->nb_deques; i++) {
+        /* start from the next queue, to spread thieves over victims */
+        victim = (own + i) % p_stack->nb_deques;
+        if (victim == own || p_stack->deques[victim].nb_tasks == 0)
+            continue;
+
+        if (p_stack->deques[victim].min_task_depth < best_depth) {
+            best = victim;
+            best_depth = p_stack->deques[victim].min_task_depth;
+        }
+    }
 
-    /* wait for a task */
-    sem_wait_safe(&p_stack->sem_tasks);
+    if (best == -1)
+        return NULL;
 
-    /* lock the stack */
-    P(p_stack->stack_lock);
+    P(p_stack->deques[best].deque_lock);
+    if (p_stack->deques[best].nb_tasks > 0)
+        p_task = deque_take(&p_stack->deques[best],
+                            p_stack->deques[best].min_task_depth);
+    V(p_stack->deques[best].deque_lock);
 
-    /* The scan is a 'depth first' scan: directly go to the highest depth. */
-    p_task = p_stack->tasks_at_depth[p_stack->max_task_depth];
+    if (p_task != NULL)
+        DisplayLog(LVL_FULL, FSSCAN_TAG,
+                   "Queue #%u stole task %s (depth %u) from queue #%d",
+                   own, p_task->path, p_task->depth, best);
 
-    /* sanity check */
-    if (p_task == NULL) {
-        V(p_stack->stack_lock);
-        DisplayLog(LVL_CRIT, FSSCAN_TAG, "UNEXPECTED ERROR: NO TASK FOUND");
-        return NULL;
-    }
+    return p_task;
+}
 
-    /* update the list for this depth */
-    p_stack->tasks_at_depth[p_stack->max_task_depth] = p_task->next_task;
+/* take a task (blocking until there is a task in the stack) */
+robinhood_task_t *GetTask_from_Stack(task_stack_t *p_stack,
+                                     unsigned int thr_index)
+{
+    unsigned int own = deque_index(p_stack, thr_index);
+    task_deque_t *p_deque = &p_stack->deques[own];
+    robinhood_task_t *p_task = NULL;
+    unsigned int retry = 0;
 
-    /* if the list at current depth is empty, we need to
-     * update max_task_depth.
-     */
-    if (p_task->next_task == NULL) {
-        for (index = p_stack->max_task_depth; index >= 0; index--) {
-            if (p_stack->tasks_at_depth[index] != NULL) {
-                p_stack->max_task_depth = index;
-                break;
-            }
+    /* wait for a task: each token matches a task already inserted
+     * in one of the queues */
+    sem_wait_safe(&p_stack->sem_tasks);
+
+    do {
+        /* The scan is a 'depth first' scan: directly go to the highest
+         * depth of the thread's own queue. */
+        if (p_deque->nb_tasks > 0) {
+            P(p_deque->deque_lock);
+            if (p_deque->nb_tasks > 0)
+                p_task = deque_take(p_deque, p_deque->max_task_depth);
+            V(p_deque->deque_lock);
         }
-        /* no item found */
-        if (index < 0)
-            p_stack->max_task_depth = 0;
-    }
 
-    /* unlock the stack */
-    V(p_stack->stack_lock);
+        /* else, steal a task from another thread */
+        if (p_task == NULL)
+            p_task = steal_task(p_stack, own);
+
+        /* A task is guaranteed to exist as we got a token, but another
+         * thread may have taken the one we saw: retry. */
+        if (p_task == NULL) {
+            retry++;
+            /* sanity check */
+            if (retry == 1000000)
+                DisplayLog(LVL_CRIT, FSSCAN_TAG,
+                           "UNEXPECTED ERROR: NO TASK FOUND");
+            sched_yield();
+        }
+    } while (p_task == NULL);
 
     /* returns pointer to the task */
     return p_task;
@@ -21,13 +21,20 @@
 
 #include "fs_scan_types.h"
 
-/* initialize a task stack */
-int InitTaskStack(task_stack_t *p_stack);
+/* index of the shared queue, for tasks not pushed by a scan thread */
+#define TASK_QUEUE_SHARED ((unsigned int)-1)
 
-/* insert a task in the stack */
-void InsertTask_to_Stack(task_stack_t *p_stack, robinhood_task_t *p_task);
+/* initialize a task stack with one queue per scan thread */
+int InitTaskStack(task_stack_t *p_stack, unsigned int nb_threads);
 
-/* take a task in the stack (block until there is a task available) */
-robinhood_task_t *GetTask_from_Stack(task_stack_t *p_stack);
+/* insert a task in the queue of the given thread */
+void InsertTask_to_Stack(task_stack_t *p_stack, robinhood_task_t *p_task,
+                         unsigned int thr_index);
+
+/* take a task in the stack (block until there is a task available).
+ * Take it from the thread's own queue first, else steal one from
+ * another queue. */
+robinhood_task_t *GetTask_from_Stack(task_stack_t *p_stack,
+                                     unsigned int thr_index);
 
 #endif
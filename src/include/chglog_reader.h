@@ -46,6 +46,8 @@ typedef struct chglog_reader_config_t {
 
     /* nbr of changelog records to be agregated for llapi_changelog_clear() */
     int batch_ack_count;
+    /* max delay between two llapi_changelog_clear() calls */
+    time_t batch_ack_delay;
 
     bool force_polling;
     time_t polling_interval;
@@ -53,6 +55,30 @@ typedef struct chglog_reader_config_t {
     /* Maximum number of operations to keep in the internal queue. */
     int queue_max_size;
 
+    /* Number of threads decoding and filtering records of each MDT. */
+    int decoder_threads;
+
+    /* Directory where records are spilled when the pipeline is stuck
+     * (e.g. DB outage). Empty: never spill records. */
+    char spill_dir[RBH_PATH_MAX];
+    /* Maximum size of the spill file of each MDT */
+    ull_t spill_max_size;
+    /* Start spilling records when the pipeline is full and no record
+     * has been committed to the DB for this delay. */
+    time_t spill_delay;
+
+    /* Save records read from the changelogs to <capture_file>.<mdt_name> */
+    char capture_file[RBH_PATH_MAX];
+    /* Read records from <replay_file>.<mdt_name> (previously captured)
+     * instead of MDT changelogs. */
+    char replay_file[RBH_PATH_MAX];
+    /* Replay records at the speed they were recorded (else max speed) */
+    bool replay_realtime;
+
+    /* Fold related records of an entry while they are in the internal
+     * queue (attribute changes, create/unlink and rename sequences). */
+    bool fold_records;
+
     /* Age of the opration we keep in the internal queue before we
      * push them to thepipeline. */
     time_t queue_max_age;
@@ -36,6 +36,26 @@
 typedef MYSQL       db_conn_t;
 typedef MYSQL_RES  *result_handle_t;
 
+/** max number of parameters of a prepared statement */
+#define DB_MAX_STMT_PARAMS 65535
+
+/** prepared statement, with its parameter and result bindings */
+typedef struct db_stmt_t {
+    MYSQL_STMT     *stmt;
+    char           *query;
+    unsigned int    nb_params;
+    MYSQL_BIND     *params;
+    unsigned long  *param_len;
+    unsigned int    nb_fields;
+    MYSQL_BIND     *fields;
+    char          **field_buf;
+    unsigned long  *field_size;
+    unsigned long  *field_len;
+    my_bool        *field_null;
+    /** integer fields are bound to field_num */
+    long long      *field_num;
+} db_stmt_t;
+
 /** specific database configuration */
 typedef struct db_config_t {
     char server[256];
@@ -46,6 +66,8 @@ typedef struct db_config_t {
     char socket[RBH_PATH_MAX];
     char engine[1024];
     char tokudb_compression[50];
+    /** read-only replicas (comma-separated list of host[:port]) */
+    char read_servers[1024];
 } db_config_t;
 
 #elif defined(_SQLITE)
@@ -56,6 +78,10 @@ typedef struct db_config_t {
 
 typedef sqlite3 *db_conn_t;
 
+/** max number of parameters of a prepared statement
+ * (SQLITE_MAX_VARIABLE_NUMBER default) */
+#define DB_MAX_STMT_PARAMS 999
+
 typedef struct result_handle_t {
     char            **result_array;
     unsigned int      curr_row;
@@ -63,9 +89,17 @@ typedef struct result_handle_t {
     int               nb_cols;
 } result_handle_t;
 
+typedef struct db_stmt_t {
+    sqlite3_stmt     *stmt;
+    char             *query;
+    unsigned int      nb_params;
+} db_stmt_t;
+
 typedef struct db_config_t {
     char         filepath[RBH_PATH_MAX];
     unsigned int retry_delay_microsec;  /* retry time when busy */
+    char         journal_mode[32];  /* empty: keep the mode of the DB */
+    unsigned long long mmap_size;   /* 0: no memory-mapped I/O */
 } db_config_t;
 
 #else
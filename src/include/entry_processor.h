@@ -156,6 +156,9 @@ typedef struct entry_proc_op_t {
     /* for pipeline flush: indicate if not seen paths must be cleaned
      * (preserve entries). Used for partial scans. */
     unsigned int    gc_names:1;
+    /* for pipeline flush: only clean the content of directories
+     * in gc_dirs. Used for incremental scans. */
+    unsigned int    gc_dirs_only:1;
 
     operation_type_e db_op_type;
     callback_func_t callback_func;
@@ -176,6 +179,10 @@ typedef struct entry_proc_op_t {
     /* true if the striping in DB is up-to-date (do not require a DB update)*/
     bool            db_stripe_ok;
 
+    /* directories to be cleaned if gc_dirs_only is set */
+    wagon_t        *gc_dirs;
+    unsigned int    gc_dir_count;
+
     op_extra_info_t extra_info;
     free_func_t     extra_info_free_func;
 
@@ -196,6 +203,9 @@ typedef struct entry_proc_op_t {
      */
     struct rh_list_head name_hash_list;
 
+    /* chaining in the pools of free operations */
+    struct entry_proc_op_t *next_free;
+
 } entry_proc_op_t;
 
 /* test attribute from filesystem, or else from DB */
@@ -241,6 +251,18 @@ int EntryProcessor_Terminate(bool flush_ops);
  */
 void EntryProcessor_Push(entry_proc_op_t *p_entry);
 
+/**
+ * Same as EntryProcessor_Push(), but never blocks.
+ * \retval EAGAIN if max_pending_operations are already being processed
+ *         (the operation is not pushed).
+ */
+int EntryProcessor_TryPush(entry_proc_op_t *p_entry);
+
+/**
+ * Indicate if the pipeline is full (max_pending_operations reached).
+ */
+bool EntryProcessor_Saturated(void);
+
 /**
  * Advise that the entry is ready for next step of the pipeline.
  * @param next_stage The next stage to be performed for this entry
@@ -254,6 +276,14 @@ int EntryProcessor_Acknowledge(entry_proc_op_t *p_op,
 int EntryProcessor_AcknowledgeBatch(entry_proc_op_t **p_op, unsigned int count,
                                     unsigned int next_stage, bool remove);
 
+/**
+ * Acknowledge a batch of operations that go to different stages.
+ * @param next_stages next stage of each operation. A negative value
+ *        means the operation must be removed from the pipeline.
+ */
+int EntryProcessor_AcknowledgeEach(entry_proc_op_t **p_op, unsigned int count,
+                                   const int *next_stages);
+
 /**
  * Set entry id.
  */
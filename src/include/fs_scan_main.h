@@ -29,8 +29,16 @@
 #include "policy_rules.h"
 #include <stdbool.h>
 
-/** start scanning module */
-int FSScan_Start(run_flags_t flags, const char *partial_root);
+/** max number of directories for a partial scan */
+#define MAX_SCAN_ROOTS 16
+
+/** start scanning module
+ * @param partial_roots list of directories to be scanned,
+ *        NULL for a full scan.
+ * @param root_count number of directories in partial_roots.
+ */
+int FSScan_Start(run_flags_t flags, const char **partial_roots,
+                 unsigned int root_count);
 
 /** terminate scanning module */
 void FSScan_Terminate(void);
@@ -63,6 +71,27 @@ typedef struct fs_scan_config_t {
     /** memory management */
     unsigned        nb_prealloc_tasks;
 
+    /** size of the buffer for reading directory entries */
+    unsigned long long readdir_buffer_size;
+
+    /** max number of entries to be stat'ed ahead by a helper thread
+     * (0 = no prefetch) */
+    unsigned int    stat_prefetch_window;
+
+    /** don't force the filesystem to synchronize attributes with
+     * the server when getting entry attributes (statx AT_STATX_DONT_SYNC) */
+    bool            stat_dont_sync;
+
+    /** adaptive throttling: target for the 99th percentile of filesystem
+     * operation latency, in milliseconds (0 = disabled) */
+    unsigned int    target_latency_ms;
+    /** min number of active scan threads when throttling */
+    unsigned int    min_threads_scan;
+
+    /** if a scan was interrupted, resume it by skipping the sub-trees
+     * (shards) of the scan root that were completely scanned */
+    bool            resume_scan;
+
     /** ignore list (bool expr) */
     whitelist_item_t *ignore_list;
     unsigned int    ignore_count;
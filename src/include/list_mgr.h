@@ -194,6 +194,19 @@ typedef struct lmgr_t {
     /* operation statistics */
     unsigned int    nbop[OPCOUNT];
 
+    /* prepared statements of this connection, indexed by query */
+    GHashTable     *stmt_cache;
+
+    /* accounting changes of the current transaction (acct_aggregate) */
+    GHashTable     *acct_pending;
+
+    /* path cache invalidations of the current transaction */
+    GPtrArray      *path_inval;
+    bool            path_clear;
+
+    /* read-only connection to a replica */
+    bool            replica;
+
 } lmgr_t;
 
 /** List manager configuration */
@@ -206,6 +219,34 @@ typedef struct lmgr_config_t {
 
     /** enable accounting */
     bool            acct;
+    /** maintain accounting info in the daemon instead of DB triggers */
+    bool            acct_aggregate;
+    /** interval for flushing aggregated accounting info to the DB */
+    time_t          acct_flush_interval;
+
+    /** load the entries of the first scan into the DB by large chunks */
+    bool            initial_load;
+    /** directory of the files to be loaded */
+    char            initial_load_dir[RBH_PATH_MAX];
+    /** size of the files to be loaded */
+    unsigned long long initial_load_chunk;
+
+    /** max number of directories in the path cache (0 to disable it) */
+    unsigned int    path_cache_size;
+    /** max age of cached directories (changes done by other processes) */
+    time_t          path_cache_ttl;
+
+    /** number of entries read by each request of an iterator
+     * (0 to read all entries in a single request) */
+    unsigned int    iterator_page_size;
+
+    /** file of the report snapshot (empty to disable it) */
+    char            snapshot_file[RBH_PATH_MAX];
+    /** interval between snapshot exports */
+    time_t          snapshot_interval;
+
+    /** create the indexes recommended for policies */
+    bool            policy_indexes;
 } lmgr_config_t;
 
 /** config handlers */
@@ -240,10 +281,17 @@ typedef struct lmgr_iter_opt_t {
     unsigned int force_no_acct:1;   /* don't use acct table for reports */
     unsigned int allow_no_attr:1;   /* allow returning entries if no attr is
                                        available */
+    unsigned int force_primary:1;   /* don't send the request to a read
+                                       replica */
+    unsigned int allow_snapshot:1;  /* build reports from the report
+                                       snapshot, if possible */
+    unsigned int explain:1;         /* log the execution plan of the
+                                       request */
 } lmgr_iter_opt_t;
 
 #define LMGR_ITER_OPT_INIT {.list_count_max = 0, .force_no_acct = 0, \
-                            .allow_no_attr = 0}
+                            .allow_no_attr = 0, .force_primary = 0, \
+                            .allow_snapshot = 0, .explain = 0}
 
 typedef struct attr_mask {
     uint32_t std;     /**< standard attribute mask */
@@ -655,6 +703,16 @@ void free_stripe_items(stripe_items_t *p_stripe_items);
  */
 int ListMgr_Get(lmgr_t *p_mgr, const entry_id_t *p_id, attr_set_t *p_info);
 
+/**
+ * Retrieves a batch of entries from database, with a single request
+ * for main, annex and names tables.
+ * All entries must have the same attr mask.
+ * @param[out] rcs per-entry status (DB_SUCCESS or DB_NOT_EXISTS).
+ * @return a global error code.
+ */
+int ListMgr_BatchGet(lmgr_t *p_mgr, entry_id_t **p_ids, attr_set_t **p_attrs,
+                     unsigned int count, int *rcs);
+
 /**
  * Retrieve the FID from the database given the parent FID and the
  * file name.
@@ -680,6 +738,32 @@ int ListMgr_BatchInsert(lmgr_t *p_mgr, entry_id_t **p_ids,
                         attr_set_t **p_attrs, unsigned int count,
                         bool update_if_exists);
 
+/**
+ * Start loading the entries of a first scan by large chunks
+ * (if initial_load is enabled). Secondary indexes and accounting
+ * triggers are dropped until ListMgr_BulkLoadEnd() is called.
+ * Entries must not be modified by other means (e.g. changelog records)
+ * until the load ends.
+ */
+int ListMgr_BulkLoadStart(lmgr_t *p_mgr);
+
+/** Indicate if an initial load is running. */
+bool ListMgr_BulkLoadActive(void);
+
+/**
+ * Insert (or replace) a batch of entries during the initial load.
+ * Entries are written to files that are loaded when they are big enough.
+ * Entries can have different attr masks.
+ */
+int ListMgr_BulkInsert(lmgr_t *p_mgr, entry_id_t **p_ids,
+                       attr_set_t **p_attrs, unsigned int count);
+
+/**
+ * Load the remaining entries, then build indexes and accounting info.
+ * @return an error if some entries of the load could not be inserted.
+ */
+int ListMgr_BulkLoadEnd(lmgr_t *p_mgr);
+
 /**
  * Modifies an existing entry in the database.
  */
@@ -701,6 +785,14 @@ typedef void (*rm_cb_func_t) (const entry_id_t *);
 int ListMgr_Remove(lmgr_t *p_mgr, const entry_id_t *p_id,
                    const attr_set_t *p_attr_set, bool last);
 
+/**
+ * Removes a batch of names from the database, with a single request per
+ * table. Remove the entries if last is true.
+ * The batch must not contain several names of the same entry.
+ */
+int ListMgr_BatchRemove(lmgr_t *p_mgr, entry_id_t **p_ids,
+                        attr_set_t **p_attrs, unsigned int count, bool last);
+
 /**
  * Removes all entries that match the specified filter.
  */
@@ -728,6 +820,15 @@ int ListMgr_Replace(lmgr_t *p_mgr, entry_id_t *old_id, attr_set_t *old_attrs,
 int ListMgr_SoftRemove(lmgr_t *p_mgr, const entry_id_t *p_id,
                        attr_set_t *p_old_attrs);
 
+/**
+ * Soft remove a batch of entries: insert them to the soft rm table and
+ * remove them from the main database in a single transaction, with
+ * multi-row requests.
+ * \param p_old_attrs contain rm_time
+ */
+int ListMgr_BatchSoftRemove(lmgr_t *p_mgr, entry_id_t **p_ids,
+                            attr_set_t **p_old_attrs, unsigned int count);
+
 /**
  * Soft remove a set of entries according to a filter.
  */
@@ -1016,6 +1117,24 @@ void ListMgr_CloseReport(struct lmgr_report_t *p_iter);
  */
 int ListMgr_EntryCount(lmgr_t *p_mgr, uint64_t *count);
 
+/**
+ * Export the attributes of all entries to the report snapshot file,
+ * if it is older than ListManager::snapshot_interval.
+ * @retval DB_NOT_SUPPORTED if no snapshot file is configured.
+ */
+int ListMgr_UpdateSnapshot(lmgr_t *p_mgr);
+
+/**
+ * Make sure there is an index on the given attributes of the main table.
+ * If it doesn't exist, it is built online (the table remains readable
+ * and writable), or only reported if ListManager::policy_indexes is
+ * disabled.
+ * @param reason what the index is needed for (for logging).
+ * @retval DB_NOT_SUPPORTED if an attribute is not in the main table.
+ */
+int ListMgr_EnsureIndex(lmgr_t *p_mgr, const unsigned int *attrs,
+                        unsigned int count, const char *reason);
+
 /**
  * Retrieve profile (on size, atime, mtime, ...)
  * (by status, by user, by group, ...)
@@ -1088,6 +1207,18 @@ void ListMgr_CloseProfile(struct lmgr_profile_t *p_iter);
 #define PREV_SCAN_START_TIME  "PrevScanStartTime"
 #define PREV_SCAN_END_TIME    "PrevScanEndTime"
 
+/* set while the initial load is running (indexes and accounting are not
+ * maintained) */
+#define INITIAL_LOAD_VAR      "InitialLoad"
+/* set while aggregated accounting info of a process may not be written to
+ * the DB (one variable per process: <ACCT_DELTAS_VAR>_<host>:<pid>) */
+#define ACCT_DELTAS_VAR       "AcctDeltas"
+
+/* root(s) of the last scan, to determine if it can be resumed */
+#define LAST_SCAN_ROOT        "LastScanRoot"
+/* scan shard checkpoints: <prefix><shard_dir_id> = scan start time */
+#define SCAN_SHARD_PREFIX     "ScanShard_"
+
 #define SCAN_STATUS_DONE       "done"
 #define SCAN_STATUS_RUNNING    "running"
 #define SCAN_STATUS_ABORTED    "aborted"
@@ -1132,6 +1263,11 @@ int ListMgr_GetVar(lmgr_t *p_mgr, const char *varname, char *value,
  */
 int ListMgr_SetVar(lmgr_t *p_mgr, const char *varname, const char *value);
 
+/**
+ *  Removes all variables whose name starts with the given prefix.
+ */
+int ListMgr_ClearVars(lmgr_t *p_mgr, const char *prefix);
+
 /** @} */
 
 /**
@@ -174,6 +174,13 @@ static inline char *rh_get_cl_cr_name(const struct changelog_rec *rec)
 
 #endif
 
+/** size of a changelog record, including its name(s) */
+static inline size_t rh_get_cl_rec_size(const CL_REC_TYPE *rec)
+{
+    return (size_t)(rh_get_cl_cr_name(rec) - (const char *)rec)
+        + rec->cr_namelen;
+}
+
 #endif /* HAVE_CHANGELOGS */
 
 #ifndef LOV_PATTERN_F_RELEASED
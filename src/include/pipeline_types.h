@@ -24,6 +24,10 @@
 typedef struct changelog_record {
     CL_REC_TYPE  *p_log_rec;
     char         *mdt;
+    /** order of the record in the changelog reader queues */
+    unsigned long long seq;
+    /** types of the records folded into this one (1 << cr_type) */
+    unsigned int  folded_types;
 } changelog_record_t;
 #endif
 
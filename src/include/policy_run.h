@@ -334,6 +334,8 @@ typedef struct policy_info_t {
     run_flags_t             flags;        /**< from policy_opt */
     bool                    aborted;      /**< abort status */
     bool                    stopping;     /**< current run is stopping */
+    bool                    plan_logged;  /**< execution plan of the candidate
+                                               request has been logged */
     volatile bool           waiting;      /**< a thread is already trying to
                                                join the trigger thread */
 } policy_info_t;
@@ -446,6 +448,23 @@ int policy_module_start(policy_info_t *policy, /* out */
                         policy_run_config_t *p_config, /* in */
                         const policy_opt_t *options);  /* in */
 int policy_module_stop(policy_info_t *policy);
+
+/**
+ * Add the DB indexes needed to select the candidates of a policy to the
+ * list of indexes to be created. An index needed by several policies is
+ * only created once.
+ */
+void policy_indexes_add(const policy_descr_t *descr,
+                        const policy_run_config_t *config,
+                        const policy_opt_t *options);
+/**
+ * Start a thread that creates the missing indexes of the list, so that
+ * policy triggers are not delayed by index creation.
+ */
+int policy_indexes_start(void);
+/** wait for the end of index creation */
+void policy_indexes_wait(void);
+
 int policy_module_wait(policy_info_t *policy);
 void policy_module_dump_stats(policy_info_t *policy);
 
@@ -93,6 +93,10 @@ typedef enum run_flags {
     RUNFLG_NO_GC        = (1 << 5),  /* don't clean orphan entries after scan */
     RUNFLG_FORCE_RUN    = (1 << 6),  /* force running policy even if no scan was
                                         complete */
+    RUNFLG_INCR_SCAN    = (1 << 7),  /* only list directories modified since
+                                        last scan */
+    RUNFLG_NO_BULK_LOAD = (1 << 8),  /* changelogs are processed during the
+                                        scan: no initial load */
 } run_flags_t;
 
 /* Config module masks:
@@ -149,6 +149,49 @@ void TestLockFile(time_t *p_last_action);
 void stat2rbh_attrs(const struct stat *p_inode, attr_set_t *p_attr_set,
                     bool size_info);
 
+#ifndef HAVE_STATX
+/* statx fields, for building masks on systems without statx */
+#define STATX_TYPE          0x00000001U
+#define STATX_MODE          0x00000002U
+#define STATX_NLINK         0x00000004U
+#define STATX_UID           0x00000008U
+#define STATX_GID           0x00000010U
+#define STATX_ATIME         0x00000020U
+#define STATX_MTIME         0x00000040U
+#define STATX_CTIME         0x00000080U
+#define STATX_INO           0x00000100U
+#define STATX_SIZE          0x00000200U
+#define STATX_BLOCKS        0x00000400U
+#define STATX_BASIC_STATS   0x000007ffU
+#endif
+
+/**
+ * Convert a robinhood attribute mask to the mask of statx fields
+ * needed to get these attributes.
+ */
+unsigned int attr_mask2statx(const attr_mask_t *mask);
+
+/**
+ * Get entry attributes (without following symlinks) using statx, so only
+ * the requested fields are retrieved. Falls back to fstatat
+ * if statx is not supported.
+ * Type, inode and device id are always retrieved.
+ * @param dirfd     directory fd for relative paths (or AT_FDCWD).
+ * @param stx_mask  requested statx fields.
+ * @param dont_sync allow using cached attributes (AT_STATX_DONT_SYNC).
+ * @param stx_got   set to the fields actually retrieved.
+ * @return 0 on success, -errno on error.
+ */
+int rbh_statx(int dirfd, const char *path, unsigned int stx_mask,
+              bool dont_sync, struct stat *p_inode, unsigned int *stx_got);
+
+/**
+ * Convert the fields of a POSIX attribute structure that are set in
+ * stx_mask to a robinhood attribute set.
+ */
+void statx2rbh_attrs(const struct stat *p_inode, attr_set_t *p_attr_set,
+                     unsigned int stx_mask);
+
 /**
  * Convert a robinhood attribute set to a posix struct stat.
  */
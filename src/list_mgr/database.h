@@ -62,9 +62,20 @@ extern lmgr_config_t lmgr_config;
 /* create client connection */
 int            db_connect( db_conn_t * conn );
 
+#ifdef _MYSQL
+/* create client connection to a read-only replica of the database */
+int            db_connect_replica( db_conn_t * conn, const char *server,
+                                   unsigned int port );
+#endif
+
 /* close connection */
 int            db_close_conn( db_conn_t * conn );
 
+/* init/release client resources of a thread that uses a connection
+ * created by another thread */
+void           db_thread_init( void );
+void           db_thread_end( void );
+
 
 /* -------------------- SQL queries/result management ---------------- */
 
@@ -86,6 +97,46 @@ int            db_result_nb_records( db_conn_t * conn, result_handle_t * p_resul
 /* free result resources */
 int            db_result_free( db_conn_t * conn, result_handle_t * p_result );
 
+/* -------------------- prepared statements ---------------- */
+
+/** value of a statement parameter or result field */
+typedef struct db_field_value {
+    bool          is_null;
+    /** integer value, sent or read in binary form (else: str) */
+    bool          is_num;
+    bool          is_unsigned;
+    long long     num;
+    char         *str;
+} db_field_value_t;
+
+/* prepare a statement, with '?' placeholders for its parameters */
+int            db_stmt_prepare(db_conn_t *conn, const char *query,
+                               db_stmt_t **p_stmt);
+
+/* execute a prepared statement with the given parameters.
+ * The result (if any) is read by db_stmt_next_record()
+ * or db_stmt_next_values(). */
+int            db_stmt_exec(db_conn_t *conn, db_stmt_t *stmt,
+                            const db_field_value_t *params,
+                            unsigned int nb_params);
+
+/* get the next record from a statement result.
+ * Returned strings are valid until the next call. */
+int            db_stmt_next_record(db_conn_t *conn, db_stmt_t *stmt,
+                                   char *outtab[], unsigned int outtabsize);
+
+/* get the next record from a statement result, integer fields being
+ * returned as numbers. Returned strings are valid until the next call. */
+int            db_stmt_next_values(db_conn_t *conn, db_stmt_t *stmt,
+                                   db_field_value_t *values,
+                                   unsigned int count);
+
+/* release the result of a statement, before executing it again */
+int            db_stmt_free_result(db_conn_t *conn, db_stmt_t *stmt);
+
+/* release a prepared statement */
+void           db_stmt_close(db_conn_t *conn, db_stmt_t *stmt);
+
 /* indicate if the error is retryable (transaction must be restarted) */
 bool db_is_retryable(int db_err);
 
@@ -115,10 +166,36 @@ int            db_drop_component( db_conn_t * conn, db_object_e obj_type, const
 int db_check_component(db_conn_t *conn, db_object_e obj_type, const char *name, const char *arg);
 
 
+/**
+ * Take a named lock, held until the connection is closed.
+ * \retval DB_ALREADY_EXISTS if the lock is held by another connection.
+ * \retval DB_NOT_SUPPORTED if the database has no named locks.
+ */
+int db_lock_acquire(db_conn_t *conn, const char *name);
+
+/**
+ * Check if a named lock is held by a connection.
+ * \retval DB_NOT_SUPPORTED if the database has no named locks.
+ */
+int db_lock_is_used(db_conn_t *conn, const char *name, bool *used);
+
 /* create a trigger */
 int            db_create_trigger( db_conn_t * conn, const char *name, const char *event,
                                const char *table, const char *body );
 
+/**
+ * Load a client-side file into a table. Rows are tab-separated values
+ * of the given fields (\N for NULL, tab, newline and backslash escaped
+ * by a backslash). The given fields of existing rows with the same key
+ * are updated, their other fields are kept.
+ * \param set_field optional field computed from the others (NULL if none).
+ * \param set_expr  expression of set_field.
+ * \retval DB_NOT_SUPPORTED if the database can't load files.
+ */
+int db_load_file(db_conn_t *conn, const char *path, const char *table,
+                 const char *fields, const char *set_field,
+                 const char *set_expr);
+
 /* -------------------- miscellaneous routines ---------------- */
 
 /* escape a string in a SQL request */
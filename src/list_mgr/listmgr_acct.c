@@ -0,0 +1,683 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    listmgr_acct.c
+ * \brief   Aggregation of accounting info in the daemon.
+ *
+ * When accounting_aggregation is enabled, there is no trigger on the
+ * accounting source table. Instead, the accounting info of modified
+ * entries is read before and after each modification (in the same
+ * transaction), and the difference is accumulated in a hash, per
+ * connection. When the transaction is committed, these changes are merged
+ * into a global sharded hash, that is periodically written to ACCT_STAT
+ * in a single transaction.
+ *
+ * If the process terminates before the changes are written,
+ * ACCT_STAT is built again from the entries at next startup
+ * (see ACCT_DELTAS_VAR). Each process sets its own marker, and holds a
+ * named DB lock of the same name while it is running, so that another
+ * process can tell a stale marker from a running process.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "list_mgr.h"
+#include "listmgr_common.h"
+#include "listmgr_internal.h"
+#include "database.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+
+#define ACCT_TAG "AcctAggr"
+
+/** number of shards of the global hash */
+#define ACCT_SHARDS 16
+/** max number of rows per INSERT request when writing to ACCT_STAT */
+#define ACCT_FLUSH_BATCH 1000
+
+/* separators in hash keys */
+#define KEY_SEP  '\x1f'
+#define KEY_NULL '\x1e'
+
+/** accounting changes of a set of ACCT_STAT primary key values */
+typedef struct acct_delta {
+    /** values of primary key fields (NULL for NULL) */
+    char      **pk;
+    /** acct fields, count, then size profile */
+    long long   val[];
+} acct_delta_t;
+
+typedef struct acct_shard {
+    pthread_mutex_t lock;
+    GHashTable     *deltas;
+} acct_shard_t;
+
+static acct_shard_t acct_shards[ACCT_SHARDS];
+
+/* source table of accounting info */
+static const char *acct_src = NULL;
+
+/* names of primary key fields, and of value fields */
+static const char **pk_names = NULL;
+static unsigned int nb_pk = 0;
+static const char **val_names = NULL;
+static unsigned int nb_val = 0;
+
+/* serialize writes to ACCT_STAT */
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static time_t last_flush = 0;
+
+/* number of open accesses in this process (for ACCT_DELTAS_VAR) */
+static pthread_mutex_t users_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int acct_users = 0;
+
+/* marker of this process, and connection holding the lock of the same
+ * name while the marker is set */
+static char marker_name[RBH_NAME_MAX];
+static db_conn_t marker_conn;
+static bool marker_set = false;
+static bool marker_locked = false;
+
+static void acct_delta_free(gpointer ptr)
+{
+    acct_delta_t *d = ptr;
+    unsigned int i;
+
+    for (i = 0; i < nb_pk; i++)
+        g_free(d->pk[i]);
+    g_free(d->pk);
+    g_free(d);
+}
+
+static GHashTable *acct_hash_new(void)
+{
+    return g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                 acct_delta_free);
+}
+
+static void build_key(GString *key, char *const *pk)
+{
+    unsigned int i;
+
+    g_string_truncate(key, 0);
+    for (i = 0; i < nb_pk; i++) {
+        if (i > 0)
+            g_string_append_c(key, KEY_SEP);
+        if (pk[i] == NULL)
+            g_string_append_c(key, KEY_NULL);
+        else
+            g_string_append(key, pk[i]);
+    }
+}
+
+/** add sign * val to the delta of the given key */
+static void acct_add(GHashTable *h, const char *key, char *const *pk,
+                     const long long *val, int sign)
+{
+    acct_delta_t *d;
+    unsigned int i;
+    bool zero = true;
+
+    d = g_hash_table_lookup(h, key);
+    if (d == NULL) {
+        d = g_malloc0(sizeof(*d) + nb_val * sizeof(long long));
+        d->pk = g_new0(char *, nb_pk);
+        for (i = 0; i < nb_pk; i++)
+            d->pk[i] = g_strdup(pk[i]);
+        g_hash_table_insert(h, g_strdup(key), d);
+    }
+
+    for (i = 0; i < nb_val; i++) {
+        d->val[i] += sign * val[i];
+        if (d->val[i] != 0)
+            zero = false;
+    }
+
+    /* changes cancelled each other */
+    if (zero)
+        g_hash_table_remove(h, key);
+}
+
+static inline acct_shard_t *key_shard(const char *key)
+{
+    return &acct_shards[g_str_hash(key) % ACCT_SHARDS];
+}
+
+/** merge a hash of deltas into the global hash */
+static void acct_merge(GHashTable *h)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&iter, h);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        acct_delta_t *d = value;
+        acct_shard_t *s = key_shard(key);
+
+        P(s->lock);
+        acct_add(s->deltas, key, d->pk, d->val, 1);
+        V(s->lock);
+    }
+}
+
+void append_acct_select(GString *req, const char *table)
+{
+    unsigned int i;
+
+    g_string_append(req, "SELECT ");
+    attrmask2fieldlist(req, acct_pk_attr_set, T_ACCT, "", "", 0);
+    attrmask2fieldlist(req, acct_attr_set, T_ACCT, "SUM(", ")",
+                       AOF_LEADING_SEP);
+    g_string_append(req, ",COUNT(id),SUM(size=0)");
+    for (i = 1; i < SZ_PROFIL_COUNT - 1; i++)   /* 1 to 8 */
+        g_string_append_printf(req, ",SUM(" SZRANGE_FUNC "(size)=%u)", i - 1);
+    g_string_append_printf(req, ",SUM(" SZRANGE_FUNC "(size)>=%u)", i - 1);
+    g_string_append_printf(req, " FROM %s", table);
+}
+
+void lmgr_acct_init(const char *src_table)
+{
+    int i, cookie;
+
+    acct_src = src_table;
+    if (!lmgr_acct_aggregated() || pk_names != NULL)
+        return;
+
+    pk_names = g_new0(const char *, ATTR_COUNT);
+    val_names = g_new0(const char *, ATTR_COUNT + 1 + SZ_PROFIL_COUNT);
+
+    /* same order as attrmask2fieldlist() */
+    cookie = -1;
+    while ((i = attr_index_iter(0, &cookie)) != -1) {
+        if (!match_table(T_ACCT, i))
+            continue;
+        if (is_acct_pk(i))
+            pk_names[nb_pk++] = field_name(i);
+        else if (is_acct_field(i))
+            val_names[nb_val++] = field_name(i);
+    }
+    val_names[nb_val++] = ACCT_FIELD_COUNT;
+    for (i = 0; i < SZ_PROFIL_COUNT; i++)
+        val_names[nb_val++] = sz_field[i];
+
+    for (i = 0; i < ACCT_SHARDS; i++) {
+        pthread_mutex_init(&acct_shards[i].lock, NULL);
+        acct_shards[i].deltas = acct_hash_new();
+    }
+    last_flush = time(NULL);
+}
+
+bool lmgr_acct_source(table_enum table)
+{
+    const char *name = table2name(table);
+
+    return acct_src != NULL && name != NULL && !strcmp(name, acct_src);
+}
+
+int lmgr_acct_snapshot(lmgr_t *p_mgr, const char *id_cond, int sign)
+{
+    GString *req;
+    GString *key;
+    result_handle_t result;
+    char **fields;
+    long long *val;
+    unsigned int i;
+    int rc;
+
+    if (!lmgr_acct_aggregated())
+        return DB_SUCCESS;
+
+    req = g_string_new(NULL);
+    append_acct_select(req, acct_src);
+    if (id_cond != NULL)
+        g_string_append_printf(req, " WHERE id%s", id_cond);
+    g_string_append(req, " GROUP BY ");
+    attrmask2fieldlist(req, acct_pk_attr_set, T_ACCT, "", "", 0);
+
+    rc = db_exec_sql(&p_mgr->conn, req->str, &result);
+    g_string_free(req, TRUE);
+    if (rc)
+        return rc;
+
+    if (p_mgr->acct_pending == NULL)
+        p_mgr->acct_pending = acct_hash_new();
+
+    fields = g_new0(char *, nb_pk + nb_val);
+    val = g_new0(long long, nb_val);
+    key = g_string_new(NULL);
+
+    while ((rc = db_next_record(&p_mgr->conn, &result, fields,
+                                nb_pk + nb_val)) == DB_SUCCESS) {
+        for (i = 0; i < nb_val; i++)
+            val[i] = fields[nb_pk + i] ? strtoll(fields[nb_pk + i], NULL, 10)
+                                       : 0;
+        build_key(key, fields);
+        acct_add(p_mgr->acct_pending, key->str, fields, val, sign);
+    }
+    if (rc == DB_END_OF_LIST)
+        rc = DB_SUCCESS;
+
+    db_result_free(&p_mgr->conn, &result);
+    g_string_free(key, TRUE);
+    g_free(val);
+    g_free(fields);
+    return rc;
+}
+
+void lmgr_acct_tx_commit(lmgr_t *p_mgr)
+{
+    if (p_mgr->acct_pending == NULL)
+        return;
+
+    acct_merge(p_mgr->acct_pending);
+    g_hash_table_remove_all(p_mgr->acct_pending);
+}
+
+void lmgr_acct_tx_abort(lmgr_t *p_mgr)
+{
+    if (p_mgr->acct_pending != NULL)
+        g_hash_table_remove_all(p_mgr->acct_pending);
+}
+
+static void append_quoted(lmgr_t *p_mgr, GString *req, const char *val)
+{
+    char escaped[1024];
+
+    if (val == NULL) {
+        g_string_append(req, "NULL");
+        return;
+    }
+    db_escape_string(&p_mgr->conn, escaped, sizeof(escaped), val);
+    g_string_append_printf(req, "'%s'", escaped);
+}
+
+/** append a row of the INSERT request for positive changes */
+static void append_insert_row(lmgr_t *p_mgr, GString *req,
+                              const acct_delta_t *d)
+{
+    unsigned int i;
+
+    g_string_append_c(req, '(');
+    for (i = 0; i < nb_pk; i++) {
+        if (i > 0)
+            g_string_append_c(req, ',');
+        append_quoted(p_mgr, req, d->pk[i]);
+    }
+    for (i = 0; i < nb_val; i++)
+        g_string_append_printf(req, ",%lld", d->val[i]);
+    g_string_append_c(req, ')');
+}
+
+static int flush_insert(lmgr_t *p_mgr, GString *req, unsigned int rows)
+{
+    unsigned int i;
+
+    if (rows == 0)
+        return DB_SUCCESS;
+
+#ifdef _SQLITE
+    g_string_append(req, " ON CONFLICT(");
+    for (i = 0; i < nb_pk; i++)
+        g_string_append_printf(req, "%s%s", i > 0 ? "," : "", pk_names[i]);
+    g_string_append(req, ") DO UPDATE SET ");
+    for (i = 0; i < nb_val; i++)
+        g_string_append_printf(req, "%s%s=%s+excluded.%s", i > 0 ? "," : "",
+                               val_names[i], val_names[i], val_names[i]);
+#else
+    g_string_append(req, " ON DUPLICATE KEY UPDATE ");
+    for (i = 0; i < nb_val; i++)
+        g_string_append_printf(req, "%s%s=%s+VALUES(%s)", i > 0 ? "," : "",
+                               val_names[i], val_names[i], val_names[i]);
+#endif
+
+    return db_exec_sql(&p_mgr->conn, req->str, NULL);
+}
+
+static void start_insert(GString *req)
+{
+    unsigned int i;
+
+    g_string_assign(req, "INSERT INTO " ACCT_TABLE "(");
+    for (i = 0; i < nb_pk; i++)
+        g_string_append_printf(req, "%s%s", i > 0 ? "," : "", pk_names[i]);
+    for (i = 0; i < nb_val; i++)
+        g_string_append_printf(req, ",%s", val_names[i]);
+    g_string_append(req, ") VALUES ");
+}
+
+#ifdef _SQLITE
+/* SQLite integers are signed */
+#define SIGNED_FMT      "%s"
+#define NULL_SAFE_EQ    " IS "
+#else
+#define SIGNED_FMT      "CAST(%s as SIGNED)"
+#define NULL_SAFE_EQ    "<=>"
+#endif
+
+/** accounting fields are unsigned: negative changes can't be
+ * inserted, they are applied by an UPDATE */
+static int update_row(lmgr_t *p_mgr, const acct_delta_t *d)
+{
+    GString *req;
+    unsigned int i;
+    int rc;
+
+    req = g_string_new("UPDATE " ACCT_TABLE " SET ");
+    for (i = 0; i < nb_val; i++)
+        g_string_append_printf(req, "%s%s=" SIGNED_FMT "+(%lld)",
+                               i > 0 ? "," : "", val_names[i], val_names[i],
+                               d->val[i]);
+    g_string_append(req, " WHERE ");
+    for (i = 0; i < nb_pk; i++) {
+        g_string_append_printf(req, "%s%s" NULL_SAFE_EQ,
+                               i > 0 ? " AND " : "", pk_names[i]);
+        append_quoted(p_mgr, req, d->pk[i]);
+    }
+
+    rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+    g_string_free(req, TRUE);
+    return rc;
+}
+
+/** write accumulated changes to ACCT_STAT in a single transaction */
+static int acct_write(lmgr_t *p_mgr, GHashTable **shard_deltas)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    GString *req;
+    unsigned int rows = 0;
+    unsigned int i, s;
+    int rc;
+
+    rc = db_exec_sql(&p_mgr->conn, "BEGIN", NULL);
+    if (rc)
+        return rc;
+
+    req = g_string_new(NULL);
+    start_insert(req);
+
+    for (s = 0; s < ACCT_SHARDS; s++) {
+        g_hash_table_iter_init(&iter, shard_deltas[s]);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            acct_delta_t *d = value;
+            bool negative = false;
+
+            for (i = 0; i < nb_val; i++)
+                if (d->val[i] < 0)
+                    negative = true;
+
+            if (negative) {
+                rc = update_row(p_mgr, d);
+                if (rc)
+                    goto rollback;
+                continue;
+            }
+
+            if (rows > 0)
+                g_string_append_c(req, ',');
+            append_insert_row(p_mgr, req, d);
+            rows++;
+
+            if (rows >= ACCT_FLUSH_BATCH) {
+                rc = flush_insert(p_mgr, req, rows);
+                if (rc)
+                    goto rollback;
+                start_insert(req);
+                rows = 0;
+            }
+        }
+    }
+
+    rc = flush_insert(p_mgr, req, rows);
+    if (rc)
+        goto rollback;
+
+    g_string_free(req, TRUE);
+    return db_exec_sql(&p_mgr->conn, "COMMIT", NULL);
+
+ rollback:
+    g_string_free(req, TRUE);
+    db_exec_sql(&p_mgr->conn, "ROLLBACK", NULL);
+    return rc;
+}
+
+int lmgr_acct_flush(lmgr_t *p_mgr, bool force)
+{
+    GHashTable *shard_deltas[ACCT_SHARDS];
+    unsigned int i, count = 0;
+    int rc = DB_SUCCESS;
+
+    if (!lmgr_acct_aggregated())
+        return DB_SUCCESS;
+
+    if (force)
+        P(flush_lock);
+    else if (time(NULL) < last_flush + lmgr_config.acct_flush_interval
+             || pthread_mutex_trylock(&flush_lock) != 0)
+        return DB_SUCCESS;
+
+    /* take the changes of all shards, so they are not locked while
+     * writing to the DB */
+    for (i = 0; i < ACCT_SHARDS; i++) {
+        P(acct_shards[i].lock);
+        shard_deltas[i] = acct_shards[i].deltas;
+        acct_shards[i].deltas = acct_hash_new();
+        V(acct_shards[i].lock);
+
+        count += g_hash_table_size(shard_deltas[i]);
+    }
+    last_flush = time(NULL);
+
+    if (count > 0) {
+        rc = acct_write(p_mgr, shard_deltas);
+        if (rc) {
+            char errmsg[1024];
+
+            DisplayLog(LVL_MAJOR, ACCT_TAG, "Failed to write accounting "
+                       "info (%u records): Error: %s. Will retry later.",
+                       count, db_errmsg(&p_mgr->conn, errmsg, sizeof(errmsg)));
+        } else
+            DisplayLog(LVL_FULL, ACCT_TAG, "%u accounting records written",
+                       count);
+    }
+
+    for (i = 0; i < ACCT_SHARDS; i++) {
+        /* keep the changes for next flush */
+        if (rc)
+            acct_merge(shard_deltas[i]);
+        g_hash_table_destroy(shard_deltas[i]);
+    }
+
+    V(flush_lock);
+    return rc;
+}
+
+/** number of changes not written to the DB */
+static unsigned int acct_count(void)
+{
+    unsigned int i, count = 0;
+
+    for (i = 0; i < ACCT_SHARDS; i++) {
+        P(acct_shards[i].lock);
+        count += g_hash_table_size(acct_shards[i].deltas);
+        V(acct_shards[i].lock);
+    }
+    return count;
+}
+
+void lmgr_acct_reset(void)
+{
+    unsigned int i;
+
+    if (!lmgr_acct_aggregated())
+        return;
+
+    P(flush_lock);
+    for (i = 0; i < ACCT_SHARDS; i++) {
+        P(acct_shards[i].lock);
+        g_hash_table_remove_all(acct_shards[i].deltas);
+        V(acct_shards[i].lock);
+    }
+    V(flush_lock);
+}
+
+/** take the lock of this process marker on a dedicated connection */
+static void marker_lock(void)
+{
+    int rc;
+
+    if (marker_locked)
+        return;
+
+    rc = db_connect(&marker_conn);
+    if (rc) {
+        DisplayLog(LVL_MAJOR, ACCT_TAG, "Failed to connect to the database "
+                   "to lock %s: error %d", marker_name, rc);
+        return;
+    }
+
+    rc = db_lock_acquire(&marker_conn, marker_name);
+    if (rc == DB_SUCCESS) {
+        marker_locked = true;
+        return;
+    }
+    if (rc != DB_NOT_SUPPORTED)
+        DisplayLog(LVL_MAJOR, ACCT_TAG, "Failed to lock %s: error %d",
+                   marker_name, rc);
+    db_close_conn(&marker_conn);
+}
+
+static void marker_unlock(void)
+{
+    if (!marker_locked)
+        return;
+    /* the lock is released with the connection */
+    db_close_conn(&marker_conn);
+    marker_locked = false;
+}
+
+int lmgr_acct_open(lmgr_t *p_mgr)
+{
+    char hostname[HOST_NAME_MAX + 1];
+    char timestr[256];
+    int rc = DB_SUCCESS;
+
+    if (!lmgr_acct_aggregated())
+        return DB_SUCCESS;
+
+    P(users_lock);
+    /* ACCT_STAT may be inconsistent until all changes are written */
+    if (!marker_set) {
+        if (gethostname(hostname, sizeof(hostname)) != 0)
+            strcpy(hostname, "localhost");
+        hostname[sizeof(hostname) - 1] = '\0';
+        snprintf(marker_name, sizeof(marker_name), ACCT_DELTAS_VAR "_%s:%d",
+                 hostname, (int)getpid());
+        /* lock first, so the marker is never seen unlocked */
+        marker_lock();
+        snprintf(timestr, sizeof(timestr), "%lu", (unsigned long)time(NULL));
+        rc = lmgr_set_var(&p_mgr->conn, marker_name, timestr);
+        if (rc == DB_SUCCESS)
+            marker_set = true;
+        else
+            marker_unlock();
+    }
+    if (rc == DB_SUCCESS)
+        acct_users++;
+    V(users_lock);
+
+    return rc;
+}
+
+int lmgr_acct_close(lmgr_t *p_mgr)
+{
+    int rc;
+
+    if (p_mgr->acct_pending != NULL) {
+        g_hash_table_destroy(p_mgr->acct_pending);
+        p_mgr->acct_pending = NULL;
+    }
+
+    if (!lmgr_acct_aggregated())
+        return DB_SUCCESS;
+
+    rc = lmgr_acct_flush(p_mgr, true);
+
+    P(users_lock);
+    if (acct_users > 0)
+        acct_users--;
+    if (acct_users == 0 && marker_set && rc == DB_SUCCESS
+        && acct_count() == 0) {
+        rc = lmgr_set_var(&p_mgr->conn, marker_name, NULL);
+        if (rc == DB_SUCCESS) {
+            marker_set = false;
+            marker_unlock();
+        }
+    }
+    V(users_lock);
+
+    return rc;
+}
+
+bool lmgr_acct_marker_alive(db_conn_t *pconn, const char *marker)
+{
+    char hostname[HOST_NAME_MAX + 1];
+    const char *host;
+    const char *sep;
+    bool used;
+    long pid;
+    int rc;
+
+    /* marker of an older version (global to all processes) */
+    if (strncmp(marker, ACCT_DELTAS_VAR "_", strlen(ACCT_DELTAS_VAR "_")))
+        return false;
+
+    rc = db_lock_is_used(pconn, marker, &used);
+    if (rc == DB_SUCCESS)
+        return used;
+    if (rc != DB_NOT_SUPPORTED) {
+        DisplayLog(LVL_MAJOR, ACCT_TAG, "Failed to check lock %s: error %d",
+                   marker, rc);
+        return true;
+    }
+
+    /* no lock support: check the process, if it runs on this host */
+    host = marker + strlen(ACCT_DELTAS_VAR "_");
+    sep = strrchr(host, ':');
+    if (sep == NULL)
+        return false;
+    pid = strtol(sep + 1, NULL, 10);
+
+    if (gethostname(hostname, sizeof(hostname)) != 0)
+        return true;
+    hostname[sizeof(hostname) - 1] = '\0';
+    if (strlen(hostname) != (size_t)(sep - host)
+        || strncmp(hostname, host, sep - host))
+        /* can't tell: assume it is running */
+        return true;
+
+    /* our own pid (marker left by a previous process) */
+    if (pid <= 0 || pid == getpid())
+        return false;
+
+    return (kill(pid, 0) == 0 || errno == EPERM);
+}
@@ -0,0 +1,544 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    listmgr_bulk.c
+ * \brief   Initial load of entries into an empty database.
+ *
+ * During the first scan, entries are written to files (one per table and
+ * set of fields) that are loaded into the database when they reach
+ * a given size. Secondary indexes and accounting triggers are dropped
+ * at the beginning of the load, and built again at its end.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "list_mgr.h"
+#include "listmgr_common.h"
+#include "listmgr_internal.h"
+#include "database.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "Memory.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/** max number of files being written (different tables and sets of
+ * fields) */
+#define BULK_MAX_FILES 32
+
+/** a file of rows to be loaded into a table */
+typedef struct bulk_file {
+    table_enum   table;
+    /** fields in the file (in addition to id) */
+    attr_mask_t  fields;
+    char         path[RBH_PATH_MAX];
+    FILE        *stream;
+    size_t       size;
+    unsigned int rows;
+} bulk_file_t;
+
+/** tables whose rows are loaded from files */
+static const table_enum bulk_tables[] = {T_MAIN, T_DNAMES, T_ANNEX};
+#define BULK_TABLE_COUNT (sizeof(bulk_tables) / sizeof(*bulk_tables))
+
+static pthread_mutex_t bulk_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool bulk_active = false;
+static bulk_file_t bulk_files[BULK_MAX_FILES];
+static unsigned int bulk_nb_files = 0;
+static unsigned int bulk_seq = 0;
+/** first error of a file load (the load is then incomplete) */
+static int bulk_error = DB_SUCCESS;
+
+/* statistics */
+static time_t bulk_start;
+static unsigned long long bulk_rows = 0;
+static unsigned long long bulk_bytes = 0;
+
+static int bulk_file_open(bulk_file_t *bf, table_enum table,
+                          attr_mask_t fields)
+{
+    int rc;
+
+    memset(bf, 0, sizeof(*bf));
+    bf->table = table;
+    bf->fields = fields;
+    snprintf(bf->path, sizeof(bf->path), "%s/rbh_load.%s.%d.%u",
+             lmgr_config.initial_load_dir, table2name(table), getpid(),
+             bulk_seq++);
+
+    bf->stream = fopen(bf->path, "w");
+    if (bf->stream == NULL) {
+        rc = errno;
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to create load file "
+                   "'%s': %s", bf->path, strerror(rc));
+        return DB_REQUEST_FAILED;
+    }
+    return DB_SUCCESS;
+}
+
+/** close a load file and load it into the database */
+static int bulk_file_load(lmgr_t *p_mgr, bulk_file_t *bf)
+{
+    GString *fields;
+    char err_buf[1024];
+    int rc, retry_status;
+
+    if (fclose(bf->stream)) {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to write load file '%s': "
+                   "%s", bf->path, strerror(errno));
+        return DB_REQUEST_FAILED;
+    }
+    bf->stream = NULL;
+
+    fields = g_string_new("id");
+    attrmask2fieldlist(fields, bf->fields, bf->table, "", "",
+                       AOF_LEADING_SEP);
+
+ retry:
+    rc = lmgr_begin(p_mgr);
+    retry_status = lmgr_delayed_retry(p_mgr, rc);
+    if (retry_status == 1)
+        goto retry;
+    else if (retry_status == 2) {
+        rc = DB_RBH_SIG_SHUTDOWN;
+        goto out;
+    } else if (rc)
+        goto out;
+
+    if (bf->table == T_DNAMES)
+        rc = db_load_file(&p_mgr->conn, bf->path, table2name(bf->table),
+                          fields->str, "pkn", HNAME_DEF);
+    else
+        rc = db_load_file(&p_mgr->conn, bf->path, table2name(bf->table),
+                          fields->str, NULL, NULL);
+    retry_status = lmgr_delayed_retry(p_mgr, rc);
+    if (retry_status == 1)
+        goto retry;
+    else if (rc || retry_status == 2) {
+        lmgr_rollback(p_mgr);
+        if (retry_status == 2)
+            rc = DB_RBH_SIG_SHUTDOWN;
+        goto out;
+    }
+
+    /* directories with no loaded name may have been cached as the top of
+     * the namespace: clear the cache once the file is loaded */
+    lmgr_path_cache_clear(p_mgr);
+
+    rc = lmgr_commit(p_mgr);
+    if (lmgr_delayed_retry(p_mgr, rc) == 1)
+        goto retry;
+
+ out:
+    if (rc) {
+        /* keep the file for investigation. The scan is reported as
+         * incomplete, so the entries will be inserted by the next scan. */
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to load '%s' into %s: "
+                   "code=%d: %s", bf->path, table2name(bf->table), rc,
+                   db_errmsg(&p_mgr->conn, err_buf, sizeof(err_buf)));
+        P(bulk_lock);
+        if (bulk_active && bulk_error == DB_SUCCESS)
+            bulk_error = rc;
+        V(bulk_lock);
+    } else {
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "%u rows loaded into %s from "
+                   "'%s'", bf->rows, table2name(bf->table), bf->path);
+        unlink(bf->path);
+
+        P(bulk_lock);
+        bulk_rows += bf->rows;
+        bulk_bytes += bf->size;
+        V(bulk_lock);
+    }
+    g_string_free(fields, TRUE);
+    return rc;
+}
+
+/** append a value to a row, escaped as expected by db_load_file() */
+static void append_load_value(GString *row, const char *val)
+{
+    if (val == NULL) {
+        g_string_append(row, "\\N");
+        return;
+    }
+
+    for (; *val != '\0'; val++) {
+        switch (*val) {
+        case '\\':
+            g_string_append(row, "\\\\");
+            break;
+        case '\t':
+            g_string_append(row, "\\t");
+            break;
+        case '\n':
+            g_string_append(row, "\\n");
+            break;
+        case '\r':
+            g_string_append(row, "\\r");
+            break;
+        default:
+            g_string_append_c(row, *val);
+        }
+    }
+}
+
+/** build the row of an entry for the given table */
+static void entry2row(GString *row, const PK_ARG_T pk, const attr_set_t *p_attrs,
+                      table_enum table)
+{
+    GString *dummy = g_string_new(NULL);
+    GArray *values = g_array_new(FALSE, FALSE, sizeof(db_field_value_t));
+    GStringChunk *chunk = g_string_chunk_new(1024);
+    int i;
+
+    g_string_truncate(row, 0);
+    append_load_value(row, pk);
+
+    attrset2paramlist(dummy, values, chunk, p_attrs, table, AOF_LEADING_SEP);
+    for (i = 0; i < values->len; i++) {
+        const db_field_value_t *v = &g_array_index(values, db_field_value_t, i);
+
+        g_string_append_c(row, '\t');
+        if (v->is_num)
+            g_string_append_printf(row, v->is_unsigned ? "%llu" : "%lld",
+                                   v->num);
+        else
+            append_load_value(row, v->is_null ? NULL : v->str);
+    }
+    g_string_append_c(row, '\n');
+
+    g_string_chunk_free(chunk);
+    g_array_free(values, TRUE);
+    g_string_free(dummy, TRUE);
+}
+
+/** get the fields to be written to the given table (null if none) */
+static attr_mask_t bulk_table_fields(table_enum table,
+                                     const attr_set_t *p_attrs)
+{
+    attr_mask_t null_mask = {0};
+
+    switch (table) {
+    case T_MAIN:
+        return attr_mask_and(&p_attrs->attr_mask, &main_attr_set);
+    case T_DNAMES:
+        if (!ATTR_MASK_TEST(p_attrs, name)
+            || !ATTR_MASK_TEST(p_attrs, parent_id))
+            return null_mask;
+        return attr_mask_and(&p_attrs->attr_mask, &names_attr_set);
+    case T_ANNEX:
+        return attr_mask_and(&p_attrs->attr_mask, &annex_attr_set);
+    default:
+        return null_mask;
+    }
+}
+
+/**
+ * Write a row to the file of the given table and fields.
+ * Must be called with bulk_lock held.
+ * Files that must be loaded are returned in 'full'.
+ * @return the number of files to be loaded (up to 2), or -1 on error.
+ */
+static int bulk_write(table_enum table, attr_mask_t fields, GString *row,
+                      bulk_file_t *full)
+{
+    bulk_file_t *bf = NULL;
+    int i, nb_full = 0;
+
+    for (i = 0; i < bulk_nb_files; i++) {
+        if (bulk_files[i].table == table
+            && attr_mask_equal(&bulk_files[i].fields, &fields)) {
+            bf = &bulk_files[i];
+            break;
+        }
+    }
+
+    if (bf == NULL) {
+        bulk_file_t new_file;
+
+        if (bulk_file_open(&new_file, table, fields))
+            return -1;
+
+        if (bulk_nb_files == BULK_MAX_FILES) {
+            int biggest = 0;
+
+            /* make room for the new file */
+            for (i = 1; i < bulk_nb_files; i++)
+                if (bulk_files[i].size > bulk_files[biggest].size)
+                    biggest = i;
+
+            full[nb_full++] = bulk_files[biggest];
+            bulk_files[biggest] = bulk_files[--bulk_nb_files];
+        }
+
+        bf = &bulk_files[bulk_nb_files++];
+        *bf = new_file;
+    }
+
+    if (fwrite(row->str, row->len, 1, bf->stream) != 1) {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to write load file '%s': "
+                   "%s", bf->path, strerror(errno));
+        return -1;
+    }
+    bf->size += row->len;
+    bf->rows++;
+
+    if (bf->size >= lmgr_config.initial_load_chunk) {
+        full[nb_full++] = *bf;
+        *bf = bulk_files[--bulk_nb_files];
+    }
+
+    return nb_full;
+}
+
+bool ListMgr_BulkLoadActive(void)
+{
+    return bulk_active;
+}
+
+int ListMgr_BulkLoadStart(lmgr_t *p_mgr)
+{
+    bulk_file_t probe;
+    attr_mask_t null_mask = {0};
+    char timestr[128];
+    char sizestr[128];
+    int rc;
+
+    if (!lmgr_config.initial_load || bulk_active)
+        return DB_SUCCESS;
+
+    /* check that files can be loaded, before dropping anything */
+    rc = bulk_file_open(&probe, T_MAIN, null_mask);
+    if (rc)
+        return rc;
+    rc = bulk_file_load(p_mgr, &probe);
+    if (rc) {
+        unlink(probe.path);
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Failed to load a file into the "
+                   "database (is 'local_infile' enabled on the server?): "
+                   "entries will be inserted one batch at a time");
+        return rc;
+    }
+
+    /* if the load is interrupted, ListMgr_Init() completes it */
+    snprintf(timestr, sizeof(timestr), "%lu", (unsigned long)time(NULL));
+    rc = lmgr_set_var(&p_mgr->conn, INITIAL_LOAD_VAR, timestr);
+    if (rc)
+        return rc;
+
+    DisplayLog(LVL_EVENT, LISTMGR_TAG, "Dropping indexes and accounting "
+               "triggers for the initial load");
+    rc = lmgr_bulk_suspend(&p_mgr->conn);
+    if (rc) {
+        /* restore what was dropped */
+        if (lmgr_bulk_resume(&p_mgr->conn) == DB_SUCCESS)
+            lmgr_set_var(&p_mgr->conn, INITIAL_LOAD_VAR, NULL);
+        return rc;
+    }
+
+    P(bulk_lock);
+    bulk_start = time(NULL);
+    bulk_rows = bulk_bytes = 0;
+    bulk_error = DB_SUCCESS;
+    bulk_active = true;
+    V(bulk_lock);
+
+    DisplayLog(LVL_EVENT, LISTMGR_TAG, "Initial load started: entries are "
+               "loaded by chunks of %s", FormatFileSize(sizestr,
+               sizeof(sizestr), lmgr_config.initial_load_chunk));
+    return DB_SUCCESS;
+}
+
+int ListMgr_BulkInsert(lmgr_t *p_mgr, entry_id_t **p_ids,
+                       attr_set_t **p_attrs, unsigned int count)
+{
+    GString *row;
+    bulk_file_t full[2];
+    int i, j, t, nb_full;
+    int rc = DB_SUCCESS;
+#ifdef _LUSTRE
+    entry_id_t **stripe_ids = NULL;
+    attr_set_t **stripe_attrs = NULL;
+    pktype *stripe_pks = NULL;
+    unsigned int stripe_count = 0;
+    int retry_status;
+#endif
+
+    if (!bulk_active) {
+        /* not in initial load mode (any longer) */
+        for (i = 0; i < count; i++) {
+            rc = ListMgr_Insert(p_mgr, p_ids[i], p_attrs[i], true);
+            if (rc)
+                return rc;
+        }
+        return DB_SUCCESS;
+    }
+
+    row = g_string_new(NULL);
+
+    for (i = 0; i < count; i++) {
+        DEF_PK(pk);
+
+        entry_id2pk(p_ids[i], PTR_PK(pk));
+
+        for (t = 0; t < BULK_TABLE_COUNT; t++) {
+            attr_mask_t fields = bulk_table_fields(bulk_tables[t],
+                                                   p_attrs[i]);
+
+            if (attr_mask_is_null(fields))
+                continue;
+
+            entry2row(row, pk, p_attrs[i], bulk_tables[t]);
+
+            P(bulk_lock);
+            nb_full = bulk_write(bulk_tables[t], fields, row, full);
+            if (nb_full < 0 && bulk_error == DB_SUCCESS)
+                /* the entry is lost for this load */
+                bulk_error = DB_REQUEST_FAILED;
+            V(bulk_lock);
+
+            if (nb_full < 0) {
+                rc = DB_REQUEST_FAILED;
+                goto out;
+            }
+
+            for (j = 0; j < nb_full; j++) {
+                int rc2 = bulk_file_load(p_mgr, &full[j]);
+
+                if (rc2 && !rc)
+                    rc = rc2;
+            }
+            if (rc)
+                goto out;
+        }
+    }
+
+#ifdef _LUSTRE
+    /* stripe info is not loaded from files */
+    for (i = 0; i < count; i++) {
+        if (!stripe_fields(p_attrs[i]->attr_mask))
+            continue;
+
+        if (stripe_ids == NULL) {
+            stripe_ids = MemCalloc(count, sizeof(*stripe_ids));
+            stripe_attrs = MemCalloc(count, sizeof(*stripe_attrs));
+            stripe_pks = MemCalloc(count, sizeof(*stripe_pks));
+            if (!stripe_ids || !stripe_attrs || !stripe_pks) {
+                rc = DB_NO_MEMORY;
+                goto out;
+            }
+        }
+        stripe_ids[stripe_count] = p_ids[i];
+        stripe_attrs[stripe_count] = p_attrs[i];
+        entry_id2pk(p_ids[i], PTR_PK(stripe_pks[stripe_count]));
+        stripe_count++;
+    }
+
+    if (stripe_count > 0) {
+ retry:
+        rc = lmgr_begin(p_mgr);
+        retry_status = lmgr_delayed_retry(p_mgr, rc);
+        if (retry_status == 1)
+            goto retry;
+        else if (retry_status == 2) {
+            rc = DB_RBH_SIG_SHUTDOWN;
+            goto out;
+        } else if (rc)
+            goto out;
+
+        rc = listmgr_batch_insert_stripes_no_tx(p_mgr, stripe_ids, stripe_pks,
+                                                stripe_attrs, stripe_count);
+        retry_status = lmgr_delayed_retry(p_mgr, rc);
+        if (retry_status == 1)
+            goto retry;
+        else if (rc || retry_status == 2) {
+            lmgr_rollback(p_mgr);
+            if (retry_status == 2)
+                rc = DB_RBH_SIG_SHUTDOWN;
+            goto out;
+        }
+
+        rc = lmgr_commit(p_mgr);
+        if (lmgr_delayed_retry(p_mgr, rc) == 1)
+            goto retry;
+    }
+#endif
+
+ out:
+#ifdef _LUSTRE
+    MemFree(stripe_ids);
+    MemFree(stripe_attrs);
+    MemFree(stripe_pks);
+#endif
+    g_string_free(row, TRUE);
+
+    /* success, count it */
+    if (!rc)
+        p_mgr->nbop[OPIDX_INSERT] += count;
+    return rc;
+}
+
+int ListMgr_BulkLoadEnd(lmgr_t *p_mgr)
+{
+    bulk_file_t files[BULK_MAX_FILES];
+    unsigned int i, nb_files;
+    char durstr[128];
+    char sizestr[128];
+    int rc = DB_SUCCESS;
+    int rc2;
+
+    P(bulk_lock);
+    if (!bulk_active) {
+        V(bulk_lock);
+        return DB_SUCCESS;
+    }
+    bulk_active = false;
+    memcpy(files, bulk_files, bulk_nb_files * sizeof(*files));
+    nb_files = bulk_nb_files;
+    bulk_nb_files = 0;
+    V(bulk_lock);
+
+    /* load remaining files */
+    for (i = 0; i < nb_files; i++) {
+        rc2 = bulk_file_load(p_mgr, &files[i]);
+        if (rc2 && !rc)
+            rc = rc2;
+    }
+    /* report the failed loads of previous chunks too */
+    if (!rc)
+        rc = bulk_error;
+
+    DisplayLog(LVL_EVENT, LISTMGR_TAG, "Initial load: building indexes and "
+               "accounting info. This can take a while...");
+    FlushLogs();
+
+    rc2 = lmgr_bulk_resume(&p_mgr->conn);
+    if (rc2) {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to build indexes and "
+                   "accounting info: they will be built at next startup");
+        return rc2;
+    }
+    lmgr_set_var(&p_mgr->conn, INITIAL_LOAD_VAR, NULL);
+
+    DisplayLog(rc ? LVL_CRIT : LVL_EVENT, LISTMGR_TAG, "Initial load %s: "
+               "%llu rows (%s) loaded in %s",
+               rc ? "incomplete (some files failed to load)" : "complete",
+               bulk_rows, FormatFileSize(sizestr, sizeof(sizestr), bulk_bytes),
+               FormatDuration(durstr, sizeof(durstr), time(NULL) - bulk_start));
+    return rc;
+}
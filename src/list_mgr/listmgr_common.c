@@ -101,6 +101,68 @@ void printdbtype(db_conn_t *pconn, GString *str, db_type_e type,
     }
 }
 
+void dbtype2param(GStringChunk *values, db_type_e type,
+                  const db_type_u *value_ptr, db_field_value_t *param)
+{
+    memset(param, 0, sizeof(*param));
+
+    switch (type) {
+    case DB_ID:
+        {
+            DEF_PK(tmpstr);
+
+            entry_id2pk(&value_ptr->val_id, tmpstr);
+            param->str = g_string_chunk_insert(values, tmpstr);
+            return;
+        }
+    case DB_UIDGID:
+        if (global_config.uid_gid_as_numbers) {
+            param->is_num = true;
+            param->num = value_ptr->val_int;
+            return;
+        }
+        /* UID/GID is TEXT. Fall throught ... */
+
+    case DB_TEXT:
+    case DB_ENUM_FTYPE:
+        if (value_ptr->val_str == NULL)
+            param->is_null = true;
+        else
+            param->str = g_string_chunk_insert(values, value_ptr->val_str);
+        return;
+
+    case DB_INT:
+        param->num = value_ptr->val_int;
+        break;
+    case DB_UINT:
+        param->num = value_ptr->val_uint;
+        param->is_unsigned = true;
+        break;
+    case DB_SHORT:
+        param->num = value_ptr->val_short;
+        break;
+    case DB_USHORT:
+        param->num = value_ptr->val_ushort;
+        param->is_unsigned = true;
+        break;
+    case DB_BIGINT:
+        param->num = value_ptr->val_bigint;
+        break;
+    case DB_BIGUINT:
+        param->num = value_ptr->val_biguint;
+        param->is_unsigned = true;
+        break;
+    case DB_BOOL:
+        param->num = value_ptr->val_bool ? 1 : 0;
+        break;
+
+    case DB_STRIPE_INFO:
+    case DB_STRIPE_ITEMS:
+        RBH_BUG("Unsupported DB type");
+    }
+    param->is_num = true;
+}
+
 /** print attribute value to display to the user
  * @param quote string to quote string types (eg. "'") */
 int ListMgr_PrintAttr(GString *str, db_type_e type,
@@ -687,35 +749,47 @@ int attrmask2fieldcomparison(GString *str, attr_mask_t attr_mask,
     return nbfields;
 }
 
-static void print_attr_value(lmgr_t *p_mgr, GString *str,
-                             const attr_set_t *p_set, unsigned int attr_index)
+/** get the DB type and value of an attribute
+ * @param tmp buffer for converted values */
+static db_type_e attr_db_value(const attr_set_t *p_set,
+                               unsigned int attr_index, db_type_u *typeu,
+                               char *tmp, size_t tmp_size)
 {
-    char tmp[1024];
-    db_type_u typeu;
     db_type_e t;
 
     if (attr_index < ATTR_COUNT) {
-        assign_union(&typeu, field_infos[attr_index].db_type,
+        assign_union(typeu, field_infos[attr_index].db_type,
                      attr_address_const(p_set, attr_index));
 
         if (is_sepdlist(attr_index)) {
-            separated_list2db(typeu.val_str, tmp, sizeof(tmp));
-            typeu.val_str = tmp;
+            separated_list2db(typeu->val_str, tmp, tmp_size);
+            typeu->val_str = tmp;
         }
         t = field_infos[attr_index].db_type;
     } else if (is_status_field(attr_index)) {
         unsigned int status_idx = attr2status_index(attr_index);
 
-        assign_union(&typeu, DB_TEXT, p_set->attr_values.sm_status[status_idx]);
+        assign_union(typeu, DB_TEXT, p_set->attr_values.sm_status[status_idx]);
         t = DB_TEXT;
     } else if (is_sm_info_field(attr_index)) {
         unsigned int info_idx = attr2sminfo_index(attr_index);
 
         t = sm_attr_info[info_idx].def->db_type;
-        assign_union(&typeu, t, (char *)p_set->attr_values.sm_info[info_idx]);
+        assign_union(typeu, t, (char *)p_set->attr_values.sm_info[info_idx]);
     } else
         RBH_BUG("Attribute index is not in a valid range");
 
+    return t;
+}
+
+static void print_attr_value(lmgr_t *p_mgr, GString *str,
+                             const attr_set_t *p_set, unsigned int attr_index)
+{
+    char tmp[1024];
+    db_type_u typeu;
+    db_type_e t;
+
+    t = attr_db_value(p_set, attr_index, &typeu, tmp, sizeof(tmp));
     printdbtype(&p_mgr->conn, str, t, &typeu);
 }
 
@@ -748,6 +822,45 @@ int attrset2valuelist(lmgr_t *p_mgr, GString *str, const attr_set_t *p_set,
     return nbfields;
 }
 
+/**
+ * Same as attrset2valuelist(), but append '?' placeholders to the request,
+ * and the values to the parameters of a prepared statement.
+ * @param values storage for parameter values
+ * @param table T_MAIN, T_ANNEX
+ * @return nbr of fields
+ */
+int attrset2paramlist(GString *str, GArray *params, GStringChunk *values,
+                      const attr_set_t *p_set, table_enum table,
+                      attrset_op_flag_e flags)
+{
+    int i, cookie;
+    unsigned int nbfields = 0;
+    bool leading_comma = flags & AOF_LEADING_SEP;
+
+    if ((table == T_STRIPE_INFO) || (table == T_STRIPE_ITEMS))
+        return -DB_NOT_SUPPORTED;
+
+    cookie = -1;
+    while ((i = attr_index_iter(0, &cookie)) != -1) {
+        if (attr_mask_test_index(&p_set->attr_mask, i)
+            && match_table(table, i)) {
+            char tmp[1024];
+            db_type_u typeu;
+            db_type_e t;
+            db_field_value_t param;
+
+            g_string_append(str, (leading_comma || (nbfields > 0)) ?
+                            ",?" : "?");
+
+            t = attr_db_value(p_set, i, &typeu, tmp, sizeof(tmp));
+            dbtype2param(values, t, &typeu, &param);
+            g_array_append_val(params, param);
+            nbfields++;
+        }
+    }
+    return nbfields;
+}
+
 /**
  * @param table T_MAIN, T_ANNEX
  * @return nbr of fields
@@ -839,8 +952,86 @@ void fullpath_db2attr(const char *db, char *attr)
         sprintf(attr, "%s/%s", global_config.fs_path, c);
 }
 
-int result2attrset(table_enum table, char **result_tab,
-                   unsigned int res_count, attr_set_t *p_set)
+/** set a DB value from an integer read in binary form */
+static int num2dbtype(long long num, db_type_e type, db_type_u *value_out)
+{
+    switch (type) {
+    case DB_UIDGID:
+        if (!global_config.uid_gid_as_numbers)
+            return 0;
+        /* fall through */
+    case DB_INT:
+        value_out->val_int = num;
+        return 1;
+    case DB_UINT:
+        value_out->val_uint = num;
+        return 1;
+    case DB_SHORT:
+        value_out->val_short = num;
+        return 1;
+    case DB_USHORT:
+        value_out->val_ushort = num;
+        return 1;
+    case DB_BIGINT:
+        value_out->val_bigint = num;
+        return 1;
+    case DB_BIGUINT:
+        value_out->val_biguint = num;
+        return 1;
+    case DB_BOOL:
+        value_out->val_bool = (num != 0);
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/** result fields, as strings or typed values */
+typedef struct result_fields {
+    char                   **strs;
+    const db_field_value_t  *values;
+    /** integers printed to a string */
+    char                     buf[32];
+} result_fields_t;
+
+static inline bool res_is_null(const result_fields_t *res, unsigned int i)
+{
+    if (res->values != NULL)
+        return res->values[i].is_null;
+    return res->strs == NULL || res->strs[i] == NULL;
+}
+
+/** get a field as a string (integer fields are printed) */
+static char *res_str(result_fields_t *res, unsigned int i)
+{
+    if (res->values == NULL)
+        return res->strs[i];
+    if (!res->values[i].is_num)
+        return res->values[i].str;
+
+    snprintf(res->buf, sizeof(res->buf), "%lld", res->values[i].num);
+    return res->buf;
+}
+
+static inline int res_int(result_fields_t *res, unsigned int i)
+{
+    if (res->values != NULL && res->values[i].is_num)
+        return res->values[i].num;
+    return atoi(res_str(res, i));
+}
+
+/** convert a field to the DB type of the given attribute */
+static int res_parse(result_fields_t *res, unsigned int i, db_type_e type,
+                     db_type_u *value_out)
+{
+    if (res->values != NULL && res->values[i].is_num
+        && num2dbtype(res->values[i].num, type, value_out))
+        return 1;
+    return parsedbtype(res_str(res, i), type, value_out);
+}
+
+static int fields2attrset(table_enum table, result_fields_t *res,
+                          unsigned int res_count, attr_set_t *p_set)
 {
     int i, cookie;
     unsigned int nbfields = 0;
@@ -850,11 +1041,11 @@ int result2attrset(table_enum table, char **result_tab,
     while ((i = attr_index_iter(0, &cookie)) != -1) {
         if (attr_mask_test_index(&p_set->attr_mask, i)
             && match_table(table, i)) {
-            if (log_config.debug_level >= LVL_FULL && result_tab != NULL) {
+            if (log_config.debug_level >= LVL_FULL && nbfields < res_count) {
                 DisplayLog(LVL_FULL, LISTMGR_TAG, "result[%u]: %s = %s",
                            nbfields, field_name(i),
-                           result_tab[nbfields] ? result_tab[nbfields] :
-                           "<null>");
+                           res_is_null(res, nbfields) ? "<null>" :
+                           res_str(res, nbfields));
             }
 
             /* Parse nbfield'th value */
@@ -863,36 +1054,36 @@ int result2attrset(table_enum table, char **result_tab,
             }
 #ifdef _LUSTRE
             if (i < ATTR_COUNT && field_infos[i].db_type == DB_STRIPE_INFO) {
-                if ((result_tab == NULL)
-                    || (result_tab[nbfields] == NULL)
-                    || (result_tab[nbfields + 1] == NULL)
-                    || (result_tab[nbfields + 2] == NULL)) {
+                if (nbfields + 2 >= res_count
+                    || res_is_null(res, nbfields)
+                    || res_is_null(res, nbfields + 1)
+                    || res_is_null(res, nbfields + 2)) {
                     /* must skip 3 columns in this case */
                     attr_mask_unset_index(&p_set->attr_mask, i);
                     nbfields += 3;
                     continue;
                 }
                 ATTR(p_set, stripe_info).stripe_count =
-                    atoi(result_tab[nbfields]);
+                    res_int(res, nbfields);
                 ATTR(p_set, stripe_info).stripe_size =
-                    atoi(result_tab[nbfields + 1]);
+                    res_int(res, nbfields + 1);
                 rh_strncpy(ATTR(p_set, stripe_info).pool_name,
-                           result_tab[nbfields + 2], MAX_POOL_LEN);
+                           res_str(res, nbfields + 2), MAX_POOL_LEN);
 
                 /* stripe count, stripe size and pool_name */
                 nbfields += 3;
                 continue;
             } else
 #endif
-            if ((result_tab == NULL) || (result_tab[nbfields] == NULL)) {
+            if (res_is_null(res, nbfields)) {
                 attr_mask_unset_index(&p_set->attr_mask, i);
                 nbfields++;
                 continue;
             } else
-                if (!parsedbtype(result_tab[nbfields], field_type(i), &typeu)) {
+                if (!res_parse(res, nbfields, field_type(i), &typeu)) {
                 DisplayLog(LVL_CRIT, LISTMGR_TAG,
                            "Error: cannot parse field value '%s' (position %u) for %s",
-                           result_tab[nbfields], nbfields, field_name(i));
+                           res_str(res, nbfields), nbfields, field_name(i));
                 RBH_BUG("DB value cannot be parsed: DB may be corrupted");
                 attr_mask_unset_index(&p_set->attr_mask, i);
                 nbfields++;
@@ -944,6 +1135,22 @@ int result2attrset(table_enum table, char **result_tab,
 
 }
 
+int result2attrset(table_enum table, char **result_tab,
+                   unsigned int res_count, attr_set_t *p_set)
+{
+    result_fields_t res = {.strs = result_tab};
+
+    return fields2attrset(table, &res, res_count, p_set);
+}
+
+int values2attrset(table_enum table, const db_field_value_t *values,
+                   unsigned int count, attr_set_t *p_set)
+{
+    result_fields_t res = {.values = values};
+
+    return fields2attrset(table, &res, count, p_set);
+}
+
 char *compar2str(filter_comparator_t compar)
 {
     switch (compar) {
@@ -1707,6 +1914,9 @@ int _lmgr_begin(lmgr_t *p_mgr, int behavior)
 
 void _lmgr_rollback(lmgr_t *p_mgr, int behavior)
 {
+    lmgr_acct_tx_abort(p_mgr);
+    lmgr_path_cache_tx_end(p_mgr);
+
     if (behavior == 0)
         return;
     else {
@@ -1718,23 +1928,42 @@ void _lmgr_rollback(lmgr_t *p_mgr, int behavior)
     }
 }
 
+/** accounting changes and path cache invalidations are applied once the
+ * transaction is committed */
+static void lmgr_committed(lmgr_t *p_mgr)
+{
+    lmgr_path_cache_tx_end(p_mgr);
+
+    if (!lmgr_acct_aggregated())
+        return;
+
+    lmgr_acct_tx_commit(p_mgr);
+    lmgr_acct_flush(p_mgr, false);
+}
+
 int _lmgr_commit(lmgr_t *p_mgr, int behavior)
 {
-    if (behavior == 0)
+    int rc;
+
+    if (behavior == 0) {
+        lmgr_committed(p_mgr);
         return DB_SUCCESS;
-    else if (behavior == 1)
-        return db_exec_sql(&p_mgr->conn, "COMMIT", NULL);
-    else {
+    } else if (behavior == 1) {
+        rc = db_exec_sql(&p_mgr->conn, "COMMIT", NULL);
+        if (rc == DB_SUCCESS)
+            lmgr_committed(p_mgr);
+        return rc;
+    } else {
         /* if the transaction count is reached:
          * commit operations and result transaction count
          */
         if ((p_mgr->last_commit % behavior == 0) || p_mgr->force_commit) {
-            int rc;
             rc = db_exec_sql(&p_mgr->conn, "COMMIT", NULL);
             if (rc)
                 return rc;
 
             p_mgr->last_commit = 0;
+            lmgr_committed(p_mgr);
         }
     }
     return DB_SUCCESS;
@@ -1769,6 +1998,7 @@ int _lmgr_flush_commit(lmgr_t *p_mgr, int behavior)
             return rc;
 
         p_mgr->last_commit = 0;
+        lmgr_committed(p_mgr);
         return DB_SUCCESS;
     } else
         return DB_SUCCESS;
@@ -1777,7 +2007,7 @@ int _lmgr_flush_commit(lmgr_t *p_mgr, int behavior)
 int lmgr_table_count(db_conn_t *pconn, const char *table, uint64_t *count)
 {
     char *str_count = NULL;
-    result_handle_t result = NULL;
+    result_handle_t result;
     char *sql;
     int rc;
 
@@ -1790,15 +2020,11 @@ int lmgr_table_count(db_conn_t *pconn, const char *table, uint64_t *count)
         goto out_free;
 
     rc = db_next_record(pconn, &result, &str_count, 1);
-    if (rc)
-        goto out_free;
-
-    if (sscanf(str_count, "%" SCNu64, count) != 1)
+    if (rc == DB_SUCCESS && sscanf(str_count, "%" SCNu64, count) != 1)
         rc = DB_REQUEST_FAILED;
 
+    db_result_free(pconn, &result);
  out_free:
-    if (result != NULL)
-        db_result_free(pconn, &result);
     free(sql);
     return rc;
 }
@@ -2065,6 +2291,66 @@ int lmgr_range2list(const char *set, db_type_e type, value_list_t *p_list)
     return -1;
 }
 
+/* max number of prepared statements per connection (queries depend on
+ * attribute masks and batch sizes) */
+#define STMT_CACHE_MAX 256
+
+static gboolean stmt_cache_remove(gpointer key, gpointer value,
+                                  gpointer udata)
+{
+    lmgr_t *p_mgr = udata;
+
+    db_stmt_close(&p_mgr->conn, value);
+    return TRUE;
+}
+
+void lmgr_stmt_cache_flush(lmgr_t *p_mgr)
+{
+    if (p_mgr->stmt_cache != NULL)
+        g_hash_table_foreach_remove(p_mgr->stmt_cache, stmt_cache_remove,
+                                    p_mgr);
+}
+
+int lmgr_stmt_get(lmgr_t *p_mgr, const char *query, db_stmt_t **p_stmt)
+{
+    int rc;
+
+    if (p_mgr->stmt_cache == NULL)
+        p_mgr->stmt_cache = g_hash_table_new(g_str_hash, g_str_equal);
+
+    *p_stmt = g_hash_table_lookup(p_mgr->stmt_cache, query);
+    if (*p_stmt != NULL)
+        return DB_SUCCESS;
+
+    if (g_hash_table_size(p_mgr->stmt_cache) >= STMT_CACHE_MAX)
+    {
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Prepared statement cache is full:"
+                   " flushing it");
+        lmgr_stmt_cache_flush(p_mgr);
+    }
+
+    rc = db_stmt_prepare(&p_mgr->conn, query, p_stmt);
+    if (rc)
+        return rc;
+
+    /* the key is owned by the statement */
+    g_hash_table_insert(p_mgr->stmt_cache, (*p_stmt)->query, *p_stmt);
+    return DB_SUCCESS;
+}
+
+int lmgr_stmt_exec(lmgr_t *p_mgr, const char *query,
+                   const db_field_value_t *params, unsigned int nb_params,
+                   db_stmt_t **p_stmt)
+{
+    int rc;
+
+    rc = lmgr_stmt_get(p_mgr, query, p_stmt);
+    if (rc)
+        return rc;
+
+    return db_stmt_exec(&p_mgr->conn, *p_stmt, params, nb_params);
+}
+
 /** manage delayed retry of retryable errors
  * \return 1 if the transaction must be restarted
  * \return 2 if transaction must be cancelled
@@ -2098,6 +2384,13 @@ int _lmgr_delayed_retry(lmgr_t *lmgr, int errcode, const char *func, int line)
         return 0;
     }
 
+    /* statements don't survive a reconnection */
+    if (errcode == DB_CONNECT_FAILED)
+        lmgr_stmt_cache_flush(lmgr);
+
+    /* the transaction has been rolled back by the DB */
+    lmgr_acct_tx_abort(lmgr);
+
     /* Got TERM signal, must stop transactions and exit. */
     if (lmgr_cancel_retry)
         return 2;
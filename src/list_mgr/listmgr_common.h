@@ -424,6 +424,11 @@ static inline bool is_recov_field(unsigned int attr_index)
 void printdbtype(db_conn_t *pconn, GString *str, db_type_e type,
                  const db_type_u *value_ptr);
 
+/** convert a value to a prepared statement parameter
+ * @param values storage for string values */
+void dbtype2param(GStringChunk *values, db_type_e type,
+                  const db_type_u *value_ptr, db_field_value_t *param);
+
 /** parse a value from DB */
 int parsedbtype(char *instr, db_type_e type, db_type_u *value_out);
 
@@ -508,6 +513,10 @@ int attrmask2fieldoperation(GString *str, attr_mask_t attr_mask,
 int attrset2valuelist(lmgr_t *p_mgr, GString *str, const attr_set_t *p_set,
                       table_enum table, attrset_op_flag_e flags);
 
+int attrset2paramlist(GString *str, GArray *params, GStringChunk *values,
+                      const attr_set_t *p_set, table_enum table,
+                      attrset_op_flag_e flags);
+
 int attrset2updatelist(lmgr_t *p_mgr, GString *str, const attr_set_t *p_set,
                        table_enum table, attrset_op_flag_e flags);
 
@@ -559,6 +568,10 @@ void append_size_range_fields(GString *str, bool leading_comma,
 
 int result2attrset(table_enum table, char **result_tab, unsigned int res_count,
                    attr_set_t *p_set );
+/** same as result2attrset(), from the typed values of a statement result
+ * (see db_stmt_next_values()) */
+int values2attrset(table_enum table, const db_field_value_t *values,
+                   unsigned int count, attr_set_t *p_set);
 
 /* return the attr string for a dirattr */
 const char *dirattr2str(unsigned int attr_index);
@@ -598,10 +611,118 @@ static inline int lmgr_flush_commit(lmgr_t *p_mgr)
                                                        __LINE__)
 int _lmgr_delayed_retry(lmgr_t *lmgr, int errcode, const char *func, int line);
 
+/** Get a prepared statement for the given query from the connection
+ * cache, or prepare it. */
+int lmgr_stmt_get(lmgr_t *p_mgr, const char *query, db_stmt_t **p_stmt);
+
+/** Get a prepared statement for the given query and execute it.
+ * Its result (if any) must be released by db_stmt_free_result(). */
+int lmgr_stmt_exec(lmgr_t *p_mgr, const char *query,
+                   const db_field_value_t *params, unsigned int nb_params,
+                   db_stmt_t **p_stmt);
+
+/** Release all prepared statements of a connection. */
+void lmgr_stmt_cache_flush(lmgr_t *p_mgr);
+
 /* get/set variable in DB */
 int lmgr_get_var(db_conn_t *pconn, const char *varname, char *value,
                  int bufsize);
 int lmgr_set_var(db_conn_t *pconn, const char *varname, const char *value);
+int lmgr_clear_vars(db_conn_t *pconn, const char *prefix);
+/** add the names of the variables starting with prefix to names
+ * (as strings to be freed by g_free) */
+int lmgr_list_vars(db_conn_t *pconn, const char *prefix, GPtrArray *names);
+
+/** Drop secondary indexes and accounting triggers before an initial load.
+ * Accounting info is cleared. */
+int lmgr_bulk_suspend(db_conn_t *pconn);
+/** Build the indexes and accounting info dropped by lmgr_bulk_suspend(). */
+int lmgr_bulk_resume(db_conn_t *pconn);
+
+/* accounting aggregation (see listmgr_acct.c) */
+
+/** indicate if accounting info is maintained by robinhood instead of
+ * DB triggers */
+static inline bool lmgr_acct_aggregated(void)
+{
+    return lmgr_config.acct && lmgr_config.acct_aggregate;
+}
+
+/** append the request that computes accounting info from a table */
+void append_acct_select(GString *req, const char *table);
+
+void lmgr_acct_init(const char *src_table);
+/** indicate if the table is the source of accounting info */
+bool lmgr_acct_source(table_enum table);
+
+/** Add (sign=1) or subtract (sign=-1) the accounting info of entries
+ * matching the given id condition (all entries if NULL) to the changes
+ * of the current transaction. */
+int lmgr_acct_snapshot(lmgr_t *p_mgr, const char *id_cond, int sign);
+/** the current transaction is committed / rolled back */
+void lmgr_acct_tx_commit(lmgr_t *p_mgr);
+void lmgr_acct_tx_abort(lmgr_t *p_mgr);
+
+/** Write the committed changes to ACCT_STAT (if force is false,
+ * only if accounting_flush_interval has elapsed). */
+int lmgr_acct_flush(lmgr_t *p_mgr, bool force);
+/** drop the changes (accounting info has been rebuilt) */
+void lmgr_acct_reset(void);
+
+int lmgr_acct_open(lmgr_t *p_mgr);
+int lmgr_acct_close(lmgr_t *p_mgr);
+/** Check if the process that set the given ACCT_DELTAS_VAR marker is
+ * still running. */
+bool lmgr_acct_marker_alive(db_conn_t *pconn, const char *marker);
+
+/* cache of directory names (see listmgr_paths.c) */
+void lmgr_path_cache_init(void);
+/** If fullpath is in mask, replace it by the attributes it is built from.
+ * @param[out] extra the attributes added to mask.
+ * @return true if fullpath must be resolved by lmgr_path_cache_resolve().
+ */
+bool lmgr_path_cache_prepare(attr_mask_t *mask, attr_mask_t *extra);
+/** Set fullpath of entries from their parent_id and name,
+ * and remove extra attributes. */
+int lmgr_path_cache_resolve(lmgr_t *p_mgr, attr_set_t **p_attrs,
+                            unsigned int count, attr_mask_t extra);
+/** the names of the given entries changed, or the entries were removed,
+ * in the current transaction (invalidated when it ends) */
+void lmgr_path_cache_invalidate(lmgr_t *p_mgr, pktype *pks,
+                                unsigned int count);
+/** clear the cache now, and when the current transaction ends */
+void lmgr_path_cache_clear(lmgr_t *p_mgr);
+/** apply the invalidations of a committed or rolled back transaction */
+void lmgr_path_cache_tx_end(lmgr_t *p_mgr);
+void lmgr_path_cache_release(lmgr_t *p_mgr);
+
+/* connections to read replicas (see listmgr_pool.c) */
+int lmgr_pool_init(void);
+/** Get a connection for a read-only request: a connection to a replica,
+ * or p_mgr if no replica is available. */
+lmgr_t *lmgr_pool_get_reader(lmgr_t *p_mgr, const lmgr_iter_opt_t *p_opt);
+/** Give a connection to a replica back to the pool
+ * (failed: the replica could not be reached). */
+void lmgr_pool_put_reader(lmgr_t *p_reader, bool failed);
+
+/* report snapshot (see listmgr_snapshot.c) */
+typedef struct snapshot_result snapshot_result_t;
+/** Compute a report from the snapshot file.
+ * @return NULL if there is no recent snapshot, or if it can't be used
+ * for this report: the report must then be computed from the DB.
+ */
+snapshot_result_t *lmgr_snapshot_report(const report_field_descr_t *
+                                        report_desc_array,
+                                        unsigned int report_descr_count,
+                                        const profile_field_descr_t *
+                                        profile_descr,
+                                        const lmgr_filter_t *p_filter,
+                                        const lmgr_iter_opt_t *p_opt);
+/** Get the next row of the report, with the same fields as the
+ * result of the SQL request */
+int lmgr_snapshot_next(snapshot_result_t *res, char **row,
+                       unsigned int count);
+void lmgr_snapshot_free(snapshot_result_t *res);
 
 int fullpath_attr2db(const char *attr, char *db);
 void fullpath_db2attr(const char *db, char *attr);
@@ -48,6 +48,7 @@ static void lmgr_cfg_set_default(void *module_config)
     conf->db_config.port = 0;
     conf->db_config.socket[0] = '\0';
     strcpy(conf->db_config.engine, "InnoDB");
+    conf->db_config.read_servers[0] = '\0';
 
     /* Depending on the MariaDB version, the TokuDB compression
      * default can be either no compression or zlib compression. See
@@ -58,9 +59,27 @@ static void lmgr_cfg_set_default(void *module_config)
 #elif defined(_SQLITE)
     strcpy(conf->db_config.filepath, "/var/robinhood/robinhood_sqlite_db");
     conf->db_config.retry_delay_microsec = 1000;    /* 1ms */
+    strcpy(conf->db_config.journal_mode, "WAL");
+    conf->db_config.mmap_size = 256 * 1024 * 1024;  /* 256MB */
 #endif
 
     conf->acct = true;
+    conf->acct_aggregate = false;
+    conf->acct_flush_interval = 10;
+
+    conf->initial_load = false;
+    strcpy(conf->initial_load_dir, "/var/tmp");
+    conf->initial_load_chunk = 256 * 1024 * 1024;   /* 256MB */
+
+    conf->path_cache_size = 0;
+    conf->path_cache_ttl = 600;
+
+    conf->iterator_page_size = 0;
+
+    conf->snapshot_file[0] = '\0';
+    conf->snapshot_interval = 3600;
+
+    conf->policy_indexes = true;
 }
 
 static void lmgr_cfg_write_default(FILE *output)
@@ -70,6 +89,17 @@ static void lmgr_cfg_write_default(FILE *output)
     print_line(output, 1, "connect_retry_interval_min  : 1s");
     print_line(output, 1, "connect_retry_interval_max  : 30s");
     print_line(output, 1, "accounting  : enabled");
+    print_line(output, 1, "accounting_aggregation     : no");
+    print_line(output, 1, "accounting_flush_interval  : 10s");
+    print_line(output, 1, "initial_load            : no");
+    print_line(output, 1, "initial_load_dir        : \"/var/tmp\"");
+    print_line(output, 1, "initial_load_chunk_size : 256MB");
+    print_line(output, 1, "path_cache_size         : 0 (disabled)");
+    print_line(output, 1, "path_cache_ttl          : 10min");
+    print_line(output, 1, "iterator_page_size      : 0 (disabled)");
+    print_line(output, 1, "snapshot_file           : \"\" (disabled)");
+    print_line(output, 1, "snapshot_interval       : 1h");
+    print_line(output, 1, "policy_indexes          : yes");
     fprintf(output, "\n");
 
 #ifdef _MYSQL
@@ -81,12 +111,15 @@ static void lmgr_cfg_write_default(FILE *output)
     print_line(output, 2, "port    :   (MySQL default)");
     print_line(output, 2, "socket  :   NONE");
     print_line(output, 2, "engine  :   InnoDB");
+    print_line(output, 2, "read_servers : NONE");
     print_end_block(output, 1);
 #elif defined(_SQLITE)
     print_begin_block(output, 1, SQLITE_CONFIG_BLOCK, NULL);
     print_line(output, 2,
                "db_file              :  \"/var/robinhood/robinhood_sqlite_db\"");
     print_line(output, 2, "retry_delay_microsec :  1000 (1 millisec)");
+    print_line(output, 2, "journal_mode         :  WAL");
+    print_line(output, 2, "mmap_size            :  256MB");
     print_end_block(output, 1);
 #endif
 
@@ -107,7 +140,11 @@ static int lmgr_cfg_read(config_file_t config, void *module_config,
 
     static const char *lmgr_allowed[] = {
         "commit_behavior", "connect_retry_interval_min",
-        "connect_retry_interval_max", "accounting",
+        "connect_retry_interval_max", "accounting", "accounting_aggregation",
+        "accounting_flush_interval", "initial_load",
+        "initial_load_dir", "initial_load_chunk_size", "path_cache_size",
+        "path_cache_ttl", "iterator_page_size", "snapshot_file",
+        "snapshot_interval", "policy_indexes",
         MYSQL_CONFIG_BLOCK, SQLITE_CONFIG_BLOCK,
         "user_acct", "group_acct",  /* deprecated => accounting */
         NULL
@@ -119,13 +156,33 @@ static int lmgr_cfg_read(config_file_t config, void *module_config,
         {"connect_retry_interval_max", PT_DURATION, PFLG_POSITIVE |
          PFLG_NOT_NULL, &conf->connect_retry_max, 0},
         {"accounting", PT_BOOL, 0, &conf->acct, 0},
+        {"accounting_aggregation", PT_BOOL, 0, &conf->acct_aggregate, 0},
+        {"accounting_flush_interval", PT_DURATION, PFLG_POSITIVE |
+         PFLG_NOT_NULL, &conf->acct_flush_interval, 0},
+        {"initial_load", PT_BOOL, 0, &conf->initial_load, 0},
+        {"initial_load_dir", PT_STRING, PFLG_ABSOLUTE_PATH |
+         PFLG_NO_WILDCARDS | PFLG_REMOVE_FINAL_SLASH, conf->initial_load_dir,
+         sizeof(conf->initial_load_dir)},
+        {"initial_load_chunk_size", PT_SIZE, PFLG_POSITIVE | PFLG_NOT_NULL,
+         &conf->initial_load_chunk, 0},
+        {"path_cache_size", PT_INT, PFLG_POSITIVE, &conf->path_cache_size,
+         0},
+        {"path_cache_ttl", PT_DURATION, PFLG_POSITIVE,
+         &conf->path_cache_ttl, 0},
+        {"iterator_page_size", PT_INT, PFLG_POSITIVE,
+         &conf->iterator_page_size, 0},
+        {"snapshot_file", PT_STRING, PFLG_ABSOLUTE_PATH | PFLG_NO_WILDCARDS,
+         conf->snapshot_file, sizeof(conf->snapshot_file)},
+        {"snapshot_interval", PT_DURATION, PFLG_POSITIVE | PFLG_NOT_NULL,
+         &conf->snapshot_interval, 0},
+        {"policy_indexes", PT_BOOL, 0, &conf->policy_indexes, 0},
         END_OF_PARAMS
     };
 
 #ifdef _MYSQL
     static const char *db_allowed[] = {
         "server", "db", "user", "password", "password_file", "port", "socket",
-        "engine", "tokudb_compression", NULL
+        "engine", "tokudb_compression", "read_servers", NULL
     };
 
     const cfg_param_t db_params[] = {
@@ -150,11 +207,14 @@ static int lmgr_cfg_read(config_file_t config, void *module_config,
          conf->db_config.tokudb_compression,
          sizeof(conf->db_config.tokudb_compression)}
         ,
+        {"read_servers", PT_STRING, PFLG_NO_WILDCARDS,
+         conf->db_config.read_servers, sizeof(conf->db_config.read_servers)}
+        ,
         END_OF_PARAMS
     };
 #elif defined(_SQLITE)
     static const char *db_allowed[] = {
-        "db_file", "retry_delay_microsec",
+        "db_file", "retry_delay_microsec", "journal_mode", "mmap_size",
         NULL
     };
     const cfg_param_t db_params[] = {
@@ -163,6 +223,9 @@ static int lmgr_cfg_read(config_file_t config, void *module_config,
         ,
         {"retry_delay_microsec", PT_INT, PFLG_POSITIVE | PFLG_NOT_NULL,
          (int *)&conf->db_config.retry_delay_microsec, 0},
+        {"journal_mode", PT_STRING, PFLG_NO_WILDCARDS,
+         conf->db_config.journal_mode, sizeof(conf->db_config.journal_mode)},
+        {"mmap_size", PT_SIZE, PFLG_POSITIVE, &conf->db_config.mmap_size, 0},
         END_OF_PARAMS
     };
 #endif
@@ -325,6 +388,63 @@ static int lmgr_cfg_reload(lmgr_config_t *conf)
                    LMGR_CONFIG_BLOCK
                    "::accounting changed in config file, but cannot be modified dynamically");
 
+    if (conf->acct_aggregate != lmgr_config.acct_aggregate)
+        DisplayLog(LVL_MAJOR, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::accounting_aggregation changed in config file, but cannot be modified dynamically");
+
+    if (conf->acct_flush_interval != lmgr_config.acct_flush_interval) {
+        DisplayLog(LVL_EVENT, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::accounting_flush_interval updated: %ld->%ld",
+                   lmgr_config.acct_flush_interval, conf->acct_flush_interval);
+        lmgr_config.acct_flush_interval = conf->acct_flush_interval;
+    }
+
+    if (conf->initial_load != lmgr_config.initial_load)
+        DisplayLog(LVL_MAJOR, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::initial_load changed in config file, but cannot be modified dynamically");
+
+    if (conf->path_cache_size != lmgr_config.path_cache_size)
+        DisplayLog(LVL_MAJOR, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::path_cache_size changed in config file, but cannot be modified dynamically");
+
+    if (conf->path_cache_ttl != lmgr_config.path_cache_ttl) {
+        DisplayLog(LVL_EVENT, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::path_cache_ttl updated: %ld->%ld",
+                   lmgr_config.path_cache_ttl, conf->path_cache_ttl);
+        lmgr_config.path_cache_ttl = conf->path_cache_ttl;
+    }
+
+    if (conf->iterator_page_size != lmgr_config.iterator_page_size) {
+        DisplayLog(LVL_EVENT, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::iterator_page_size updated: %u->%u",
+                   lmgr_config.iterator_page_size, conf->iterator_page_size);
+        lmgr_config.iterator_page_size = conf->iterator_page_size;
+    }
+
+    if (strcmp(conf->snapshot_file, lmgr_config.snapshot_file))
+        DisplayLog(LVL_MAJOR, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::snapshot_file changed in config file, but cannot be modified dynamically");
+
+    if (conf->snapshot_interval != lmgr_config.snapshot_interval) {
+        DisplayLog(LVL_EVENT, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::snapshot_interval updated: %ld->%ld",
+                   lmgr_config.snapshot_interval, conf->snapshot_interval);
+        lmgr_config.snapshot_interval = conf->snapshot_interval;
+    }
+
+    if (conf->policy_indexes != lmgr_config.policy_indexes)
+        DisplayLog(LVL_MAJOR, TAG,
+                   LMGR_CONFIG_BLOCK
+                   "::policy_indexes changed in config file, but cannot be modified dynamically");
+
     if (conf->connect_retry_min != lmgr_config.connect_retry_min) {
         DisplayLog(LVL_EVENT, TAG,
                    LMGR_CONFIG_BLOCK
@@ -358,12 +478,28 @@ static int lmgr_cfg_reload(lmgr_config_t *conf)
         DisplayLog(LVL_MAJOR, TAG,
                    MYSQL_CONFIG_BLOCK
                    "::password changed in config file, but cannot be modified dynamically");
+    if (strcmp(conf->db_config.read_servers,
+               lmgr_config.db_config.read_servers))
+        DisplayLog(LVL_MAJOR, TAG,
+                   MYSQL_CONFIG_BLOCK
+                   "::read_servers changed in config file, but cannot be modified dynamically");
 #elif defined(_SQLITE)
     if (strcmp(conf->db_config.filepath, lmgr_config.db_config.filepath))
         DisplayLog(LVL_MAJOR, TAG,
                    SQLITE_CONFIG_BLOCK
                    "::db_file changed in config file, but cannot be modified dynamically");
 
+    if (strcmp(conf->db_config.journal_mode,
+               lmgr_config.db_config.journal_mode))
+        DisplayLog(LVL_MAJOR, TAG,
+                   SQLITE_CONFIG_BLOCK
+                   "::journal_mode changed in config file, but cannot be modified dynamically");
+
+    if (conf->db_config.mmap_size != lmgr_config.db_config.mmap_size)
+        DisplayLog(LVL_MAJOR, TAG,
+                   SQLITE_CONFIG_BLOCK
+                   "::mmap_size changed in config file, but cannot be modified dynamically");
+
     if (conf->db_config.retry_delay_microsec !=
         lmgr_config.db_config.retry_delay_microsec) {
         DisplayLog(LVL_EVENT, TAG,
@@ -414,6 +550,52 @@ static void lmgr_cfg_write_template(FILE *output)
                "# disable the following options if you are not interested in");
     print_line(output, 1, "# user or group stats (to speed up scan)");
     print_line(output, 1, "accounting  = enabled ;");
+    print_line(output, 1,
+               "# Maintain accounting info in robinhood instead of DB triggers,");
+    print_line(output, 1,
+               "# and write it to the DB periodically (reduces lock contention");
+    print_line(output, 1, "# between DB_APPLY threads).");
+    print_line(output, 1, "#accounting_aggregation = yes ;");
+    print_line(output, 1, "#accounting_flush_interval = 10s ;");
+    fprintf(output, "\n");
+    print_line(output, 1,
+               "# Load the entries of the first scan (into an empty DB) by large chunks,");
+    print_line(output, 1,
+               "# and build indexes and accounting info at the end of the scan.");
+    print_line(output, 1,
+               "# Requires 'local_infile' to be enabled on the MySQL server.");
+    print_line(output, 1, "#initial_load = yes ;");
+    print_line(output, 1, "#initial_load_dir = \"/var/tmp\" ;");
+    print_line(output, 1, "#initial_load_chunk_size = 256MB ;");
+    fprintf(output, "\n");
+    print_line(output, 1,
+               "# Build entry paths from a cache of directory names, instead of");
+    print_line(output, 1,
+               "# DB functions. Changes done by other processes are seen after");
+    print_line(output, 1, "# path_cache_ttl.");
+    print_line(output, 1, "#path_cache_size = 1000000 ;");
+    print_line(output, 1, "#path_cache_ttl = 10min ;");
+    fprintf(output, "\n");
+    print_line(output, 1,
+               "# Read iterator results (e.g. policy candidates) by pages");
+    print_line(output, 1,
+               "# of this size, instead of a single long-running request.");
+    print_line(output, 1, "#iterator_page_size = 100000 ;");
+    fprintf(output, "\n");
+    print_line(output, 1,
+               "# The daemon periodically exports entry attributes to this");
+    print_line(output, 1,
+               "# file. rbh-report computes supported reports from it instead");
+    print_line(output, 1,
+               "# of querying the DB, unless it is older than 2 intervals.");
+    print_line(output, 1, "#snapshot_file = \"/var/robinhood/report_snapshot\" ;");
+    print_line(output, 1, "#snapshot_interval = 1h ;");
+    fprintf(output, "\n");
+    print_line(output, 1,
+               "# Build the indexes needed by the configured policies, when");
+    print_line(output, 1,
+               "# policies are started. If disabled, they are only reported.");
+    print_line(output, 1, "#policy_indexes = yes ;");
     fprintf(output, "\n");
 #ifdef _MYSQL
     print_begin_block(output, 1, MYSQL_CONFIG_BLOCK, NULL);
@@ -424,11 +606,19 @@ static void lmgr_cfg_write_template(FILE *output)
     print_line(output, 2, "# port   = 3306 ;");
     print_line(output, 2, "# socket = \"/tmp/mysql.sock\" ;");
     print_line(output, 2, "engine = InnoDB ;");
+    print_line(output, 2,
+               "# route iterators and reports to read-only replicas");
+    print_line(output, 2, "# read_servers = \"replica1,replica2:3307\" ;");
     print_end_block(output, 1);
 #elif defined(_SQLITE)
     print_begin_block(output, 1, SQLITE_CONFIG_BLOCK, NULL);
     print_line(output, 2, "db_file = \"/var/robinhood/robinhood_sqlite_db\" ;");
     print_line(output, 2, "retry_delay_microsec = 1000 ;");
+    print_line(output, 2,
+               "# WAL journal allows reading the DB while it is modified");
+    print_line(output, 2, "journal_mode = WAL ;");
+    print_line(output, 2, "# size of the DB file mapped in memory");
+    print_line(output, 2, "mmap_size = 256MB ;");
     print_end_block(output, 1);
 #endif
 
@@ -459,5 +649,6 @@ mod_cfg_funcs_t lmgr_cfg_hdlr = {
 
 bool lmgr_parallel_batches(void)
 {
-    return !lmgr_config.acct;
+    /* no trigger on entry tables when accounting is aggregated */
+    return !lmgr_config.acct || lmgr_config.acct_aggregate;
 }
@@ -23,6 +23,7 @@
 #include "database.h"
 #include "rbh_logs.h"
 #include "rbh_misc.h"
+#include "Memory.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,53 +31,46 @@
 
 int ListMgr_Exists(lmgr_t *p_mgr, const entry_id_t *p_id)
 {
-    GString        *req;
     int             rc;
-    result_handle_t result;
+    db_stmt_t      *stmt;
     char           *str_count = NULL;
     DEF_PK(pk);
+    db_field_value_t params[1] = {{.str = pk}};
     int             retry_status;
 
     /* retrieve primary key */
     entry_id2pk(p_id, PTR_PK(pk));
 
-    /* verify it exists in main table */
-    req = g_string_new("SELECT id FROM " MAIN_TABLE " WHERE id=");
-    g_string_append_printf(req, DPK, pk);
-
 retry:
-    /* execute the request (must return negative value on error) */
-    rc = -db_exec_sql(&p_mgr->conn, req->str, &result);
+    /* verify it exists in main table
+     * (execute the request, must return negative value on error) */
+    rc = -lmgr_stmt_exec(p_mgr, "SELECT id FROM " MAIN_TABLE " WHERE id=?",
+                         params, 1, &stmt);
     retry_status = lmgr_delayed_retry(p_mgr, -rc);
     if (retry_status == 1)
         goto retry;
-    else if (retry_status == 2) {
-        rc = -DB_RBH_SIG_SHUTDOWN;
-        goto free_str;
-    } else if (rc)
-        goto free_str;
+    else if (retry_status == 2)
+        return -DB_RBH_SIG_SHUTDOWN;
+    else if (rc)
+        return rc;
 
-    rc = db_next_record(&p_mgr->conn, &result, &str_count, 1);
+    rc = db_stmt_next_record(&p_mgr->conn, stmt, &str_count, 1);
     if (rc == 0)
         rc = 1; /* return 1 if entry exists */
     else if (rc != DB_END_OF_LIST)
     {
-        retry_status = lmgr_delayed_retry(p_mgr, -rc);
+        db_stmt_free_result(&p_mgr->conn, stmt);
+        retry_status = lmgr_delayed_retry(p_mgr, rc);
         if (retry_status == 1)
             goto retry;
-        else if (retry_status == 2) {
-            rc = -DB_RBH_SIG_SHUTDOWN;
-            goto free_result;
-        }
+        else if (retry_status == 2)
+            return -DB_RBH_SIG_SHUTDOWN;
+        return -rc;
     }
     else
         rc = 0;
 
-free_result:
-    db_result_free(&p_mgr->conn, &result);
-
-free_str:
-    g_string_free(req, TRUE);
+    db_stmt_free_result(&p_mgr->conn, stmt);
     return rc;
 }
 
@@ -216,6 +210,62 @@ static void clean_std_table_bits(attr_mask_t *p_mask)
                                | names_attr_set.sm_info);
 }
 
+/**
+ * Retrieve the attributes that are not stored in main, annex and names tables
+ * (stripe info, directory attributes).
+ * @param[in,out] checkmain set to false if the entry was found by this call.
+ */
+static int get_secondary_attrs(lmgr_t *p_mgr, PK_ARG_T pk, attr_set_t *p_info,
+                               bool *checkmain)
+{
+#ifdef _LUSTRE
+    int rc;
+#endif
+
+    /* remove stripe info if it is not a file */
+    if (stripe_fields(p_info->attr_mask) && ATTR_MASK_TEST(p_info, type)
+        && strcmp(ATTR(p_info, type), STR_TYPE_FILE) != 0)
+    {
+        p_info->attr_mask = attr_mask_and_not(&p_info->attr_mask, &stripe_attr_set);
+    }
+
+    /* get stripe info if asked */
+#ifdef _LUSTRE
+    if (stripe_fields(p_info->attr_mask))
+    {
+        rc = get_stripe_info(p_mgr, pk, &ATTR(p_info, stripe_info),
+                             ATTR_MASK_TEST(p_info, stripe_items)?
+                                &ATTR(p_info, stripe_items) : NULL);
+        if (rc == DB_ATTR_MISSING || rc == DB_NOT_EXISTS)
+        {
+            /* stripe info is in std mask */
+            p_info->attr_mask.std &= ~ATTR_MASK_stripe_info;
+
+            if (ATTR_MASK_TEST(p_info, stripe_items))
+                p_info->attr_mask.std &= ~ATTR_MASK_stripe_items;
+        }
+        else if (rc)
+            return rc;
+        else
+            *checkmain = false; /* entry exists */
+    }
+#else
+    /* POSIX: always clean stripe bits */
+    p_info->attr_mask = attr_mask_and_not(&p_info->attr_mask, &stripe_attr_set);
+#endif
+
+    /* special field dircount */
+    if (dirattr_fields(p_info->attr_mask))
+    {
+        if (listmgr_get_dirattrs(p_mgr, pk, p_info))
+        {
+            DisplayLog(LVL_MAJOR, LISTMGR_TAG, "listmgr_get_dirattrs failed for "DPK, pk);
+            p_info->attr_mask = attr_mask_and_not(&p_info->attr_mask, &dir_attr_set);
+        }
+    }
+    return DB_SUCCESS;
+}
+
 /**
  *  Retrieve entry attributes from its primary key
  */
@@ -226,13 +276,17 @@ int listmgr_get_by_pk( lmgr_t * p_mgr, PK_ARG_T pk, attr_set_t * p_info )
     GString        *req, *from;
     /* attribute count is up to 1 per bit (8 per byte).
      * x2 for bullet proofing */
-    char           *result_tab[2*8*sizeof(p_info->attr_mask)];
-    result_handle_t result;
+    char           *result_tab[1];
+    db_field_value_t values[2*8*sizeof(p_info->attr_mask)];
+    db_stmt_t      *stmt;
+    db_field_value_t params[1] = {{.str = (char *)pk}};
     bool            checkmain   = true;
     int             main_count  = 0,
                     annex_count = 0,
                     name_count  = 0;
     attr_mask_t     gen = gen_fields(p_info->attr_mask);
+    attr_mask_t     path_extra;
+    bool            cached_path;
 
     if (p_info == NULL)
         return 0;
@@ -251,6 +305,9 @@ int listmgr_get_by_pk( lmgr_t * p_mgr, PK_ARG_T pk, attr_set_t * p_info )
      */
     supported_bits_only(&p_info->attr_mask);
 
+    /* get parent and name instead of computing fullpath in the DB */
+    cached_path = lmgr_path_cache_prepare(&p_info->attr_mask, &path_extra);
+
     /* get info from main table (if asked) */
     main_count = attrmask2fieldlist(req, p_info->attr_mask, T_MAIN, "", "", 0);
     if (main_count < 0)
@@ -310,15 +367,18 @@ int listmgr_get_by_pk( lmgr_t * p_mgr, PK_ARG_T pk, attr_set_t * p_info )
     {
         int shift = 0;
 
-        g_string_append_printf(req, "%s WHERE %s.id="DPK, from->str,
-                               first_table, pk);
+        /* the request only depends on the attribute mask:
+         * use a prepared statement */
+        g_string_append_printf(req, "%s WHERE %s.id=?", from->str,
+                               first_table);
 
-        rc = db_exec_sql(&p_mgr->conn, req->str, &result);
+        rc = lmgr_stmt_exec(p_mgr, req->str, params, 1, &stmt);
         if (rc)
             goto free_str;
 
-        rc = db_next_record(&p_mgr->conn, &result, result_tab,
-                            main_count + annex_count + name_count);
+        /* integer fields are read in binary form */
+        rc = db_stmt_next_values(&p_mgr->conn, stmt, values,
+                                 main_count + annex_count + name_count);
         /* END_OF_LIST means it does not exist */
         if (rc == DB_END_OF_LIST)
         {
@@ -336,86 +396,44 @@ int listmgr_get_by_pk( lmgr_t * p_mgr, PK_ARG_T pk, attr_set_t * p_info )
         /* set info from result */
         if (main_count)
         {
-            rc = result2attrset(T_MAIN, result_tab + shift, main_count, p_info);
+            rc = values2attrset(T_MAIN, values + shift, main_count, p_info);
             shift += main_count;
             if (rc)
                 goto free_res;
         }
         if (annex_count)
         {
-            rc = result2attrset(T_ANNEX, result_tab + shift, annex_count,
-                                p_info);
+            rc = values2attrset(T_ANNEX, values + shift, annex_count, p_info);
             shift += annex_count;
             if (rc)
                 goto free_res;
         }
         if (name_count)
         {
-            rc = result2attrset(T_DNAMES, result_tab + shift, name_count,
-                                p_info);
+            rc = values2attrset(T_DNAMES, values + shift, name_count, p_info);
             shift += name_count;
             if (rc)
                 goto free_res;
         }
 
 next_table:
-        db_result_free(&p_mgr->conn, &result);
-    }
-
-    /* remove stripe info if it is not a file */
-    if (stripe_fields(p_info->attr_mask) && ATTR_MASK_TEST(p_info, type)
-        && strcmp(ATTR(p_info, type), STR_TYPE_FILE) != 0)
-    {
-        p_info->attr_mask = attr_mask_and_not(&p_info->attr_mask, &stripe_attr_set);
-    }
-
-    /* get stripe info if asked */
-#ifdef _LUSTRE
-    if (stripe_fields(p_info->attr_mask))
-    {
-        rc = get_stripe_info(p_mgr, pk, &ATTR(p_info, stripe_info),
-                             ATTR_MASK_TEST(p_info, stripe_items)?
-                                &ATTR(p_info, stripe_items) : NULL);
-        if (rc == DB_ATTR_MISSING || rc == DB_NOT_EXISTS)
-        {
-            /* stripe info is in std mask */
-            p_info->attr_mask.std &= ~ATTR_MASK_stripe_info;
-
-            if (ATTR_MASK_TEST(p_info, stripe_items))
-                p_info->attr_mask.std &= ~ATTR_MASK_stripe_items;
-        }
-        else if (rc)
-            goto free_str;
-        else
-            checkmain = false; /* entry exists */
+        db_stmt_free_result(&p_mgr->conn, stmt);
     }
-#else
-    /* POSIX: always clean stripe bits */
-    p_info->attr_mask = attr_mask_and_not(&p_info->attr_mask, &stripe_attr_set);
-#endif
 
-    /* special field dircount */
-    if (dirattr_fields(p_info->attr_mask))
-    {
-        if (listmgr_get_dirattrs(p_mgr, pk, p_info))
-        {
-            DisplayLog(LVL_MAJOR, LISTMGR_TAG, "listmgr_get_dirattrs failed for "DPK, pk);
-            p_info->attr_mask = attr_mask_and_not(&p_info->attr_mask, &dir_attr_set);
-        }
-    }
+    rc = get_secondary_attrs(p_mgr, pk, p_info, &checkmain);
+    if (rc)
+        goto free_str;
 
     if (checkmain)
     {
         /* verify it exists in main table */
-        g_string_printf(req, "SELECT id FROM " MAIN_TABLE " WHERE id="DPK, pk);
-
-        /* execute the request */
-        rc = db_exec_sql(&p_mgr->conn, req->str, &result);
+        rc = lmgr_stmt_exec(p_mgr, "SELECT id FROM " MAIN_TABLE " WHERE id=?",
+                            params, 1, &stmt);
         if (rc)
             goto free_str;
 
-        rc = db_next_record(&p_mgr->conn, &result, result_tab, 1);
-        db_result_free(&p_mgr->conn, &result);
+        rc = db_stmt_next_record(&p_mgr->conn, stmt, result_tab, 1);
+        db_stmt_free_result(&p_mgr->conn, stmt);
         if (rc)
         {
             rc = DB_NOT_EXISTS;
@@ -423,6 +441,13 @@ next_table:
         }
     }
 
+    if (cached_path)
+    {
+        rc = lmgr_path_cache_resolve(p_mgr, &p_info, 1, path_extra);
+        if (rc)
+            goto free_str;
+    }
+
     /* restore generated fields in attr mask */
     p_info->attr_mask = attr_mask_or(&p_info->attr_mask, &gen);
     /* generate them */
@@ -435,8 +460,14 @@ next_table:
     goto free_str;
 
   free_res:
-    db_result_free(&p_mgr->conn, &result);
+    db_stmt_free_result(&p_mgr->conn, stmt);
   free_str:
+    if (rc && cached_path)
+    {
+        /* restore the requested mask, in case the request is retried */
+        p_info->attr_mask = attr_mask_and_not(&p_info->attr_mask, &path_extra);
+        attr_mask_set_index(&p_info->attr_mask, ATTR_INDEX_fullpath);
+    }
     g_string_free(req, TRUE);
     g_string_free(from, TRUE);
     return rc;
@@ -462,6 +493,235 @@ retry:
 }
 
 
+/**
+ * Retrieve the attributes of a batch of entries from main, annex and names
+ * tables with a single multi-row request, then get their secondary attributes
+ * one by one.
+ */
+static int listmgr_batch_get_by_pk(lmgr_t *p_mgr, pktype *pks,
+                                   attr_set_t **p_attrs, unsigned int count,
+                                   int *rcs)
+{
+    int             rc;
+    unsigned int    i;
+    GString        *req;
+    db_field_value_t values[1 + 2*8*sizeof(p_attrs[0]->attr_mask)];
+    db_stmt_t      *stmt;
+    db_field_value_t *params;
+    int             main_count, annex_count, name_count;
+    attr_mask_t     mask = p_attrs[0]->attr_mask;
+    attr_mask_t     gen = gen_fields(mask);
+    attr_mask_t     path_extra;
+    bool            cached_path;
+
+    add_source_fields_for_gen(&mask.std);
+    supported_bits_only(&mask);
+    cached_path = lmgr_path_cache_prepare(&mask, &path_extra);
+
+    for (i = 0; i < count; i++)
+    {
+        memset(&p_attrs[i]->attr_values, 0, sizeof(entry_info_t));
+        p_attrs[i]->attr_mask = mask;
+        rcs[i] = DB_NOT_EXISTS;
+    }
+
+    params = MemCalloc(count, sizeof(*params));
+    if (params == NULL)
+        return DB_NO_MEMORY;
+
+    /* always join from MAIN_TABLE, so the same request tells
+     * if the entry exists */
+    req = g_string_new("SELECT "MAIN_TABLE".id");
+
+    main_count = attrmask2fieldlist(req, mask, T_MAIN, "", "",
+                                    AOF_LEADING_SEP);
+    if (main_count < 0)
+    {
+        rc = -main_count;
+        goto free_str;
+    }
+    annex_count = attrmask2fieldlist(req, mask, T_ANNEX, "", "",
+                                     AOF_LEADING_SEP);
+    if (annex_count < 0)
+    {
+        rc = -annex_count;
+        goto free_str;
+    }
+    name_count = attrmask2fieldlist(req, mask, T_DNAMES, "", "",
+                                    AOF_LEADING_SEP);
+    if (name_count < 0)
+    {
+        rc = -name_count;
+        goto free_str;
+    }
+
+    g_string_append(req, " FROM "MAIN_TABLE);
+    if (annex_count > 0)
+        g_string_append(req, " LEFT JOIN "ANNEX_TABLE" ON "MAIN_TABLE".id="
+                        ANNEX_TABLE".id");
+    if (name_count > 0)
+        g_string_append(req, " LEFT JOIN "DNAMES_TABLE" ON "MAIN_TABLE".id="
+                        DNAMES_TABLE".id");
+
+    /* the statement depends on the attribute mask and the batch size */
+    g_string_append(req, " WHERE "MAIN_TABLE".id IN (");
+    for (i = 0; i < count; i++)
+    {
+        g_string_append(req, i == 0 ? "?" : ",?");
+        params[i].str = pks[i];
+    }
+    g_string_append_c(req, ')');
+
+    rc = lmgr_stmt_exec(p_mgr, req->str, params, count, &stmt);
+    if (rc)
+        goto free_str;
+
+    while ((rc = db_stmt_next_values(&p_mgr->conn, stmt, values,
+                                     1 + main_count + annex_count
+                                     + name_count)) == DB_SUCCESS)
+    {
+        int shift = 1;
+        attr_set_t *p_info = NULL;
+
+        if (values[0].str == NULL)
+            continue;
+
+        /* several records can be returned for an entry with multiple paths:
+         * only take the first one, to get consistent parent_id, name and
+         * fullpath. */
+        for (i = 0; i < count; i++)
+        {
+            if (rcs[i] == DB_NOT_EXISTS && !strcmp(values[0].str, pks[i]))
+            {
+                p_info = p_attrs[i];
+                break;
+            }
+        }
+        if (p_info == NULL)
+            continue;
+
+        rcs[i] = DB_SUCCESS;
+
+        if (main_count)
+        {
+            rc = values2attrset(T_MAIN, values + shift, main_count, p_info);
+            shift += main_count;
+            if (rc)
+                goto free_res;
+        }
+        if (annex_count)
+        {
+            rc = values2attrset(T_ANNEX, values + shift, annex_count, p_info);
+            shift += annex_count;
+            if (rc)
+                goto free_res;
+        }
+        if (name_count)
+        {
+            rc = values2attrset(T_DNAMES, values + shift, name_count, p_info);
+            shift += name_count;
+            if (rc)
+                goto free_res;
+        }
+    }
+    if (rc != DB_END_OF_LIST)
+        goto free_res;
+    db_stmt_free_result(&p_mgr->conn, stmt);
+
+    if (cached_path)
+    {
+        /* build the paths of all found entries at once */
+        attr_set_t **found = MemCalloc(count, sizeof(*found));
+        unsigned int nb_found = 0;
+
+        if (found == NULL)
+        {
+            rc = DB_NO_MEMORY;
+            goto free_str;
+        }
+        for (i = 0; i < count; i++)
+            if (rcs[i] == DB_SUCCESS)
+                found[nb_found++] = p_attrs[i];
+
+        rc = lmgr_path_cache_resolve(p_mgr, found, nb_found, path_extra);
+        MemFree(found);
+        if (rc)
+            goto free_str;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        bool dummy;
+
+        if (rcs[i] != DB_SUCCESS)
+        {
+            ATTR_MASK_INIT(p_attrs[i]);
+            continue;
+        }
+
+        rc = get_secondary_attrs(p_mgr, pks[i], p_attrs[i], &dummy);
+        if (rc)
+            goto free_str;
+
+        /* restore generated fields in attr mask */
+        p_attrs[i]->attr_mask = attr_mask_or(&p_attrs[i]->attr_mask, &gen);
+        generate_fields(p_attrs[i]);
+
+        p_mgr->nbop[OPIDX_GET]++;
+    }
+
+    rc = DB_SUCCESS;
+    goto free_str;
+
+  free_res:
+    db_stmt_free_result(&p_mgr->conn, stmt);
+  free_str:
+    g_string_free(req, TRUE);
+    MemFree(params);
+    return rc;
+}
+
+int ListMgr_BatchGet(lmgr_t *p_mgr, entry_id_t **p_ids, attr_set_t **p_attrs,
+                     unsigned int count, int *rcs)
+{
+    int          rc;
+    unsigned int i;
+    pktype      *pks;
+    attr_mask_t  mask;
+    int          retry_status;
+
+    if (count == 0)
+        return DB_SUCCESS;
+    else if (count == 1)
+    {
+        rcs[0] = ListMgr_Get(p_mgr, p_ids[0], p_attrs[0]);
+        return (rcs[0] == DB_NOT_EXISTS) ? DB_SUCCESS : rcs[0];
+    }
+
+    pks = MemCalloc(count, sizeof(pktype));
+    if (pks == NULL)
+        return DB_NO_MEMORY;
+
+    for (i = 0; i < count; i++)
+        entry_id2pk(p_ids[i], PTR_PK(pks[i]));
+
+    /* keep the requested mask, in case the request must be retried */
+    mask = p_attrs[0]->attr_mask;
+retry:
+    rc = listmgr_batch_get_by_pk(p_mgr, pks, p_attrs, count, rcs);
+    retry_status = lmgr_delayed_retry(p_mgr, rc);
+    if (retry_status == 1)
+    {
+        p_attrs[0]->attr_mask = mask;
+        goto retry;
+    }
+    else if (retry_status == 2)
+        rc = DB_RBH_SIG_SHUTDOWN;
+
+    MemFree(pks);
+    return rc;
+}
+
 /* Retrieve the FID from the database given the parent FID and the file name. */
 int ListMgr_Get_FID_from_Path( lmgr_t * p_mgr, const entry_id_t * parent_fid,
                                const char *name, entry_id_t * fid)
@@ -22,9 +22,11 @@
 #include "listmgr_common.h"
 #include "rbh_logs.h"
 #include "rbh_misc.h"
+#include "RW_Lock.h"
 #include <stdio.h>
 #include <pwd.h>
 #include <grp.h>
+#include <pthread.h>
 
 /* global symbols */
 static const char *acct_info_table = NULL;
@@ -1337,6 +1339,51 @@ static int run_create_index(db_conn_t *pconn, const char *table_name,
     return DB_SUCCESS;
 }
 
+/**
+ * Get the list of indexed fields of a table (in addition to its primary
+ * key).
+ * @return an array of field names, to be released by g_ptr_array_free().
+ */
+static GPtrArray *table_index_fields(table_enum table)
+{
+    GPtrArray *fields = g_ptr_array_new();
+    int i, cookie;
+
+    cookie = -1;
+    while ((i = attr_index_iter(0, &cookie)) != -1) {
+        if (match_table(table, i) && is_indexed_field(i))
+            g_ptr_array_add(fields, (char *)field_name(i));
+    }
+
+    /* this index is needed to build the fullpath of entries */
+    if (table == T_DNAMES)
+        g_ptr_array_add(fields, "id");
+
+    return fields;
+}
+
+/** create the secondary indexes of a table */
+static int create_table_indexes(db_conn_t *pconn, table_enum table)
+{
+    GString *request = g_string_new(NULL);
+    GPtrArray *fields = table_index_fields(table);
+    const char *f;
+    int i, rc = DB_SUCCESS;
+
+    for (i = 0; i < fields->len; i++) {
+        f = g_ptr_array_index(fields, i);
+        g_string_printf(request, "CREATE INDEX %s_index ON %s(%s)", f,
+                        table2name(table), f);
+        rc = run_create_index(pconn, table2name(table), f, request->str);
+        if (rc)
+            break;
+    }
+
+    g_ptr_array_free(fields, TRUE);
+    g_string_free(request, TRUE);
+    return rc;
+}
+
 static void append_engine(GString *request)
 {
 #ifdef _MYSQL
@@ -1450,19 +1497,7 @@ static int create_table_main(db_conn_t *pconn, bool *affects_trig)
         goto free_str;
 
     /* create indexes on this table */
-    cookie = -1;
-    while ((i = attr_index_iter(0, &cookie)) != -1) {
-        if (is_main_field(i) && is_indexed_field(i)) {
-            g_string_printf(request,
-                            "CREATE INDEX %s_index ON " MAIN_TABLE "(%s)",
-                            field_name(i), field_name(i));
-            rc = run_create_index(pconn, MAIN_TABLE, field_name(i),
-                                  request->str);
-            if (rc)
-                goto free_str;
-        }
-    }
-    rc = DB_SUCCESS;
+    rc = create_table_indexes(pconn, T_MAIN);
 
  free_str:
     g_string_free(request, TRUE);
@@ -1527,22 +1562,8 @@ static int create_table_dnames(db_conn_t *pconn, bool *affects_trig)
         goto free_str;
 
     /* create indexes on this table */
-    cookie = -1;
-    while ((i = attr_index_iter(0, &cookie)) != -1) {
-        if (is_names_field(i) && is_indexed_field(i)) {
-            g_string_printf(request,
-                            "CREATE INDEX %s_index ON " DNAMES_TABLE "(%s)",
-                            field_name(i), field_name(i));
-            rc = run_create_index(pconn, DNAMES_TABLE, field_name(i),
-                                  request->str);
-            if (rc)
-                goto free_str;
-        }
-    }
+    rc = create_table_indexes(pconn, T_DNAMES);
 
-    /* this index is needed to build the fullpath of entries */
-    rc = run_create_index(pconn, DNAMES_TABLE, "id",
-                          "CREATE INDEX id_index ON " DNAMES_TABLE "(id)");
  free_str:
     g_string_free(request, TRUE);
     return rc;
@@ -1614,19 +1635,7 @@ static int create_table_annex(db_conn_t *pconn, bool *affects_trig)
         goto free_str;
 
     /* create indexes on this table */
-    cookie = -1;
-    while ((i = attr_index_iter(0, &cookie)) != -1) {
-        if (is_annex_field(i) && is_indexed_field(i)) {
-            g_string_printf(request,
-                            "CREATE INDEX %s_index ON " ANNEX_TABLE "(%s)",
-                            field_name(i), field_name(i));
-            rc = run_create_index(pconn, ANNEX_TABLE, field_name(i),
-                                  request->str);
-            if (rc)
-                goto free_str;
-        }
-    }
-    rc = DB_SUCCESS;
+    rc = create_table_indexes(pconn, T_ANNEX);
 
  free_str:
     g_string_free(request, TRUE);
@@ -1918,7 +1927,7 @@ static int check_table_acct(db_conn_t *pconn, bool *affects_trig)
 
 static int populate_acct_table(db_conn_t *pconn)
 {
-    int i, rc;
+    int rc;
     GString *request = NULL;
     char err_buf[1024];
     char timestr[256] = "";
@@ -1947,19 +1956,10 @@ static int populate_acct_table(db_conn_t *pconn)
     g_string_append(request, ", " ACCT_FIELD_COUNT);
     append_size_range_fields(request, true, "");
 
-    /* ...SELECT <fields>... */
-    g_string_append(request, ") SELECT ");
-    attrmask2fieldlist(request, acct_pk_attr_set, T_ACCT, "", "", 0);
-    attrmask2fieldlist(request, acct_attr_set, T_ACCT, "SUM(", ")",
-                       AOF_LEADING_SEP);
-    g_string_append(request, ",COUNT(id),SUM(size=0)");
-    for (i = 1; i < SZ_PROFIL_COUNT - 1; i++)   /* 1 to 8 */
-        g_string_append_printf(request, ",SUM(" SZRANGE_FUNC "(size)=%u)",
-                               i - 1);
-    g_string_append_printf(request, ",SUM(" SZRANGE_FUNC "(size)>=%u)", i - 1);
-
-    /* FROM ... GROUP BY ... */
-    g_string_append_printf(request, " FROM %s  GROUP BY ", acct_info_table);
+    /* ...SELECT <fields> FROM ... GROUP BY ... */
+    g_string_append(request, ") ");
+    append_acct_select(request, acct_info_table);
+    g_string_append(request, " GROUP BY ");
     attrmask2fieldlist(request, acct_pk_attr_set, T_ACCT, "", "", 0);
 
     rc = db_exec_sql(pconn, request->str, NULL);
@@ -2259,8 +2259,8 @@ static int check_trig_acct_insert(db_conn_t *pconn, bool *affects_trig)
     int rc;
     char strbuf[4096];
 
-    if (!lmgr_config.acct) {
-        /* no acct: must delete trigger */
+    if (!lmgr_config.acct || lmgr_acct_aggregated()) {
+        /* no acct (or maintained by robinhood): must delete trigger */
         if (!report_only) {
             DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Dropping trigger %s",
                        ACCT_TRIGGER_INSERT);
@@ -2288,8 +2288,8 @@ static int check_trig_acct_delete(db_conn_t *pconn, bool *affects_trig)
 {
     int rc;
     char strbuf[4096];
-    if (!lmgr_config.acct) {
-        /* no acct: must delete trigger */
+    if (!lmgr_config.acct || lmgr_acct_aggregated()) {
+        /* no acct (or maintained by robinhood): must delete trigger */
         if (!report_only) {
             DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Dropping trigger %s",
                        ACCT_TRIGGER_DELETE);
@@ -2317,8 +2317,8 @@ static int check_trig_acct_update(db_conn_t *pconn, bool *affects_trig)
 {
     int rc;
     char strbuf[4096];
-    if (!lmgr_config.acct) {
-        /* no acct: must delete trigger */
+    if (!lmgr_config.acct || lmgr_acct_aggregated()) {
+        /* no acct (or maintained by robinhood): must delete trigger */
         if (!report_only) {
             DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Dropping trigger %s",
                        ACCT_TRIGGER_UPDATE);
@@ -2777,6 +2777,196 @@ static const dbobj_descr_t o_list[] = {
     {0, NULL, NULL, NULL}   /* STOP item */
 };
 
+/** tables whose indexes are not maintained during an initial load */
+static const table_enum bulk_tables[] = {T_MAIN, T_DNAMES, T_ANNEX};
+
+/**
+ * Add or drop the secondary indexes of a table (only the ones that
+ * exist/don't exist), in a single request.
+ */
+static int alter_table_indexes(db_conn_t *pconn, table_enum table, bool add)
+{
+    GPtrArray *fields = table_index_fields(table);
+    GString *request;
+    char index[128];
+    const char *f;
+    unsigned int nb = 0;
+    int i, rc = DB_SUCCESS;
+
+    request = g_string_new("ALTER TABLE ");
+    g_string_append(request, table2name(table));
+
+    for (i = 0; i < fields->len; i++) {
+        f = g_ptr_array_index(fields, i);
+        snprintf(index, sizeof(index), "%s_index", f);
+
+        rc = db_check_component(pconn, DBOBJ_INDEX, index, table2name(table));
+        if (rc == DB_SUCCESS && add)
+            continue;
+        else if (rc == DB_NOT_EXISTS && !add)
+            continue;
+        else if (rc != DB_SUCCESS && rc != DB_NOT_EXISTS)
+            goto out;
+
+        if (add)
+            g_string_append_printf(request, "%s ADD INDEX %s(%s)",
+                                   nb > 0 ? "," : "", index, f);
+        else
+            g_string_append_printf(request, "%s DROP INDEX %s",
+                                   nb > 0 ? "," : "", index);
+        nb++;
+    }
+
+    rc = DB_SUCCESS;
+    if (nb == 0)
+        goto out;
+
+    DisplayLog(LVL_EVENT, LISTMGR_TAG, "%s %u indexes of table %s...",
+               add ? "Building" : "Dropping", nb, table2name(table));
+    FlushLogs();
+
+    rc = db_exec_sql(pconn, request->str, NULL);
+    if (rc) {
+        char errmsg[1024];
+
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to %s indexes of %s: "
+                   "Error: %s", add ? "create" : "drop", table2name(table),
+                   db_errmsg(pconn, errmsg, sizeof(errmsg)));
+    }
+ out:
+    g_ptr_array_free(fields, TRUE);
+    g_string_free(request, TRUE);
+    return rc;
+}
+
+int lmgr_bulk_suspend(db_conn_t *pconn)
+{
+    const char *trig[] = {ACCT_TRIGGER_INSERT, ACCT_TRIGGER_DELETE,
+                          ACCT_TRIGGER_UPDATE, NULL};
+    char errmsg[1024];
+    int i, rc;
+
+    for (i = 0; i < sizeof(bulk_tables) / sizeof(*bulk_tables); i++) {
+        rc = alter_table_indexes(pconn, bulk_tables[i], false);
+        if (rc)
+            return rc;
+    }
+
+    if (!lmgr_config.acct)
+        return DB_SUCCESS;
+
+    for (i = 0; trig[i] != NULL && !lmgr_acct_aggregated(); i++) {
+        rc = db_drop_component(pconn, DBOBJ_TRIGGER, trig[i]);
+        if (rc != DB_SUCCESS && rc != DB_TRG_NOT_EXISTS) {
+            DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to drop %s trigger: "
+                       "Error: %s", trig[i],
+                       db_errmsg(pconn, errmsg, sizeof(errmsg)));
+            return rc;
+        }
+    }
+
+    /* accounting is computed again at the end of the load */
+    return db_exec_sql(pconn, "DELETE FROM " ACCT_TABLE, NULL);
+}
+
+int lmgr_bulk_resume(db_conn_t *pconn)
+{
+    bool dummy = false;
+    int i, rc;
+
+    for (i = 0; i < sizeof(bulk_tables) / sizeof(*bulk_tables); i++) {
+        rc = alter_table_indexes(pconn, bulk_tables[i], true);
+        if (rc)
+            return rc;
+    }
+
+    if (!lmgr_config.acct)
+        return DB_SUCCESS;
+
+    /* changes that occurred during the load are in the entries */
+    lmgr_acct_reset();
+
+    rc = db_exec_sql(pconn, "DELETE FROM " ACCT_TABLE, NULL);
+    if (rc)
+        return rc;
+    rc = populate_acct_table(pconn);
+    if (rc)
+        return rc;
+
+    if (lmgr_acct_aggregated())
+        return DB_SUCCESS;
+
+    rc = create_trig_acct_insert(pconn, &dummy);
+    if (rc)
+        return rc;
+    rc = create_trig_acct_delete(pconn, &dummy);
+    if (rc)
+        return rc;
+    return create_trig_acct_update(pconn, &dummy);
+}
+
+/**
+ * Rebuild ACCT_STAT if a process terminated before writing its accounting
+ * changes (its ACCT_DELTAS_VAR marker is left, and it is no longer running).
+ * The rebuild is postponed while other processes are running, as their
+ * pending changes would be applied twice.
+ */
+static int recover_acct_deltas(db_conn_t *pconn, bool acct_rebuilt)
+{
+    GPtrArray *markers;
+    unsigned int i, nb_dead = 0;
+    bool alive = false;
+    int rc;
+
+    markers = g_ptr_array_new_with_free_func(g_free);
+    rc = lmgr_list_vars(pconn, ACCT_DELTAS_VAR, markers);
+    if (rc)
+        goto out;
+
+    for (i = 0; i < markers->len; i++) {
+        const char *m = g_ptr_array_index(markers, i);
+
+        if (lmgr_acct_marker_alive(pconn, m)) {
+            DisplayLog(LVL_DEBUG, LISTMGR_TAG, "%s: process is running", m);
+            alive = true;
+        } else {
+            nb_dead++;
+        }
+    }
+
+    if (nb_dead == 0)
+        goto out;
+
+    if (alive) {
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Accounting changes of a previous "
+                   "run may not have been written, but other processes are "
+                   "running: postponing the rebuild of accounting info");
+        goto out;
+    }
+
+    if (lmgr_config.acct && !acct_rebuilt) {
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Accounting changes of a "
+                   "previous run may not have been written: rebuilding "
+                   "accounting info");
+        rc = db_exec_sql(pconn, "DELETE FROM " ACCT_TABLE, NULL);
+        if (rc)
+            goto out;
+        rc = populate_acct_table(pconn);
+        if (rc)
+            goto out;
+    }
+
+    for (i = 0; i < markers->len; i++) {
+        rc = lmgr_set_var(pconn, g_ptr_array_index(markers, i), NULL);
+        if (rc)
+            goto out;
+    }
+
+ out:
+    g_ptr_array_free(markers, TRUE);
+    return rc;
+}
+
 /**
  * Initialize the database access module and
  * check and create the schema.
@@ -2789,6 +2979,8 @@ int ListMgr_Init(enum lmgr_init_flags flags)
     bool create_all_functions = false;
     bool create_all_triggers = false;
     bool dummy;
+    bool acct_rebuilt = false;
+    char varval[1024];
 
     /* store the parameter as a global variable */
     init_flags = flags;
@@ -2800,6 +2992,11 @@ int ListMgr_Init(enum lmgr_init_flags flags)
 
     /* determine source tables for accounting */
     acct_info_table = acct_table();
+    lmgr_acct_init(acct_info_table);
+    lmgr_path_cache_init();
+    rc = lmgr_pool_init();
+    if (rc)
+        return rc;
 
     /* create a database access */
     rc = db_connect(&conn);
@@ -2860,6 +3057,30 @@ int ListMgr_Init(enum lmgr_init_flags flags)
         }
     }
 
+    /* indexes and accounting may be missing if an initial load was
+     * interrupted */
+    if (!report_only && lmgr_get_var(&conn, INITIAL_LOAD_VAR, varval,
+                                     sizeof(varval)) == DB_SUCCESS) {
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Initial load started at %s "
+                   "did not complete: building indexes and accounting "
+                   "info", varval);
+        rc = lmgr_bulk_resume(&conn);
+        if (rc)
+            goto close_conn;
+        rc = lmgr_set_var(&conn, INITIAL_LOAD_VAR, NULL);
+        if (rc)
+            goto close_conn;
+        acct_rebuilt = true;
+    }
+
+    /* accounting changes may have been lost if the previous process
+     * terminated abnormally */
+    if (!report_only) {
+        rc = recover_acct_deltas(&conn, acct_rebuilt);
+        if (rc)
+            goto close_conn;
+    }
+
     if (create_all_triggers && !report_only) {
         rc = set_triggers_version(&conn, &dummy);
         if (rc)
@@ -2884,6 +3105,13 @@ int ListMgr_InitAccess(lmgr_t *p_mgr)
 {
     int rc, i;
 
+    /* statements are prepared on first use */
+    p_mgr->stmt_cache = NULL;
+    p_mgr->acct_pending = NULL;
+    p_mgr->path_inval = NULL;
+    p_mgr->path_clear = false;
+    p_mgr->replica = false;
+
     rc = db_connect(&p_mgr->conn);
 
     if (rc)
@@ -2910,6 +3138,9 @@ int ListMgr_InitAccess(lmgr_t *p_mgr)
     for (i = 0; i < OPCOUNT; i++)
         p_mgr->nbop[i] = 0;
 
+    if (!report_only)
+        return lmgr_acct_open(p_mgr);
+
     return 0;
 }
 
@@ -2920,8 +3151,212 @@ int ListMgr_CloseAccess(lmgr_t *p_mgr)
     /* force to commit queued requests */
     rc = lmgr_flush_commit(p_mgr);
 
+    /* write accounting changes */
+    if (!report_only) {
+        int rc2 = lmgr_acct_close(p_mgr);
+
+        if (rc == DB_SUCCESS)
+            rc = rc2;
+    }
+
+    if (p_mgr->stmt_cache != NULL)
+    {
+        lmgr_stmt_cache_flush(p_mgr);
+        g_hash_table_destroy(p_mgr->stmt_cache);
+        p_mgr->stmt_cache = NULL;
+    }
+    lmgr_path_cache_release(p_mgr);
+
     /* close connexion */
     db_close_conn(&p_mgr->conn);
 
     return rc;
 }
+
+/** interval between progress messages of index creation */
+#define INDEX_PROGRESS_INTERVAL 60
+
+typedef struct index_build {
+    const char      *name;
+    time_t           start;
+    bool             done;
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;
+} index_build_t;
+
+#ifdef _MYSQL
+/**
+ * Get the progress of the running ALTER TABLE from performance_schema.
+ * It is only available if 'stage/innodb/alter table%' instruments and
+ * 'events_stages_current' consumer are enabled.
+ * @return progress in percent, or -1 if unknown.
+ */
+static int index_build_progress(db_conn_t *pconn)
+{
+    result_handle_t result;
+    char *res[2] = { NULL, NULL };
+    int pct = -1;
+
+    if (db_exec_sql_quiet(pconn, "SELECT WORK_COMPLETED,WORK_ESTIMATED FROM "
+                          "performance_schema.events_stages_current WHERE "
+                          "EVENT_NAME LIKE 'stage/innodb/alter table%'",
+                          &result) != DB_SUCCESS)
+        return -1;
+
+    if (db_next_record(pconn, &result, res, 2) == DB_SUCCESS
+        && res[0] != NULL && res[1] != NULL && str2bigint(res[1]) > 0)
+        pct = (100 * str2bigint(res[0])) / str2bigint(res[1]);
+
+    db_result_free(pconn, &result);
+    return pct;
+}
+#endif
+
+/** thread that reports the progress of an index creation */
+static void *index_progress_thr(void *arg)
+{
+    index_build_t *build = arg;
+#ifdef _MYSQL
+    db_conn_t conn;
+    bool connected = (db_connect(&conn) == DB_SUCCESS);
+#endif
+
+    P(build->lock);
+    while (!build->done) {
+        struct timespec ts = {.tv_sec = time(NULL) + INDEX_PROGRESS_INTERVAL };
+        int pct = -1;
+
+        pthread_cond_timedwait(&build->cond, &build->lock, &ts);
+        if (build->done)
+            break;
+
+#ifdef _MYSQL
+        if (connected)
+            pct = index_build_progress(&conn);
+#endif
+        if (pct >= 0)
+            DisplayLog(LVL_EVENT, LISTMGR_TAG, "Creating index %s: %d%% "
+                       "done (%lus elapsed)", build->name, pct,
+                       time(NULL) - build->start);
+        else
+            DisplayLog(LVL_EVENT, LISTMGR_TAG, "Creating index %s: "
+                       "%lus elapsed", build->name,
+                       time(NULL) - build->start);
+    }
+    V(build->lock);
+
+#ifdef _MYSQL
+    if (connected)
+        db_close_conn(&conn);
+#endif
+    return NULL;
+}
+
+int ListMgr_EnsureIndex(lmgr_t *p_mgr, const unsigned int *attrs,
+                        unsigned int count, const char *reason)
+{
+    GString *name, *cols, *request;
+    index_build_t build;
+    pthread_t thr;
+    uint64_t entries = 0;
+    unsigned int i;
+    char errmsg[1024];
+    bool thr_ok;
+    int rc;
+
+    if (count == 0)
+        return DB_INVALID_ARG;
+
+    for (i = 0; i < count; i++)
+        if (!is_main_field(attrs[i]))
+            return DB_NOT_SUPPORTED;
+
+    /* single field indexes are managed by ListMgr_Init() */
+    if (count == 1 && is_indexed_field(attrs[0]))
+        return DB_SUCCESS;
+
+    name = g_string_new(NULL);
+    cols = g_string_new(NULL);
+
+    for (i = 0; i < count; i++) {
+        const char *f = field_name(attrs[i]);
+
+        g_string_append_printf(name, "%s%s", i == 0 ? "" : "_", f);
+        g_string_append_printf(cols, "%s%s", i == 0 ? "" : ",", f);
+#ifdef _MYSQL
+        /* only index the beginning of long strings */
+        if (field_type(attrs[i]) == DB_TEXT && field_size(attrs[i]) > 255)
+            g_string_append(cols, "(255)");
+#endif
+    }
+    /* max identifier length is 64 */
+    if (name->len > 58)
+        g_string_truncate(name, 58);
+    g_string_append(name, "_index");
+
+    rc = db_check_component(&p_mgr->conn, DBOBJ_INDEX, name->str,
+                            MAIN_TABLE);
+    if (rc != DB_NOT_EXISTS)
+        goto out;
+
+    if (!lmgr_config.policy_indexes) {
+        DisplayLog(LVL_EVENT, LISTMGR_TAG, "Index on " MAIN_TABLE "(%s) is "
+                   "recommended for %s: set ListManager::policy_indexes "
+                   "to create it", cols->str, reason);
+        rc = DB_SUCCESS;
+        goto out;
+    }
+
+    if (lmgr_table_count(&p_mgr->conn, MAIN_TABLE, &entries) != DB_SUCCESS)
+        entries = 0;
+
+    DisplayLog(LVL_EVENT, LISTMGR_TAG, "Creating index %s on " MAIN_TABLE
+               "(%s) for %s (%llu entries)...", name->str, cols->str,
+               reason, (unsigned long long)entries);
+
+    request = g_string_new(NULL);
+#ifdef _MYSQL
+    /* the table remains readable and writable during index creation */
+    g_string_printf(request, "ALTER TABLE " MAIN_TABLE " ADD INDEX %s(%s), "
+                    "ALGORITHM=INPLACE, LOCK=NONE", name->str, cols->str);
+#else
+    g_string_printf(request, "CREATE INDEX IF NOT EXISTS %s ON " MAIN_TABLE
+                    "(%s)", name->str, cols->str);
+#endif
+
+    build.name = name->str;
+    build.start = time(NULL);
+    build.done = false;
+    pthread_mutex_init(&build.lock, NULL);
+    pthread_cond_init(&build.cond, NULL);
+    thr_ok = (pthread_create(&thr, NULL, index_progress_thr, &build) == 0);
+
+    DisplayLog(LVL_FULL, LISTMGR_TAG, "Index creation request =\n%s",
+               request->str);
+    rc = db_exec_sql(&p_mgr->conn, request->str, NULL);
+
+    P(build.lock);
+    build.done = true;
+    pthread_cond_signal(&build.cond);
+    V(build.lock);
+    if (thr_ok)
+        pthread_join(thr, NULL);
+    pthread_cond_destroy(&build.cond);
+    pthread_mutex_destroy(&build.lock);
+
+    if (rc)
+        /* don't retry with a locking algorithm: this would block
+         * the table for the whole index creation */
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Failed to create index %s on "
+                   MAIN_TABLE "(%s): Error: %s", name->str, cols->str,
+                   db_errmsg(&p_mgr->conn, errmsg, sizeof(errmsg)));
+    else
+        DisplayLog(LVL_EVENT, LISTMGR_TAG, "Index %s created in %lus",
+                   name->str, time(NULL) - build.start);
+
+    g_string_free(request, TRUE);
+ out:
+    g_string_free(name, TRUE);
+    g_string_free(cols, TRUE);
+    return rc;
+}
@@ -99,8 +99,12 @@ static int run_batch_insert(lmgr_t *p_mgr,
 {
     GString    *req = NULL;
     int         rc = DB_SUCCESS;
-    int         i;
+    int         i, nb_fields;
     bool        first;
+    bool        use_stmt;
+    GArray     *params = NULL;
+    GStringChunk *values = NULL;
+    db_stmt_t  *stmt;
 
     if (unlikely(extra_field_name != NULL && extra_field_value == NULL))
         return DB_INVALID_ARG;
@@ -110,10 +114,20 @@ static int run_batch_insert(lmgr_t *p_mgr,
     g_string_append_printf(req, "%s(id", table2name(table));
 
     /* do nothing if no field is to be set */
-    if ((attrmask2fieldlist(req, full_mask, table, "", "", AOF_LEADING_SEP) <= 0)
-        && (extra_field_name == NULL))
+    nb_fields = attrmask2fieldlist(req, full_mask, table, "", "",
+                                   AOF_LEADING_SEP);
+    if ((nb_fields <= 0) && (extra_field_name == NULL))
         goto free_str;
 
+    /* values are sent as statement parameters, unless there are too many */
+    use_stmt = (count * (MAX(nb_fields, 0) + 1) <= DB_MAX_STMT_PARAMS);
+    if (use_stmt)
+    {
+        params = g_array_sized_new(FALSE, FALSE, sizeof(db_field_value_t),
+                                   count * (MAX(nb_fields, 0) + 1));
+        values = g_string_chunk_new(4096);
+    }
+
     if (extra_field_name != NULL)
         g_string_append_printf(req,",%s) VALUES ", extra_field_name);
     else
@@ -126,8 +140,22 @@ static int run_batch_insert(lmgr_t *p_mgr,
         if (!entry_filter(table, update, pklist[i], p_attrs[i]))
             continue;
 
-        g_string_append_printf(req, "%s("DPK, first ? "" : ",", pklist[i]);
-        attrset2valuelist(p_mgr, req, p_attrs[i], table, AOF_LEADING_SEP);
+        if (use_stmt)
+        {
+            db_field_value_t id = {.str = pklist[i]};
+
+            g_string_append(req, first ? "(?" : ",(?");
+            g_array_append_val(params, id);
+            attrset2paramlist(req, params, values, p_attrs[i], table,
+                              AOF_LEADING_SEP);
+        }
+        else
+        {
+            g_string_append_printf(req, "%s("DPK, first ? "" : ",",
+                                   pklist[i]);
+            attrset2valuelist(p_mgr, req, p_attrs[i], table,
+                              AOF_LEADING_SEP);
+        }
 
         if (extra_field_value != NULL)
             g_string_append_printf(req,",%s)", extra_field_value);
@@ -152,13 +180,49 @@ static int run_batch_insert(lmgr_t *p_mgr,
         attrset2updatelist(p_mgr, req, &fake_attrs, table, AOF_GENERIC_VAL);
     }
 
-    rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+    if (use_stmt)
+        rc = lmgr_stmt_exec(p_mgr, req->str,
+                            &g_array_index(params, db_field_value_t, 0),
+                            params->len, &stmt);
+    else
+        rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
 
 free_str:
+    if (params != NULL)
+        g_array_free(params, TRUE);
+    if (values != NULL)
+        g_string_chunk_free(values);
     g_string_free(req, TRUE);
     return rc;
 }
 
+#ifdef _LUSTRE
+int listmgr_batch_insert_stripes_no_tx(lmgr_t *p_mgr, entry_id_t **p_ids,
+                                       pktype *pklist, attr_set_t **p_attrs,
+                                       unsigned int count)
+{
+    int  i, rc;
+    /* create validator list */
+    int *validators = (int*)MemCalloc(count, sizeof(int));
+
+    if (!validators)
+        return DB_NO_MEMORY;
+
+    for (i = 0; i < count; i++)
+#ifdef HAVE_LLAPI_FSWAP_LAYOUTS
+        validators[i] = ATTR_MASK_TEST(p_attrs[i], stripe_info)?
+                            ATTR(p_attrs[i],stripe_info).validator:VALID_NOSTRIPE;
+#else
+        validators[i] = VALID(p_ids[i]);
+#endif
+
+    rc = batch_insert_stripe_info(p_mgr, pklist, validators, p_attrs,
+                                  count, true);
+    MemFree(validators);
+    return rc;
+}
+#endif
+
 int listmgr_batch_insert_no_tx(lmgr_t * p_mgr, entry_id_t **p_ids,
                                attr_set_t **p_attrs,
                                unsigned int count,
@@ -169,6 +233,7 @@ int listmgr_batch_insert_no_tx(lmgr_t * p_mgr, entry_id_t **p_ids,
     attr_mask_t       full_mask;
     attr_mask_t       all_bits_on = {.std = ~0, .status = ~0, .sm_info = ~0LL};
     pktype        *pklist = NULL;
+    GString       *acct_cond = NULL;
 
     full_mask = sum_masks(p_attrs, count, all_bits_on);
     pklist = (pktype *)MemCalloc(count, sizeof(pktype));
@@ -190,6 +255,23 @@ int listmgr_batch_insert_no_tx(lmgr_t * p_mgr, entry_id_t **p_ids,
         entry_id2pk(p_ids[i], PTR_PK(pklist[i])); /* The same for all tables? */
     }
 
+    if (lmgr_acct_aggregated())
+    {
+        acct_cond = g_string_new(" IN (");
+        for (i = 0; i < count; i++)
+            g_string_append_printf(acct_cond, "%s"DPK, i == 0 ? "" : ",",
+                                   pklist[i]);
+        g_string_append(acct_cond, ")");
+
+        /* previous accounting info of existing entries */
+        if (update_if_exists)
+        {
+            rc = lmgr_acct_snapshot(p_mgr, acct_cond->str, -1);
+            if (rc)
+                goto out_free;
+        }
+    }
+
     rc = run_batch_insert(p_mgr, full_mask, pklist, p_attrs,
                           count, T_MAIN, update_if_exists,
                           true, NULL, NULL);
@@ -206,6 +288,9 @@ int listmgr_batch_insert_no_tx(lmgr_t * p_mgr, entry_id_t **p_ids,
                               T_DNAMES, true, false, "pkn", HNAME_DEF);
         if (rc)
             goto out_free;
+
+        /* entries may have been renamed, or cached with no name */
+        lmgr_path_cache_invalidate(p_mgr, pklist, count);
     }
     else if (!update_if_exists) /* warn for create operations without name information */
     {
@@ -228,30 +313,19 @@ int listmgr_batch_insert_no_tx(lmgr_t * p_mgr, entry_id_t **p_ids,
     /* batch insert of striping info */
     if (stripe_fields(full_mask))
     {
-        /* create validator list */
-        int *validators = (int*)MemCalloc(count, sizeof(int));
-        if (!validators)
-        {
-            rc =  DB_NO_MEMORY;
-            goto out_free;
-        }
-        for (i = 0; i < count; i++)
-#ifdef HAVE_LLAPI_FSWAP_LAYOUTS
-            validators[i] = ATTR_MASK_TEST(p_attrs[i], stripe_info)?
-                                ATTR(p_attrs[i],stripe_info).validator:VALID_NOSTRIPE;
-#else
-            validators[i] = VALID(p_ids[i]);
-#endif
-
-        rc = batch_insert_stripe_info(p_mgr, pklist, validators, p_attrs,
-                                      count, true);
-        MemFree(validators);
+        rc = listmgr_batch_insert_stripes_no_tx(p_mgr, p_ids, pklist, p_attrs,
+                                                count);
         if (rc)
             goto out_free;
     }
 #endif
 
+    if (acct_cond != NULL)
+        rc = lmgr_acct_snapshot(p_mgr, acct_cond->str, 1);
+
 out_free:
+    if (acct_cond != NULL)
+        g_string_free(acct_cond, TRUE);
     MemFree(pklist);
     return rc;
 }
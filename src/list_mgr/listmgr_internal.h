@@ -83,6 +83,12 @@ int listmgr_get_funcattrs(lmgr_t *p_mgr, PK_ARG_T pk, attr_set_t *p_attrs);
 int listmgr_batch_insert_no_tx(lmgr_t *p_mgr, entry_id_t **p_ids,
                                attr_set_t **p_attrs, unsigned int count,
                                bool update_if_exists);
+#ifdef _LUSTRE
+/** insert (or update) the stripe info of entries */
+int listmgr_batch_insert_stripes_no_tx(lmgr_t *p_mgr, entry_id_t **p_ids,
+                                       pktype *pklist, attr_set_t **p_attrs,
+                                       unsigned int count);
+#endif
 
 int listmgr_remove_no_tx(lmgr_t *p_mgr, const entry_id_t *p_id,
                          const attr_set_t *p_attr_set, bool last);
@@ -92,6 +98,9 @@ typedef struct lmgr_iterator_t {
     lmgr_iter_opt_t  opt;
     result_handle_t  select_result;
     unsigned int     opt_is_set:1;
+    unsigned int     on_replica:1;
+    /** result read by pages (NULL if it is read by a single request) */
+    struct iter_pager *pager;
 } lmgr_iterator_t;
 
 #ifdef _LUSTRE
@@ -26,6 +26,8 @@
 #include "rbh_misc.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 /* generate a select query that defines the given dirattr with the given name.
  * (for FILTERDIR_OTHER types)
@@ -196,6 +198,417 @@ static int select_all_request(lmgr_t *p_mgr, GString *req,
     return DB_SUCCESS;
 }
 
+/** page of an iterator result */
+typedef struct iter_page {
+    unsigned int  count;
+    /** next row to be returned */
+    unsigned int  next;
+    /** max number of rows requested (the last page has less rows) */
+    unsigned int  limit;
+    char        **ids;
+    /** value of the sort attribute for each row */
+    char        **keys;
+} iter_page_t;
+
+typedef enum {
+    PAGE_NONE,      /**< no next page */
+    PAGE_RUNNING,   /**< next page is being read */
+    PAGE_READY,     /**< next page has been read */
+} page_state_e;
+
+/**
+ * Keyset pagination of an iterator result: each page is read by a request
+ * that resumes after the sort key and id of the last entry of the previous
+ * page. The next page is read by a thread, with a connection of its own,
+ * while the entries of the current page are returned.
+ */
+struct iter_pager {
+    /** connection to read pages */
+    lmgr_t         *p_mgr;
+    bool            on_replica;
+
+    /** SELECT id[,key] FROM ... [WHERE ...] */
+    GString        *base;
+    bool            has_where;
+    char           *id_field;
+    /** sort attribute (NULL if no sort order is requested) */
+    char           *key_field;
+    bool            desc;
+    /** remaining number of entries to be read (if list_count_max is set) */
+    bool            limited;
+    unsigned int    remaining;
+
+    iter_page_t     curr;
+    iter_page_t     next;
+    page_state_e    next_state;
+    int             next_rc;
+    pthread_t       thread;
+};
+
+/** max number of columns in the output of EXPLAIN */
+#define EXPLAIN_MAX_COLS 16
+
+/** log the execution plan of a request */
+static void explain_request(lmgr_t *p_mgr, const char *req)
+{
+    GString *str = g_string_new(NULL);
+    GString *line = g_string_new(NULL);
+    result_handle_t result;
+    char *res[EXPLAIN_MAX_COLS];
+    int i, n, rc;
+
+#ifdef _SQLITE
+    g_string_printf(str, "EXPLAIN QUERY PLAN %s", req);
+#else
+    g_string_printf(str, "EXPLAIN %s", req);
+#endif
+    rc = db_exec_sql_quiet(&p_mgr->conn, str->str, &result);
+    if (rc) {
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Failed to get the execution plan "
+                   "of request: %s", req);
+        goto out;
+    }
+
+    DisplayLog(LVL_EVENT, LISTMGR_TAG, "Execution plan of request: %s", req);
+    for (;;) {
+        memset(res, 0, sizeof(res));
+        rc = db_next_record(&p_mgr->conn, &result, res, EXPLAIN_MAX_COLS);
+        if (rc)
+            break;
+
+        /* ignore trailing NULL columns */
+        for (n = EXPLAIN_MAX_COLS; n > 0 && res[n - 1] == NULL; n--)
+            ;
+
+        g_string_truncate(line, 0);
+        for (i = 0; i < n; i++)
+            g_string_append_printf(line, "%s%s", i == 0 ? "" : " | ",
+                                   res[i] != NULL ? res[i] : "NULL");
+        DisplayLog(LVL_EVENT, LISTMGR_TAG, "    %s", line->str);
+    }
+    db_result_free(&p_mgr->conn, &result);
+
+ out:
+    g_string_free(line, TRUE);
+    g_string_free(str, TRUE);
+}
+
+static void page_free(iter_page_t *page)
+{
+    unsigned int i;
+
+    for (i = 0; i < page->count; i++) {
+        g_free(page->ids[i]);
+        g_free(page->keys[i]);
+    }
+    MemFree(page->ids);
+    MemFree(page->keys);
+    memset(page, 0, sizeof(*page));
+}
+
+/** append the condition to resume after the given entry */
+static int append_keyset_cond(struct iter_pager *pg, GString *req,
+                              const char *last_id, const char *last_key)
+{
+    const char *cmp = pg->desc ? "<" : ">";
+    char *esc;
+    size_t len;
+
+    g_string_append(req, pg->has_where ? " AND " : " WHERE ");
+
+    if (pg->key_field == NULL) {
+        g_string_append_printf(req, "%s%s" DPK, pg->id_field, cmp, last_id);
+        return DB_SUCCESS;
+    }
+
+    /* NULL values are first in ascending order, last in descending order */
+    if (last_key == NULL) {
+        g_string_append_printf(req, "((%s IS NULL AND %s%s" DPK ")",
+                               pg->key_field, pg->id_field, cmp, last_id);
+        g_string_append_printf(req, pg->desc ? ")" : " OR %s IS NOT NULL)",
+                               pg->key_field);
+        return DB_SUCCESS;
+    }
+
+    len = 2 * strlen(last_key) + 1;
+    esc = MemAlloc(len);
+    if (esc == NULL)
+        return DB_NO_MEMORY;
+    db_escape_string(&pg->p_mgr->conn, esc, len, last_key);
+
+    g_string_append_printf(req, "(%s%s'%s' OR (%s='%s' AND %s%s" DPK ")",
+                           pg->key_field, cmp, esc, pg->key_field, esc,
+                           pg->id_field, cmp, last_id);
+    g_string_append_printf(req, pg->desc ? " OR %s IS NULL)" : ")",
+                           pg->key_field);
+    MemFree(esc);
+    return DB_SUCCESS;
+}
+
+/** build the request of the page following the given entry (first page
+ * if last_id is NULL) */
+static GString *page_request(struct iter_pager *pg, const char *last_id,
+                             const char *last_key, unsigned int limit)
+{
+    GString *req;
+
+    req = g_string_new(pg->base->str);
+    if (last_id != NULL
+        && append_keyset_cond(pg, req, last_id, last_key) != DB_SUCCESS) {
+        g_string_free(req, TRUE);
+        return NULL;
+    }
+    if (pg->key_field != NULL)
+        g_string_append_printf(req, " ORDER BY %s %s,", pg->key_field,
+                               pg->desc ? "DESC" : "ASC");
+    else
+        g_string_append(req, " ORDER BY");
+    g_string_append_printf(req, " %s %s LIMIT %u", pg->id_field,
+                           pg->desc ? "DESC" : "ASC", limit);
+    return req;
+}
+
+/** read the page following the given entry (first page if last_id is
+ * NULL) */
+static int page_read(struct iter_pager *pg, iter_page_t *page,
+                     const char *last_id, const char *last_key)
+{
+    GString *req;
+    result_handle_t result;
+    char *row[2];
+    int rc;
+
+    memset(page, 0, sizeof(*page));
+    page->limit = lmgr_config.iterator_page_size;
+    if (pg->limited && pg->remaining < page->limit)
+        page->limit = pg->remaining;
+
+    page->ids = MemCalloc(page->limit, sizeof(char *));
+    page->keys = MemCalloc(page->limit, sizeof(char *));
+    if (page->ids == NULL || page->keys == NULL) {
+        rc = DB_NO_MEMORY;
+        goto free_page;
+    }
+
+    req = page_request(pg, last_id, last_key, page->limit);
+    if (req == NULL) {
+        rc = DB_NO_MEMORY;
+        goto free_page;
+    }
+
+    do {
+        rc = db_exec_sql(&pg->p_mgr->conn, req->str, &result);
+    } while (rc != DB_SUCCESS && lmgr_delayed_retry(pg->p_mgr, rc) == 1);
+    g_string_free(req, TRUE);
+    if (rc)
+        goto free_page;
+
+    while (page->count < page->limit
+           && (rc = db_next_record(&pg->p_mgr->conn, &result, row,
+                                   pg->key_field ? 2 : 1)) == DB_SUCCESS) {
+        if (row[0] == NULL)
+            continue;
+        page->ids[page->count] = g_strdup(row[0]);
+        page->keys[page->count] = pg->key_field ? g_strdup(row[1]) : NULL;
+        page->count++;
+    }
+    db_result_free(&pg->p_mgr->conn, &result);
+
+    if (rc != DB_SUCCESS && rc != DB_END_OF_LIST)
+        goto free_page;
+
+    if (pg->limited)
+        pg->remaining -= page->count;
+    return DB_SUCCESS;
+
+ free_page:
+    page_free(page);
+    return rc;
+}
+
+/** read the page after the current one */
+static void page_read_next(struct iter_pager *pg)
+{
+    const iter_page_t *curr = &pg->curr;
+
+    pg->next_rc = page_read(pg, &pg->next, curr->ids[curr->count - 1],
+                            curr->keys[curr->count - 1]);
+}
+
+static void *page_read_thr(void *arg)
+{
+    db_thread_init();
+    page_read_next(arg);
+    db_thread_end();
+    return NULL;
+}
+
+/** start reading the page after the current one, if any */
+static void page_prefetch(struct iter_pager *pg)
+{
+    int rc;
+
+    pg->next_state = PAGE_NONE;
+
+    /* current page is the last one */
+    if (pg->curr.count == 0 || pg->curr.count < pg->curr.limit
+        || (pg->limited && pg->remaining == 0))
+        return;
+
+    rc = pthread_create(&pg->thread, NULL, page_read_thr, pg);
+    if (rc == 0) {
+        pg->next_state = PAGE_RUNNING;
+        return;
+    }
+
+    DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Failed to start a thread to read "
+               "the next page of an iterator: %s", strerror(rc));
+    page_read_next(pg);
+    pg->next_state = PAGE_READY;
+}
+
+/** wait for the next page, and make it the current one */
+static int page_switch(struct iter_pager *pg)
+{
+    if (pg->next_state == PAGE_NONE)
+        return DB_END_OF_LIST;
+
+    if (pg->next_state == PAGE_RUNNING)
+        pthread_join(pg->thread, NULL);
+    pg->next_state = PAGE_NONE;
+
+    page_free(&pg->curr);
+    if (pg->next_rc)
+        return pg->next_rc;
+
+    pg->curr = pg->next;
+    memset(&pg->next, 0, sizeof(pg->next));
+
+    page_prefetch(pg);
+    return (pg->curr.count == 0) ? DB_END_OF_LIST : DB_SUCCESS;
+}
+
+static int pager_next(struct iter_pager *pg, char **id)
+{
+    int rc;
+
+    if (pg->curr.next >= pg->curr.count) {
+        rc = page_switch(pg);
+        if (rc)
+            return rc;
+    }
+    *id = pg->curr.ids[pg->curr.next];
+    pg->curr.next++;
+    return DB_SUCCESS;
+}
+
+static void pager_free(struct iter_pager *pg)
+{
+    if (pg->next_state == PAGE_RUNNING)
+        pthread_join(pg->thread, NULL);
+    page_free(&pg->curr);
+    page_free(&pg->next);
+
+    if (pg->p_mgr != NULL) {
+        if (pg->on_replica) {
+            lmgr_pool_put_reader(pg->p_mgr, false);
+        } else {
+            ListMgr_CloseAccess(pg->p_mgr);
+            MemFree(pg->p_mgr);
+        }
+    }
+    g_string_free(pg->base, TRUE);
+    g_free(pg->id_field);
+    g_free(pg->key_field);
+    MemFree(pg);
+}
+
+/** log the execution plan of the requests of the pager */
+static void pager_explain(struct iter_pager *pg)
+{
+    const iter_page_t *curr = &pg->curr;
+    GString *req;
+
+    /* next pages are read with a condition on the last entry: this is
+     * the request of most pages */
+    if (curr->count > 0 && curr->count == curr->limit)
+        req = page_request(pg, curr->ids[curr->count - 1],
+                           curr->keys[curr->count - 1], curr->limit);
+    else
+        req = page_request(pg, NULL, NULL, curr->limit);
+
+    if (req != NULL) {
+        explain_request(pg->p_mgr, req->str);
+        g_string_free(req, TRUE);
+    }
+}
+
+/**
+ * Create a pager and read the first page.
+ * @param from  FROM clause of the request.
+ * @param where WHERE clause of the request (NULL if none).
+ * @param id_table table to get entry ids from.
+ */
+static struct iter_pager *pager_new(lmgr_t *p_mgr, const char *from,
+                                    const char *where, table_enum id_table,
+                                    table_enum sort_table,
+                                    const lmgr_sort_type_t *p_sort_type,
+                                    const lmgr_iter_opt_t *p_opt)
+{
+    struct iter_pager *pg;
+
+    pg = MemCalloc(1, sizeof(*pg));
+    if (pg == NULL)
+        return NULL;
+
+    pg->id_field = g_strdup_printf("%s.id", table2name(id_table));
+    if (sort_table != T_NONE) {
+        pg->key_field = g_strdup_printf("%s.%s", table2name(sort_table),
+                                        field_name(p_sort_type->attr_index));
+        pg->desc = (p_sort_type->order == SORT_DESC);
+    }
+    if (p_opt != NULL && p_opt->list_count_max > 0) {
+        pg->limited = true;
+        pg->remaining = p_opt->list_count_max;
+    }
+
+    pg->base = g_string_new(NULL);
+    g_string_printf(pg->base, "SELECT %s AS id", pg->id_field);
+    if (pg->key_field != NULL)
+        g_string_append_printf(pg->base, ",%s", pg->key_field);
+    g_string_append_printf(pg->base, " FROM %s", from);
+    if (where != NULL) {
+        g_string_append_printf(pg->base, " WHERE %s", where);
+        pg->has_where = true;
+    }
+
+    /* pages are read by another thread: they need their own connection */
+    pg->p_mgr = lmgr_pool_get_reader(NULL, p_opt);
+    if (pg->p_mgr != NULL) {
+        pg->on_replica = true;
+    } else {
+        pg->p_mgr = MemAlloc(sizeof(lmgr_t));
+        if (pg->p_mgr == NULL || ListMgr_InitAccess(pg->p_mgr) != DB_SUCCESS) {
+            MemFree(pg->p_mgr);
+            pg->p_mgr = NULL;
+            goto free_pager;
+        }
+    }
+
+    if (page_read(pg, &pg->curr, NULL, NULL) != DB_SUCCESS)
+        goto free_pager;
+
+    if (p_opt != NULL && p_opt->explain)
+        pager_explain(pg);
+
+    page_prefetch(pg);
+    return pg;
+
+ free_pager:
+    pager_free(pg);
+    return NULL;
+}
+
 /** get an iterator on a list of entries */
 struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
                                          const lmgr_filter_t *p_filter,
@@ -338,7 +751,6 @@ struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
 
     /* allocate a new iterator */
     it = (lmgr_iterator_t *) MemAlloc(sizeof(lmgr_iterator_t));
-    it->p_mgr = p_mgr;
     if (p_opt) {
         it->opt = *p_opt;
         it->opt_is_set = 1;
@@ -346,11 +758,47 @@ struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
         it->opt_is_set = 0;
     }
 
+    /* the iterator (and the gets of its entries) are sent to a replica */
+    it->p_mgr = lmgr_pool_get_reader(p_mgr, p_opt);
+    it->on_replica = (it->p_mgr != p_mgr);
+    it->pager = NULL;
+
+    /* read the result by pages, if it can be resumed from the sort key */
+    if (lmgr_config.iterator_page_size > 0 && !distinct
+        && filter_dir_type == FILTERDIR_NONE
+        && (sort_dirattr & ATTR_INDEX_FLG_UNSPEC)
+        && (sort_table == T_NONE || sort_table == T_MAIN
+            || sort_table == T_ANNEX)) {
+        table_enum id_table = (sort_table != T_NONE) ? sort_table : T_MAIN;
+
+        if (from != NULL)
+            it->pager = pager_new(p_mgr, from->str, where->str, query_tab,
+                                  sort_table, p_sort_type, p_opt);
+        else
+            it->pager = pager_new(p_mgr, table2name(id_table), NULL,
+                                  id_table, sort_table, p_sort_type, p_opt);
+        if (it->pager == NULL)
+            goto free_it;
+        goto done;
+    }
+
+    if (p_opt && p_opt->explain)
+        explain_request(it->p_mgr, req->str);
+
+ exec:
     /* execute request */
-    rc = db_exec_sql(&p_mgr->conn, req->str, &it->select_result);
+    rc = db_exec_sql(&it->p_mgr->conn, req->str, &it->select_result);
+    if (rc == DB_CONNECT_FAILED && it->on_replica) {
+        /* fall back to the primary server */
+        lmgr_pool_put_reader(it->p_mgr, true);
+        it->p_mgr = p_mgr;
+        it->on_replica = 0;
+        goto exec;
+    }
     if (rc)
         goto free_it;
 
+ done:
     if (filter_dir != NULL)
         g_string_free(filter_dir, TRUE);
     if (from != NULL)
@@ -363,8 +811,11 @@ struct lmgr_iterator_t *ListMgr_Iterator(lmgr_t *p_mgr,
     return it;
 
  free_it:
-    if (it != NULL)
+    if (it != NULL) {
+        if (it->on_replica)
+            lmgr_pool_put_reader(it->p_mgr, false);
         MemFree(it);
+    }
  free_str:
     if (filter_dir != NULL)
         g_string_free(filter_dir, TRUE);
@@ -391,8 +842,11 @@ int ListMgr_GetNext(struct lmgr_iterator_t *p_iter, entry_id_t *p_id,
         entry_disappeared = false;
 
         idstr[0] = idstr[1] = idstr[2] = NULL;
-        rc = db_next_record(&p_iter->p_mgr->conn, &p_iter->select_result, idstr,
-                            3);
+        if (p_iter->pager != NULL)
+            rc = pager_next(p_iter->pager, &idstr[0]);
+        else
+            rc = db_next_record(&p_iter->p_mgr->conn, &p_iter->select_result,
+                                idstr, 3);
 
         if (rc)
             return rc;
@@ -439,6 +893,11 @@ int ListMgr_GetNext(struct lmgr_iterator_t *p_iter, entry_id_t *p_id,
 
 void ListMgr_CloseIterator(struct lmgr_iterator_t *p_iter)
 {
-    db_result_free(&p_iter->p_mgr->conn, &p_iter->select_result);
+    if (p_iter->pager != NULL)
+        pager_free(p_iter->pager);
+    else
+        db_result_free(&p_iter->p_mgr->conn, &p_iter->select_result);
+    if (p_iter->on_replica)
+        lmgr_pool_put_reader(p_iter->p_mgr, false);
     MemFree(p_iter);
 }
@@ -0,0 +1,605 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    listmgr_paths.c
+ * \brief   Cache of directory names, to build entry paths.
+ *
+ * Instead of calling the recursive this_path() DB function for each
+ * entry, fullpath is built from the parent_id and name of the entry, and
+ * the cached names of its parent directories. Missing directories are
+ * read from NAMES table level by level, for all the entries of a request
+ * at once.
+ *
+ * A directory is invalidated when the transaction that modifies its names,
+ * or removes it, is committed. Its subdirectories refer to it by id, so
+ * they don't need to be invalidated. Changes done by other processes are
+ * taken into account after path_cache_ttl.
+ *
+ * Directories read from a replica, or while an invalidation occurred, may
+ * be outdated: they are only used for the current request, and are not
+ * cached. Neither are directories with no name that are not the top of the
+ * namespace (their name may not be committed yet).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "list_mgr.h"
+#include "listmgr_common.h"
+#include "listmgr_internal.h"
+#include "database.h"
+#include "RW_Lock.h"
+#include "rbh_logs.h"
+#include "Memory.h"
+#include <stdio.h>
+#include <string.h>
+
+#define PATH_TAG "PathCache"
+
+/** max number of parent levels (in case of a loop in the namespace) */
+#define PATH_MAX_DEPTH 1024
+/** max number of directories read from the DB in a single request */
+#define PATH_FILL_BATCH 1000
+
+/** name of a directory (shared by all directories with the same name) */
+typedef struct path_seg {
+    char        *name;
+    unsigned int refs;
+} path_seg_t;
+
+typedef struct path_node {
+    /** parent id (NULL if the directory has no name in the DB) */
+    char        *parent;
+    path_seg_t  *seg;
+    time_t       stamp;
+    /** link in path_cache.age */
+    GList       *link;
+} path_node_t;
+
+/** directory that is only used by the current request */
+typedef struct local_dir {
+    /** parent id and name (NULL for the top of a path) */
+    char        *parent;
+    char        *name;
+} local_dir_t;
+
+static struct {
+    rw_lock_t   lock;
+    /** directory id => path_node_t */
+    GHashTable *nodes;
+    /** name => path_seg_t */
+    GHashTable *segs;
+    /** ids of cached directories, oldest first */
+    GQueue      age;
+    /** incremented by each invalidation */
+    unsigned long gen;
+} path_cache = {.nodes = NULL};
+
+static path_seg_t *seg_get(const char *name)
+{
+    path_seg_t *seg = g_hash_table_lookup(path_cache.segs, name);
+
+    if (seg == NULL) {
+        seg = g_new0(path_seg_t, 1);
+        seg->name = g_strdup(name);
+        g_hash_table_insert(path_cache.segs, seg->name, seg);
+    }
+    seg->refs++;
+    return seg;
+}
+
+static void seg_put(path_seg_t *seg)
+{
+    if (--seg->refs > 0)
+        return;
+
+    g_hash_table_remove(path_cache.segs, seg->name);
+    g_free(seg->name);
+    g_free(seg);
+}
+
+static void node_free(gpointer ptr)
+{
+    path_node_t *node = ptr;
+
+    g_queue_delete_link(&path_cache.age, node->link);
+    if (node->seg != NULL)
+        seg_put(node->seg);
+    g_free(node->parent);
+    g_free(node);
+}
+
+static void local_dir_free(gpointer ptr)
+{
+    local_dir_t *dir = ptr;
+
+    g_free(dir->parent);
+    g_free(dir->name);
+    g_free(dir);
+}
+
+void lmgr_path_cache_init(void)
+{
+    if (lmgr_config.path_cache_size == 0 || path_cache.nodes != NULL)
+        return;
+
+    rw_lock_init(&path_cache.lock);
+    path_cache.nodes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                             node_free);
+    path_cache.segs = g_hash_table_new(g_str_hash, g_str_equal);
+    g_queue_init(&path_cache.age);
+}
+
+static inline bool path_cache_enabled(void)
+{
+    return path_cache.nodes != NULL;
+}
+
+/**
+ * Add a directory to the cache (name is NULL if it has no name in DB).
+ * If the cache is full, the oldest directories are evicted, except those
+ * read since 'keep' (they may be needed by running requests).
+ * Must be called with the write lock.
+ */
+static void node_insert(const char *id, const char *parent, const char *name,
+                        time_t now, time_t keep)
+{
+    path_node_t *node;
+    char *key;
+
+    while (g_hash_table_size(path_cache.nodes) >= lmgr_config.path_cache_size
+           && !g_queue_is_empty(&path_cache.age)) {
+        const char *oldest = g_queue_peek_head(&path_cache.age);
+        const path_node_t *old = g_hash_table_lookup(path_cache.nodes, oldest);
+
+        if (old->stamp >= keep)
+            break;
+        /* also removes it from the queue */
+        g_hash_table_remove(path_cache.nodes, oldest);
+    }
+
+    node = g_new0(path_node_t, 1);
+    node->stamp = now;
+    if (name != NULL) {
+        node->parent = g_strdup(parent);
+        node->seg = seg_get(name);
+    }
+    key = g_strdup(id);
+    /* frees the previous node, and its link */
+    g_hash_table_replace(path_cache.nodes, key, node);
+    g_queue_push_tail(&path_cache.age, key);
+    node->link = g_queue_peek_tail_link(&path_cache.age);
+}
+
+static void local_insert(GHashTable *local, const char *id, const char *parent,
+                         const char *name)
+{
+    local_dir_t *dir = g_new0(local_dir_t, 1);
+
+    if (name != NULL) {
+        dir->parent = g_strdup(parent);
+        dir->name = g_strdup(name);
+    }
+    g_hash_table_replace(local, g_strdup(id), dir);
+}
+
+/** get a valid directory from the cache (read lock) */
+static const path_node_t *node_lookup(const char *id, time_t now)
+{
+    const path_node_t *node = g_hash_table_lookup(path_cache.nodes, id);
+
+    if (node != NULL && now - node->stamp > lmgr_config.path_cache_ttl)
+        return NULL;
+    return node;
+}
+
+/**
+ * Build the DB representation of a path (<top_id>/<name>/.../<name>),
+ * from the parent and name of an entry (read lock).
+ * @param local directories read for this request only.
+ * @retval 0  path is complete.
+ * @retval 1  a parent directory is not in the cache (returned in missing).
+ * @retval -1 the path can't be built.
+ */
+static int build_path(const char *parent, const char *name, GString *path,
+                      time_t now, GHashTable *local, const char **missing)
+{
+    const char *curr = parent;
+    int depth;
+
+    g_string_assign(path, name);
+
+    for (depth = 0; depth < PATH_MAX_DEPTH; depth++) {
+        const local_dir_t *dir = g_hash_table_lookup(local, curr);
+        const path_node_t *node;
+        const char *dname;
+        const char *dparent;
+
+        if (dir != NULL) {
+            dname = dir->name;
+            dparent = dir->parent;
+        } else {
+            node = node_lookup(curr, now);
+            if (node == NULL) {
+                *missing = curr;
+                return 1;
+            }
+            dname = node->seg != NULL ? node->seg->name : NULL;
+            dparent = node->parent;
+        }
+
+        if (dname == NULL) {
+            /* top of the namespace */
+            g_string_prepend_c(path, '/');
+            g_string_prepend(path, curr);
+            return 0;
+        }
+        g_string_prepend_c(path, '/');
+        g_string_prepend(path, dname);
+        curr = dparent;
+    }
+
+    DisplayLog(LVL_MAJOR, PATH_TAG, "Path of '%s' has more than %u levels: "
+               "loop in namespace?", name, PATH_MAX_DEPTH);
+    return -1;
+}
+
+/** append the list of the given ids to a request */
+static void append_id_list(GString *req, GPtrArray *ids, unsigned int start,
+                           unsigned int count)
+{
+    unsigned int i;
+
+    for (i = start; i < start + count; i++)
+        g_string_append_printf(req, "%s" DPK, i == start ? "" : ",",
+                               (char *)g_ptr_array_index(ids, i));
+    g_string_append_c(req, ')');
+}
+
+/**
+ * Get the given ids that have no name, but have a row in the main table.
+ * They are not the top of the namespace: their name may not be committed
+ * or loaded yet.
+ */
+static int get_unnamed(lmgr_t *p_mgr, GPtrArray *ids, GHashTable *found,
+                       GHashTable *unnamed)
+{
+    GString *req;
+    result_handle_t result;
+    DEF_PK(root_pk);
+    char *res;
+    unsigned int i, nb = 0;
+    int rc;
+
+    entry_id2pk(get_root_id(), PTR_PK(root_pk));
+
+    req = g_string_new("SELECT id FROM " MAIN_TABLE " WHERE id IN (");
+    for (i = 0; i < ids->len; i++) {
+        const char *id = g_ptr_array_index(ids, i);
+
+        /* the root is the top of the namespace */
+        if (g_hash_table_lookup(found, id) != NULL || !strcmp(id, root_pk))
+            continue;
+        g_string_append_printf(req, "%s" DPK, nb == 0 ? "" : ",", id);
+        nb++;
+    }
+    g_string_append_c(req, ')');
+
+    if (nb == 0) {
+        g_string_free(req, TRUE);
+        return DB_SUCCESS;
+    }
+
+    rc = db_exec_sql(&p_mgr->conn, req->str, &result);
+    g_string_free(req, TRUE);
+    if (rc)
+        return rc;
+
+    while ((rc = db_next_record(&p_mgr->conn, &result, &res, 1))
+           == DB_SUCCESS) {
+        if (res != NULL)
+            g_hash_table_insert(unnamed, g_strdup(res), GINT_TO_POINTER(1));
+    }
+    db_result_free(&p_mgr->conn, &result);
+
+    return (rc == DB_END_OF_LIST) ? DB_SUCCESS : rc;
+}
+
+/**
+ * Read the given directories from NAMES table, and cache them.
+ * @param keep  start time of the request (see node_insert()).
+ * @param local directories that must not be cached.
+ */
+static int fill_dirs(lmgr_t *p_mgr, GPtrArray *ids, unsigned int start,
+                     unsigned int count, time_t keep, GHashTable *local)
+{
+    GString *req;
+    GHashTable *found;
+    GHashTable *unnamed;
+    GPtrArray *batch;
+    result_handle_t result;
+    char *res[3];
+    unsigned int i;
+    unsigned long gen;
+    bool cache;
+    time_t now = time(NULL);
+    int rc;
+
+    /* invalidations after this point may not be seen by the request */
+    P_r(&path_cache.lock);
+    gen = path_cache.gen;
+    V_r(&path_cache.lock);
+
+    req = g_string_new("SELECT id,parent_id,name FROM " DNAMES_TABLE
+                       " WHERE id IN (");
+    append_id_list(req, ids, start, count);
+
+    rc = db_exec_sql(&p_mgr->conn, req->str, &result);
+    g_string_free(req, TRUE);
+    if (rc)
+        return rc;
+
+    found = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    unnamed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    batch = g_ptr_array_new_with_free_func(g_free);
+
+    /* copy the rows: unnamed directories are queried before taking
+     * the lock */
+    while ((rc = db_next_record(&p_mgr->conn, &result, res, 3))
+           == DB_SUCCESS) {
+        if (res[0] == NULL || res[1] == NULL || res[2] == NULL)
+            continue;
+        /* a directory has a single path */
+        if (g_hash_table_lookup(found, res[0]) != NULL)
+            continue;
+
+        g_hash_table_insert(found, g_strdup(res[0]), GINT_TO_POINTER(1));
+        g_ptr_array_add(batch, g_strdup(res[0]));
+        g_ptr_array_add(batch, g_strdup(res[1]));
+        g_ptr_array_add(batch, g_strdup(res[2]));
+    }
+    db_result_free(&p_mgr->conn, &result);
+    if (rc != DB_END_OF_LIST)
+        goto out;
+
+    for (i = start; i < start + count; i++) {
+        const char *id = g_ptr_array_index(ids, i);
+
+        if (g_hash_table_lookup(found, id) == NULL)
+            g_ptr_array_add(batch, g_strdup(id));
+    }
+    if (batch->len > 3 * g_hash_table_size(found)) {
+        GPtrArray *sub = g_ptr_array_new();
+
+        for (i = 3 * g_hash_table_size(found); i < batch->len; i++)
+            g_ptr_array_add(sub, g_ptr_array_index(batch, i));
+        rc = get_unnamed(p_mgr, sub, found, unnamed);
+        g_ptr_array_free(sub, TRUE);
+        if (rc)
+            goto out;
+    }
+
+    P_w(&path_cache.lock);
+    /* don't cache data read from a replica, or possibly invalidated */
+    cache = !p_mgr->replica && gen == path_cache.gen;
+
+    for (i = 0; i < 3 * g_hash_table_size(found); i += 3) {
+        const char *id = g_ptr_array_index(batch, i);
+        const char *parent = g_ptr_array_index(batch, i + 1);
+        const char *name = g_ptr_array_index(batch, i + 2);
+
+        if (cache)
+            node_insert(id, parent, name, now, keep);
+        else
+            local_insert(local, id, parent, name);
+    }
+
+    /* directories with no name are the top of their path */
+    for (; i < batch->len; i++) {
+        const char *id = g_ptr_array_index(batch, i);
+
+        if (cache && g_hash_table_lookup(unnamed, id) == NULL)
+            node_insert(id, NULL, NULL, now, keep);
+        else
+            local_insert(local, id, NULL, NULL);
+    }
+    V_w(&path_cache.lock);
+    rc = DB_SUCCESS;
+
+ out:
+    g_ptr_array_free(batch, TRUE);
+    g_hash_table_destroy(unnamed);
+    g_hash_table_destroy(found);
+
+    return (rc == DB_END_OF_LIST) ? DB_SUCCESS : rc;
+}
+
+bool lmgr_path_cache_prepare(attr_mask_t *mask, attr_mask_t *extra)
+{
+    memset(extra, 0, sizeof(*extra));
+
+    if (!path_cache_enabled()
+        || !attr_mask_test_index(mask, ATTR_INDEX_fullpath))
+        return false;
+
+    /* fullpath is built from parent_id and name */
+    attr_mask_unset_index(mask, ATTR_INDEX_fullpath);
+    if (!attr_mask_test_index(mask, ATTR_INDEX_parent_id)) {
+        attr_mask_set_index(mask, ATTR_INDEX_parent_id);
+        attr_mask_set_index(extra, ATTR_INDEX_parent_id);
+    }
+    if (!attr_mask_test_index(mask, ATTR_INDEX_name)) {
+        attr_mask_set_index(mask, ATTR_INDEX_name);
+        attr_mask_set_index(extra, ATTR_INDEX_name);
+    }
+    return true;
+}
+
+int lmgr_path_cache_resolve(lmgr_t *p_mgr, attr_set_t **p_attrs,
+                            unsigned int count, attr_mask_t extra)
+{
+    pktype *parents;
+    GString *path;
+    GPtrArray *missing;
+    GHashTable *missing_set;
+    GHashTable *local;
+    unsigned int i, level;
+    bool done;
+    time_t start = time(NULL);
+    int rc = DB_SUCCESS;
+
+    parents = MemCalloc(count, sizeof(pktype));
+    if (parents == NULL)
+        return DB_NO_MEMORY;
+
+    local = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                  local_dir_free);
+
+    for (i = 0; i < count; i++)
+        if (ATTR_MASK_TEST(p_attrs[i], parent_id))
+            entry_id2pk(&ATTR(p_attrs[i], parent_id), PTR_PK(parents[i]));
+
+    path = g_string_new(NULL);
+
+    /* get missing parent directories, one level at a time */
+    for (level = 0; level < PATH_MAX_DEPTH; level++) {
+        time_t now = time(NULL);
+
+        missing = g_ptr_array_new_with_free_func(g_free);
+        missing_set = g_hash_table_new(g_str_hash, g_str_equal);
+
+        P_r(&path_cache.lock);
+        for (i = 0; i < count; i++) {
+            const char *id = NULL;
+
+            if (!ATTR_MASK_TEST(p_attrs[i], parent_id)
+                || !ATTR_MASK_TEST(p_attrs[i], name))
+                continue;
+
+            if (build_path(parents[i], ATTR(p_attrs[i], name), path, now,
+                           local, &id) == 1
+                && g_hash_table_lookup(missing_set, id) == NULL) {
+                char *dup = g_strdup(id);
+
+                g_ptr_array_add(missing, dup);
+                g_hash_table_insert(missing_set, dup, dup);
+            }
+        }
+        V_r(&path_cache.lock);
+
+        for (i = 0; i < missing->len && rc == DB_SUCCESS;
+             i += PATH_FILL_BATCH)
+            rc = fill_dirs(p_mgr, missing, i, MIN(PATH_FILL_BATCH,
+                                                  missing->len - i),
+                           start, local);
+
+        g_hash_table_destroy(missing_set);
+        done = (missing->len == 0);
+        g_ptr_array_free(missing, TRUE);
+        if (rc)
+            goto out;
+        if (done)
+            break;
+    }
+
+    /* build paths */
+    P_r(&path_cache.lock);
+    for (i = 0; i < count; i++) {
+        const char *id = NULL;
+
+        if (ATTR_MASK_TEST(p_attrs[i], parent_id)
+            && ATTR_MASK_TEST(p_attrs[i], name)
+            && build_path(parents[i], ATTR(p_attrs[i], name), path, time(NULL),
+                          local, &id) == 0
+            && path->len + strlen(global_config.fs_path) + 1 < RBH_PATH_MAX) {
+            fullpath_db2attr(path->str, ATTR(p_attrs[i], fullpath));
+            ATTR_MASK_SET(p_attrs[i], fullpath);
+        }
+    }
+    V_r(&path_cache.lock);
+
+ out:
+    for (i = 0; i < count; i++)
+        p_attrs[i]->attr_mask = attr_mask_and_not(&p_attrs[i]->attr_mask,
+                                                  &extra);
+    g_string_free(path, TRUE);
+    g_hash_table_destroy(local);
+    MemFree(parents);
+    return rc;
+}
+
+void lmgr_path_cache_invalidate(lmgr_t *p_mgr, pktype *pks,
+                                unsigned int count)
+{
+    unsigned int i;
+
+    if (!path_cache_enabled())
+        return;
+
+    /* a concurrent request could read the previous names until the
+     * transaction is committed */
+    if (p_mgr->path_inval == NULL)
+        p_mgr->path_inval = g_ptr_array_new_with_free_func(g_free);
+    for (i = 0; i < count; i++)
+        g_ptr_array_add(p_mgr->path_inval, g_strdup(pks[i]));
+}
+
+static void path_cache_clear(void)
+{
+    P_w(&path_cache.lock);
+    g_hash_table_remove_all(path_cache.nodes);
+    path_cache.gen++;
+    V_w(&path_cache.lock);
+}
+
+void lmgr_path_cache_clear(lmgr_t *p_mgr)
+{
+    if (!path_cache_enabled())
+        return;
+
+    path_cache_clear();
+    /* and again when the transaction is committed */
+    p_mgr->path_clear = true;
+}
+
+void lmgr_path_cache_tx_end(lmgr_t *p_mgr)
+{
+    unsigned int i;
+
+    if (!path_cache_enabled())
+        return;
+
+    if (p_mgr->path_clear) {
+        path_cache_clear();
+        p_mgr->path_clear = false;
+    } else if (p_mgr->path_inval != NULL && p_mgr->path_inval->len > 0) {
+        P_w(&path_cache.lock);
+        for (i = 0; i < p_mgr->path_inval->len; i++)
+            g_hash_table_remove(path_cache.nodes,
+                                g_ptr_array_index(p_mgr->path_inval, i));
+        path_cache.gen++;
+        V_w(&path_cache.lock);
+    }
+
+    if (p_mgr->path_inval != NULL)
+        g_ptr_array_set_size(p_mgr->path_inval, 0);
+}
+
+void lmgr_path_cache_release(lmgr_t *p_mgr)
+{
+    if (p_mgr->path_inval != NULL) {
+        g_ptr_array_free(p_mgr->path_inval, TRUE);
+        p_mgr->path_inval = NULL;
+    }
+}
@@ -0,0 +1,248 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    listmgr_pool.c
+ * \brief   Pool of connections to read-only replicas of the database.
+ *
+ * Iterators and reports borrow a connection to one of the replicas listed
+ * in MySQL::read_servers, and give it back to the pool when they are
+ * closed. Replicas are used in turn. A replica that can't be reached is
+ * not used again before connect_retry_interval_max, and requests are
+ * sent to the primary server in the meantime.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "list_mgr.h"
+#include "listmgr_common.h"
+#include "listmgr_internal.h"
+#include "database.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "Memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define POOL_TAG "DBPool"
+
+/** max number of idle connections kept in the pool */
+#define POOL_MAX_IDLE 16
+
+typedef struct replica {
+    char          server[256];
+    unsigned int  port;
+    /** don't try to connect before this time */
+    time_t        down_until;
+} replica_t;
+
+/** connection to a replica */
+typedef struct reader {
+    lmgr_t        lmgr;     /* must be first */
+    unsigned int  replica;
+} reader_t;
+
+static struct {
+    pthread_mutex_t lock;
+    replica_t      *replicas;
+    unsigned int    count;
+    /** next replica to connect to */
+    unsigned int    next;
+    /** idle connections (reader_t) */
+    GPtrArray      *idle;
+} pool = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+int lmgr_pool_init(void)
+{
+#ifdef _MYSQL
+    char *list, *item, *saveptr = NULL;
+    unsigned int max;
+
+    if (pool.replicas != NULL
+        || EMPTY_STRING(lmgr_config.db_config.read_servers))
+        return DB_SUCCESS;
+
+    list = strdup(lmgr_config.db_config.read_servers);
+    if (list == NULL)
+        return DB_NO_MEMORY;
+
+    /* upper bound of the number of servers */
+    max = 1;
+    for (item = list; *item != '\0'; item++)
+        if (*item == ',')
+            max++;
+
+    pool.replicas = MemCalloc(max, sizeof(replica_t));
+    if (pool.replicas == NULL) {
+        free(list);
+        return DB_NO_MEMORY;
+    }
+
+    for (item = strtok_r(list, ", ", &saveptr); item != NULL;
+         item = strtok_r(NULL, ", ", &saveptr)) {
+        replica_t *r = &pool.replicas[pool.count];
+        char *port = strchr(item, ':');
+
+        if (port != NULL) {
+            int val;
+
+            *port = '\0';
+            port++;
+            val = str2int(port);
+            if (val <= 0) {
+                DisplayLog(LVL_CRIT, POOL_TAG, "Invalid port '%s' for read "
+                           "server '%s'", port, item);
+                free(list);
+                MemFree(pool.replicas);
+                pool.replicas = NULL;
+                pool.count = 0;
+                return DB_INVALID_ARG;
+            }
+            r->port = val;
+        }
+        rh_strncpy(r->server, item, sizeof(r->server));
+        pool.count++;
+
+        DisplayLog(LVL_VERB, POOL_TAG, "Read requests will be sent to "
+                   "replica '%s' (port %u)", r->server, r->port);
+    }
+    free(list);
+
+    pool.idle = g_ptr_array_new();
+#endif
+    return DB_SUCCESS;
+}
+
+#ifdef _MYSQL
+static void reader_close(reader_t *reader)
+{
+    if (reader->lmgr.stmt_cache != NULL) {
+        lmgr_stmt_cache_flush(&reader->lmgr);
+        g_hash_table_destroy(reader->lmgr.stmt_cache);
+    }
+    db_close_conn(&reader->lmgr.conn);
+    MemFree(reader);
+}
+
+/** connect to the given replica (without the pool lock) */
+static reader_t *reader_open(unsigned int idx)
+{
+    const replica_t *r = &pool.replicas[idx];
+    reader_t *reader;
+    int rc;
+
+    reader = MemCalloc(1, sizeof(reader_t));
+    if (reader == NULL)
+        return NULL;
+    reader->replica = idx;
+    /* its data must not be cached (see listmgr_paths.c) */
+    reader->lmgr.replica = true;
+
+    rc = db_connect_replica(&reader->lmgr.conn, r->server, r->port);
+    if (rc) {
+        db_close_conn(&reader->lmgr.conn);
+        MemFree(reader);
+        return NULL;
+    }
+
+    rc = db_transaction_level(&reader->lmgr.conn, TRANS_SESSION,
+                              TXL_READ_COMMITTED);
+    if (rc) {
+        reader_close(reader);
+        return NULL;
+    }
+
+    DisplayLog(LVL_DEBUG, POOL_TAG, "New connection to replica '%s'",
+               r->server);
+    return reader;
+}
+
+/** the replica can't be used for a while (pool lock must be held) */
+static void replica_down(unsigned int idx)
+{
+    replica_t *r = &pool.replicas[idx];
+
+    if (r->down_until > time(NULL))
+        return;
+
+    r->down_until = time(NULL) + lmgr_config.connect_retry_max;
+    DisplayLog(LVL_MAJOR, POOL_TAG, "Replica '%s' is not available: "
+               "sending read requests to the primary server for %lds",
+               r->server, lmgr_config.connect_retry_max);
+}
+#endif
+
+lmgr_t *lmgr_pool_get_reader(lmgr_t *p_mgr, const lmgr_iter_opt_t *p_opt)
+{
+#ifdef _MYSQL
+    unsigned int i;
+    reader_t *reader = NULL;
+
+    if (pool.count == 0 || (p_opt != NULL && p_opt->force_primary))
+        return p_mgr;
+
+    P(pool.lock);
+    if (pool.idle->len > 0)
+        reader = g_ptr_array_remove_index_fast(pool.idle, pool.idle->len - 1);
+    V(pool.lock);
+
+    if (reader != NULL)
+        return &reader->lmgr;
+
+    for (i = 0; i < pool.count; i++) {
+        unsigned int idx;
+        bool up;
+
+        P(pool.lock);
+        idx = pool.next;
+        pool.next = (pool.next + 1) % pool.count;
+        up = (pool.replicas[idx].down_until <= time(NULL));
+        V(pool.lock);
+
+        if (!up)
+            continue;
+
+        reader = reader_open(idx);
+        if (reader != NULL)
+            return &reader->lmgr;
+
+        P(pool.lock);
+        replica_down(idx);
+        V(pool.lock);
+    }
+#endif
+    return p_mgr;
+}
+
+void lmgr_pool_put_reader(lmgr_t *p_reader, bool failed)
+{
+#ifdef _MYSQL
+    reader_t *reader = (reader_t *)p_reader;
+
+    P(pool.lock);
+    if (failed)
+        replica_down(reader->replica);
+
+    if (!failed && pool.idle->len < POOL_MAX_IDLE) {
+        g_ptr_array_add(pool.idle, reader);
+        reader = NULL;
+    }
+    V(pool.lock);
+
+    if (reader != NULL)
+        reader_close(reader);
+#endif
+}
@@ -421,6 +421,8 @@ struct lmgr_iterator_t *ListMgr_RecovResume(lmgr_t *p_mgr, const char *dir_path,
     /* allocate a new iterator */
     it = (lmgr_iterator_t *) MemAlloc(sizeof(lmgr_iterator_t));
     it->p_mgr = p_mgr;
+    it->on_replica = 0;
+    it->pager = NULL;
 
     /* execute request */
     rc = db_exec_sql(&p_mgr->conn, query, &it->select_result);
@@ -468,6 +470,8 @@ struct lmgr_iterator_t *ListMgr_RecovList(lmgr_t *p_mgr, recov_type_e st)
     /* allocate a new iterator */
     it = (lmgr_iterator_t *) MemAlloc(sizeof(lmgr_iterator_t));
     it->p_mgr = p_mgr;
+    it->on_replica = 0;
+    it->pager = NULL;
 
     /* execute request */
     rc = db_exec_sql(&p_mgr->conn, query, &it->select_result);
@@ -43,15 +43,16 @@ static int clean_names(lmgr_t *p_mgr, const lmgr_filter_t *p_filter,
 
     DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Direct deletion in "DNAMES_TABLE" table");
     rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+    lmgr_path_cache_clear(p_mgr);
 out:
     g_string_free(req, TRUE);
     return rc;
 }
 
-/** helper for listmgr_remove_single */
+/** helper for listmgr_remove_tables */
 static inline void append_table_join(GString *fields, GString *tables, GString *where,
                                      const char *tname, const char *talias,
-                                     PK_ARG_T pk, const char **first_table)
+                                     const char *id_cond, const char **first_table)
 {
     g_string_append_printf(fields, "%s%s.*", *first_table == NULL?"":",", talias);
 
@@ -65,31 +66,43 @@ static inline void append_table_join(GString *fields, GString *tables, GString *
                                tname, talias, *first_table, talias);
 
     if (GSTRING_EMPTY(where))
-        g_string_printf(where, "%s.id="DPK, talias, pk);
+        g_string_printf(where, "%s.id%s", talias, id_cond);
 }
 
-/** removal of a single entry (no transaction management) */
-static int listmgr_remove_single(lmgr_t *p_mgr, PK_ARG_T pk, table_enum exclude_tab)
+/**
+ * Removal of the entries matching the given id condition
+ * (e.g. "='pk'" or " IN (...)") from all tables, except exclude_tab.
+ * No transaction management.
+ */
+static int listmgr_remove_tables(lmgr_t *p_mgr, const char *id_cond,
+                                 table_enum exclude_tab)
 {
     const char *first_table = NULL;
     GString *req, *tables, *where;
     int rc;
 
+    /* entries are removed from accounting source table */
+    if (!lmgr_acct_source(exclude_tab)) {
+        rc = lmgr_acct_snapshot(p_mgr, id_cond, -1);
+        if (rc)
+            return rc;
+    }
+
     req = g_string_new("DELETE ");
     tables = g_string_new(NULL);
     where = g_string_new(NULL);
 
     if (exclude_tab != T_MAIN)
-        append_table_join(req, tables, where, MAIN_TABLE, "M", pk, &first_table);
+        append_table_join(req, tables, where, MAIN_TABLE, "M", id_cond, &first_table);
     if (exclude_tab != T_ANNEX)
-        append_table_join(req, tables, where, ANNEX_TABLE, "A", pk, &first_table);
+        append_table_join(req, tables, where, ANNEX_TABLE, "A", id_cond, &first_table);
     if (exclude_tab != T_DNAMES)
-        append_table_join(req, tables, where, DNAMES_TABLE, "N", pk, &first_table);
+        append_table_join(req, tables, where, DNAMES_TABLE, "N", id_cond, &first_table);
 #ifdef _LUSTRE
     if (exclude_tab != T_STRIPE_INFO)
-        append_table_join(req, tables, where, STRIPE_INFO_TABLE, "I", pk, &first_table);
+        append_table_join(req, tables, where, STRIPE_INFO_TABLE, "I", id_cond, &first_table);
     if (exclude_tab != T_STRIPE_ITEMS)
-        append_table_join(req, tables, where, STRIPE_ITEMS_TABLE, "S", pk, &first_table);
+        append_table_join(req, tables, where, STRIPE_ITEMS_TABLE, "S", id_cond, &first_table);
 #endif
 
     /* Doing this in a single request instead of 1 DELETE per table
@@ -107,6 +120,52 @@ static int listmgr_remove_single(lmgr_t *p_mgr, PK_ARG_T pk, table_enum exclude_
     return rc;
 }
 
+/** removal of a single entry (no transaction management) */
+static int listmgr_remove_single(lmgr_t *p_mgr, PK_ARG_T pk, table_enum exclude_tab)
+{
+    char id_cond[PK_LEN + 4];
+
+    snprintf(id_cond, sizeof(id_cond), "="DPK, pk);
+    return listmgr_remove_tables(p_mgr, id_cond, exclude_tab);
+}
+
+/** check the attributes needed to remove an entry from NAMES table */
+static bool check_dname_attrs(const attr_set_t *p_attr_set)
+{
+    if (p_attr_set && ATTR_MASK_TEST(p_attr_set, parent_id)
+        && ATTR_MASK_TEST(p_attr_set, name))
+        return true;
+
+    DisplayLog(LVL_MAJOR, LISTMGR_TAG, "WARNING: missing attribute(s) to "
+                "delete entry from "DNAMES_TABLE":%s%s%s",
+                !p_attr_set ? " attrs=NULL" : "",
+                p_attr_set && !ATTR_MASK_TEST(p_attr_set, parent_id) ? " parent" : "",
+                p_attr_set && !ATTR_MASK_TEST(p_attr_set, name) ? " name" : "");
+    return false;
+}
+
+/** append the condition matching the name of an entry in NAMES table */
+static int append_dname_cond(lmgr_t *p_mgr, GString *req, PK_ARG_T pk,
+                             const attr_set_t *p_attr_set)
+{
+    char *escaped;
+    int   len;
+    DEF_PK(ppk);
+
+    entry_id2pk(&ATTR(p_attr_set, parent_id), PTR_PK(ppk));
+
+    /* according to MySQL documentation, escaped string can be up to 2*orig_len+1 */
+    len = 2 * strlen(ATTR(p_attr_set, name)) + 1;
+    escaped = MemAlloc(len);
+    if (escaped == NULL)
+        return DB_NO_MEMORY;
+    db_escape_string(&p_mgr->conn, escaped, len, ATTR(p_attr_set, name));
+
+    g_string_append_printf(req, "(pkn="HNAME_FMT" AND id="DPK")", ppk,
+                           escaped, pk);
+    MemFree(escaped);
+    return DB_SUCCESS;
+}
 
 int listmgr_remove_no_tx(lmgr_t *p_mgr, const entry_id_t *p_id,
                          const attr_set_t *p_attr_set, bool last)
@@ -114,7 +173,6 @@ int listmgr_remove_no_tx(lmgr_t *p_mgr, const entry_id_t *p_id,
     GString *req;
     int      rc = DB_SUCCESS;
     DEF_PK(pk);
-    DEF_PK(ppk);
 
     entry_id2pk(p_id, PTR_PK(pk));
 
@@ -140,38 +198,15 @@ int listmgr_remove_no_tx(lmgr_t *p_mgr, const entry_id_t *p_id,
     }
 
     /* Allow removing entry from MAIN_TABLE without removing it from NAMES */
-    if (p_attr_set && ATTR_MASK_TEST(p_attr_set, parent_id) && ATTR_MASK_TEST(p_attr_set, name))
+    if (check_dname_attrs(p_attr_set))
     {
-        char *escaped;
-        int   len;
-
-        entry_id2pk(&ATTR(p_attr_set, parent_id), PTR_PK(ppk));
-
-        /* according to MySQL documentation, escaped string can be up to 2*orig_len+1 */
-        len = 2 * strlen(ATTR(p_attr_set, name)) + 1;
-        escaped = MemAlloc(len);
-        if (escaped == NULL)
-        {
-            rc = DB_NO_MEMORY;
+        g_string_assign(req, "DELETE FROM "DNAMES_TABLE" WHERE ");
+        rc = append_dname_cond(p_mgr, req, pk, p_attr_set);
+        if (rc)
             goto out;
-        }
-        db_escape_string(&p_mgr->conn, escaped, len, ATTR(p_attr_set, name));
-
-        g_string_printf(req, "DELETE FROM "DNAMES_TABLE" WHERE pkn="HNAME_FMT" AND id="DPK,
-                        ppk, escaped, pk);
-        MemFree(escaped);
 
         rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
-        if (rc)
-            return rc;
-    }
-    else if (!p_attr_set || !ATTR_MASK_TEST(p_attr_set, parent_id) || !ATTR_MASK_TEST(p_attr_set, name))
-    {
-        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "WARNING: missing attribute(s) to "
-                    "delete entry from "DNAMES_TABLE":%s%s%s",
-                    !p_attr_set ? " attrs=NULL" : "",
-                    p_attr_set && !ATTR_MASK_TEST(p_attr_set, parent_id) ? " parent" : "",
-                    p_attr_set && !ATTR_MASK_TEST(p_attr_set, name) ? " name" : "");
+        lmgr_path_cache_invalidate(p_mgr, &pk, 1);
     }
 
 out:
@@ -216,6 +251,111 @@ retry:
     return rc;
 }
 
+/** removal of a batch of entries (no transaction management) */
+static int listmgr_batch_remove_no_tx(lmgr_t *p_mgr, entry_id_t **p_ids,
+                                      attr_set_t **p_attrs,
+                                      unsigned int count, bool last)
+{
+    GString     *req, *id_cond;
+    int          rc = DB_SUCCESS;
+    unsigned int i, nb_names = 0;
+    pktype      *pks;
+
+    pks = MemCalloc(count, sizeof(pktype));
+    if (pks == NULL)
+        return DB_NO_MEMORY;
+
+    id_cond = g_string_new(" IN (");
+    for (i = 0; i < count; i++)
+    {
+        entry_id2pk(p_ids[i], PTR_PK(pks[i]));
+        g_string_append_printf(id_cond, "%s"DPK, i == 0 ? "" : ",", pks[i]);
+    }
+    g_string_append(id_cond, ")");
+
+    req = g_string_new(NULL);
+
+    /* The batch can't contain several operations on the same entry
+     * (see the pipeline ID constraint), so each nlink is decremented once. */
+    if (last)
+        rc = listmgr_remove_tables(p_mgr, id_cond->str, T_DNAMES);
+    else
+    {
+        g_string_printf(req, "UPDATE "MAIN_TABLE" SET nlink=nlink-1 WHERE "
+                        "id%s AND nlink>0", id_cond->str);
+        rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+    }
+    if (rc)
+        goto out;
+
+    /* remove all the names in a single request */
+    g_string_assign(req, "DELETE FROM "DNAMES_TABLE" WHERE ");
+    for (i = 0; i < count; i++)
+    {
+        if (!check_dname_attrs(p_attrs[i]))
+            continue;
+
+        if (nb_names > 0)
+            g_string_append(req, " OR ");
+        rc = append_dname_cond(p_mgr, req, pks[i], p_attrs[i]);
+        if (rc)
+            goto out;
+        nb_names++;
+    }
+
+    if (nb_names > 0) {
+        rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+        lmgr_path_cache_invalidate(p_mgr, pks, count);
+    }
+
+out:
+    g_string_free(req, TRUE);
+    g_string_free(id_cond, TRUE);
+    MemFree(pks);
+    return rc;
+}
+
+int ListMgr_BatchRemove(lmgr_t *p_mgr, entry_id_t **p_ids,
+                        attr_set_t **p_attrs, unsigned int count, bool last)
+{
+    int rc;
+    int retry_status;
+
+    if (count == 0)
+        return DB_SUCCESS;
+    else if (count == 1)
+        return ListMgr_Remove(p_mgr, p_ids[0], p_attrs[0], last);
+
+    /* the whole batch is removed atomically */
+retry:
+    rc = lmgr_begin(p_mgr);
+    retry_status = lmgr_delayed_retry(p_mgr, rc);
+    if (retry_status == 1)
+        goto retry;
+    else if (retry_status == 2)
+        return DB_RBH_SIG_SHUTDOWN;
+    else if (rc)
+        return rc;
+
+    rc = listmgr_batch_remove_no_tx(p_mgr, p_ids, p_attrs, count, last);
+    retry_status = lmgr_delayed_retry(p_mgr, rc);
+    if (retry_status == 1)
+        goto retry;
+    else if (rc || retry_status == 2)
+    {
+        lmgr_rollback(p_mgr);
+        return (retry_status == 2) ? DB_RBH_SIG_SHUTDOWN : rc;
+    }
+
+    rc = lmgr_commit(p_mgr);
+    retry_status = lmgr_delayed_retry(p_mgr, rc);
+    if (retry_status == 1)
+        goto retry;
+    if (!rc)
+         p_mgr->nbop[OPIDX_RM] += count;
+    return rc;
+}
+
 /**
  * Insert all entries to soft rm table.
  * @TODO check how it behaves with millions/billion entries.
@@ -250,6 +390,12 @@ static int listmgr_rm_all(lmgr_t * p_mgr)
 {
     int rc;
 
+    rc = lmgr_acct_snapshot(p_mgr, NULL, -1);
+    if (rc)
+        return rc;
+
+    lmgr_path_cache_clear(p_mgr);
+
     /* stripes are only managed for lustre filesystems */
 #ifdef _LUSTRE
     rc = db_exec_sql(&p_mgr->conn, "DELETE FROM " STRIPE_ITEMS_TABLE, NULL);
@@ -366,6 +512,87 @@ static int listmgr_softrm_single(lmgr_t *p_mgr, const entry_id_t *p_id,
     return rc;
 }
 
+/**
+ * Insert a batch of entries to soft rm table, with a single request.
+ * All entries must have the same set of SOFT_RM attributes, including
+ * rm_time. Their fullpath must have been set by set_fullpath().
+ */
+static int listmgr_softrm_batch(lmgr_t *p_mgr, entry_id_t **p_ids,
+                                attr_set_t *attrs, unsigned int count)
+{
+    DEF_PK(pk);
+    int  rc;
+    char err_buf[1024];
+    GString *req;
+    attr_mask_t tmp_mask;
+    unsigned int i;
+
+    /* if fullpath is set, update it */
+    if (ATTR_MASK_TEST(&attrs[0], fullpath))
+        req = g_string_new("INSERT INTO " SOFT_RM_TABLE "(id");
+    else /* else, don't update */
+        req = g_string_new("INSERT IGNORE INTO " SOFT_RM_TABLE "(id");
+
+    tmp_mask = attr_mask_and(&softrm_attr_set, &attrs[0].attr_mask);
+    attrmask2fieldlist(req, tmp_mask, T_SOFTRM, "", "", AOF_LEADING_SEP);
+    g_string_append(req, ") VALUES ");
+
+    for (i = 0; i < count; i++)
+    {
+        entry_id2pk(p_ids[i], PTR_PK(pk));
+        g_string_append_printf(req, "%s("DPK, i == 0 ? "" : ",", pk);
+        attrset2valuelist(p_mgr, req, &attrs[i], T_SOFTRM, AOF_LEADING_SEP);
+        g_string_append(req, ")");
+    }
+
+    if (ATTR_MASK_TEST(&attrs[0], fullpath))
+        g_string_append(req, " ON DUPLICATE KEY UPDATE fullpath=VALUES(fullpath)");
+
+    rc = db_exec_sql(&p_mgr->conn, req->str, NULL);
+    if (rc)
+        DisplayLog(LVL_CRIT, LISTMGR_TAG,
+                   "DB query failed in %s line %d: code=%d: %s",
+                   __FUNCTION__, __LINE__, rc,
+                   db_errmsg(&p_mgr->conn, err_buf, sizeof(err_buf)));
+    g_string_free(req, TRUE);
+    return rc;
+}
+
+/** set the mask of the attributes to be retrieved from DB for soft removal */
+static void softrm_missing_attrs(attr_set_t *all_attrs,
+                                 const attr_set_t *p_old_attrs)
+{
+    /* get missing attributes for SOFT_RM table from DB */
+    all_attrs->attr_mask = softrm_attr_set;
+    /* ...except rm_time */
+    attr_mask_unset_index(&all_attrs->attr_mask, ATTR_INDEX_rm_time);
+    /* ...except attributes already in p_old_attrs */
+    all_attrs->attr_mask = attr_mask_and_not(&all_attrs->attr_mask,
+                                             &p_old_attrs->attr_mask);
+
+    /* these are needed for remove function */
+    if (!ATTR_MASK_TEST(all_attrs, parent_id)
+        || !ATTR_MASK_TEST(all_attrs, name))
+    {
+        ATTR_MASK_SET(all_attrs, parent_id);
+        ATTR_MASK_SET(all_attrs, name);
+    }
+}
+
+/** merge attributes from DB with old attributes, and set rm_time */
+static void softrm_complete_attrs(attr_set_t *all_attrs,
+                                  const attr_set_t *p_old_attrs)
+{
+    if (p_old_attrs != NULL)
+        ListMgr_MergeAttrSets(all_attrs, p_old_attrs, true);
+
+    if (!ATTR_MASK_TEST(all_attrs, rm_time))
+    {
+        ATTR_MASK_SET(all_attrs, rm_time);
+        ATTR(all_attrs, rm_time) = time(NULL);
+    }
+}
+
 /** create a temporary table with all entries to be deleted */
 static int create_tmp_table_rm(lmgr_t *p_mgr, const lmgr_filter_t *p_filter,
                                const struct field_count *counts,
@@ -586,6 +813,14 @@ static int listmgr_mass_remove_no_tx(lmgr_t *p_mgr, const lmgr_filter_t *p_filte
         DisplayLog(LVL_DEBUG, LISTMGR_TAG, "Direct deletion in %s table", table2name(query_tab));
         direct_del = true;
 
+        if (lmgr_acct_source(query_tab))
+        {
+            g_string_printf(req, " IN (SELECT id FROM %s)", tmp_table_name);
+            rc = lmgr_acct_snapshot(p_mgr, req->str, -1);
+            if (rc)
+                goto free_str;
+        }
+
         /* if filter is on a single table, we can directly use filter in WHERE clause */
         g_string_printf(req, "DELETE FROM %s WHERE %s", table2name(query_tab),
                         GSTRING_SAFE(where));
@@ -674,6 +909,10 @@ static int listmgr_mass_remove_no_tx(lmgr_t *p_mgr, const lmgr_filter_t *p_filte
     DisplayLog(LVL_DEBUG, LISTMGR_TAG,
                "End of indirect removal: %u identifiers removed", *rm_count);
 
+    /* removed names are not known here */
+    if (*rm_count > 0)
+        lmgr_path_cache_clear(p_mgr);
+
     /* drop tmp table */
     rc = db_drop_component(&p_mgr->conn, DBOBJ_TABLE, tmp_table_name);
     if (rc)
@@ -767,33 +1006,13 @@ int            ListMgr_SoftRemove(lmgr_t *p_mgr, const entry_id_t *p_id,
     int        rc;
     attr_set_t all_attrs = ATTR_SET_INIT;
 
-    /* get missing attributes for SOFT_RM table from DB */
-    all_attrs.attr_mask = softrm_attr_set;
-    /* ...except rm_time */
-    attr_mask_unset_index(&all_attrs.attr_mask, ATTR_INDEX_rm_time);
-    /* ...except attributes already in p_old_attrs */
-    all_attrs.attr_mask = attr_mask_and_not(&all_attrs.attr_mask, &p_old_attrs->attr_mask);
-
-    /* these are needed for remove function */
-    if (!ATTR_MASK_TEST(&all_attrs, parent_id)
-        || !ATTR_MASK_TEST(&all_attrs, name))
-    {
-        ATTR_MASK_SET(&all_attrs, parent_id);
-        ATTR_MASK_SET(&all_attrs, name);
-    }
+    softrm_missing_attrs(&all_attrs, p_old_attrs);
 
     if (!attr_mask_is_null(all_attrs.attr_mask)
         && (ListMgr_Get(p_mgr, p_id, &all_attrs) != DB_SUCCESS))
         ATTR_MASK_INIT(&all_attrs);
 
-    if (p_old_attrs != NULL)
-        ListMgr_MergeAttrSets(&all_attrs, p_old_attrs, true);
-
-    if (!ATTR_MASK_TEST(&all_attrs, rm_time))
-    {
-        ATTR_MASK_SET(&all_attrs, rm_time);
-        ATTR(&all_attrs, rm_time) = time(NULL);
-    }
+    softrm_complete_attrs(&all_attrs, p_old_attrs);
 
     /* We want the removal sequence to be atomic */
 retry:
@@ -835,6 +1054,134 @@ out:
     return rc;
 }
 
+int ListMgr_BatchSoftRemove(lmgr_t *p_mgr, entry_id_t **p_ids,
+                            attr_set_t **p_old_attrs, unsigned int count)
+{
+    int           rc;
+    int           retry_status;
+    unsigned int  i, j, k;
+    bool          same_mask = true;
+    attr_set_t   *all_attrs;
+    attr_set_t  **p_all_attrs = NULL;
+    int          *rcs = NULL;
+
+    if (count == 0)
+        return DB_SUCCESS;
+    else if (count == 1)
+        return ListMgr_SoftRemove(p_mgr, p_ids[0], p_old_attrs[0]);
+
+    all_attrs = MemCalloc(count, sizeof(*all_attrs));
+    p_all_attrs = MemCalloc(count, sizeof(*p_all_attrs));
+    rcs = MemCalloc(count, sizeof(*rcs));
+    if (all_attrs == NULL || p_all_attrs == NULL || rcs == NULL)
+    {
+        rc = DB_NO_MEMORY;
+        goto free_arrays;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        softrm_missing_attrs(&all_attrs[i], p_old_attrs[i]);
+        p_all_attrs[i] = &all_attrs[i];
+        if (!attr_mask_equal(&all_attrs[i].attr_mask, &all_attrs[0].attr_mask))
+            same_mask = false;
+    }
+
+    /* get missing attributes of all entries in a single request, if they
+     * are the same for all */
+    if (same_mask && !attr_mask_is_null(all_attrs[0].attr_mask))
+    {
+        rc = ListMgr_BatchGet(p_mgr, p_ids, p_all_attrs, count, rcs);
+        if (rc == DB_RBH_SIG_SHUTDOWN)
+            goto free_attrs;
+        for (i = 0; i < count; i++)
+            if (rc != DB_SUCCESS || rcs[i] != DB_SUCCESS)
+                ATTR_MASK_INIT(&all_attrs[i]);
+    }
+    else
+    {
+        for (i = 0; i < count; i++)
+            if (!attr_mask_is_null(all_attrs[i].attr_mask)
+                && (ListMgr_Get(p_mgr, p_ids[i], &all_attrs[i]) != DB_SUCCESS))
+                ATTR_MASK_INIT(&all_attrs[i]);
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        softrm_complete_attrs(&all_attrs[i], p_old_attrs[i]);
+        set_fullpath(p_mgr, &all_attrs[i]);
+    }
+
+    /* We want the removal sequence to be atomic */
+retry:
+    rc = lmgr_begin(p_mgr);
+    retry_status = lmgr_delayed_retry(p_mgr, rc);
+    if (retry_status == 1)
+        goto retry;
+    else if (retry_status == 2)
+    {
+        rc = DB_RBH_SIG_SHUTDOWN;
+        goto free_attrs;
+    }
+    else if (rc)
+        goto free_attrs;
+
+    /* one insert request per range of entries with the same attributes */
+    for (j = 0; j < count; j = k)
+    {
+        attr_mask_t mask = attr_mask_and(&softrm_attr_set,
+                                         &all_attrs[j].attr_mask);
+
+        for (k = j + 1; k < count; k++)
+        {
+            attr_mask_t next = attr_mask_and(&softrm_attr_set,
+                                             &all_attrs[k].attr_mask);
+            if (!attr_mask_equal(&mask, &next))
+                break;
+        }
+
+        rc = listmgr_softrm_batch(p_mgr, p_ids + j, all_attrs + j, k - j);
+        if (rc)
+            break;
+    }
+
+    /* remove the entries from main tables, if they exist */
+    if (rc == DB_SUCCESS)
+    {
+        rc = listmgr_batch_remove_no_tx(p_mgr, p_ids, p_all_attrs, count, true);
+        if (rc == DB_NOT_EXISTS)
+            rc = DB_SUCCESS;
+    }
+
+    retry_status = lmgr_delayed_retry(p_mgr, rc);
+    if (retry_status == 1)
+        goto retry;
+    else if (rc || retry_status == 2)
+    {
+        lmgr_rollback(p_mgr);
+        if (retry_status == 2)
+            rc = DB_RBH_SIG_SHUTDOWN;
+        goto free_attrs;
+    }
+
+    /* commit */
+    rc = lmgr_commit(p_mgr);
+    retry_status = lmgr_delayed_retry(p_mgr, rc);
+    if (retry_status == 1)
+        goto retry;
+    if (!rc)
+         p_mgr->nbop[OPIDX_RM] += count;
+
+free_attrs:
+    for (i = 0; i < count; i++)
+        ListMgr_FreeAttrs(&all_attrs[i]);
+free_arrays:
+    MemFree(rcs);
+    MemFree(p_all_attrs);
+    MemFree(all_attrs);
+    return rc;
+}
+
 typedef struct lmgr_rm_list_t
 {
     lmgr_t        *p_mgr;
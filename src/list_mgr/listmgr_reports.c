@@ -35,6 +35,10 @@ struct result {
 typedef struct lmgr_report_t {
     lmgr_t *p_mgr;
     result_handle_t select_result;
+    /** p_mgr is a connection to a read replica */
+    bool on_replica;
+    /** report computed from the snapshot (no DB request) */
+    snapshot_result_t *snap;
 
     /* expected result content */
     struct result *result;
@@ -278,6 +282,29 @@ static bool full_acct(const report_field_descr_t *report_desc_array,
     return true;
 }
 
+/** set the types of report fields, as for a request on ENTRIES */
+static void report_snapshot_types(lmgr_report_t *p_report,
+                                  const report_field_descr_t *
+                                  report_desc_array,
+                                  unsigned int report_descr_count)
+{
+    unsigned int i;
+
+    for (i = 0; i < report_descr_count; i++) {
+        if (report_desc_array[i].report_type == REPORT_COUNT
+            || report_desc_array[i].report_type == REPORT_COUNT_DISTINCT)
+            p_report->result[i].type = DB_BIGUINT;
+        else
+            p_report->result[i].type =
+                field_type(report_desc_array[i].attr_index);
+
+        p_report->result[i].flags = field_flag(report_desc_array[i].attr_index);
+    }
+
+    for (i = report_descr_count; i < p_report->result_count; i++)
+        p_report->result[i].type = DB_BIGUINT;
+}
+
 /**
  * Builds a report from database.
  */
@@ -329,6 +356,8 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
         return NULL;
 
     p_report->p_mgr = p_mgr;
+    p_report->on_replica = false;
+    p_report->snap = NULL;
 
     p_report->result = (struct result *)MemCalloc(report_descr_count
                                                   + profile_len + ratio,
@@ -348,6 +377,17 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
     if (p_opt)
         opt = *p_opt;
 
+    if (opt.allow_snapshot) {
+        p_report->snap = lmgr_snapshot_report(report_desc_array,
+                                              report_descr_count,
+                                              profile_descr, p_filter, p_opt);
+        if (p_report->snap != NULL) {
+            report_snapshot_types(p_report, report_desc_array,
+                                  report_descr_count);
+            return p_report;
+        }
+    }
+
     fields = g_string_new(NULL);
     group_by = g_string_new(NULL);
     order_by = g_string_new(NULL);
@@ -576,25 +616,36 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
     if (opt.list_count_max > 0)
         g_string_append_printf(req, " LIMIT %u", opt.list_count_max);
 
+    /* reports are sent to a replica */
+    p_report->p_mgr = lmgr_pool_get_reader(p_mgr, p_opt);
+    p_report->on_replica = (p_report->p_mgr != p_mgr);
+
  retry:
     /* execute request (expect that ACCT table does not exists) */
     if (use_acct_table)
-        rc = db_exec_sql_quiet(&p_mgr->conn, req->str,
+        rc = db_exec_sql_quiet(&p_report->p_mgr->conn, req->str,
                                &p_report->select_result);
     else
-        rc = db_exec_sql(&p_mgr->conn, req->str, &p_report->select_result);
+        rc = db_exec_sql(&p_report->p_mgr->conn, req->str,
+                         &p_report->select_result);
+
+    if (rc == DB_CONNECT_FAILED && p_report->on_replica) {
+        /* fall back to the primary server */
+        lmgr_pool_put_reader(p_report->p_mgr, true);
+        p_report->p_mgr = p_mgr;
+        p_report->on_replica = false;
+        goto retry;
+    }
 
-    if (lmgr_delayed_retry(p_mgr, rc))
+    if (lmgr_delayed_retry(p_report->p_mgr, rc))
         goto retry;
 
     /* if the ACCT table does exist, switch to standard mode */
     if (use_acct_table && (rc == DB_NOT_EXISTS)) {
-        lmgr_iter_opt_t new_opt;
+        lmgr_iter_opt_t new_opt = LMGR_ITER_OPT_INIT;
 
         if (p_opt != NULL)
             new_opt = *p_opt;
-        else
-            new_opt.list_count_max = 0;
 
         new_opt.force_no_acct = true;
 
@@ -610,6 +661,11 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
         if (filter_name != NULL)
             g_string_free(filter_name, TRUE);
 
+        if (p_report->on_replica)
+            lmgr_pool_put_reader(p_report->p_mgr, false);
+        MemFree(p_report->result);
+        MemFree(p_report);
+
         return ListMgr_Report(p_mgr, report_desc_array, report_descr_count,
                               profile_descr, p_filter, &new_opt);
     }
@@ -631,6 +687,8 @@ struct lmgr_report_t *ListMgr_Report(lmgr_t *p_mgr,
         return p_report;
 
 /* error */
+    if (p_report->on_replica)
+        lmgr_pool_put_reader(p_report->p_mgr, false);
     MemFree(p_report->result);
 
  free_report:
@@ -661,8 +719,12 @@ int ListMgr_GetNextReportItem(struct lmgr_report_t *p_iter,
             return DB_NO_MEMORY;
     }
 
-    rc = db_next_record(&p_iter->p_mgr->conn, &p_iter->select_result,
-                        p_iter->str_tab, p_iter->result_count);
+    if (p_iter->snap != NULL)
+        rc = lmgr_snapshot_next(p_iter->snap, p_iter->str_tab,
+                                p_iter->result_count);
+    else
+        rc = db_next_record(&p_iter->p_mgr->conn, &p_iter->select_result,
+                            p_iter->str_tab, p_iter->result_count);
 
     if (rc)
         return rc;
@@ -720,7 +782,12 @@ int ListMgr_GetNextReportItem(struct lmgr_report_t *p_iter,
 
 void ListMgr_CloseReport(struct lmgr_report_t *p_iter)
 {
-    db_result_free(&p_iter->p_mgr->conn, &p_iter->select_result);
+    if (p_iter->snap != NULL)
+        lmgr_snapshot_free(p_iter->snap);
+    else
+        db_result_free(&p_iter->p_mgr->conn, &p_iter->select_result);
+    if (p_iter->on_replica)
+        lmgr_pool_put_reader(p_iter->p_mgr, false);
 
     if (p_iter->str_tab != NULL)
         MemFree(p_iter->str_tab);
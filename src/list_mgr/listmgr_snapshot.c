@@ -0,0 +1,1512 @@
+/* -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; -*-
+ * vim:expandtab:shiftwidth=4:tabstop=4:
+ */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the CeCILL License.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license (http://www.cecill.info) and that you
+ * accept its terms.
+ */
+
+/**
+ * \file    listmgr_snapshot.c
+ * \brief   Columnar snapshot of entry attributes, to build reports.
+ *
+ * The daemon periodically exports the attributes used by reports (owner,
+ * group, type, size, times, fileclass, status...) to ListManager::
+ * snapshot_file. Reports can then be computed by scanning this file
+ * instead of querying the database. Reports that are not supported by
+ * the snapshot (other attributes, complex filters, count distinct...)
+ * are computed from the DB as usual.
+ *
+ * The file is written by chunks of SNAP_CHUNK_ROWS entries. In each
+ * chunk, the values of a column are stored contiguously and compressed.
+ * Numeric columns are stored as 64 bits values with a null indicator,
+ * text columns as codes in a dictionary (0 for NULL). Dictionaries are
+ * written after the chunks. The file is only read on the host that
+ * wrote it, so values are in host byte order.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "list_mgr.h"
+#include "listmgr_common.h"
+#include "listmgr_internal.h"
+#include "database.h"
+#include "rbh_logs.h"
+#include "rbh_misc.h"
+#include "Memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define SNAP_TAG "Snapshot"
+
+#define SNAP_MAGIC      "RBHSNAP"
+#define SNAP_VERSION    1
+/** number of entries in a chunk (and in each request to the DB) */
+#define SNAP_CHUNK_ROWS 65536
+
+typedef enum {
+    SNAP_NUM = 0,
+    SNAP_DICT = 1
+} snap_kind_e;
+
+typedef struct snap_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t col_count;
+    uint64_t row_count;
+    uint64_t chunk_count;
+    /** time when the export started */
+    int64_t  export_time;
+    uint64_t dict_offset;
+} snap_header_t;
+
+typedef struct snap_coldesc {
+    char     name[64];
+    uint8_t  kind;
+    uint8_t  is_signed;
+    uint8_t  padding[6];
+} snap_coldesc_t;
+
+typedef struct snap_col {
+    snap_coldesc_t desc;
+
+    /* values of the current chunk */
+    int64_t   *num;
+    uint8_t   *null;
+    uint32_t  *codes;
+
+    /** code-1 => string */
+    GPtrArray  *dict;
+    /** string => code (export only) */
+    GHashTable *dict_codes;
+
+    /** column is used by the current report */
+    bool       needed;
+} snap_col_t;
+
+/** attributes exported to the snapshot (with the status of all
+ * status managers) */
+static const unsigned int snap_std_attrs[] = {
+    ATTR_INDEX_uid, ATTR_INDEX_gid, ATTR_INDEX_projid, ATTR_INDEX_type,
+    ATTR_INDEX_size, ATTR_INDEX_blocks, ATTR_INDEX_creation_time,
+    ATTR_INDEX_last_access, ATTR_INDEX_last_mod, ATTR_INDEX_fileclass
+};
+
+static snap_kind_e attr_kind(unsigned int attr_index, bool *is_signed)
+{
+    *is_signed = false;
+
+    switch (field_type(attr_index)) {
+    case DB_UIDGID:
+        if (!global_config.uid_gid_as_numbers)
+            return SNAP_DICT;
+        *is_signed = true;
+        return SNAP_NUM;
+    case DB_TEXT:
+    case DB_ENUM_FTYPE:
+        return SNAP_DICT;
+    case DB_INT:
+    case DB_SHORT:
+    case DB_BIGINT:
+        *is_signed = true;
+        return SNAP_NUM;
+    default:
+        return SNAP_NUM;
+    }
+}
+
+static void col_free(snap_col_t *col)
+{
+    MemFree(col->num);
+    MemFree(col->null);
+    MemFree(col->codes);
+    if (col->dict != NULL)
+        g_ptr_array_free(col->dict, TRUE);
+    if (col->dict_codes != NULL)
+        g_hash_table_destroy(col->dict_codes);
+}
+
+static int col_alloc(snap_col_t *col)
+{
+    if (col->desc.kind == SNAP_NUM) {
+        col->num = MemAlloc(SNAP_CHUNK_ROWS * sizeof(int64_t));
+        col->null = MemAlloc(SNAP_CHUNK_ROWS);
+        if (col->num == NULL || col->null == NULL)
+            return DB_NO_MEMORY;
+    } else {
+        col->codes = MemAlloc(SNAP_CHUNK_ROWS * sizeof(uint32_t));
+        if (col->codes == NULL)
+            return DB_NO_MEMORY;
+        col->dict = g_ptr_array_new_with_free_func(g_free);
+    }
+    return DB_SUCCESS;
+}
+
+/* -------------------- export -------------------- */
+
+/** write a block of data, compressed if it is worth it */
+static int write_block(FILE *f, const void *data, uint32_t len)
+{
+    uLongf zlen = compressBound(len);
+    Bytef *zbuf = MemAlloc(zlen);
+    uint32_t hdr[2] = {len, 0};
+    int rc = DB_SUCCESS;
+
+    if (zbuf == NULL)
+        return DB_NO_MEMORY;
+
+    if (compress2(zbuf, &zlen, data, len, Z_BEST_SPEED) == Z_OK
+        && zlen < len)
+        hdr[1] = zlen;
+
+    if (fwrite(hdr, sizeof(hdr), 1, f) != 1
+        || (hdr[1] != 0 && fwrite(zbuf, hdr[1], 1, f) != 1)
+        || (hdr[1] == 0 && len > 0 && fwrite(data, len, 1, f) != 1))
+        rc = DB_REQUEST_FAILED;
+
+    MemFree(zbuf);
+    return rc;
+}
+
+static uint32_t dict_code(snap_col_t *col, const char *str)
+{
+    gpointer code;
+    char *dup;
+
+    if (str == NULL)
+        return 0;
+
+    code = g_hash_table_lookup(col->dict_codes, str);
+    if (code != NULL)
+        return GPOINTER_TO_UINT(code);
+
+    dup = g_strdup(str);
+    g_ptr_array_add(col->dict, dup);
+    g_hash_table_insert(col->dict_codes, dup, GUINT_TO_POINTER(col->dict->len));
+    return col->dict->len;
+}
+
+static int write_chunk(FILE *f, snap_col_t *cols, unsigned int col_count,
+                       uint32_t rows)
+{
+    unsigned int i;
+    int rc;
+
+    if (fwrite(&rows, sizeof(rows), 1, f) != 1)
+        return DB_REQUEST_FAILED;
+
+    for (i = 0; i < col_count; i++) {
+        if (cols[i].desc.kind == SNAP_NUM) {
+            rc = write_block(f, cols[i].num, rows * sizeof(int64_t));
+            if (rc == DB_SUCCESS)
+                rc = write_block(f, cols[i].null, rows);
+        } else {
+            rc = write_block(f, cols[i].codes, rows * sizeof(uint32_t));
+        }
+        if (rc)
+            return rc;
+    }
+    return DB_SUCCESS;
+}
+
+static int write_dicts(FILE *f, snap_col_t *cols, unsigned int col_count)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < col_count; i++) {
+        uint32_t count;
+
+        if (cols[i].desc.kind != SNAP_DICT)
+            continue;
+
+        count = cols[i].dict->len;
+        if (fwrite(&count, sizeof(count), 1, f) != 1)
+            return DB_REQUEST_FAILED;
+
+        for (j = 0; j < count; j++) {
+            const char *str = g_ptr_array_index(cols[i].dict, j);
+            uint32_t len = strlen(str);
+
+            if (fwrite(&len, sizeof(len), 1, f) != 1
+                || (len > 0 && fwrite(str, len, 1, f) != 1))
+                return DB_REQUEST_FAILED;
+        }
+    }
+    return DB_SUCCESS;
+}
+
+/** get the columns to be exported */
+static snap_col_t *export_columns(unsigned int *count)
+{
+    unsigned int max = G_N_ELEMENTS(snap_std_attrs) + sm_inst_count;
+    snap_col_t *cols;
+    unsigned int i, n = 0;
+
+    cols = MemCalloc(max, sizeof(snap_col_t));
+    if (cols == NULL)
+        return NULL;
+
+    for (i = 0; i < max; i++) {
+        unsigned int attr;
+        bool is_signed;
+
+        if (i < G_N_ELEMENTS(snap_std_attrs))
+            attr = snap_std_attrs[i];
+        else
+            attr = ATTR_INDEX_FLG_STATUS | (i - G_N_ELEMENTS(snap_std_attrs));
+
+        if (!is_main_field(attr))
+            continue;
+
+        rh_strncpy(cols[n].desc.name, field_name(attr),
+                   sizeof(cols[n].desc.name));
+        cols[n].desc.kind = attr_kind(attr, &is_signed);
+        cols[n].desc.is_signed = is_signed;
+        n++;
+    }
+    *count = n;
+    return cols;
+}
+
+static int snapshot_export(lmgr_t *p_mgr, const char *tmp_file)
+{
+    snap_header_t hdr = { SNAP_MAGIC, SNAP_VERSION };
+    snap_col_t *cols;
+    unsigned int col_count, i;
+    GString *fields, *req;
+    DEF_PK(last_id);
+    char **res = NULL;
+    FILE *f = NULL;
+    off_t offset;
+    int rc;
+
+    hdr.export_time = time(NULL);
+
+    cols = export_columns(&col_count);
+    if (cols == NULL)
+        return DB_NO_MEMORY;
+    hdr.col_count = col_count;
+
+    fields = g_string_new("id");
+    for (i = 0; i < col_count; i++) {
+        g_string_append_printf(fields, ",%s", cols[i].desc.name);
+        rc = col_alloc(&cols[i]);
+        if (rc)
+            goto free_cols;
+        if (cols[i].desc.kind == SNAP_DICT)
+            cols[i].dict_codes = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+    req = g_string_new(NULL);
+
+    res = MemCalloc(col_count + 1, sizeof(char *));
+    if (res == NULL) {
+        rc = DB_NO_MEMORY;
+        goto free_str;
+    }
+
+    f = fopen(tmp_file, "w");
+    if (f == NULL) {
+        rc = errno;
+        DisplayLog(LVL_CRIT, SNAP_TAG, "Failed to create '%s': %s",
+                   tmp_file, strerror(rc));
+        rc = DB_REQUEST_FAILED;
+        goto free_str;
+    }
+
+    /* header is written again when the export is complete */
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+        rc = DB_REQUEST_FAILED;
+        goto close;
+    }
+    for (i = 0; i < col_count; i++)
+        if (fwrite(&cols[i].desc, sizeof(cols[i].desc), 1, f) != 1) {
+            rc = DB_REQUEST_FAILED;
+            goto close;
+        }
+
+    /* read entries by pages, resuming from the last id */
+    last_id[0] = '\0';
+    do {
+        result_handle_t result;
+        uint32_t rows = 0;
+
+        g_string_printf(req, "SELECT %s FROM " MAIN_TABLE, fields->str);
+        if (!EMPTY_STRING(last_id))
+            g_string_append_printf(req, " WHERE id>" DPK, last_id);
+        g_string_append_printf(req, " ORDER BY id LIMIT %u", SNAP_CHUNK_ROWS);
+
+        do {
+            rc = db_exec_sql(&p_mgr->conn, req->str, &result);
+        } while (rc != DB_SUCCESS && lmgr_delayed_retry(p_mgr, rc));
+        if (rc)
+            goto close;
+
+        while ((rc = db_next_record(&p_mgr->conn, &result, res,
+                                    col_count + 1)) == DB_SUCCESS) {
+            if (res[0] == NULL)
+                continue;
+            rh_strncpy(last_id, res[0], sizeof(last_id));
+
+            for (i = 0; i < col_count; i++) {
+                snap_col_t *col = &cols[i];
+                const char *val = res[i + 1];
+
+                if (col->desc.kind == SNAP_DICT) {
+                    col->codes[rows] = dict_code(col, val);
+                } else if (val == NULL) {
+                    col->null[rows] = 1;
+                    col->num[rows] = 0;
+                } else {
+                    col->null[rows] = 0;
+                    col->num[rows] = col->desc.is_signed ?
+                        strtoll(val, NULL, 10) :
+                        (int64_t)strtoull(val, NULL, 10);
+                }
+            }
+            rows++;
+        }
+        db_result_free(&p_mgr->conn, &result);
+
+        if (rc != DB_END_OF_LIST)
+            goto close;
+
+        if (rows > 0) {
+            rc = write_chunk(f, cols, col_count, rows);
+            if (rc)
+                goto close;
+            hdr.row_count += rows;
+            hdr.chunk_count++;
+        }
+
+        rc = DB_SUCCESS;
+        if (rows < SNAP_CHUNK_ROWS)
+            break;
+    } while (1);
+
+    offset = ftello(f);
+    if (offset == -1) {
+        rc = DB_REQUEST_FAILED;
+        goto close;
+    }
+    hdr.dict_offset = offset;
+
+    rc = write_dicts(f, cols, col_count);
+    if (rc)
+        goto close;
+
+    if (fseeko(f, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, f) != 1
+        || fflush(f) != 0 || fsync(fileno(f)) != 0)
+        rc = DB_REQUEST_FAILED;
+
+ close:
+    if (fclose(f) != 0 && rc == DB_SUCCESS)
+        rc = DB_REQUEST_FAILED;
+    if (rc == DB_SUCCESS)
+        DisplayLog(LVL_VERB, SNAP_TAG, "%" PRIu64 " entries exported in %"
+                   PRIu64 " chunks", hdr.row_count, hdr.chunk_count);
+ free_str:
+    MemFree(res);
+    g_string_free(req, TRUE);
+ free_cols:
+    g_string_free(fields, TRUE);
+    for (i = 0; i < col_count; i++)
+        col_free(&cols[i]);
+    MemFree(cols);
+    return rc;
+}
+
+int ListMgr_UpdateSnapshot(lmgr_t *p_mgr)
+{
+    const char *file = lmgr_config.snapshot_file;
+    struct stat st;
+    char *tmp_file;
+    lmgr_t *reader;
+    time_t start = time(NULL);
+    int rc;
+
+    if (EMPTY_STRING(file))
+        return DB_NOT_SUPPORTED;
+
+    if (stat(file, &st) == 0
+        && start - st.st_mtime < lmgr_config.snapshot_interval)
+        return DB_SUCCESS;
+
+    tmp_file = g_strdup_printf("%s.%u.tmp", file, (unsigned int)getpid());
+
+    /* the whole table is read: use a replica if there is one */
+    reader = lmgr_pool_get_reader(p_mgr, NULL);
+    rc = snapshot_export(reader, tmp_file);
+    if (reader != p_mgr)
+        lmgr_pool_put_reader(reader, rc == DB_CONNECT_FAILED);
+
+    if (rc == DB_SUCCESS && rename(tmp_file, file) != 0) {
+        DisplayLog(LVL_CRIT, SNAP_TAG, "Failed to rename '%s' to '%s': %s",
+                   tmp_file, file, strerror(errno));
+        rc = DB_REQUEST_FAILED;
+    }
+
+    if (rc == DB_SUCCESS) {
+        DisplayLog(LVL_EVENT, SNAP_TAG, "Report snapshot '%s' updated in %lds",
+                   file, (long)(time(NULL) - start));
+    } else {
+        DisplayLog(LVL_MAJOR, SNAP_TAG, "Failed to export report snapshot "
+                   "to '%s' (error %d)", file, rc);
+        unlink(tmp_file);
+    }
+
+    g_free(tmp_file);
+    return rc;
+}
+
+/* -------------------- reports -------------------- */
+
+typedef struct snap_file {
+    FILE          *f;
+    snap_header_t  hdr;
+    snap_col_t    *cols;
+} snap_file_t;
+
+/** filter on a column */
+typedef struct snap_filter {
+    int                  col;
+    filter_comparator_t  compar;
+    int                  flags;
+    /* numeric columns: value(s) to compare with */
+    int64_t             *values;
+    unsigned int         value_count;
+    /* text columns: result of the filter for each code */
+    uint8_t             *match;
+} snap_filter_t;
+
+/** a report field */
+typedef struct snap_field {
+    /** column (-1 for count) */
+    int         col;
+    /** index in the group key (group by fields) */
+    int         key;
+} snap_field_t;
+
+typedef struct snap_group {
+    unsigned int ng;
+    int64_t     *key;
+    uint8_t     *key_null;
+
+    int64_t     *acc;
+    uint64_t    *nonnull;
+    uint64_t     count;
+    uint64_t     profile[SZ_PROFIL_COUNT];
+    uint64_t     ratio;
+} snap_group_t;
+
+typedef struct snap_query {
+    snap_file_t                 *snap;
+    const report_field_descr_t  *desc;
+    unsigned int                 desc_count;
+    const profile_field_descr_t *profile;
+
+    snap_field_t   *fields;
+    unsigned int    ng;
+    /** columns of group keys */
+    int            *key_cols;
+    /** size column for profiles */
+    int             size_col;
+
+    GArray         *filters;
+} snap_query_t;
+
+struct snapshot_result {
+    GPtrArray    *rows;
+    GStringChunk *strings;
+    unsigned int  count;
+    unsigned int  next;
+};
+
+static int read_block(FILE *f, void *buf, uint32_t expected, bool skip)
+{
+    uint32_t hdr[2];
+    uLongf len;
+    Bytef *zbuf;
+    int rc;
+
+    if (fread(hdr, sizeof(hdr), 1, f) != 1 || hdr[0] != expected)
+        return DB_REQUEST_FAILED;
+
+    if (skip)
+        return fseeko(f, hdr[1] != 0 ? hdr[1] : hdr[0], SEEK_CUR) == 0 ?
+            DB_SUCCESS : DB_REQUEST_FAILED;
+
+    if (hdr[1] == 0)
+        return (expected == 0 || fread(buf, expected, 1, f) == 1) ?
+            DB_SUCCESS : DB_REQUEST_FAILED;
+
+    zbuf = MemAlloc(hdr[1]);
+    if (zbuf == NULL)
+        return DB_NO_MEMORY;
+
+    len = expected;
+    if (fread(zbuf, hdr[1], 1, f) != 1
+        || uncompress(buf, &len, zbuf, hdr[1]) != Z_OK || len != expected)
+        rc = DB_REQUEST_FAILED;
+    else
+        rc = DB_SUCCESS;
+
+    MemFree(zbuf);
+    return rc;
+}
+
+static void snap_close(snap_file_t *snap)
+{
+    unsigned int i;
+
+    if (snap->cols != NULL) {
+        for (i = 0; i < snap->hdr.col_count; i++)
+            col_free(&snap->cols[i]);
+        MemFree(snap->cols);
+    }
+    fclose(snap->f);
+    MemFree(snap);
+}
+
+static int read_dicts(snap_file_t *snap)
+{
+    unsigned int i, j;
+
+    if (fseeko(snap->f, snap->hdr.dict_offset, SEEK_SET) != 0)
+        return DB_REQUEST_FAILED;
+
+    for (i = 0; i < snap->hdr.col_count; i++) {
+        snap_col_t *col = &snap->cols[i];
+        uint32_t count;
+
+        if (col->desc.kind != SNAP_DICT)
+            continue;
+
+        if (fread(&count, sizeof(count), 1, snap->f) != 1)
+            return DB_REQUEST_FAILED;
+
+        for (j = 0; j < count; j++) {
+            uint32_t len;
+            char *str;
+
+            if (fread(&len, sizeof(len), 1, snap->f) != 1)
+                return DB_REQUEST_FAILED;
+            str = g_malloc(len + 1);
+            if (len > 0 && fread(str, len, 1, snap->f) != 1) {
+                g_free(str);
+                return DB_REQUEST_FAILED;
+            }
+            str[len] = '\0';
+            g_ptr_array_add(col->dict, str);
+        }
+    }
+    return DB_SUCCESS;
+}
+
+/** open the snapshot file, if it is recent enough */
+static snap_file_t *snap_open(void)
+{
+    const char *file = lmgr_config.snapshot_file;
+    snap_file_t *snap;
+    time_t age;
+    unsigned int i;
+
+    if (EMPTY_STRING(file))
+        return NULL;
+
+    snap = MemCalloc(1, sizeof(snap_file_t));
+    if (snap == NULL)
+        return NULL;
+
+    snap->f = fopen(file, "r");
+    if (snap->f == NULL) {
+        DisplayLog(LVL_DEBUG, SNAP_TAG, "Can't open '%s': %s", file,
+                   strerror(errno));
+        MemFree(snap);
+        return NULL;
+    }
+
+    if (fread(&snap->hdr, sizeof(snap->hdr), 1, snap->f) != 1
+        || strcmp(snap->hdr.magic, SNAP_MAGIC) != 0
+        || snap->hdr.version != SNAP_VERSION) {
+        DisplayLog(LVL_MAJOR, SNAP_TAG, "'%s' is not a valid report snapshot",
+                   file);
+        goto err;
+    }
+
+    age = time(NULL) - snap->hdr.export_time;
+    if (age > 2 * lmgr_config.snapshot_interval) {
+        DisplayLog(LVL_VERB, SNAP_TAG, "Report snapshot is too old (%lds): "
+                   "querying the database", (long)age);
+        goto err;
+    }
+
+    snap->cols = MemCalloc(snap->hdr.col_count, sizeof(snap_col_t));
+    if (snap->cols == NULL)
+        goto err;
+
+    for (i = 0; i < snap->hdr.col_count; i++) {
+        if (fread(&snap->cols[i].desc, sizeof(snap->cols[i].desc), 1,
+                  snap->f) != 1)
+            goto err;
+        snap->cols[i].desc.name[sizeof(snap->cols[i].desc.name) - 1] = '\0';
+        if (col_alloc(&snap->cols[i]))
+            goto err;
+    }
+    return snap;
+
+ err:
+    snap_close(snap);
+    return NULL;
+}
+
+/** get the column of an attribute, if its representation in the
+ * snapshot matches the current configuration */
+static int snap_col_index(const snap_file_t *snap, unsigned int attr_index)
+{
+    unsigned int i;
+    bool is_signed;
+    snap_kind_e kind;
+
+    if (!is_main_field(attr_index) || is_sm_info_field(attr_index))
+        return -1;
+
+    kind = attr_kind(attr_index, &is_signed);
+
+    for (i = 0; i < snap->hdr.col_count; i++)
+        if (!strcmp(snap->cols[i].desc.name, field_name(attr_index)))
+            return (snap->cols[i].desc.kind == kind) ? i : -1;
+
+    return -1;
+}
+
+static int64_t value2num(db_type_e type, const db_type_u *val)
+{
+    switch (type) {
+    case DB_UIDGID:
+    case DB_INT:
+        return val->val_int;
+    case DB_UINT:
+        return val->val_uint;
+    case DB_SHORT:
+        return val->val_short;
+    case DB_USHORT:
+        return val->val_ushort;
+    case DB_BIGINT:
+        return val->val_bigint;
+    case DB_BIGUINT:
+        return (int64_t)val->val_biguint;
+    case DB_BOOL:
+        return val->val_bool ? 1 : 0;
+    default:
+        return 0;
+    }
+}
+
+static inline int num_cmp(int64_t a, int64_t b, bool is_signed)
+{
+    if (is_signed)
+        return (a > b) - (a < b);
+    return ((uint64_t)a > (uint64_t)b) - ((uint64_t)a < (uint64_t)b);
+}
+
+/** SQL LIKE matching ('%', '_', and '\' as escape character) */
+static bool like_match(const char *pattern, const char *str, bool icase)
+{
+    for (; *pattern != '\0'; pattern++, str++) {
+        switch (*pattern) {
+        case '%':
+            while (*(pattern + 1) == '%')
+                pattern++;
+            if (*(pattern + 1) == '\0')
+                return true;
+            for (; *str != '\0'; str++)
+                if (like_match(pattern + 1, str, icase))
+                    return true;
+            return false;
+
+        case '_':
+            if (*str == '\0')
+                return false;
+            break;
+
+        case '\\':
+            if (*(pattern + 1) != '\0')
+                pattern++;
+            /* fall through */
+        default:
+            if (icase ? tolower((unsigned char)*pattern)
+                != tolower((unsigned char)*str) : *pattern != *str)
+                return false;
+        }
+    }
+    return *str == '\0';
+}
+
+/** @return 1 if the condition matches, 0 if not, -1 if the result is NULL */
+static int compar_result(int cmp, filter_comparator_t compar)
+{
+    switch (compar) {
+    case EQUAL:
+        return cmp == 0;
+    case NOTEQUAL:
+        return cmp != 0;
+    case LESSTHAN:
+        return cmp <= 0;
+    case MORETHAN:
+        return cmp >= 0;
+    case LESSTHAN_STRICT:
+        return cmp < 0;
+    case MORETHAN_STRICT:
+        return cmp > 0;
+    default:
+        return -1;
+    }
+}
+
+static int str_match(const char *str, filter_comparator_t compar,
+                     const filter_value_t *val)
+{
+    unsigned int i;
+
+    switch (compar) {
+    case LIKE:
+    case UNLIKE:
+    case ILIKE:
+    case IUNLIKE:
+        if (val->value.val_str == NULL)
+            return -1;
+        return like_match(val->value.val_str, str,
+                          compar == ILIKE || compar == IUNLIKE)
+            == (compar == LIKE || compar == ILIKE);
+    case IN:
+    case NOTIN:
+        for (i = 0; i < val->list.count; i++)
+            if (val->list.values[i].val_str != NULL
+                && !strcmp(val->list.values[i].val_str, str))
+                return compar == IN;
+        return compar == NOTIN;
+    case ISNULL:
+        return 0;
+    case NOTNULL:
+        return 1;
+    default:
+        if (val->value.val_str == NULL)
+            return -1;
+        return compar_result(strcmp(str, val->value.val_str), compar);
+    }
+}
+
+static int num_match(int64_t v, bool is_signed, const snap_filter_t *filter)
+{
+    unsigned int i;
+
+    switch (filter->compar) {
+    case IN:
+    case NOTIN:
+        for (i = 0; i < filter->value_count; i++)
+            if (v == filter->values[i])
+                return filter->compar == IN;
+        return filter->compar == NOTIN;
+    case ISNULL:
+        return 0;
+    case NOTNULL:
+        return 1;
+    default:
+        return compar_result(num_cmp(v, filter->values[0], is_signed),
+                             filter->compar);
+    }
+}
+
+/** apply SQL NULL semantics and filter flags to a condition result */
+static bool filter_pass(int res, bool is_null, const snap_filter_t *filter)
+{
+    if (is_null)
+        res = (filter->compar == ISNULL) ? 1 :
+              (filter->compar == NOTNULL) ? 0 : -1;
+    if ((filter->flags & FILTER_FLAG_NOT) && res != -1)
+        res = !res;
+    if ((filter->flags & FILTER_FLAG_ALLOW_NULL) && is_null)
+        res = 1;
+    return res == 1;
+}
+
+static bool add_filter(snap_query_t *q, unsigned int attr_index,
+                       filter_comparator_t compar, int flags,
+                       const filter_value_t *val)
+{
+    snap_filter_t filter = {.compar = compar, .flags = flags};
+    snap_col_t *col;
+    unsigned int i;
+
+    if (flags & ~(FILTER_FLAG_NOT | FILTER_FLAG_ALLOW_NULL
+                  | FILTER_FLAG_ALLOC_STR | FILTER_FLAG_ALLOC_LIST))
+        return false;
+    if (compar == RLIKE || is_sepdlist(attr_index))
+        return false;
+
+    filter.col = snap_col_index(q->snap, attr_index);
+    if (filter.col < 0)
+        return false;
+    col = &q->snap->cols[filter.col];
+    col->needed = true;
+
+    if (col->desc.kind == SNAP_DICT) {
+        /* compute the result for each value of the dictionary */
+        filter.match = MemAlloc(col->dict->len + 1);
+        if (filter.match == NULL)
+            return false;
+        filter.match[0] = filter_pass(-1, true, &filter);
+        for (i = 0; i < col->dict->len; i++)
+            filter.match[i + 1] =
+                filter_pass(str_match(g_ptr_array_index(col->dict, i),
+                                      compar, val), false, &filter);
+    } else {
+        db_type_e type = field_type(attr_index);
+
+        if (compar == LIKE || compar == UNLIKE || compar == ILIKE
+            || compar == IUNLIKE)
+            return false;
+
+        if (compar == IN || compar == NOTIN) {
+            filter.value_count = val->list.count;
+            filter.values = MemCalloc(MAX(val->list.count, 1),
+                                      sizeof(int64_t));
+            if (filter.values == NULL)
+                return false;
+            for (i = 0; i < val->list.count; i++)
+                filter.values[i] = value2num(type, &val->list.values[i]);
+        } else {
+            filter.value_count = 1;
+            filter.values = MemAlloc(sizeof(int64_t));
+            if (filter.values == NULL)
+                return false;
+            filter.values[0] = value2num(type, &val->value);
+        }
+    }
+
+    g_array_append_val(q->filters, filter);
+    return true;
+}
+
+/** check the report can be computed from the snapshot, and prepare it */
+static bool query_init(snap_query_t *q, const lmgr_filter_t *p_filter)
+{
+    unsigned int i;
+
+    q->fields = MemCalloc(MAX(q->desc_count, 1), sizeof(snap_field_t));
+    q->key_cols = MemCalloc(MAX(q->desc_count, 1), sizeof(int));
+    q->filters = g_array_new(FALSE, TRUE, sizeof(snap_filter_t));
+    q->size_col = -1;
+    if (q->fields == NULL || q->key_cols == NULL)
+        return false;
+
+    for (i = 0; i < q->desc_count; i++) {
+        const report_field_descr_t *d = &q->desc[i];
+        snap_field_t *field = &q->fields[i];
+
+        field->key = -1;
+        field->col = -1;
+
+        if (d->report_type == REPORT_COUNT)
+            goto filter;
+        if (d->report_type == REPORT_COUNT_DISTINCT)
+            return false;
+
+        field->col = snap_col_index(q->snap, d->attr_index);
+        if (field->col < 0)
+            return false;
+        q->snap->cols[field->col].needed = true;
+
+        if (d->report_type == REPORT_GROUP_BY) {
+            field->key = q->ng;
+            q->key_cols[q->ng] = field->col;
+            q->ng++;
+        } else if (q->snap->cols[field->col].desc.kind != SNAP_NUM) {
+            /* min, max, sum, avg on text */
+            return false;
+        }
+
+ filter:
+        /* filters on group by fields apply to entries,
+         * filters on aggregates apply to groups */
+        if (d->filter && d->report_type == REPORT_GROUP_BY
+            && !add_filter(q, d->attr_index, d->filter_compar, 0,
+                           &d->filter_value))
+            return false;
+        if (d->filter && d->report_type != REPORT_GROUP_BY
+            && (d->filter_compar == IN || d->filter_compar == NOTIN
+                || compar_result(0, d->filter_compar) == -1))
+            return false;
+    }
+
+    if (q->profile != NULL) {
+        q->size_col = snap_col_index(q->snap, ATTR_INDEX_size);
+        if (q->size_col < 0)
+            return false;
+        q->snap->cols[q->size_col].needed = true;
+    }
+
+    if (!no_filter(p_filter)) {
+        if (p_filter->filter_type != FILTER_SIMPLE)
+            return false;
+
+        for (i = 0; i < p_filter->filter_simple.filter_count; i++)
+            if (!add_filter(q, p_filter->filter_simple.filter_index[i],
+                            p_filter->filter_simple.filter_compar[i],
+                            p_filter->filter_simple.filter_flags[i],
+                            &p_filter->filter_simple.filter_value[i]))
+                return false;
+    }
+    return true;
+}
+
+static void query_free(snap_query_t *q)
+{
+    unsigned int i;
+
+    for (i = 0; i < q->filters->len; i++) {
+        snap_filter_t *filter = &g_array_index(q->filters, snap_filter_t, i);
+
+        MemFree(filter->values);
+        MemFree(filter->match);
+    }
+    g_array_free(q->filters, TRUE);
+    MemFree(q->fields);
+    MemFree(q->key_cols);
+}
+
+static guint group_hash(gconstpointer key)
+{
+    const snap_group_t *g = key;
+    guint h = 2166136261u;
+    unsigned int i;
+
+    for (i = 0; i < g->ng; i++) {
+        h = (h ^ (guint)g->key[i]) * 16777619u;
+        h = (h ^ (guint)(g->key[i] >> 32)) * 16777619u;
+        h = (h ^ g->key_null[i]) * 16777619u;
+    }
+    return h;
+}
+
+static gboolean group_equal(gconstpointer a, gconstpointer b)
+{
+    const snap_group_t *ga = a;
+    const snap_group_t *gb = b;
+    unsigned int i;
+
+    for (i = 0; i < ga->ng; i++)
+        if (ga->key_null[i] != gb->key_null[i]
+            || (!ga->key_null[i] && ga->key[i] != gb->key[i]))
+            return FALSE;
+    return TRUE;
+}
+
+static snap_group_t *group_new(const snap_query_t *q, const snap_group_t *key)
+{
+    snap_group_t *g = g_new0(snap_group_t, 1);
+
+    g->ng = q->ng;
+    g->key = g_new0(int64_t, MAX(q->ng, 1));
+    g->key_null = g_new0(uint8_t, MAX(q->ng, 1));
+    g->acc = g_new0(int64_t, MAX(q->desc_count, 1));
+    g->nonnull = g_new0(uint64_t, MAX(q->desc_count, 1));
+    if (key != NULL) {
+        memcpy(g->key, key->key, q->ng * sizeof(int64_t));
+        memcpy(g->key_null, key->key_null, q->ng);
+    }
+    return g;
+}
+
+static void group_free(gpointer ptr)
+{
+    snap_group_t *g = ptr;
+
+    g_free(g->key);
+    g_free(g->key_null);
+    g_free(g->acc);
+    g_free(g->nonnull);
+    g_free(g);
+}
+
+/** read the value of a column for the given row */
+static inline bool col_value(const snap_col_t *col, unsigned int row,
+                             int64_t *val)
+{
+    if (col->desc.kind == SNAP_DICT) {
+        *val = col->codes[row];
+        return col->codes[row] != 0;
+    }
+    *val = col->num[row];
+    return !col->null[row];
+}
+
+static unsigned int size_profile_index(uint64_t size)
+{
+    unsigned int log2 = 0;
+
+    if (size == 0)
+        return 0;
+
+    /* same as sz_range() + 1, the last range having no upper bound */
+    while (size >>= 1)
+        log2++;
+    return MIN(log2 / 5 + 1, SZ_PROFIL_COUNT - 1);
+}
+
+static void group_update(const snap_query_t *q, snap_group_t *g,
+                         unsigned int row)
+{
+    unsigned int i;
+
+    g->count++;
+
+    for (i = 0; i < q->desc_count; i++) {
+        const snap_col_t *col;
+        int64_t v;
+
+        if (q->fields[i].key >= 0 || q->fields[i].col < 0)
+            continue;
+
+        col = &q->snap->cols[q->fields[i].col];
+        if (!col_value(col, row, &v))
+            continue;
+
+        switch (q->desc[i].report_type) {
+        case REPORT_MIN:
+            if (g->nonnull[i] == 0 || num_cmp(v, g->acc[i],
+                                              col->desc.is_signed) < 0)
+                g->acc[i] = v;
+            break;
+        case REPORT_MAX:
+            if (g->nonnull[i] == 0 || num_cmp(v, g->acc[i],
+                                              col->desc.is_signed) > 0)
+                g->acc[i] = v;
+            break;
+        case REPORT_SUM:
+        case REPORT_AVG:
+            g->acc[i] = (int64_t)((uint64_t)g->acc[i] + (uint64_t)v);
+            break;
+        default:
+            break;
+        }
+        g->nonnull[i]++;
+    }
+
+    if (q->size_col >= 0) {
+        int64_t size;
+
+        if (col_value(&q->snap->cols[q->size_col], row, &size)) {
+            g->profile[size_profile_index(size)]++;
+
+            if (q->profile->range_ratio_len > 0) {
+                unsigned int start = q->profile->range_ratio_start;
+                unsigned int end = start + q->profile->range_ratio_len;
+
+                if ((uint64_t)size >= SZ_MIN_BY_INDEX(start)
+                    && (end >= SZ_PROFIL_COUNT
+                        || (uint64_t)size < SZ_MIN_BY_INDEX(end)))
+                    g->ratio++;
+            }
+        }
+    }
+}
+
+/** scan the snapshot and aggregate selected entries */
+static int query_scan(snap_query_t *q, GHashTable *groups, snap_group_t *all)
+{
+    snap_file_t *snap = q->snap;
+    snap_group_t *tmp;
+    uint8_t *sel;
+    uint64_t c;
+    unsigned int i, row, f;
+    int rc = DB_SUCCESS;
+
+    if (fseeko(snap->f, sizeof(snap_header_t)
+               + snap->hdr.col_count * sizeof(snap_coldesc_t), SEEK_SET) != 0)
+        return DB_REQUEST_FAILED;
+
+    sel = MemAlloc(SNAP_CHUNK_ROWS);
+    if (sel == NULL)
+        return DB_NO_MEMORY;
+    tmp = group_new(q, NULL);
+
+    for (c = 0; c < snap->hdr.chunk_count; c++) {
+        uint32_t rows;
+
+        if (fread(&rows, sizeof(rows), 1, snap->f) != 1
+            || rows > SNAP_CHUNK_ROWS) {
+            rc = DB_REQUEST_FAILED;
+            break;
+        }
+
+        for (i = 0; i < snap->hdr.col_count && rc == DB_SUCCESS; i++) {
+            snap_col_t *col = &snap->cols[i];
+
+            if (col->desc.kind == SNAP_NUM) {
+                rc = read_block(snap->f, col->num, rows * sizeof(int64_t),
+                                !col->needed);
+                if (rc == DB_SUCCESS)
+                    rc = read_block(snap->f, col->null, rows, !col->needed);
+            } else {
+                rc = read_block(snap->f, col->codes, rows * sizeof(uint32_t),
+                                !col->needed);
+            }
+        }
+        if (rc)
+            break;
+
+        /* select entries, one filter at a time */
+        memset(sel, 1, rows);
+        for (f = 0; f < q->filters->len; f++) {
+            const snap_filter_t *filter = &g_array_index(q->filters,
+                                                         snap_filter_t, f);
+            const snap_col_t *col = &snap->cols[filter->col];
+
+            if (col->desc.kind == SNAP_DICT) {
+                for (row = 0; row < rows; row++)
+                    sel[row] &= filter->match[col->codes[row]];
+            } else {
+                for (row = 0; row < rows; row++) {
+                    if (!sel[row])
+                        continue;
+                    sel[row] = filter_pass(col->null[row] ? -1 :
+                                           num_match(col->num[row],
+                                                     col->desc.is_signed,
+                                                     filter),
+                                           col->null[row], filter);
+                }
+            }
+        }
+
+        for (row = 0; row < rows; row++) {
+            snap_group_t *g;
+
+            if (!sel[row])
+                continue;
+
+            if (q->ng == 0) {
+                group_update(q, all, row);
+                continue;
+            }
+
+            /* NULL values are stored as 0 */
+            for (i = 0; i < q->ng; i++)
+                tmp->key_null[i] = !col_value(&snap->cols[q->key_cols[i]],
+                                              row, &tmp->key[i]);
+
+            g = g_hash_table_lookup(groups, tmp);
+            if (g == NULL) {
+                g = group_new(q, tmp);
+                g_hash_table_insert(groups, g, g);
+            }
+            group_update(q, g, row);
+        }
+    }
+
+    group_free(tmp);
+    MemFree(sel);
+    return rc;
+}
+
+/** get the value of a report field for a group.
+ * @return false if the value is NULL */
+static bool field_value(const snap_query_t *q, const snap_group_t *g,
+                        unsigned int i, int64_t *val)
+{
+    const snap_field_t *field = &q->fields[i];
+    bool is_signed;
+
+    if (q->desc[i].report_type == REPORT_COUNT) {
+        *val = g->count;
+        return true;
+    }
+    if (field->key >= 0) {
+        *val = g->key[field->key];
+        return !g->key_null[field->key];
+    }
+    if (g->nonnull[i] == 0)
+        return false;
+
+    is_signed = q->snap->cols[field->col].desc.is_signed;
+    if (q->desc[i].report_type == REPORT_AVG) {
+        /* ROUND(AVG(x)) */
+        long double avg = is_signed ? (long double)g->acc[i] :
+                                      (long double)(uint64_t)g->acc[i];
+
+        avg /= g->nonnull[i];
+        *val = is_signed ? llroundl(avg) : (int64_t)(uint64_t)roundl(avg);
+    } else {
+        *val = g->acc[i];
+    }
+    return true;
+}
+
+static bool field_signed(const snap_query_t *q, unsigned int i)
+{
+    if (q->fields[i].col < 0)
+        return false;
+    return q->snap->cols[q->fields[i].col].desc.is_signed;
+}
+
+static bool field_is_text(const snap_query_t *q, unsigned int i)
+{
+    return q->fields[i].col >= 0
+        && q->snap->cols[q->fields[i].col].desc.kind == SNAP_DICT;
+}
+
+static const char *dict_str(const snap_query_t *q, unsigned int i,
+                            int64_t code)
+{
+    return g_ptr_array_index(q->snap->cols[q->fields[i].col].dict, code - 1);
+}
+
+/** filters on aggregated values */
+static bool group_having(const snap_query_t *q, const snap_group_t *g)
+{
+    unsigned int i;
+
+    for (i = 0; i < q->desc_count; i++) {
+        const report_field_descr_t *d = &q->desc[i];
+        db_type_e type;
+        int64_t v;
+
+        if (!d->filter || d->report_type == REPORT_GROUP_BY)
+            continue;
+
+        if (!field_value(q, g, i, &v))
+            return false;
+
+        type = (d->report_type == REPORT_COUNT) ? DB_BIGUINT :
+            field_type(d->attr_index);
+        if (compar_result(num_cmp(v, value2num(type, &d->filter_value.value),
+                                  field_signed(q, i)), d->filter_compar) != 1)
+            return false;
+    }
+    return true;
+}
+
+static inline double group_ratio(const snap_group_t *g)
+{
+    return g->count == 0 ? 0.0 : (double)g->ratio / g->count;
+}
+
+static gint group_cmp(gconstpointer a, gconstpointer b, gpointer udata)
+{
+    const snap_query_t *q = udata;
+    const snap_group_t *ga = *(const snap_group_t * const *)a;
+    const snap_group_t *gb = *(const snap_group_t * const *)b;
+    unsigned int i;
+    int cmp;
+
+    /* sorting by ratio first */
+    if (q->profile != NULL && q->profile->range_ratio_len > 0
+        && q->profile->range_ratio_sort != SORT_NONE) {
+        double ra = group_ratio(ga);
+        double rb = group_ratio(gb);
+
+        cmp = (ra > rb) - (ra < rb);
+        if (cmp != 0)
+            return q->profile->range_ratio_sort == SORT_DESC ? -cmp : cmp;
+    }
+
+    for (i = 0; i < q->desc_count; i++) {
+        int64_t va, vb;
+        bool na, nb;
+
+        if (q->desc[i].sort_flag == SORT_NONE)
+            continue;
+
+        na = !field_value(q, ga, i, &va);
+        nb = !field_value(q, gb, i, &vb);
+
+        /* NULL is lower than any value */
+        if (na || nb)
+            cmp = (int)nb - (int)na;
+        else if (field_is_text(q, i))
+            cmp = strcmp(dict_str(q, i, va), dict_str(q, i, vb));
+        else
+            cmp = num_cmp(va, vb, field_signed(q, i));
+
+        if (cmp != 0)
+            return q->desc[i].sort_flag == SORT_DESC ? -cmp : cmp;
+    }
+    return 0;
+}
+
+/** convert a group to a result row, as it would be returned by the DB */
+static char **group_row(const snap_query_t *q, const snap_group_t *g,
+                        GStringChunk *strings, unsigned int count)
+{
+    char **row = g_new0(char *, count);
+    char buff[64];
+    unsigned int i;
+
+    for (i = 0; i < q->desc_count; i++) {
+        int64_t v;
+
+        if (!field_value(q, g, i, &v))
+            continue;
+
+        if (field_is_text(q, i) && q->desc[i].report_type == REPORT_GROUP_BY) {
+            row[i] = g_string_chunk_insert(strings, dict_str(q, i, v));
+            continue;
+        }
+        if (field_signed(q, i))
+            snprintf(buff, sizeof(buff), "%" PRId64, v);
+        else
+            snprintf(buff, sizeof(buff), "%" PRIu64, (uint64_t)v);
+        row[i] = g_string_chunk_insert(strings, buff);
+    }
+
+    if (q->profile != NULL) {
+        for (i = 0; i < SZ_PROFIL_COUNT; i++) {
+            snprintf(buff, sizeof(buff), "%" PRIu64, g->profile[i]);
+            row[q->desc_count + i] = g_string_chunk_insert(strings, buff);
+        }
+        if (q->profile->range_ratio_len > 0 && g->count > 0) {
+            snprintf(buff, sizeof(buff), "%.4f", group_ratio(g));
+            row[q->desc_count + SZ_PROFIL_COUNT] =
+                g_string_chunk_insert(strings, buff);
+        }
+    }
+    return row;
+}
+
+snapshot_result_t *lmgr_snapshot_report(const report_field_descr_t *
+                                        report_desc_array,
+                                        unsigned int report_descr_count,
+                                        const profile_field_descr_t *
+                                        profile_descr,
+                                        const lmgr_filter_t *p_filter,
+                                        const lmgr_iter_opt_t *p_opt)
+{
+    snap_query_t q = { 0 };
+    snapshot_result_t *res = NULL;
+    GHashTable *groups;
+    GPtrArray *sorted;
+    snap_group_t *all;
+    GHashTableIter iter;
+    gpointer g;
+    unsigned int i, limit;
+    int rc;
+
+    q.snap = snap_open();
+    if (q.snap == NULL)
+        return NULL;
+    q.desc = report_desc_array;
+    q.desc_count = report_descr_count;
+    q.profile = profile_descr;
+
+    /* dictionaries are needed to prepare filters on text columns */
+    rc = read_dicts(q.snap);
+    if (rc) {
+        DisplayLog(LVL_MAJOR, SNAP_TAG, "Failed to read report snapshot '%s' "
+                   "(error %d): querying the database",
+                   lmgr_config.snapshot_file, rc);
+        goto close;
+    }
+
+    if (!query_init(&q, p_filter)) {
+        DisplayLog(LVL_DEBUG, SNAP_TAG, "Report is not supported by the "
+                   "snapshot: querying the database");
+        goto out;
+    }
+
+    groups = g_hash_table_new_full(group_hash, group_equal, group_free, NULL);
+    all = group_new(&q, NULL);
+
+    rc = query_scan(&q, groups, all);
+    if (rc) {
+        DisplayLog(LVL_MAJOR, SNAP_TAG, "Failed to read report snapshot '%s' "
+                   "(error %d): querying the database",
+                   lmgr_config.snapshot_file, rc);
+        g_hash_table_destroy(groups);
+        group_free(all);
+        goto out;
+    }
+
+    sorted = g_ptr_array_new();
+    if (q.ng == 0) {
+        /* aggregates without group by always return a row */
+        g_ptr_array_add(sorted, all);
+    } else {
+        g_hash_table_iter_init(&iter, groups);
+        while (g_hash_table_iter_next(&iter, &g, NULL))
+            g_ptr_array_add(sorted, g);
+    }
+    g_ptr_array_sort_with_data(sorted, group_cmp, &q);
+
+    res = MemCalloc(1, sizeof(*res));
+    if (res == NULL) {
+        g_ptr_array_free(sorted, TRUE);
+        g_hash_table_destroy(groups);
+        group_free(all);
+        goto out;
+    }
+    res->rows = g_ptr_array_new_with_free_func(g_free);
+    res->strings = g_string_chunk_new(4096);
+    res->count = report_descr_count;
+    if (profile_descr != NULL)
+        res->count += SZ_PROFIL_COUNT
+            + (profile_descr->range_ratio_len > 0 ? 1 : 0);
+
+    limit = (p_opt != NULL && p_opt->list_count_max > 0) ?
+        p_opt->list_count_max : G_MAXUINT;
+
+    for (i = 0; i < sorted->len && res->rows->len < limit; i++) {
+        const snap_group_t *grp = g_ptr_array_index(sorted, i);
+
+        if (group_having(&q, grp))
+            g_ptr_array_add(res->rows, group_row(&q, grp, res->strings,
+                                                 res->count));
+    }
+
+    DisplayLog(LVL_DEBUG, SNAP_TAG, "Report computed from snapshot "
+               "(%" PRIu64 " entries, %u result rows)", q.snap->hdr.row_count,
+               res->rows->len);
+
+    g_ptr_array_free(sorted, TRUE);
+    g_hash_table_destroy(groups);
+    group_free(all);
+
+ out:
+    query_free(&q);
+ close:
+    snap_close(q.snap);
+    return res;
+}
+
+int lmgr_snapshot_next(snapshot_result_t *res, char **row, unsigned int count)
+{
+    if (count != res->count)
+        return DB_BUFFER_TOO_SMALL;
+    if (res->next >= res->rows->len)
+        return DB_END_OF_LIST;
+
+    memcpy(row, g_ptr_array_index(res->rows, res->next),
+           count * sizeof(char *));
+    res->next++;
+    return DB_SUCCESS;
+}
+
+void lmgr_snapshot_free(snapshot_result_t *res)
+{
+    g_ptr_array_free(res->rows, TRUE);
+    g_string_chunk_free(res->strings);
+    MemFree(res);
+}
@@ -33,6 +33,7 @@ int ListMgr_Update(lmgr_t *p_mgr, const entry_id_t *p_id,
     int rc;
     GString *req;
     DEF_PK(pk);
+    char acct_cond[PK_LEN + 4] = "";
 
     /* read only fields in info mask? */
     if (readonly_fields(p_update_set->attr_mask)) {
@@ -46,6 +47,16 @@ int ListMgr_Update(lmgr_t *p_mgr, const entry_id_t *p_id,
 
     entry_id2pk(p_id, PTR_PK(pk));
 
+    /* accounting info is only modified by acct fields */
+    if (lmgr_acct_aggregated()) {
+        attr_mask_t acct_mask = attr_mask_or(&acct_attr_set,
+                                             &acct_pk_attr_set);
+
+        acct_mask = attr_mask_and(&p_update_set->attr_mask, &acct_mask);
+        if (!attr_mask_is_null(acct_mask))
+            snprintf(acct_cond, sizeof(acct_cond), "=" DPK, pk);
+    }
+
     req = g_string_new(NULL);
 
  retry:
@@ -53,6 +64,14 @@ int ListMgr_Update(lmgr_t *p_mgr, const entry_id_t *p_id,
     if (lmgr_delayed_retry(p_mgr, rc))
         goto retry;
 
+    if (acct_cond[0] != '\0') {
+        rc = lmgr_acct_snapshot(p_mgr, acct_cond, -1);
+        if (lmgr_delayed_retry(p_mgr, rc))
+            goto retry;
+        else if (rc)
+            goto rollback;
+    }
+
     /* update fields in main table */
     if (main_fields(p_update_set->attr_mask)) {
         g_string_assign(req, "UPDATE " MAIN_TABLE " SET ");
@@ -90,6 +109,8 @@ int ListMgr_Update(lmgr_t *p_mgr, const entry_id_t *p_id,
             goto retry;
         else if (rc)
             goto rollback;
+
+        lmgr_path_cache_invalidate(p_mgr, &pk, 1);
     } else if (ATTR_MASK_TEST(p_update_set, name)
                || ATTR_MASK_TEST(p_update_set, parent_id)) {
         DisplayLog(LVL_DEBUG, LISTMGR_TAG,
@@ -139,6 +160,14 @@ int ListMgr_Update(lmgr_t *p_mgr, const entry_id_t *p_id,
     }
 #endif
 
+    if (acct_cond[0] != '\0') {
+        rc = lmgr_acct_snapshot(p_mgr, acct_cond, 1);
+        if (lmgr_delayed_retry(p_mgr, rc))
+            goto retry;
+        else if (rc)
+            goto rollback;
+    }
+
     rc = lmgr_commit(p_mgr);
     if (lmgr_delayed_retry(p_mgr, rc))
         goto retry;
@@ -200,6 +229,9 @@ int ListMgr_Replace(lmgr_t *p_mgr, entry_id_t *old_id, attr_set_t *old_attrs,
     else if (rc)
         goto rollback;
 
+    /* cached subdirectories still refer to the old parent */
+    lmgr_path_cache_clear(p_mgr);
+
     rc = lmgr_commit(p_mgr);
     if (lmgr_delayed_retry(p_mgr, rc))
         goto retry;
@@ -105,6 +105,61 @@ int lmgr_set_var(db_conn_t *pconn, const char *varname, const char *value)
     return rc;
 }
 
+/** append a LIKE condition matching the names starting with prefix */
+static void append_prefix_cond(GString *query, const char *prefix)
+{
+    const char *c;
+
+    /* '_' and '%' are wildcards in LIKE patterns: escape them */
+    g_string_append(query, "varname LIKE '");
+    for (c = prefix; *c != '\0'; c++) {
+        if (*c == '_' || *c == '%' || *c == '!')
+            g_string_append_c(query, '!');
+        g_string_append_c(query, *c);
+    }
+    g_string_append(query, "%' ESCAPE '!'");
+}
+
+int lmgr_clear_vars(db_conn_t *pconn, const char *prefix)
+{
+    GString *query;
+    int rc;
+
+    query = g_string_new("DELETE FROM " VAR_TABLE " WHERE ");
+    append_prefix_cond(query, prefix);
+
+    rc = db_exec_sql(pconn, query->str, NULL);
+    g_string_free(query, TRUE);
+    return rc;
+}
+
+int lmgr_list_vars(db_conn_t *pconn, const char *prefix, GPtrArray *names)
+{
+    GString *query;
+    result_handle_t result;
+    char *str_val = NULL;
+    int rc;
+
+    query = g_string_new("SELECT varname FROM " VAR_TABLE " WHERE ");
+    append_prefix_cond(query, prefix);
+
+    rc = db_exec_sql(pconn, query->str, &result);
+    if (rc)
+        goto free_str;
+
+    while ((rc = db_next_record(pconn, &result, &str_val, 1)) == DB_SUCCESS) {
+        if (str_val != NULL)
+            g_ptr_array_add(names, g_strdup(str_val));
+    }
+    if (rc == DB_END_OF_LIST)
+        rc = DB_SUCCESS;
+
+    db_result_free(pconn, &result);
+ free_str:
+    g_string_free(query, TRUE);
+    return rc;
+}
+
 /**
  *  Get variable value.
  */
@@ -133,3 +188,16 @@ int ListMgr_SetVar(lmgr_t *p_mgr, const char *varname, const char *value)
         goto retry;
     return rc;
 }
+
+/**
+ *  Remove all variables whose name starts with the given prefix.
+ */
+int ListMgr_ClearVars(lmgr_t *p_mgr, const char *prefix)
+{
+    int rc;
+ retry:
+    rc = lmgr_clear_vars(&p_mgr->conn, prefix);
+    if (lmgr_delayed_retry(p_mgr, rc))
+        goto retry;
+    return rc;
+}
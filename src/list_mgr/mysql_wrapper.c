@@ -112,10 +112,11 @@ bool db_is_retryable(int db_err)
     }
 }
 
-/* create client connection */
-int db_connect(db_conn_t *conn)
+static int db_connect_to(db_conn_t *conn, const char *server,
+                         unsigned int port, const char *socket)
 {
     my_bool reconnect = 1;
+    unsigned int local_infile = 1;
     unsigned int retry = 0;
 
     /* Connect to database */
@@ -131,27 +132,28 @@ int db_connect(db_conn_t *conn)
     /* older version */
     conn->reconnect = 1;
 #endif
+    /* initial load reads client-side files */
+    if (lmgr_config.initial_load)
+        mysql_options(conn, MYSQL_OPT_LOCAL_INFILE, &local_infile);
 
     while (1) {
         /* connect to server */
         if (!mysql_real_connect
-            (conn, lmgr_config.db_config.server, lmgr_config.db_config.user,
+            (conn, server, lmgr_config.db_config.user,
              lmgr_config.db_config.password, lmgr_config.db_config.db,
-             lmgr_config.db_config.port,
-             EMPTY_STRING(lmgr_config.db_config.socket) ?
-             NULL : lmgr_config.db_config.socket, 0)) {
+             port, socket, 0)) {
             /* connection error is retried at DB level */
             if ((retry < 3)
                 && db_is_retryable(mysql_error_convert(mysql_errno(conn), 0))) {
                 DisplayLog(LVL_MAJOR, LISTMGR_TAG,
-                           "Failed to connect to MySQL: Error: %s. Retrying...",
-                           mysql_error(conn));
+                           "Failed to connect to MySQL server '%s': Error: %s. "
+                           "Retrying...", server, mysql_error(conn));
                 retry++;
                 sleep(1);
             } else {
                 DisplayLog(LVL_CRIT, LISTMGR_TAG,
-                           "Failed to connect to MySQL after %u retries: Error: %s. Aborting.",
-                           retry, mysql_error(conn));
+                           "Failed to connect to MySQL server '%s' after %u retries: Error: %s. Aborting.",
+                           server, retry, mysql_error(conn));
                 return DB_CONNECT_FAILED;
             }
         } else {
@@ -175,11 +177,36 @@ int db_connect(db_conn_t *conn)
     mysql_options(conn, MYSQL_OPT_RECONNECT, &reconnect);
 #endif
 
-    DisplayLog(LVL_FULL, LISTMGR_TAG, "Logged on to database '%s' successfully",
-               lmgr_config.db_config.db);
+    DisplayLog(LVL_FULL, LISTMGR_TAG, "Logged on to database '%s' on '%s' "
+               "successfully", lmgr_config.db_config.db, server);
     return DB_SUCCESS;
 }
 
+/* create client connection */
+int db_connect(db_conn_t *conn)
+{
+    return db_connect_to(conn, lmgr_config.db_config.server,
+                         lmgr_config.db_config.port,
+                         EMPTY_STRING(lmgr_config.db_config.socket) ?
+                         NULL : lmgr_config.db_config.socket);
+}
+
+/* create client connection to a read replica */
+int db_connect_replica(db_conn_t *conn, const char *server, unsigned int port)
+{
+    return db_connect_to(conn, server, port, NULL);
+}
+
+void db_thread_init(void)
+{
+    mysql_thread_init();
+}
+
+void db_thread_end(void)
+{
+    mysql_thread_end();
+}
+
 int db_close_conn(db_conn_t *conn)
 {
     /* XXX Ensure there is no pending transactions? */
@@ -304,6 +331,326 @@ int db_result_nb_records(db_conn_t *conn, result_handle_t *p_result)
     return mysql_num_rows(*p_result);
 }
 
+/* -------------------- prepared statements ---------------- */
+
+/* output buffer size for numeric fields (max_length of numeric fields
+ * is not significant in the binary protocol) */
+#define STMT_MIN_FIELD_SIZE 64
+
+static int stmt_error(db_stmt_t *stmt, const char *what)
+{
+    int rc = mysql_error_convert(mysql_stmt_errno(stmt->stmt), true);
+
+    if (!db_is_retryable(rc))
+        DisplayLog(LVL_MAJOR, LISTMGR_TAG, "Error %d %s statement '%s': %s",
+                   rc, what, stmt->query, mysql_stmt_error(stmt->stmt));
+    return rc;
+}
+
+int db_stmt_prepare(db_conn_t *conn, const char *query, db_stmt_t **p_stmt)
+{
+    db_stmt_t *stmt;
+    MYSQL_RES *meta;
+    my_bool    update_max = 1;
+    int        rc;
+
+#ifdef _DEBUG_DB
+    DisplayLog(LVL_FULL, LISTMGR_TAG, "SQL prepare: %s", query);
+#endif
+
+    stmt = MemCalloc(1, sizeof(*stmt));
+    if (stmt == NULL)
+        return DB_NO_MEMORY;
+
+    stmt->query = strdup(query);
+    stmt->stmt = mysql_stmt_init(conn);
+    if (stmt->query == NULL || stmt->stmt == NULL) {
+        rc = DB_NO_MEMORY;
+        goto err;
+    }
+
+    if (mysql_stmt_prepare(stmt->stmt, query, strlen(query))) {
+        rc = stmt_error(stmt, "preparing");
+        goto err;
+    }
+
+    /* compute the max length of result fields, to size output buffers */
+    mysql_stmt_attr_set(stmt->stmt, STMT_ATTR_UPDATE_MAX_LENGTH, &update_max);
+
+    stmt->nb_params = mysql_stmt_param_count(stmt->stmt);
+    if (stmt->nb_params > 0) {
+        stmt->params = MemCalloc(stmt->nb_params, sizeof(*stmt->params));
+        stmt->param_len = MemCalloc(stmt->nb_params, sizeof(*stmt->param_len));
+        if (stmt->params == NULL || stmt->param_len == NULL) {
+            rc = DB_NO_MEMORY;
+            goto err;
+        }
+    }
+
+    /* NULL for statements with no result */
+    meta = mysql_stmt_result_metadata(stmt->stmt);
+    if (meta != NULL) {
+        stmt->nb_fields = mysql_num_fields(meta);
+        mysql_free_result(meta);
+
+        stmt->fields = MemCalloc(stmt->nb_fields, sizeof(*stmt->fields));
+        stmt->field_buf = MemCalloc(stmt->nb_fields, sizeof(*stmt->field_buf));
+        stmt->field_size = MemCalloc(stmt->nb_fields,
+                                     sizeof(*stmt->field_size));
+        stmt->field_len = MemCalloc(stmt->nb_fields, sizeof(*stmt->field_len));
+        stmt->field_null = MemCalloc(stmt->nb_fields,
+                                     sizeof(*stmt->field_null));
+        stmt->field_num = MemCalloc(stmt->nb_fields, sizeof(*stmt->field_num));
+        if (stmt->fields == NULL || stmt->field_buf == NULL
+            || stmt->field_size == NULL || stmt->field_len == NULL
+            || stmt->field_null == NULL || stmt->field_num == NULL) {
+            rc = DB_NO_MEMORY;
+            goto err;
+        }
+    }
+
+    *p_stmt = stmt;
+    return DB_SUCCESS;
+
+ err:
+    db_stmt_close(conn, stmt);
+    return rc;
+}
+
+/** integer fields are read in binary form */
+static inline bool is_int_field(const MYSQL_FIELD *field)
+{
+    switch (field->type) {
+    case MYSQL_TYPE_TINY:
+    case MYSQL_TYPE_SHORT:
+    case MYSQL_TYPE_INT24:
+    case MYSQL_TYPE_LONG:
+    case MYSQL_TYPE_LONGLONG:
+    case MYSQL_TYPE_YEAR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/** bind integer fields to 64 bits integers, and other fields to
+ * output buffers large enough for the stored result */
+static int stmt_bind_result(db_stmt_t *stmt)
+{
+    MYSQL_RES   *meta;
+    MYSQL_FIELD *fields;
+    unsigned int i;
+    int          rc = DB_SUCCESS;
+
+    meta = mysql_stmt_result_metadata(stmt->stmt);
+    if (meta == NULL)
+        return stmt_error(stmt, "getting result metadata of");
+    fields = mysql_fetch_fields(meta);
+
+    for (i = 0; i < stmt->nb_fields; i++) {
+        MYSQL_BIND   *b = &stmt->fields[i];
+        unsigned long size = MAX(fields[i].max_length, STMT_MIN_FIELD_SIZE) + 1;
+
+        if (size > stmt->field_size[i]) {
+            MemFree(stmt->field_buf[i]);
+            stmt->field_buf[i] = MemAlloc(size);
+            if (stmt->field_buf[i] == NULL) {
+                stmt->field_size[i] = 0;
+                rc = DB_NO_MEMORY;
+                goto out;
+            }
+            stmt->field_size[i] = size;
+        }
+
+        memset(b, 0, sizeof(*b));
+        if (is_int_field(&fields[i])) {
+            b->buffer_type = MYSQL_TYPE_LONGLONG;
+            b->buffer = &stmt->field_num[i];
+            b->is_unsigned = !!(fields[i].flags & UNSIGNED_FLAG);
+        } else {
+            b->buffer_type = MYSQL_TYPE_STRING;
+            b->buffer = stmt->field_buf[i];
+            b->buffer_length = stmt->field_size[i];
+            b->length = &stmt->field_len[i];
+        }
+        b->is_null = &stmt->field_null[i];
+    }
+
+    if (mysql_stmt_bind_result(stmt->stmt, stmt->fields))
+        rc = stmt_error(stmt, "binding result of");
+ out:
+    mysql_free_result(meta);
+    return rc;
+}
+
+int db_stmt_exec(db_conn_t *conn, db_stmt_t *stmt,
+                 const db_field_value_t *params, unsigned int nb_params)
+{
+    unsigned int i;
+    int          rc;
+
+    if (nb_params != stmt->nb_params) {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Statement '%s' expects %u "
+                   "parameters (%u given)", stmt->query, stmt->nb_params,
+                   nb_params);
+        return DB_INVALID_ARG;
+    }
+
+    /* integers are sent in binary form */
+    for (i = 0; i < nb_params; i++) {
+        MYSQL_BIND *b = &stmt->params[i];
+
+        memset(b, 0, sizeof(*b));
+        if (params[i].is_null) {
+            b->buffer_type = MYSQL_TYPE_NULL;
+        } else if (params[i].is_num) {
+            b->buffer_type = MYSQL_TYPE_LONGLONG;
+            b->buffer = (long long *)&params[i].num;
+            b->is_unsigned = params[i].is_unsigned;
+        } else {
+            stmt->param_len[i] = strlen(params[i].str);
+            b->buffer_type = MYSQL_TYPE_STRING;
+            b->buffer = params[i].str;
+            b->buffer_length = stmt->param_len[i];
+            b->length = &stmt->param_len[i];
+        }
+    }
+
+    if (nb_params > 0 && mysql_stmt_bind_param(stmt->stmt, stmt->params))
+        return stmt_error(stmt, "binding parameters of");
+
+    if (mysql_stmt_execute(stmt->stmt)) {
+        if (mysql_stmt_errno(stmt->stmt) == ER_DUP_ENTRY) {
+            DisplayLog(LVL_EVENT, LISTMGR_TAG, "A database record already "
+                       "exists for this entry: '%s' (%s)", stmt->query,
+                       mysql_stmt_error(stmt->stmt));
+            return DB_ALREADY_EXISTS;
+        }
+        return stmt_error(stmt, "executing");
+    }
+
+    if (stmt->nb_fields == 0)
+        return DB_SUCCESS;
+
+    /* fetch results to the client */
+    if (mysql_stmt_store_result(stmt->stmt))
+        return stmt_error(stmt, "storing result of");
+
+    rc = stmt_bind_result(stmt);
+    if (rc)
+        mysql_stmt_free_result(stmt->stmt);
+    return rc;
+}
+
+static int stmt_fetch(db_stmt_t *stmt, unsigned int count)
+{
+    int rc;
+
+    rc = mysql_stmt_fetch(stmt->stmt);
+    if (rc == MYSQL_NO_DATA)
+        return DB_END_OF_LIST;
+    else if (rc == MYSQL_DATA_TRUNCATED) {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Result of statement '%s' was "
+                   "truncated", stmt->query);
+        return DB_BUFFER_TOO_SMALL;
+    } else if (rc)
+        return stmt_error(stmt, "fetching result of");
+
+    if (stmt->nb_fields > count) {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG,
+                   "Output array too small: size = %u, num_fields = %u",
+                   count, stmt->nb_fields);
+        return DB_BUFFER_TOO_SMALL;
+    }
+    return DB_SUCCESS;
+}
+
+int db_stmt_next_record(db_conn_t *conn, db_stmt_t *stmt, char *outtab[],
+                        unsigned int outtabsize)
+{
+    unsigned int i;
+    int          rc;
+
+    for (i = 0; i < outtabsize; i++)
+        outtab[i] = NULL;
+
+    rc = stmt_fetch(stmt, outtabsize);
+    if (rc)
+        return rc;
+
+    for (i = 0; i < stmt->nb_fields; i++) {
+        if (stmt->field_null[i])
+            continue;
+        if (stmt->fields[i].buffer_type == MYSQL_TYPE_LONGLONG)
+            snprintf(stmt->field_buf[i], stmt->field_size[i],
+                     stmt->fields[i].is_unsigned ? "%llu" : "%lld",
+                     stmt->field_num[i]);
+        else
+            stmt->field_buf[i][stmt->field_len[i]] = '\0';
+        outtab[i] = stmt->field_buf[i];
+    }
+
+    return DB_SUCCESS;
+}
+
+int db_stmt_next_values(db_conn_t *conn, db_stmt_t *stmt,
+                        db_field_value_t *values, unsigned int count)
+{
+    unsigned int i;
+    int          rc;
+
+    rc = stmt_fetch(stmt, count);
+    if (rc)
+        return rc;
+
+    memset(values, 0, count * sizeof(*values));
+    for (i = 0; i < stmt->nb_fields; i++) {
+        values[i].is_null = stmt->field_null[i];
+        if (values[i].is_null)
+            continue;
+        if (stmt->fields[i].buffer_type == MYSQL_TYPE_LONGLONG) {
+            values[i].is_num = true;
+            values[i].is_unsigned = stmt->fields[i].is_unsigned;
+            values[i].num = stmt->field_num[i];
+        } else {
+            stmt->field_buf[i][stmt->field_len[i]] = '\0';
+            values[i].str = stmt->field_buf[i];
+        }
+    }
+
+    return DB_SUCCESS;
+}
+
+int db_stmt_free_result(db_conn_t *conn, db_stmt_t *stmt)
+{
+    if (stmt->nb_fields > 0)
+        mysql_stmt_free_result(stmt->stmt);
+    return DB_SUCCESS;
+}
+
+void db_stmt_close(db_conn_t *conn, db_stmt_t *stmt)
+{
+    unsigned int i;
+
+    if (stmt->stmt != NULL)
+        mysql_stmt_close(stmt->stmt);
+
+    if (stmt->field_buf != NULL)
+        for (i = 0; i < stmt->nb_fields; i++)
+            MemFree(stmt->field_buf[i]);
+
+    MemFree(stmt->field_buf);
+    MemFree(stmt->field_size);
+    MemFree(stmt->field_len);
+    MemFree(stmt->field_null);
+    MemFree(stmt->field_num);
+    MemFree(stmt->fields);
+    MemFree(stmt->param_len);
+    MemFree(stmt->params);
+    free(stmt->query);
+    MemFree(stmt);
+}
+
 int db_list_table_info(db_conn_t *conn, const char *table,
                        char **field_tab, char **type_tab, char **default_tab,
                        unsigned int outtabsize,
@@ -505,6 +852,24 @@ int db_check_component(db_conn_t *conn, db_object_e obj_type, const char *name,
         } else
             rc = DB_NOT_EXISTS;
 
+        mysql_free_result(result);
+        return rc;
+    } else if (obj_type == DBOBJ_INDEX) {
+        sprintf(query,
+                "SELECT INDEX_NAME FROM INFORMATION_SCHEMA.STATISTICS WHERE "
+                "TABLE_SCHEMA='%s' AND TABLE_NAME='%s' AND INDEX_NAME='%s' "
+                "LIMIT 1", lmgr_config.db_config.db, arg, name);
+
+        rc = _db_exec_sql(conn, query, &result, false);
+        if (rc)
+            return rc;
+
+        if (!result) {
+            DisplayLog(LVL_DEBUG, LISTMGR_TAG, "%s does not exist", name);
+            return DB_NOT_EXISTS;
+        }
+
+        rc = mysql_fetch_row(result) ? DB_SUCCESS : DB_NOT_EXISTS;
         mysql_free_result(result);
         return rc;
     } else {
@@ -512,6 +877,128 @@ int db_check_component(db_conn_t *conn, db_object_e obj_type, const char *name,
     }
 }
 
+/* Named locks are global to the server: make their name specific to the
+ * database (and short enough) */
+#define LOCK_NAME_FMT "SHA1(CONCAT(DATABASE(),'/','%s'))"
+
+/* run a query returning a single value */
+static int lock_query(db_conn_t *conn, const char *query, char *val,
+                      size_t size)
+{
+    result_handle_t result;
+    MYSQL_ROW row;
+    int rc;
+
+    rc = _db_exec_sql(conn, query, &result, false);
+    if (rc)
+        return rc;
+
+    row = mysql_fetch_row(result);
+    if (row == NULL)
+        rc = DB_REQUEST_FAILED;
+    else if (row[0] == NULL)
+        val[0] = '\0';
+    else
+        rh_strncpy(val, row[0], size);
+
+    mysql_free_result(result);
+    return rc;
+}
+
+int db_lock_acquire(db_conn_t *conn, const char *name)
+{
+    char query[1024];
+    char val[32];
+    int rc;
+
+    snprintf(query, sizeof(query), "SELECT GET_LOCK(" LOCK_NAME_FMT ",0)",
+             name);
+    rc = lock_query(conn, query, val, sizeof(val));
+    if (rc)
+        return rc;
+    /* 0 if the lock is held by another connection, NULL on error */
+    if (val[0] == '\0')
+        return DB_REQUEST_FAILED;
+    return strcmp(val, "1") ? DB_ALREADY_EXISTS : DB_SUCCESS;
+}
+
+int db_lock_is_used(db_conn_t *conn, const char *name, bool *used)
+{
+    char query[1024];
+    char val[32];
+    int rc;
+
+    snprintf(query, sizeof(query), "SELECT IS_USED_LOCK(" LOCK_NAME_FMT ")",
+             name);
+    rc = lock_query(conn, query, val, sizeof(val));
+    if (rc)
+        return rc;
+    /* connection id of the holder, or NULL */
+    *used = (val[0] != '\0');
+    return DB_SUCCESS;
+}
+
+/* load a client-side file of tab-separated rows into a table */
+int db_load_file(db_conn_t *conn, const char *path, const char *table,
+                 const char *fields, const char *set_field,
+                 const char *set_expr)
+{
+    char escaped[RBH_PATH_MAX * 2];
+    GString *request;
+    gchar **names;
+    int i, rc, rc2;
+
+    rc = db_escape_string(conn, escaped, sizeof(escaped), path);
+    if (rc)
+        return rc;
+
+    /* The file is loaded into a temporary copy of the table, then merged
+     * into the table. This way, existing rows only get the fields of the
+     * file updated (REPLACE would reset the other ones). */
+    request = g_string_new(NULL);
+    g_string_printf(request, "DROP TEMPORARY TABLE IF EXISTS LOAD_%s", table);
+    rc = _db_exec_sql(conn, request->str, NULL, false);
+    if (rc)
+        goto out;
+
+    g_string_printf(request, "CREATE TEMPORARY TABLE LOAD_%s LIKE %s", table,
+                    table);
+    rc = _db_exec_sql(conn, request->str, NULL, false);
+    if (rc)
+        goto out;
+
+    /* all rows of a file have the same fields: a later row of an entry
+     * can safely replace a previous one */
+    g_string_printf(request, "LOAD DATA LOCAL INFILE '%s' REPLACE INTO TABLE "
+                    "LOAD_%s CHARACTER SET binary (%s)", escaped, table,
+                    fields);
+    if (set_field != NULL)
+        g_string_append_printf(request, " SET %s=%s", set_field, set_expr);
+    rc = _db_exec_sql(conn, request->str, NULL, false);
+    if (rc)
+        goto drop;
+
+    g_string_printf(request, "INSERT INTO %s (%s%s%s) SELECT %s%s%s FROM "
+                    "LOAD_%s ON DUPLICATE KEY UPDATE ", table, fields,
+                    set_field ? "," : "", set_field ? set_field : "", fields,
+                    set_field ? "," : "", set_field ? set_field : "", table);
+    names = g_strsplit(fields, ",", 0);
+    for (i = 0; names[i] != NULL; i++)
+        g_string_append_printf(request, "%s%s=VALUES(%s)", i ? "," : "",
+                               names[i], names[i]);
+    g_strfreev(names);
+    rc = _db_exec_sql(conn, request->str, NULL, false);
+
+ drop:
+    g_string_printf(request, "DROP TEMPORARY TABLE LOAD_%s", table);
+    rc2 = _db_exec_sql(conn, request->str, NULL, false);
+    if (!rc)
+        rc = rc2;
+ out:
+    g_string_free(request, TRUE);
+    return rc;
+}
+
 /* create a trigger */
 int db_create_trigger(db_conn_t *conn, const char *name, const char *event,
                       const char *table, const char *body)
@@ -19,8 +19,21 @@
 #include "list_mgr.h"
 #include "database.h"
 #include "rbh_logs.h"
+#include "rbh_misc.h"
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
+#include <glib.h>
+
+/** max number of parent levels walked by path functions
+ * (in case of a loop in the namespace) */
+#define PATH_FUNC_MAX_DEPTH 1024
+
+/* flag of functions that always give the same result for the same
+ * arguments (SQLite >= 3.8.3) */
+#ifndef SQLITE_DETERMINISTIC
+#define SQLITE_DETERMINISTIC 0
+#endif
 
 static int sqlite_error_convert(int err)
 {
@@ -45,14 +58,25 @@ static int db_is_busy_err(int rc)
     return (rc == SQLITE_BUSY) || (rc == SQLITE_CANTOPEN);
 }
 
-static int set_cache_size(sqlite3 *conn)
+static int exec_pragma(sqlite3 *conn, const char *pragma)
 {
     int rc;
-    char *errmsg;
+    char *errmsg = NULL;
+
+    do {
+        rc = sqlite3_exec(conn, pragma, NULL, NULL, &errmsg);
+
+        if (db_is_busy_err(rc)) {
+            sqlite3_free(errmsg);
+            errmsg = NULL;
+            usleep(lmgr_config.db_config.retry_delay_microsec);
+        }
+    }
+    while (db_is_busy_err(rc));
 
-    rc = sqlite3_exec(conn, "PRAGMA cache_size=1000000", NULL, NULL, &errmsg);
     if (rc != SQLITE_OK) {
-        DisplayLog(LVL_CRIT, LISTMGR_TAG, "SQL error: %s", errmsg);
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "SQL error: %s: %s",
+                   errmsg ? errmsg : sqlite3_errmsg(conn), pragma);
         sqlite3_free(errmsg);
         return DB_REQUEST_FAILED;
     }
@@ -60,13 +84,266 @@ static int set_cache_size(sqlite3 *conn)
     return DB_SUCCESS;
 }
 
+/** set the journal mode and memory usage of a new connection */
+static int set_pragmas(sqlite3 *conn)
+{
+    char pragma[256];
+    int rc;
+
+    rc = exec_pragma(conn, "PRAGMA cache_size=1000000");
+    if (rc)
+        return rc;
+
+    if (!EMPTY_STRING(lmgr_config.db_config.journal_mode)) {
+        snprintf(pragma, sizeof(pragma), "PRAGMA journal_mode=%s",
+                 lmgr_config.db_config.journal_mode);
+        rc = exec_pragma(conn, pragma);
+        if (rc)
+            return rc;
+
+        /* in WAL mode, only the last transactions can be lost
+         * in case of a power failure: no need to sync every commit */
+        if (!strcasecmp(lmgr_config.db_config.journal_mode, "WAL")) {
+            rc = exec_pragma(conn, "PRAGMA synchronous=NORMAL");
+            if (rc)
+                return rc;
+        }
+    }
+
+    snprintf(pragma, sizeof(pragma), "PRAGMA mmap_size=%llu",
+             lmgr_config.db_config.mmap_size);
+    return exec_pragma(conn, pragma);
+}
+
+/* -------------------- DB functions ---------------- */
+
+/* SQLite has no stored functions: the functions defined in MySQL DB
+ * are implemented here, and registered for each connection. */
+
+/** sz_range(size): index of the size range of the accounting table */
+static void func_sz_range(sqlite3_context *ctx, int argc,
+                          sqlite3_value **argv)
+{
+    sqlite3_uint64 sz;
+    int log2 = 0;
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        sqlite3_result_null(ctx);
+        return;
+    }
+
+    /* same as IF(sz=0,-1,FLOOR(LOG2(sz)/5)) */
+    sz = sqlite3_value_int64(argv[0]);
+    if (sz == 0) {
+        sqlite3_result_int(ctx, -1);
+        return;
+    }
+    while (sz >>= 1)
+        log2++;
+    sqlite3_result_int(ctx, log2 / 5);
+}
+
+/** get parent_id and name of an entry.
+ * @return SQLITE_ROW if the entry is found, SQLITE_DONE if not.
+ */
+static int names_lookup(sqlite3_stmt *stmt, const char *id)
+{
+    sqlite3_reset(stmt);
+    sqlite3_bind_text(stmt, 1, id, -1, SQLITE_TRANSIENT);
+    return sqlite3_step(stmt);
+}
+
+/**
+ * Prepend the names of parent directories to path, starting from pid.
+ * As in MySQL functions, the path starts with the id of the first
+ * directory that is not in NAMES table.
+ */
+static void path_walk(sqlite3_context *ctx, sqlite3_stmt *stmt,
+                      const char *pid, GString *path)
+{
+    char *curr = g_strdup(pid);
+    int depth, rc;
+
+    for (depth = 0; depth < PATH_FUNC_MAX_DEPTH; depth++) {
+        const char *parent, *name;
+
+        rc = names_lookup(stmt, curr);
+        if (rc == SQLITE_DONE) {
+            g_string_prepend_c(path, '/');
+            g_string_prepend(path, curr);
+            sqlite3_result_text(ctx, path->str, path->len, SQLITE_TRANSIENT);
+            goto out;
+        } else if (rc != SQLITE_ROW) {
+            sqlite3_result_error(ctx, sqlite3_errmsg(
+                                     sqlite3_context_db_handle(ctx)), -1);
+            goto out;
+        }
+
+        parent = (const char *)sqlite3_column_text(stmt, 0);
+        name = (const char *)sqlite3_column_text(stmt, 1);
+        if (parent == NULL || name == NULL)
+            break;
+
+        g_string_prepend_c(path, '/');
+        g_string_prepend(path, name);
+        g_free(curr);
+        curr = g_strdup(parent);
+    }
+    sqlite3_result_null(ctx);
+
+ out:
+    g_free(curr);
+}
+
+/** statement of a path function, prepared at its first call on
+ * a connection (user data of the function) */
+typedef struct names_cache {
+    sqlite3_stmt *stmt;
+} names_cache_t;
+
+static void names_cache_free(void *ptr)
+{
+    names_cache_t *cache = ptr;
+
+    sqlite3_finalize(cache->stmt);
+    g_free(cache);
+}
+
+static sqlite3_stmt *names_stmt(sqlite3_context *ctx)
+{
+    names_cache_t *cache = sqlite3_user_data(ctx);
+    sqlite3 *conn = sqlite3_context_db_handle(ctx);
+
+    if (cache->stmt != NULL)
+        return cache->stmt;
+
+    if (sqlite3_prepare_v2(conn, "SELECT parent_id,name FROM " DNAMES_TABLE
+                           " WHERE id=? LIMIT 1", -1, &cache->stmt, NULL)
+        != SQLITE_OK) {
+        sqlite3_result_error(ctx, sqlite3_errmsg(conn), -1);
+        cache->stmt = NULL;
+        return NULL;
+    }
+    return cache->stmt;
+}
+
+/** this_path(parent_id, name): path of an entry, from its parent and name */
+static void func_this_path(sqlite3_context *ctx, int argc,
+                           sqlite3_value **argv)
+{
+    const char *pid = (const char *)sqlite3_value_text(argv[0]);
+    const char *name = (const char *)sqlite3_value_text(argv[1]);
+    sqlite3_stmt *stmt;
+    GString *path;
+
+    if (pid == NULL || name == NULL) {
+        sqlite3_result_null(ctx);
+        return;
+    }
+
+    stmt = names_stmt(ctx);
+    if (stmt == NULL)
+        return;
+
+    path = g_string_new(name);
+    path_walk(ctx, stmt, pid, path);
+    g_string_free(path, TRUE);
+    /* don't keep a read transaction open */
+    sqlite3_reset(stmt);
+}
+
+/** one_path(id): one of the paths of an entry (NULL if it has no name) */
+static void func_one_path(sqlite3_context *ctx, int argc,
+                          sqlite3_value **argv)
+{
+    const char *id = (const char *)sqlite3_value_text(argv[0]);
+    const char *parent, *name;
+    char *pid;
+    sqlite3_stmt *stmt;
+    GString *path;
+    int rc;
+
+    if (id == NULL) {
+        sqlite3_result_null(ctx);
+        return;
+    }
+
+    stmt = names_stmt(ctx);
+    if (stmt == NULL)
+        return;
+
+    rc = names_lookup(stmt, id);
+    if (rc != SQLITE_ROW) {
+        if (rc == SQLITE_DONE)
+            sqlite3_result_null(ctx);
+        else
+            sqlite3_result_error(ctx, sqlite3_errmsg(
+                                     sqlite3_context_db_handle(ctx)), -1);
+        goto out;
+    }
+
+    parent = (const char *)sqlite3_column_text(stmt, 0);
+    name = (const char *)sqlite3_column_text(stmt, 1);
+    if (parent == NULL || name == NULL) {
+        sqlite3_result_null(ctx);
+        goto out;
+    }
+
+    /* parent and name are overwritten by the next lookup */
+    path = g_string_new(name);
+    pid = g_strdup(parent);
+    path_walk(ctx, stmt, pid, path);
+    g_free(pid);
+    g_string_free(path, TRUE);
+
+ out:
+    sqlite3_reset(stmt);
+}
+
+static const struct {
+    const char *name;
+    int         nargs;
+    int         flags;
+    void      (*func)(sqlite3_context *, int, sqlite3_value **);
+    bool        cache;  /* needs a names_cache_t */
+} funcs[] = {
+    {SZRANGE_FUNC, 1, SQLITE_DETERMINISTIC, func_sz_range, false},
+    {ONE_PATH_FUNC, 1, 0, func_one_path, true},
+    {THIS_PATH_FUNC, 2, 0, func_this_path, true},
+};
+
+static int register_functions(sqlite3 *conn)
+{
+    names_cache_t *cache;
+    int i, rc;
+
+    for (i = 0; i < sizeof(funcs) / sizeof(funcs[0]); i++) {
+        cache = funcs[i].cache ? g_new0(names_cache_t, 1) : NULL;
+        /* the cache is freed when the function is deleted, or if the
+         * registration fails */
+        rc = sqlite3_create_function_v2(conn, funcs[i].name, funcs[i].nargs,
+                                        SQLITE_UTF8 | funcs[i].flags, cache,
+                                        funcs[i].func, NULL, NULL,
+                                        cache ? names_cache_free : NULL);
+        if (rc != SQLITE_OK) {
+            DisplayLog(LVL_CRIT, LISTMGR_TAG, "Failed to register function "
+                       "'%s': Error: %s", funcs[i].name, sqlite3_errmsg(conn));
+            return sqlite_error_convert(rc);
+        }
+    }
+    return DB_SUCCESS;
+}
+
 /* create client connection */
 int db_connect(db_conn_t *conn)
 {
     int rc;
 
-    /* Connect to database */
-    rc = sqlite3_open(lmgr_config.db_config.filepath, conn);
+    /* Connect to database. Each thread has its own connection, with its
+     * own page cache: shared cache would serialize all accesses. */
+    rc = sqlite3_open_v2(lmgr_config.db_config.filepath, conn,
+                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+                         | SQLITE_OPEN_PRIVATECACHE, NULL);
     if (rc != 0) {
         if (*conn) {
             DisplayLog(LVL_CRIT, LISTMGR_TAG,
@@ -82,11 +359,27 @@ int db_connect(db_conn_t *conn)
 
     DisplayLog(LVL_FULL, LISTMGR_TAG, "Logged on to database successfully");
 
-    set_cache_size(*conn);
+    rc = set_pragmas(*conn);
+    if (rc == DB_SUCCESS)
+        rc = register_functions(*conn);
+    if (rc) {
+        sqlite3_close(*conn);
+        *conn = NULL;
+        return DB_CONNECT_FAILED;
+    }
 
     return DB_SUCCESS;
 }
 
+/* nothing to be done: the library has no thread-specific resources */
+void db_thread_init(void)
+{
+}
+
+void db_thread_end(void)
+{
+}
+
 /* retrieve error message */
 char *db_errmsg(db_conn_t *conn, char *errmsg, unsigned int buflen)
 {
@@ -205,9 +498,278 @@ int db_result_nb_records(db_conn_t *conn, result_handle_t *p_result)
     return p_result->nb_rows;
 }
 
+/* -------------------- prepared statements ---------------- */
+
+/** step a statement, waiting while the DB is busy */
+static int stmt_step(db_conn_t *conn, db_stmt_t *stmt)
+{
+    int rc;
+
+    do {
+        rc = sqlite3_step(stmt->stmt);
+
+        if (db_is_busy_err(rc)) {
+            sqlite3_reset(stmt->stmt);
+            usleep(lmgr_config.db_config.retry_delay_microsec);
+        }
+    }
+    while (db_is_busy_err(rc));
+
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "SQLite statement failed (%d): "
+                   "%s: %s", rc, sqlite3_errmsg(*conn), stmt->query);
+    return rc;
+}
+
+int db_stmt_prepare(db_conn_t *conn, const char *query, db_stmt_t **p_stmt)
+{
+    db_stmt_t *stmt;
+    int        rc;
+
+#ifdef _DEBUG_DB
+    DisplayLog(LVL_FULL, LISTMGR_TAG, "SQL prepare: %s", query);
+#endif
+
+    stmt = calloc(1, sizeof(*stmt));
+    if (stmt == NULL)
+        return DB_NO_MEMORY;
+    stmt->query = strdup(query);
+    if (stmt->query == NULL) {
+        free(stmt);
+        return DB_NO_MEMORY;
+    }
+
+    do {
+        rc = sqlite3_prepare_v2(*conn, query, -1, &stmt->stmt, NULL);
+
+        if (db_is_busy_err(rc))
+            usleep(lmgr_config.db_config.retry_delay_microsec);
+    }
+    while (db_is_busy_err(rc));
+
+    if (rc != SQLITE_OK) {
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "SQLite prepare failed (%d): "
+                   "%s: %s", rc, sqlite3_errmsg(*conn), query);
+        db_stmt_close(conn, stmt);
+        return sqlite_error_convert(rc);
+    }
+
+    stmt->nb_params = sqlite3_bind_parameter_count(stmt->stmt);
+    *p_stmt = stmt;
+    return DB_SUCCESS;
+}
+
+int db_stmt_exec(db_conn_t *conn, db_stmt_t *stmt,
+                 const db_field_value_t *params, unsigned int nb_params)
+{
+    unsigned int i;
+    int          rc;
+
+    if (nb_params != stmt->nb_params) {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Statement '%s' expects %u "
+                   "parameters (%u given)", stmt->query, stmt->nb_params,
+                   nb_params);
+        return DB_INVALID_ARG;
+    }
+
+    sqlite3_reset(stmt->stmt);
+    sqlite3_clear_bindings(stmt->stmt);
+
+    /* unset parameters are bound to NULL */
+    for (i = 0; i < nb_params; i++) {
+        if (params[i].is_null)
+            continue;
+        if (params[i].is_num)
+            rc = sqlite3_bind_int64(stmt->stmt, i + 1, params[i].num);
+        else
+            rc = sqlite3_bind_text(stmt->stmt, i + 1, params[i].str, -1,
+                                   SQLITE_TRANSIENT);
+        if (rc != SQLITE_OK)
+            return sqlite_error_convert(rc);
+    }
+
+    /* records are stepped by db_stmt_next_record() */
+    if (sqlite3_column_count(stmt->stmt) > 0)
+        return DB_SUCCESS;
+
+    rc = stmt_step(conn, stmt);
+    sqlite3_reset(stmt->stmt);
+    return (rc == SQLITE_DONE) ? DB_SUCCESS : sqlite_error_convert(rc);
+}
+
+int db_stmt_next_record(db_conn_t *conn, db_stmt_t *stmt, char *outtab[],
+                        unsigned int outtabsize)
+{
+    int i, rc, nb_cols;
+
+    rc = stmt_step(conn, stmt);
+    if (rc == SQLITE_DONE)
+        return DB_END_OF_LIST;
+    else if (rc != SQLITE_ROW)
+        return sqlite_error_convert(rc);
+
+    nb_cols = sqlite3_column_count(stmt->stmt);
+    if (nb_cols > outtabsize)
+        return DB_BUFFER_TOO_SMALL;
+
+    for (i = 0; i < nb_cols; i++)
+        outtab[i] = (char *)sqlite3_column_text(stmt->stmt, i);
+
+    return DB_SUCCESS;
+}
+
+int db_stmt_next_values(db_conn_t *conn, db_stmt_t *stmt,
+                        db_field_value_t *values, unsigned int count)
+{
+    int i, rc, nb_cols;
+
+    rc = stmt_step(conn, stmt);
+    if (rc == SQLITE_DONE)
+        return DB_END_OF_LIST;
+    else if (rc != SQLITE_ROW)
+        return sqlite_error_convert(rc);
+
+    nb_cols = sqlite3_column_count(stmt->stmt);
+    if (nb_cols > count)
+        return DB_BUFFER_TOO_SMALL;
+
+    memset(values, 0, count * sizeof(*values));
+    for (i = 0; i < nb_cols; i++) {
+        switch (sqlite3_column_type(stmt->stmt, i)) {
+        case SQLITE_NULL:
+            values[i].is_null = true;
+            break;
+        case SQLITE_INTEGER:
+            values[i].is_num = true;
+            values[i].num = sqlite3_column_int64(stmt->stmt, i);
+            break;
+        default:
+            values[i].str = (char *)sqlite3_column_text(stmt->stmt, i);
+        }
+    }
+
+    return DB_SUCCESS;
+}
+
+int db_stmt_free_result(db_conn_t *conn, db_stmt_t *stmt)
+{
+    sqlite3_reset(stmt->stmt);
+    return DB_SUCCESS;
+}
+
+void db_stmt_close(db_conn_t *conn, db_stmt_t *stmt)
+{
+    if (stmt->stmt != NULL)
+        sqlite3_finalize(stmt->stmt);
+    free(stmt->query);
+    free(stmt);
+}
+
+int db_lock_acquire(db_conn_t *conn, const char *name)
+{
+    /* no named locks with SQLite */
+    return DB_NOT_SUPPORTED;
+}
+
+int db_lock_is_used(db_conn_t *conn, const char *name, bool *used)
+{
+    return DB_NOT_SUPPORTED;
+}
+
+int db_load_file(db_conn_t *conn, const char *path, const char *table,
+                 const char *fields, const char *set_field,
+                 const char *set_expr)
+{
+    /* no client-side bulk load with SQLite */
+    return DB_NOT_SUPPORTED;
+}
+
+/* remove a database component (table, trigger, function, ...) */
+int db_drop_component(db_conn_t *conn, db_object_e obj_type, const char *name)
+{
+    const char *tname = "";
+    char query[1024];
+
+    switch (obj_type) {
+    case DBOBJ_TABLE:
+        tname = "TABLE";
+        break;
+    case DBOBJ_TRIGGER:
+        tname = "TRIGGER";
+        break;
+    case DBOBJ_FUNCTION:
+        /* registered for each connection: nothing to drop */
+        return DB_SUCCESS;
+    default:
+        DisplayLog(LVL_CRIT, LISTMGR_TAG, "Object type not supported in %s",
+                   __func__);
+        return DB_NOT_SUPPORTED;
+    }
+
+    snprintf(query, sizeof(query), "DROP %s IF EXISTS %s", tname, name);
+    return db_exec_sql(conn, query, NULL);
+}
+
+/**
+ * check a component exists in the database
+ * \param arg depends on the object type: src table for triggers and
+ *            indexes, NULL for others.
+ */
+int db_check_component(db_conn_t *conn, db_object_e obj_type, const char *name,
+                       const char *arg)
+{
+    char query[1024];
+    result_handle_t result;
+    char *row[1];
+    int rc;
+
+    if (obj_type == DBOBJ_FUNCTION)
+        /* functions are registered by db_connect() */
+        return DB_SUCCESS;
+    else if (obj_type == DBOBJ_PROC)
+        RBH_BUG("Procedures are not supported with SQLite");
+
+    snprintf(query, sizeof(query), "SELECT tbl_name FROM sqlite_master "
+             "WHERE type='%s' AND name='%s'", dbobj2str(obj_type), name);
+
+    rc = db_exec_sql(conn, query, &result);
+    if (rc)
+        return rc;
+
+    rc = db_next_record(conn, &result, row, 1);
+    if (rc == DB_END_OF_LIST) {
+        DisplayLog(LVL_DEBUG, LISTMGR_TAG, "%s does not exist", name);
+        rc = DB_NOT_EXISTS;
+    } else if (rc == DB_SUCCESS && arg != NULL
+               && (row[0] == NULL || strcmp(arg, row[0]))) {
+        DisplayLog(LVL_CRIT, LISTMGR_TAG,
+                   "%s %s is on wrong table: expected %s, got %s",
+                   dbobj2str(obj_type), name, arg, row[0] ? row[0] : "<null>");
+        rc = DB_BAD_SCHEMA;
+    }
+
+    db_result_free(conn, &result);
+    return rc;
+}
+
+/** delete the functions that hold prepared statements, as the connection
+ * can't be closed while statements are not finalized */
+static void unregister_functions(sqlite3 *conn)
+{
+    int i;
+
+    for (i = 0; i < sizeof(funcs) / sizeof(funcs[0]); i++) {
+        if (funcs[i].cache)
+            sqlite3_create_function_v2(conn, funcs[i].name, funcs[i].nargs,
+                                       SQLITE_UTF8 | funcs[i].flags, NULL,
+                                       NULL, NULL, NULL, NULL);
+    }
+}
+
 int db_close_conn(db_conn_t *conn)
 {
     /* XXX Ensure there is no pending transactions? */
+    unregister_functions(*conn);
     sqlite3_close(*conn);
     return DB_SUCCESS;
 }
@@ -271,9 +833,14 @@ unsigned long long db_last_id(db_conn_t *conn)
 }
 
 /* escape a string in a SQL request */
-void db_escape_string(db_conn_t *conn, char *str_out, size_t out_size,
-                      const char *str_in)
+int db_escape_string(db_conn_t *conn, char *str_out, size_t out_size,
+                     const char *str_in)
 {
+    /* output size must be at least 2 x instrlen + 1 for the worst case */
+    if (out_size < 2 * strlen(str_in) + 1)
+        return DB_BUFFER_TOO_SMALL;
+
     /* using slqite3_snprintf with "%q" format, to escape strings */
-    sqlite3_snprintf(out_size, str_out, str_in);
+    sqlite3_snprintf(out_size, str_out, "%q", str_in);
+    return DB_SUCCESS;
 }
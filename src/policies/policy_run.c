@@ -1900,6 +1900,182 @@ static int execute_prepost_run_command(const policy_info_t *policy,
     return rc;
 }
 
+/** index needed to select policy candidates */
+typedef struct policy_index {
+    unsigned int attrs[2];
+    unsigned int count;
+    /** names of the policies that need it */
+    GString     *reason;
+} policy_index_t;
+
+/* indexes needed by the policies to be run (built once for all) */
+static GPtrArray *pol_indexes = NULL;
+static pthread_t  pol_indexes_thr;
+static bool       pol_indexes_started = false;
+
+/** add an index to the list of indexes to be built, if not already in it */
+static void add_index(const policy_descr_t *descr, const unsigned int *attrs,
+                      unsigned int count)
+{
+    policy_index_t *idx;
+    unsigned int i;
+
+    if (pol_indexes == NULL)
+        pol_indexes = g_ptr_array_new();
+
+    for (i = 0; i < pol_indexes->len; i++) {
+        idx = g_ptr_array_index(pol_indexes, i);
+
+        if (idx->count == count
+            && !memcmp(idx->attrs, attrs, count * sizeof(*attrs))) {
+            char *quoted = g_strdup_printf("'%s'", descr->name);
+
+            if (!strstr(idx->reason->str, quoted))
+                g_string_append_printf(idx->reason, ", %s", quoted);
+            g_free(quoted);
+            return;
+        }
+    }
+
+    idx = MemAlloc(sizeof(*idx));
+    if (idx == NULL)
+        return;
+    memcpy(idx->attrs, attrs, count * sizeof(*attrs));
+    idx->count = count;
+    idx->reason = g_string_new(NULL);
+    g_string_printf(idx->reason, "policies '%s'", descr->name);
+    g_ptr_array_add(pol_indexes, idx);
+}
+
+/** does the policy select entries by fileclass? */
+static bool policy_uses_fileclass(const policy_descr_t *descr,
+                                  const policy_run_config_t *config)
+{
+    const policy_rules_t *rules = &descr->rules;
+    int i, j;
+
+    /* fileclasses are not used in DB filters in this case */
+    if (config->recheck_ignored_entries)
+        return false;
+
+    if (rules->ignore_count > 0)
+        return true;
+
+    for (i = 0; i < rules->rule_count; i++)
+        for (j = 0; j < rules->rules[i].target_count; j++)
+            if (rules->rules[i].target_list[j]->matchable)
+                return true;
+
+    return false;
+}
+
+void policy_indexes_add(const policy_descr_t *descr,
+                        const policy_run_config_t *config,
+                        const policy_opt_t *options)
+{
+    sm_instance_t *smi = descr->status_mgr;
+    unsigned int sort_attr = config->lru_sort_attr;
+    unsigned int attrs[2];
+    unsigned int count;
+
+    /* the policy won't be run (see policy_module_start()) */
+    if ((options->target == TGT_NONE && config->trigger_count == 0)
+        || (NO_POLICY(&descr->rules)
+            && !(options->flags & RUNFLG_IGNORE_POL)))
+        return;
+
+    /* entries are selected by status (in policy scope),
+     * and sorted by lru_sort_attr */
+    if (smi != NULL && smi->sm->status_count > 0
+        && attr_mask_test_index(&descr->scope_mask, smi_status_index(smi))) {
+        count = 0;
+        attrs[count++] = smi_status_index(smi);
+        if (sort_attr != LRU_ATTR_NONE)
+            attrs[count++] = sort_attr;
+        add_index(descr, attrs, count);
+    }
+
+    if (sort_attr != LRU_ATTR_NONE) {
+        attrs[0] = sort_attr;
+        add_index(descr, attrs, 1);
+    }
+
+    /* entries are filtered by fileclass */
+    if (policy_uses_fileclass(descr, config)
+        && !(options->flags & RUNFLG_IGNORE_POL)) {
+        attrs[0] = ATTR_INDEX_fileclass;
+        attrs[1] = (sort_attr != LRU_ATTR_NONE) ? sort_attr : ATTR_INDEX_size;
+        add_index(descr, attrs, 2);
+    }
+}
+
+static void *policy_indexes_thr(void *arg)
+{
+    lmgr_t lmgr;
+    unsigned int i;
+    int rc;
+
+    rc = ListMgr_InitAccess(&lmgr);
+    if (rc) {
+        DisplayLog(LVL_MAJOR, TAG, "Could not connect to database (error %d):"
+                   " indexes for policies can't be checked", rc);
+        goto free_list;
+    }
+
+    for (i = 0; i < pol_indexes->len; i++) {
+        policy_index_t *idx = g_ptr_array_index(pol_indexes, i);
+
+        rc = ListMgr_EnsureIndex(&lmgr, idx->attrs, idx->count,
+                                 idx->reason->str);
+        if (rc == DB_NOT_SUPPORTED)
+            DisplayLog(LVL_DEBUG, TAG, "Attributes used by %s are not in the "
+                       "main table: no index can be created for them",
+                       idx->reason->str);
+        else if (rc)
+            DisplayLog(LVL_MAJOR, TAG, "Failed to create an index for %s "
+                       "(error %d): policy runs may be slow",
+                       idx->reason->str, rc);
+    }
+
+    ListMgr_CloseAccess(&lmgr);
+
+ free_list:
+    for (i = 0; i < pol_indexes->len; i++) {
+        policy_index_t *idx = g_ptr_array_index(pol_indexes, i);
+
+        g_string_free(idx->reason, TRUE);
+        MemFree(idx);
+    }
+    g_ptr_array_free(pol_indexes, TRUE);
+    pol_indexes = NULL;
+    return NULL;
+}
+
+int policy_indexes_start(void)
+{
+    int rc;
+
+    if (pol_indexes == NULL)
+        return 0;
+
+    rc = pthread_create(&pol_indexes_thr, NULL, policy_indexes_thr, NULL);
+    if (rc) {
+        DisplayLog(LVL_CRIT, TAG, "Failed to start the thread to create "
+                   "indexes for policies: %s", strerror(rc));
+        return rc;
+    }
+    pol_indexes_started = true;
+    return 0;
+}
+
+void policy_indexes_wait(void)
+{
+    if (!pol_indexes_started)
+        return;
+    pthread_join(pol_indexes_thr, NULL);
+    pol_indexes_started = false;
+}
+
 /**
  * Convert policy scope to filter.
  * @param filter    Initialized listmgr filter
@@ -2025,9 +2201,14 @@ int run_policy(policy_info_t *p_pol_info, const policy_param_t *p_param,
     nb_returned = 0;
     total_returned = 0;
 
+    /* log how the DB processes the first request of the first run */
+    opt.explain = !p_pol_info->plan_logged;
+    p_pol_info->plan_logged = true;
+
     rc = iter_open(lmgr,
                    p_pol_info->descr->manage_deleted ? IT_RMD : IT_LIST,
                    &it, &filter, &sort_type, &opt);
+    opt.explain = 0;
     if (rc != DB_SUCCESS) {
         lmgr_simple_filter_free(&filter);
         DisplayLog(LVL_CRIT, tag(p_pol_info),
@@ -3124,6 +3305,10 @@ int check_current_actions(policy_info_t *pol, lmgr_t *lmgr,
     unsigned int nb_aborted = 0;
     attr_mask_t attr_mask_sav = { 0 };
     attr_mask_t tmp;
+    /* actions may have just been started: don't read a replica */
+    lmgr_iter_opt_t opt = LMGR_ITER_OPT_INIT;
+
+    opt.force_primary = 1;
 
     /* do nothing if this policy applies to deleted entries */
     if (pol->descr->manage_deleted)
@@ -3176,7 +3361,7 @@ int check_current_actions(policy_info_t *pol, lmgr_t *lmgr,
         return rc;
 #endif
 
-    it = ListMgr_Iterator(lmgr, &filter, NULL, NULL);
+    it = ListMgr_Iterator(lmgr, &filter, NULL, &opt);
 
     if (it == NULL) {
         lmgr_simple_filter_free(&filter);
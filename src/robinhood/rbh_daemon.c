@@ -61,6 +61,7 @@ static time_t boot_time;
 #define TGT_USAGE         267
 #define FORCE_ALL         268
 #define ALTER_DB          269
+#define INCR_SCAN         273
 
 /* deprecated params */
 #define FORCE_OST_PURGE   270
@@ -133,6 +134,7 @@ static struct option option_tab[] = {
     {"detach", no_argument, NULL, 'd'},
     {"no-limit", no_argument, NULL, NO_LIMIT},
     {"no-gc", no_argument, NULL, NO_GC},
+    {"incremental", no_argument, NULL, INCR_SCAN},
     {"alter-db", no_argument, NULL, ALTER_DB},
     {"alterdb", no_argument, NULL, ALTER_DB},
     /* generic policies equivalent for --sync:
@@ -207,7 +209,9 @@ typedef struct rbh_options {
     char           pid_filepath[MAX_OPT_LEN];
     bool           test_syntax;
     bool           partial_scan;
-    char           partial_scan_path[RBH_PATH_MAX]; /* can be a deep path */
+    unsigned int   partial_scan_count;
+    /* can be deep paths */
+    char           partial_scan_path[MAX_SCAN_ROOTS][RBH_PATH_MAX];
     attr_mask_t    diff_mask;
 
     char           policy_string[MAX_OPT_LEN];
@@ -249,6 +253,7 @@ static const char *action_help =
     _B "Actions:" B_ "\n"
     "    " _B "-S" B_ ", " _B "--scan" B_ "[=" _U "dir" U_ "]\n"
     "        Scan the filesystem namespace. If " _U "dir" U_ " is specified, only scan the specified subdir.\n"
+    "        This option can be repeated to scan several subdirs concurrently.\n"
 #ifdef HAVE_CHANGELOGS
     "    " _B "-r" B_ ", " _B "--read-log" B_ "[=" _U "mdt_idx" U_ "]\n"
     "        Read events from MDT ChangeLog.\n"
@@ -311,7 +316,12 @@ static const char *scan_help =
     "        Garbage collection of entries in DB is a long operation when terminating\n"
     "        a scan. This skips this operation if you don't care about removed\n"
     "        entries (or don't expect entries to be removed).\n"
-    "        This is also recommended for partial scanning (see -scan=dir option).\n";
+    "        This is also recommended for partial scanning (see -scan=dir option).\n"
+    "    " _B "--incremental" B_ "\n"
+    "        Only read the directories whose mtime or ctime changed since they were\n"
+    "        stored in DB. The content of other directories is taken from the DB\n"
+    "        (their entries are still stat'ed). Only the entries of read directories\n"
+    "        are cleaned at the end of the scan.\n";
 
 static const char *output_help =
     _B "Output options:" B_ "\n"
@@ -418,6 +428,7 @@ static inline void display_version(const char *bin_name)
 }
 
 static pthread_t stat_thread;
+static pthread_t snapshot_thread;
 
 /* database connexion for updating stats */
 static lmgr_t   lmgr;
@@ -545,6 +556,31 @@ static void *stats_thr(void *arg)
     return NULL;
 }
 
+/** interval to check if the report snapshot must be updated */
+#define SNAPSHOT_CHECK_INTERVAL 60
+
+/** periodically export the report snapshot */
+static void *snapshot_thr(void *arg)
+{
+    lmgr_t snap_lmgr;
+
+    if (ListMgr_InitAccess(&snap_lmgr) != DB_SUCCESS)
+        return NULL;
+
+    DisplayLog(LVL_VERB, MAIN_TAG, "Report snapshot thread started");
+
+    while (!terminate_sig) {
+        /* the snapshot is only exported when it is older than
+         * ListManager::snapshot_interval */
+        if (ListMgr_UpdateSnapshot(&snap_lmgr) == DB_NOT_SUPPORTED)
+            break;
+        rh_intr_sleep(SNAPSHOT_CHECK_INTERVAL, terminate_sig);
+    }
+
+    ListMgr_CloseAccess(&snap_lmgr);
+    return NULL;
+}
+
 #define SIGHDL_TAG  "SigHdlr"
 
 static void terminate_handler(int sig)
@@ -877,12 +913,23 @@ static int rh_read_parameters(const char *bin, int argc, char **argv,
             *action_mask |= ACTION_MASK_SCAN;
 
             if (optarg) {   /* optional argument => partial scan */
+                char *path;
+
+                /* can be specified several times */
+                if (opt->partial_scan_count >= MAX_SCAN_ROOTS) {
+                    fprintf(stderr, "Error: too many directories to scan "
+                            "(max %u)\n", MAX_SCAN_ROOTS);
+                    return EINVAL;
+                }
+                path = opt->partial_scan_path[opt->partial_scan_count];
+
                 opt->flags |= RUNFLG_ONCE;
                 opt->partial_scan = true;
-                rh_strncpy(opt->partial_scan_path, optarg, RBH_PATH_MAX);
+                rh_strncpy(path, optarg, RBH_PATH_MAX);
                 /* clean final slash */
-                if (FINAL_SLASH(opt->partial_scan_path))
-                    REMOVE_FINAL_SLASH(opt->partial_scan_path);
+                if (FINAL_SLASH(path))
+                    REMOVE_FINAL_SLASH(path);
+                opt->partial_scan_count++;
             }
             break;
 
@@ -1042,6 +1089,9 @@ static int rh_read_parameters(const char *bin, int argc, char **argv,
         case NO_GC:
             opt->flags |= RUNFLG_NO_GC;
             break;
+        case INCR_SCAN:
+            opt->flags |= RUNFLG_INCR_SCAN;
+            break;
         case DRY_RUN:
             opt->flags |= RUNFLG_DRY_RUN;
             break;
@@ -1778,12 +1828,26 @@ int main(int argc, char **argv)
      */
 
     if (!terminate_sig && action_mask & ACTION_MASK_SCAN) {
+        run_flags_t scan_flags = options.flags;
+
+        /* In daemon mode, changelog records are processed while the scan
+         * is running. Entries can't be bulk-loaded in this case. */
+        if ((action_mask & ACTION_MASK_HANDLE_EVENTS)
+            && !(options.flags & RUNFLG_ONCE))
+            scan_flags |= RUNFLG_NO_BULK_LOAD;
 
         /* Start FS scan */
-        if (options.partial_scan)
-            rc = FSScan_Start(options.flags, options.partial_scan_path);
-        else
-            rc = FSScan_Start(options.flags, NULL);
+        if (options.partial_scan) {
+            const char *roots[MAX_SCAN_ROOTS];
+            int i;
+
+            for (i = 0; i < options.partial_scan_count; i++)
+                roots[i] = options.partial_scan_path[i];
+
+            rc = FSScan_Start(scan_flags, roots,
+                              options.partial_scan_count);
+        } else
+            rc = FSScan_Start(scan_flags, NULL, 0);
 
         if (rc) {
             DisplayLog(LVL_CRIT, MAIN_TAG,
@@ -1867,6 +1931,17 @@ int main(int argc, char **argv)
         }
         policy_run_cpt = run_count;
 
+        /* make sure policy candidates can be selected efficiently:
+         * indexes are created in background, once for all policies */
+        for (i = 0; i < run_count; i++) {
+            unsigned int pol_idx = runs[i].policy_index;
+
+            policy_indexes_add(&policies.policy_list[pol_idx],
+                               &run_cfgs.configs[pol_idx],
+                               &runs[i].run_opt);
+        }
+        policy_indexes_start();
+
         for (i = 0; i < run_count; i++) {
             unsigned int pol_idx = runs[i].policy_index;
 
@@ -1914,6 +1989,9 @@ int main(int argc, char **argv)
             exit(1);
         }
 
+        /* export the report snapshot, if configured */
+        pthread_create(&snapshot_thread, NULL, snapshot_thr, NULL);
+
         running_mask2str(running_mask, policy_run_mask, tmpstr);
         DisplayLog(LVL_MAJOR, MAIN_TAG, "Daemon started (running modules: %s)",
                    tmpstr);
@@ -1925,6 +2003,8 @@ int main(int argc, char **argv)
         /* should never return */
         exit(1);
     } else {
+        /* don't interrupt index creation */
+        policy_indexes_wait();
         DisplayLog(LVL_MAJOR, MAIN_TAG, "All tasks done! Exiting.");
         exit(0);
     }
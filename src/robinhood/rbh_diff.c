@@ -675,10 +675,12 @@ int main(int argc, char **argv)
     }
 
     /* Start FS scan */
-    if (options.partial_scan)
-        rc = FSScan_Start(options.flags, options.partial_scan_path);
-    else
-        rc = FSScan_Start(options.flags, NULL);
+    if (options.partial_scan) {
+        const char *root = options.partial_scan_path;
+
+        rc = FSScan_Start(options.flags, &root, 1);
+    } else
+        rc = FSScan_Start(options.flags, NULL, 0);
 
     if (rc) {
         DisplayLog(LVL_CRIT, DIFF_TAG, "Error %d initializing FS Scan module",
@@ -66,6 +66,8 @@
 #define OPT_SIZE_PROFILE  330
 #define OPT_BY_SZ_RATIO   331
 
+#define OPT_NO_SNAPSHOT   340
+
 /* options flags */
 #define OPT_FLAG_CSV        0x0001
 #define OPT_FLAG_NOHEADER   0x0002
@@ -79,6 +81,7 @@
 #define OPT_FLAG_SPROF          0x0200
 #define OPT_FLAG_BY_SZRATIO     0x0400
 #define OPT_FLAG_SPLITUSERPROJ  0x1000
+#define OPT_FLAG_NO_SNAPSHOT    0x2000
 
 #define CSV(_x) !!((_x)&OPT_FLAG_CSV)
 #define NOHEADER(_x) !!((_x)&OPT_FLAG_NOHEADER)
@@ -86,6 +89,7 @@
 #define ISSPLITUSERGROUP(_x) !!((_x)&OPT_FLAG_SPLITUSERGROUP)
 #define ISSPLITUSERPROJ(_x) !!((_x)&OPT_FLAG_SPLITUSERPROJ)
 #define FORCE_NO_ACCT(_x) !!((_x)&OPT_FLAG_NO_ACCT)
+#define FORCE_NO_SNAPSHOT(_x) !!((_x)&OPT_FLAG_NO_SNAPSHOT)
 #define SORT_BY_COUNT(_x) !!((_x)&OPT_FLAG_BY_COUNT)
 #define SORT_BY_AVGSIZE(_x) !!((_x)&OPT_FLAG_BY_AVGSIZE)
 #define SORT_BY_SZRATIO(_x) !!((_x)&OPT_FLAG_BY_SZRATIO)
@@ -180,6 +184,7 @@ static struct option option_tab[] = {
     {"help", no_argument, NULL, 'h'},
     {"version", no_argument, NULL, 'V'},
     {"force-no-acct", no_argument, NULL, 'F'},
+    {"force-no-snapshot", no_argument, NULL, OPT_NO_SNAPSHOT},
 
     {NULL, 0, NULL, 0}
 
@@ -297,7 +302,10 @@ static const char *acct_help =
     "    " _B "-J" B_ ", " _B "--split-user-projects" B_ "\n"
     "        Display the report by user AND projid\n"
     "    " _B "-F" B_ ", " _B "--force-no-acct" B_ "\n"
-    "        Generate the report without using accounting table (slower)\n";
+    "        Generate the report without using accounting table (slower)\n"
+    "    " _B "--force-no-snapshot" B_ "\n"
+    "        Generate the report from the database, even if a recent report\n"
+    "        snapshot is available (see ListManager::snapshot_file)\n";
 
 static const char *cfg_help =
     _B "Config file options:" B_ "\n"
@@ -1578,7 +1586,7 @@ static void report_fs_info(int flags)
         {ATTR_INDEX_size, REPORT_MAX, SORT_NONE, false, 0, FV_NULL},
         {ATTR_INDEX_size, REPORT_AVG, SORT_NONE, false, 0, FV_NULL},
     };
-    lmgr_iter_opt_t opt;
+    lmgr_iter_opt_t opt = LMGR_ITER_OPT_INIT;
     profile_u prof;
     bool display_header = !NOHEADER(flags);
 
@@ -1598,6 +1606,7 @@ static void report_fs_info(int flags)
     /* skip missing entries */
     opt.allow_no_attr = 0;
     opt.force_no_acct = FORCE_NO_ACCT(flags);
+    opt.allow_snapshot = !FORCE_NO_SNAPSHOT(flags);
 
     /* append global filters */
     if (mk_global_filters(&filter, !NOHEADER(flags), &is_filter) != 0) {
@@ -1744,7 +1753,7 @@ static void report_usergroup_info(char *name, int flags)
     bool is_filter = false;
     bool display_header = !NOHEADER(flags);
     unsigned long long total_size, total_used, total_count;
-    lmgr_iter_opt_t opt;
+    lmgr_iter_opt_t opt = LMGR_ITER_OPT_INIT;
 #define USERINFOCOUNT_MAX 10
     db_value_t result[USERINFOCOUNT_MAX];
     profile_u prof;
@@ -1829,6 +1838,7 @@ static void report_usergroup_info(char *name, int flags)
     field_count++;
 
     opt.force_no_acct = FORCE_NO_ACCT(flags);
+    opt.allow_snapshot = !FORCE_NO_SNAPSHOT(flags);
 
     /* no limit */
     opt.list_count_max = 0;
@@ -1922,7 +1932,7 @@ static void report_topdirs(unsigned int count, int flags)
     lmgr_sort_type_t sorttype;
     lmgr_filter_t filter;
     filter_value_t fv;
-    lmgr_iter_opt_t opt;
+    lmgr_iter_opt_t opt = LMGR_ITER_OPT_INIT;
     struct lmgr_iterator_t *it;
     attr_set_t attrs;
     entry_id_t id;
@@ -2018,7 +2028,7 @@ static void report_topsize(unsigned int count, int flags)
     lmgr_sort_type_t sorttype;
     lmgr_filter_t filter;
     filter_value_t fv;
-    lmgr_iter_opt_t opt;
+    lmgr_iter_opt_t opt = LMGR_ITER_OPT_INIT;
     struct lmgr_iterator_t *it;
     attr_set_t attrs;
     entry_id_t id;
@@ -2092,7 +2102,7 @@ static void report_oldest(obj_type_t type, unsigned int count, int flags)
     lmgr_sort_type_t sorttype;
     lmgr_filter_t filter;
     filter_value_t fv;
-    lmgr_iter_opt_t opt;
+    lmgr_iter_opt_t opt = LMGR_ITER_OPT_INIT;
     struct lmgr_iterator_t *it;
     attr_set_t attrs;
     entry_id_t id;
@@ -2197,7 +2207,7 @@ static void report_topuser(unsigned int count, int flags)
 {
     unsigned int result_count;
     struct lmgr_report_t *it;
-    lmgr_iter_opt_t opt;
+    lmgr_iter_opt_t opt = LMGR_ITER_OPT_INIT;
     int rc;
     unsigned int rank = 1;
     lmgr_filter_t filter;
@@ -2268,6 +2278,7 @@ static void report_topuser(unsigned int count, int flags)
     /* skip missing entries */
     opt.allow_no_attr = 0;
     opt.force_no_acct = FORCE_NO_ACCT(flags);
+    opt.allow_snapshot = !FORCE_NO_SNAPSHOT(flags);
 
     it = ListMgr_Report(&lmgr, user_info, TOPUSERCOUNT,
                         SPROF(flags) ? &size_profile : NULL,
@@ -2383,6 +2394,7 @@ static void report_groupby(int attr_index, int flags)
 
     struct lmgr_report_t *it;
     lmgr_filter_t filter;
+    lmgr_iter_opt_t opt = LMGR_ITER_OPT_INIT;
     int rc;
     bool header;
     unsigned int result_count;
@@ -2414,10 +2426,12 @@ static void report_groupby(int attr_index, int flags)
         return;
     }
 
+    opt.allow_snapshot = !FORCE_NO_SNAPSHOT(flags);
+
     result_count = GROUPBY_FIELDS;
     it = ListMgr_Report(&lmgr, info, GROUPBY_FIELDS,
                         SPROF(flags) ? &size_profile : NULL,
-                        is_filter ? &filter : NULL, NULL);
+                        is_filter ? &filter : NULL, &opt);
 
     if (it == NULL) {
         DisplayLog(LVL_CRIT, REPORT_TAG,
@@ -2467,7 +2481,7 @@ static void report_status_info(int smi_index, const char *val, int flags)
 
     struct lmgr_report_t *it;
     lmgr_filter_t filter;
-    lmgr_iter_opt_t opt;
+    lmgr_iter_opt_t opt = LMGR_ITER_OPT_INIT;
     int rc;
     bool header;
     unsigned int result_count;
@@ -2520,6 +2534,7 @@ static void report_status_info(int smi_index, const char *val, int flags)
     result_count = STATUSINFO_FIELDS;
 
     opt.force_no_acct = FORCE_NO_ACCT(flags);
+    opt.allow_snapshot = !FORCE_NO_SNAPSHOT(flags);
     /* no limit */
     opt.list_count_max = 0;
     /* skip missing entries */
@@ -2974,6 +2989,9 @@ int main(int argc, char **argv)
         case 'F':
             flags |= OPT_FLAG_NO_ACCT;
             break;
+        case OPT_NO_SNAPSHOT:
+            flags |= OPT_FLAG_NO_SNAPSHOT;
+            break;
         case 'S':
             flags |= OPT_FLAG_SPLITUSERGROUP;
             break;
@@ -13479,6 +13479,668 @@ function test_scan_only
 
 }
 
+# records of entries created and removed between two reads of the changelog
+# are folded and never reach the pipeline
+function test_cl_fold
+{
+    local cfg=$RBH_CFG_DIR/$1
+    local dir=$RH_ROOT/dir.fold
+    local i
+
+    clean_logs
+
+    if (( $no_log )); then
+        echo "Changelogs not supported on this config: skipped"
+        set_skipped
+        return 1
+    fi
+
+    echo "1-Creating, modifying and removing entries..."
+    mkdir $dir
+    for i in {1..20}; do
+        touch $dir/tmp.$i
+        chmod 600 $dir/tmp.$i
+        rm -f $dir/tmp.$i
+    done
+    touch $dir/file.{1..5}
+
+    echo "2-Reading changelogs..."
+    $RH -f $cfg --readlog --once -l DEBUG -L rh_chglogs.log ||
+        error "reading changelog"
+    check_db_error rh_chglogs.log
+
+    grep "RECORD: " rh_chglogs.log | grep -q "tmp\." &&
+        error "records of removed entries should have been folded"
+    grep "RECORD: CREAT" rh_chglogs.log | grep -q "file\.1 " ||
+        error "missing CREAT record of a kept entry"
+
+    find $dir | sort > fs.list
+    $FIND -f $cfg $dir -printf "%p\n" | sort > db.list
+    diff -q fs.list db.list || error "DB paths differ from filesystem"
+    rm -f fs.list db.list
+}
+
+# records spilled while the DB is stuck must be processed after a crash
+function test_cl_spill
+{
+    local cfg=$RBH_CFG_DIR/$1
+    local spill=/tmp/lustre-MDT0000.spill
+    local dir=$RH_ROOT/dir.spill
+    local lock_pid
+    local i
+
+    clean_logs
+
+    if (( $no_log )); then
+        echo "Changelogs not supported on this config: skipped"
+        set_skipped
+        return 1
+    fi
+    rm -f $spill
+
+    mkdir $dir
+    $RH -f $cfg --readlog -l FULL -L rh_chglogs.log -p rh.pid -d ||
+        error "starting changelog reader"
+    wait_changelog_clear rh_chglogs.log 5 ||
+        error "No changelog_clear after 5s"
+
+    echo "1-Creating entries while the DB is locked..."
+    mysql $RH_DB -e "LOCK TABLES ENTRIES WRITE, NAMES WRITE, ANNEX_INFO WRITE;
+                     SELECT SLEEP(15)" > /dev/null &
+    lock_pid=$!
+    sleep 1
+    touch $dir/file.{1..200}
+
+    for i in {1..10}; do
+        grep -q "saving new records to $spill" rh_chglogs.log && break
+        sleep 1
+    done
+    grep -q "saving new records to $spill" rh_chglogs.log ||
+        error "records were not spilled"
+
+    # let the spill file be synced, then simulate a crash
+    sleep 2
+    kill -9 $(cat rh.pid)
+    rm -f rh.pid
+    wait $lock_pid
+    [ -s $spill ] || error "no spill file"
+
+    echo "2-Restarting..."
+    :> rh_chglogs.log
+    $RH -f $cfg --readlog --once -l DEBUG -L rh_chglogs.log ||
+        error "reading changelog"
+    check_db_error rh_chglogs.log
+    grep -q "records to be replayed" rh_chglogs.log ||
+        error "spilled records were not reloaded"
+
+    find $dir | sort > fs.list
+    $FIND -f $cfg $dir -printf "%p\n" | sort > db.list
+    diff -q fs.list db.list || error "DB paths differ from filesystem"
+    rm -f fs.list db.list $spill
+}
+
+# replay captured records with several decoders, check they are applied
+# in order for each entry
+function test_cl_replay
+{
+    local capture_cfg=$RBH_CFG_DIR/$1
+    local cfg=$RBH_CFG_DIR/$2
+    local dir=$RH_ROOT/dir.cl
+    local i
+
+    clean_logs
+
+    if (( $no_log )); then
+        echo "Changelogs not supported on this config: skipped"
+        set_skipped
+        return 1
+    fi
+    rm -f /tmp/rbh_cl_capture.MDT0000
+
+    echo "1-Creating, modifying and removing entries..."
+    mkdir -p $dir/sub.{1..4}
+    for i in {1..40}; do
+        touch $dir/sub.$((i % 4 + 1))/file.$i
+        chmod 600 $dir/sub.$((i % 4 + 1))/file.$i
+        mv $dir/sub.$((i % 4 + 1))/file.$i $dir/sub.$(((i + 1) % 4 + 1))
+        (( $i % 3 == 0 )) && rm -f $dir/sub.$(((i + 1) % 4 + 1))/file.$i
+    done
+
+    echo "2-Reading changelogs and capturing them..."
+    $RH -f $capture_cfg --readlog --once -l DEBUG -L rh_chglogs.log ||
+        error "reading changelog"
+    check_db_error rh_chglogs.log
+    grep "captured records" rh_chglogs.log
+    [ -s /tmp/rbh_cl_capture.MDT0000 ] || error "no record captured"
+
+    echo "3-Replaying them into an empty DB with 4 decoders..."
+    $CFG_SCRIPT empty_db $RH_DB > /dev/null
+    :> rh_chglogs.log
+    $RH -f $cfg --readlog --once -l FULL -L rh_chglogs.log ||
+        error "replaying changelog"
+    check_db_error rh_chglogs.log
+    grep -q "end of replay" rh_chglogs.log || error "replay didn't complete"
+
+    # records of an entry must be applied by increasing index
+    grep " applied" rh_chglogs.log |
+        sed -e "s/.*record #\([0-9]*\) of \([^ ]*\) applied.*/\2 \1/" |
+        awk '$2 <= last[$1] { print "record " $2 " of " $1 " applied after " last[$1]; bad=1 }
+             { last[$1] = $2 }
+             END { exit bad }' || error "records applied out of order"
+    (( $(grep -c " applied" rh_chglogs.log) > 0 )) || error "no record applied"
+
+    find $dir | sort > fs.list
+    $FIND -f $cfg $dir -printf "%p\n" | sort > db.list
+    diff -q fs.list db.list || error "DB paths differ from filesystem"
+    rm -f fs.list db.list /tmp/rbh_cl_capture.MDT0000
+}
+
+# removals of archived entries read from the changelog are inserted into
+# SOFT_RM by batches
+function test_batch_softrm
+{
+    local config_file=$1
+    local cfg=$RBH_CFG_DIR/$config_file
+    local entries=$2
+    local dir=$RH_ROOT/dir.rm
+    local max_batch
+    local nb
+    local i
+
+    if (( $is_lhsm + $is_hsmlite == 0 )); then
+        echo "HSM test only: skipped"
+        set_skipped
+        return 1
+    fi
+    if (( $no_log )); then
+        echo "Changelogs not supported on this config: skipped"
+        set_skipped
+        return 1
+    fi
+
+    clean_logs
+
+    echo "1-Creating and archiving $entries files..."
+    mkdir $dir
+    for i in $(seq 1 $entries); do
+        echo "data" > $dir/file.$i
+    done
+    $RH -f $cfg --readlog --once -l DEBUG -L rh_chglogs.log ||
+        error "reading changelog"
+    if (( $is_lhsm != 0 )); then
+        flush_data
+        $RH -f $cfg $SYNC_OPT -l DEBUG -L rh_migr.log ||
+            error "flushing data to backend"
+        wait_done 120 || error "Migration timeout"
+        $RH -f $cfg --readlog --once -l DEBUG -L rh_chglogs.log ||
+            error "reading changelog"
+    else
+        $RH -f $cfg $SYNC_OPT -l DEBUG -L rh_migr.log ||
+            error "flushing data to backend"
+    fi
+
+    echo "2-Removing them..."
+    rm -f $dir/file.*
+    :> rh_chglogs.log
+    $RH -f $cfg --readlog --once -l FULL -L rh_chglogs.log ||
+        error "reading changelog"
+    check_db_error rh_chglogs.log
+
+    max_batch=$(grep -o "BatchSoftRemove([0-9]* ops" rh_chglogs.log |
+                tr -dc '0-9\n' | sort -n | tail -1)
+    echo "largest batch of soft removals: ${max_batch:-0}"
+    (( ${max_batch:-0} > 1 )) || error "soft removals should be batched"
+
+    nb=$($REPORT -f $cfg --deferred-rm --csv -q | grep -c "$dir/file\.")
+    (( $nb == $entries )) ||
+        error "$entries entries expected in deferred rm list, got $nb"
+}
+
+# check ACCT_STAT counts all entries
+function check_acct_count
+{
+    local nb_entries=$(mysql $RH_DB -Bse "SELECT COUNT(*) FROM ENTRIES")
+    local nb_acct=$(mysql $RH_DB -Bse "SELECT SUM(count) FROM ACCT_STAT")
+    [[ "$nb_entries" == "$nb_acct" ]] ||
+        error "ACCT_STAT counts $nb_acct entries, ENTRIES has $nb_entries"
+}
+
+# first scan of an empty DB, loaded by chunks (initial_load)
+function test_initial_load
+{
+    local cfg=$RBH_CFG_DIR/$1
+
+    clean_logs
+    rm -f /tmp/rbh_load.*
+
+    mkdir -p $RH_ROOT/dir.{1..5}
+    touch $RH_ROOT/dir.{1..5}/file.{1..50}
+    # hardlinks: several rows of the same entry are loaded
+    for i in {1..10}; do
+        ln $RH_ROOT/dir.1/file.$i $RH_ROOT/dir.2/link.$i ||
+            error "creating hardlink"
+    done
+
+    echo "1-Scanning empty DB..."
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log ||
+        error "scanning"
+    check_db_error rh_scan.log
+
+    grep -q "Initial load started" rh_scan.log ||
+        error "initial load should have been started"
+    grep -q "Initial load complete" rh_scan.log ||
+        error "initial load should be complete"
+    ls /tmp/rbh_load.* 2>/dev/null && error "load files should be removed"
+
+    local status=$(mysql $RH_DB -Bse "SELECT value FROM VARS WHERE varname='LastScanStatus'")
+    [[ "$status" == "done" ]] || error "unexpected scan status: $status"
+    [[ -z "$(mysql $RH_DB -Bse "SELECT value FROM VARS WHERE varname='InitialLoad'")" ]] ||
+        error "initial load marker should be removed"
+
+    echo "2-Checking DB contents..."
+    find $RH_ROOT | sort > fs.list
+    $FIND -f $cfg -printf "%p\n" | sort > db.list
+    [ "$DEBUG" = "1" ] && diff fs.list db.list
+    diff -q fs.list db.list || error "DB contents differ from filesystem"
+
+    echo "3-Checking indexes and accounting..."
+    mysql $RH_DB -Bse "SHOW INDEX FROM NAMES" | grep -q id_index ||
+        error "NAMES indexes should be built"
+    mysql $RH_DB -Bse "SHOW TRIGGERS" | grep -q ACCT_ENTRY_INSERT ||
+        error "accounting triggers should be created"
+    check_acct_count
+
+    echo "4-Scanning again (regular inserts)..."
+    touch $RH_ROOT/dir.1/new_file
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log ||
+        error "scanning"
+    check_db_error rh_scan.log
+    grep -q "Initial load started" rh_scan.log &&
+        error "no initial load expected on a non-empty DB"
+    $FIND -f $cfg -printf "%p\n" | grep -q "$RH_ROOT/dir.1/new_file$" ||
+        error "new_file should be in DB"
+    check_acct_count
+
+    rm -f fs.list db.list
+}
+
+function test_acct_markers
+{
+    local cfg=$RBH_CFG_DIR/$1
+    local lock_pid
+
+    clean_logs
+
+    mkdir -p $RH_ROOT/dir.{1..3}
+    touch $RH_ROOT/dir.{1..3}/file.{1..20}
+
+    echo "1-Scanning with aggregated accounting..."
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+    check_acct_count
+    [[ -z "$(mysql $RH_DB -Bse "SELECT varname FROM VARS WHERE varname LIKE 'AcctDeltas%'")" ]] ||
+        error "accounting marker should be removed on clean exit"
+
+    echo "2-Stale marker of a terminated process..."
+    mysql $RH_DB -Bse "UPDATE ACCT_STAT SET count=count+100"
+    mysql $RH_DB -Bse "INSERT INTO VARS (varname,value) VALUES ('AcctDeltas_otherhost:1','0')"
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+    grep -q "rebuilding accounting info" rh_scan.log ||
+        error "ACCT_STAT should be rebuilt"
+    check_acct_count
+    [[ -z "$(mysql $RH_DB -Bse "SELECT varname FROM VARS WHERE varname LIKE 'AcctDeltas%'")" ]] ||
+        error "stale marker should be removed"
+
+    echo "3-Marker of a running process..."
+    # hold the lock of a marker from another connection for 10s
+    mysql $RH_DB -Bse "SELECT GET_LOCK(SHA1(CONCAT(DATABASE(),'/','AcctDeltas_otherhost:2')),0), SLEEP(10)" > /dev/null &
+    lock_pid=$!
+    sleep 2
+    mysql $RH_DB -Bse "INSERT INTO VARS (varname,value) VALUES ('AcctDeltas_otherhost:1','0'),('AcctDeltas_otherhost:2','0')"
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+    grep -q "postponing the rebuild" rh_scan.log ||
+        error "rebuild should be postponed while a process is running"
+    grep -q "rebuilding accounting info" rh_scan.log &&
+        error "ACCT_STAT should not be rebuilt while a process is running"
+    [[ "$(mysql $RH_DB -Bse "SELECT COUNT(*) FROM VARS WHERE varname LIKE 'AcctDeltas%'")" == "2" ]] ||
+        error "markers should be kept"
+
+    # the lock is released when the connection closes
+    wait $lock_pid
+
+    echo "4-Running process terminated..."
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+    grep -q "rebuilding accounting info" rh_scan.log ||
+        error "ACCT_STAT should be rebuilt"
+    check_acct_count
+    [[ -z "$(mysql $RH_DB -Bse "SELECT varname FROM VARS WHERE varname LIKE 'AcctDeltas%'")" ]] ||
+        error "markers should be removed"
+}
+
+# compare the paths of entries in DB to the filesystem
+function check_db_paths
+{
+    local cfg=$1
+
+    find $RH_ROOT | sort > fs.list
+    $FIND -f $cfg -printf "%p\n" | sort > db.list
+    [ "$DEBUG" = "1" ] && diff fs.list db.list
+    diff -q fs.list db.list || error "DB paths differ from filesystem"
+    rm -f fs.list db.list
+}
+
+function test_path_cache
+{
+    local cfg=$RBH_CFG_DIR/$1
+
+    clean_logs
+
+    # more directories than the cache can hold
+    mkdir -p $RH_ROOT/dir.{1..6}/sub.{1..3}
+    touch $RH_ROOT/dir.{1..6}/sub.{1..3}/file.{1..3}
+
+    echo "1-Scanning..."
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+    check_db_paths $cfg
+
+    echo "2-Renaming a directory and removing another..."
+    mv $RH_ROOT/dir.1 $RH_ROOT/dir.renamed
+    mv $RH_ROOT/dir.3/sub.1 $RH_ROOT/dir.4/sub.moved
+    rm -rf $RH_ROOT/dir.2
+    # make sure the moved entries are eligible for GC
+    sleep 1
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+
+    echo "3-Checking paths..."
+    check_db_paths $cfg
+    $REPORT -f $cfg --dump -q > report.out || error "performing --dump report"
+    grep -E "$RH_ROOT/dir\.[12](/|$)" report.out &&
+        error "old paths should not be reported"
+    grep -q "$RH_ROOT/dir.4/sub.moved/file.1$" report.out ||
+        error "moved directory should be reported with its new path"
+
+    rm -f report.out
+}
+
+function test_read_replicas
+{
+    local cfg=$RBH_CFG_DIR/$1
+
+    clean_logs
+
+    mkdir -p $RH_ROOT/dir.{1..3}
+    touch $RH_ROOT/dir.{1..3}/file.{1..5}
+
+    echo "1-Scanning..."
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+
+    echo "2-Reading entries from replicas..."
+    $REPORT -f $cfg --dump -q -l DEBUG > report.out 2> rh_report.log ||
+        error "performing --dump report"
+    grep "Replica '127.0.0.1' is not available" rh_report.log ||
+        error "unreachable replica should be reported"
+    grep "New connection to replica 'localhost'" rh_report.log ||
+        error "the available replica should be used"
+    (( $(grep -c "$RH_ROOT/dir.*/file\." report.out) == 15 )) ||
+        error "15 files expected in --dump report"
+
+    $FIND -f $cfg $RH_ROOT -type f > find.out || error "rbh-find"
+    (( $(wc -l < find.out) == 15 )) || error "15 files expected from rbh-find"
+
+    rm -f report.out find.out rh_report.log
+}
+
+function test_iterator_pages
+{
+    local cfg=$RBH_CFG_DIR/$1
+    local i
+
+    clean_logs
+
+    # distinct sizes, and a set of equal sizes spanning several pages
+    mkdir -p $RH_ROOT/dir.{1..2}
+    for i in {1..30}; do
+        dd if=/dev/zero of=$RH_ROOT/dir.1/file.$i bs=1k count=$i \
+            2>/dev/null || error "writing file"
+    done
+    touch $RH_ROOT/dir.2/empty.{1..15}
+
+    echo "1-Scanning..."
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+
+    echo "2-Listing all entries by pages..."
+    find $RH_ROOT | sort > fs.list
+    $FIND -f $cfg -printf "%p\n" | sort > db.list
+    [ "$DEBUG" = "1" ] && diff fs.list db.list
+    diff -q fs.list db.list || error "paged listing differs from filesystem"
+
+    echo "3-Sorted listing by pages..."
+    $REPORT -f $cfg --top-size=40 --csv -q -l FULL > report.out 2> report.log ||
+        error "performing --top-size report"
+    grep -q "LIMIT 7" report.log || error "iterator should read by pages"
+    [[ $(wc -l < report.out) == 40 ]] ||
+        error "40 entries expected in report, got $(wc -l < report.out)"
+
+    # the 30 non-empty files in decreasing size order
+    for i in {1..30}; do echo "$RH_ROOT/dir.1/file.$((31 - i))"; done \
+        > expected.list
+    awk -F', *' '{print $2}' report.out | head -n 30 > top.list
+    [ "$DEBUG" = "1" ] && diff expected.list top.list
+    diff -q expected.list top.list || error "unexpected order of largest files"
+
+    # then 10 distinct empty files
+    awk -F', *' '{print $2}' report.out | tail -n 10 | sort -u |
+        grep -c "$RH_ROOT/dir.2/empty" | grep -qx 10 ||
+        error "10 distinct empty files expected after largest files"
+
+    echo "4-Limit on a page boundary..."
+    $REPORT -f $cfg --top-size=14 --csv -q > report.out ||
+        error "performing --top-size report"
+    [[ $(wc -l < report.out) == 14 ]] ||
+        error "14 entries expected in report, got $(wc -l < report.out)"
+
+    rm -f fs.list db.list report.out report.log expected.list top.list
+}
+
+# compare the paths and sizes of files in DB to the filesystem
+function check_db_files
+{
+    local cfg=$1
+    local dir=$2
+
+    find $dir -type f -printf "%p %s\n" | sort > fs.list
+    $FIND -f $cfg $dir -type f -printf "%p %s\n" | sort > db.list
+    [ "$DEBUG" = "1" ] && diff fs.list db.list
+    diff -q fs.list db.list || error "DB files differ from filesystem"
+    rm -f fs.list db.list
+}
+
+function test_db_apply_async
+{
+    local cfg=$RBH_CFG_DIR/$1
+    local dir=$RH_ROOT/dir.async
+    local i
+    local j
+
+    clean_logs
+
+    mkdir -p $dir
+    touch $dir/file.{1..30}
+
+    echo "1-Scanning..."
+    $RH -f $cfg --scan --once -l DEBUG -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+    grep "not start its async DB thread" rh_scan.log &&
+        error "DB operations should be asynchronous"
+    check_db_files $cfg $dir
+
+    if (( $no_log )); then
+        echo "Changelogs not supported on this config: scan only"
+        return 0
+    fi
+    # ignore the records of the initial creation
+    $RH -f $cfg --readlog --once -l EVENT -L rh_chglogs.log ||
+        error "reading changelog"
+
+    echo "2-Modifying the same entries several times..."
+    for j in {1..5}; do
+        for i in {1..30}; do
+            echo "$j" >> $dir/file.$i
+            chmod 60$((j % 8)) $dir/file.$i
+            mv $dir/file.$i $dir/file.$i.tmp
+            mv $dir/file.$i.tmp $dir/file.$i
+        done
+    done
+    rm -f $dir/file.{1..30..3}
+
+    echo "3-Reading changelogs..."
+    :> rh_chglogs.log
+    $RH -f $cfg --readlog --once -l FULL -L rh_chglogs.log ||
+        error "reading changelog"
+    check_db_error rh_chglogs.log
+
+    # records of an entry must be applied by increasing index
+    grep " applied" rh_chglogs.log |
+        sed -e "s/.*record #\([0-9]*\) of \([^ ]*\) applied.*/\2 \1/" |
+        awk '$2 <= last[$1] { print "record " $2 " of " $1 " applied after " last[$1]; bad=1 }
+             { last[$1] = $2 }
+             END { exit bad }' || error "records applied out of order"
+
+    check_db_files $cfg $dir
+}
+
+function snapshot_reports
+{
+    local cfg=$1
+    local opt=$2
+
+    $REPORT -f $cfg --fs-info --csv -q -l DEBUG $opt > report.out 2> report.log ||
+        error "performing --fs-info report"
+    $REPORT -f $cfg --user-info --csv -q -l DEBUG $opt 2>> report.log |
+        sort >> report.out || error "performing --user-info report"
+}
+
+# set the export time of a report snapshot (int64 at offset 32 of its header)
+function set_snapshot_time
+{
+    local file=$1
+    local time=$2
+    local bytes=""
+    local i
+
+    for i in {0..7}; do
+        bytes+=$(printf '\\x%02x' $(( (time >> (8 * i)) & 0xff )))
+    done
+    printf "$bytes" | dd of=$file bs=1 seek=32 conv=notrunc 2>/dev/null ||
+        error "setting export time of $file"
+}
+
+function test_report_snapshot
+{
+    local cfg=$RBH_CFG_DIR/$1
+    local snap=/tmp/rbh_report_snapshot
+    local pid
+    local i
+
+    clean_logs
+    rm -f $snap
+
+    mkdir -p $RH_ROOT/dir.{1..3}
+    for i in {1..20}; do
+        dd if=/dev/zero of=$RH_ROOT/dir.$((i % 3 + 1))/file.$i bs=1k count=$i \
+            2>/dev/null || error "writing file"
+    done
+
+    echo "1-Scanning..."
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+
+    echo "2-Exporting snapshot..."
+    $RH -f $cfg --scan -l VERB -L rh_daemon.log &
+    pid=$!
+    for i in {1..30}; do
+        grep -q "Report snapshot .* updated" rh_daemon.log && break
+        sleep 1
+    done
+    kill $pid
+    wait $pid
+    grep -q "Report snapshot .* updated" rh_daemon.log ||
+        error "report snapshot should be exported"
+    [ -f $snap ] || error "$snap should exist"
+    ls $snap.*.tmp 2>/dev/null && error "temporary snapshot should be removed"
+
+    echo "3-Reports from snapshot..."
+    snapshot_reports $cfg ""
+    grep -q "Report computed from snapshot" report.log ||
+        error "reports should be computed from snapshot"
+    mv report.out snap.out
+    snapshot_reports $cfg "--force-no-snapshot"
+    grep -q "Report computed from snapshot" report.log &&
+        error "--force-no-snapshot should query the database"
+    [ "$DEBUG" = "1" ] && diff snap.out report.out
+    diff -q snap.out report.out || error "snapshot and DB reports differ"
+
+    echo "4-Reports from a recent snapshot after DB changes..."
+    touch $RH_ROOT/dir.1/new.{1..5}
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+    snapshot_reports $cfg ""
+    grep -q "Report computed from snapshot" report.log ||
+        error "reports should be computed from snapshot"
+    diff -q snap.out report.out ||
+        error "reports should show the contents of the snapshot"
+
+    echo "5-Reports from an outdated snapshot..."
+    # older than 2 snapshot intervals
+    set_snapshot_time $snap $(( $(date +%s) - 3 * 3600 ))
+    snapshot_reports $cfg ""
+    grep -q "Report snapshot is too old" report.log ||
+        error "snapshot should be too old"
+    mv report.out snap.out
+    snapshot_reports $cfg "--force-no-snapshot"
+    diff -q snap.out report.out || error "reports should query the database"
+
+    rm -f $snap snap.out report.out report.log
+}
+
+function test_policy_indexes
+{
+    local cfg=$RBH_CFG_DIR/$1
+
+    clean_logs
+
+    mkdir -p $RH_ROOT/dir.1
+    touch $RH_ROOT/dir.1/file.{1..10}
+
+    echo "1-Scanning..."
+    $RH -f $cfg --scan --once -l VERB -L rh_scan.log || error "scanning"
+    check_db_error rh_scan.log
+
+    echo "2-Running the policy..."
+    $RH -f $cfg --run=purge --target=all --dry-run -l EVENT \
+        -L rh_purge.log || error "running purge"
+    check_db_error rh_purge.log
+    grep -q "Creating index fileclass_size_index" rh_purge.log ||
+        error "index derived from the policy should be created"
+    mysql $RH_DB -Bse "SHOW INDEX FROM ENTRIES" |
+        grep -q fileclass_size_index || error "missing fileclass_size_index"
+    grep -q "Execution plan of request" rh_purge.log ||
+        error "execution plan of the policy request should be logged"
+
+    echo "3-Running it again..."
+    :> rh_purge.log
+    $RH -f $cfg --run=purge --target=all --dry-run -l EVENT \
+        -L rh_purge.log || error "running purge"
+    grep "Creating index" rh_purge.log && error "index should exist already"
+}
+
 
 ###########################################################
 ############### End changelog functions ###################
@@ -14102,6 +14764,18 @@ run_test 124 test_commit_update commit_update.conf "Update of last committed cha
 run_test 125a test_path_gc1 test_rm1.conf "Test namespace garbage collection with partial scans"
 run_test 125b test_path_gc2 test_rm1.conf "Test namespace garbage collection after rename"
 run_test 126  test_scan_only test_scan_only.conf "Scan on a subset of directories"
+run_test 127  test_cl_fold cl_fold.conf "Records of removed entries folded in the reader queue"
+run_test 128  test_cl_spill cl_spill.conf "Spilled changelog records kept across a crash"
+run_test 129  test_cl_replay cl_capture.conf cl_replay.conf "Replay of captured records by several decoders"
+run_test 130  test_batch_softrm test_rm1.conf 50 "Batched soft removals read from changelogs"
+run_test 131  test_initial_load initial_load.conf "Initial load of an empty DB by chunks"
+run_test 132  test_acct_markers acct_aggregate.conf "Recovery of aggregated accounting per process"
+run_test 133  test_path_cache path_cache.conf "Paths built from a cache of directories"
+run_test 134  test_read_replicas read_replicas.conf "Read requests sent to replicas, or to the primary server"
+run_test 135  test_iterator_pages iterator_pages.conf "Iterators reading results by pages"
+run_test 136  test_db_apply_async db_apply_async.conf "Asynchronous DB operations applied in order"
+run_test 137  test_report_snapshot report_snapshot.conf "Reports computed from a snapshot file"
+run_test 138  test_policy_indexes policy_indexes.conf "Indexes derived from policies"
 
 #### policy matching tests  ####
 